@@ -1,5 +1,19 @@
 #pragma once
 
+// host byte order
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define LH_BIG_ENDIAN 1
+#else
+#define LH_LITTLE_ENDIAN 1
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+// SSE2 is always present, higher instruction sets are detected at runtime
+#define HAVE_X86_SIMD 1
+
+#endif
+
 #ifdef __linux__
 
 //#define HAVE_BUILTIN_BSWAP16 1
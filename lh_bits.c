@@ -0,0 +1,697 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include <string.h>
+#include <pthread.h>
+
+#include "lh_bits.h"
+#include "lh_cpu.h"
+
+// the layout is padded only if the values do not fill the words exactly
+#define IS_PADDED(bits,flags) (((flags) & LH_BITS_PADDED) && (64%(bits)) != 0)
+
+ssize_t lh_bits_size(ssize_t n, int bits, int flags) {
+    if (bits <= 0) return 0;
+    if (IS_PADDED(bits,flags)) {
+        ssize_t per = 64/bits;
+        return (n+per-1)/per*8;
+    }
+    return (n*bits+63)/64*8;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Scalar implementations
+
+// load a word, or the bytes left before the end
+static inline uint64_t load_word(const uint8_t *p, const uint8_t *end) {
+    if (end-p >= 8) return lh_parse_long_le((uint8_t *)p);
+    uint64_t w = 0;
+    int k;
+    for(k=0; p+k<end; k++) w |= (uint64_t)p[k] << (8*k);
+    return w;
+}
+
+// Unpack the values from i on. In the contiguous layout, i must be at a
+// byte boundary, in the padded one, at a word boundary.
+
+#define def_unpack_scalar(name,type)                                    \
+    static void unpack_##name(type *v, ssize_t i, ssize_t n,            \
+                              const uint8_t *p, const uint8_t *end,     \
+                              int bits) {                               \
+        uint64_t mask = ((uint64_t)1<<bits)-1;                          \
+        uint64_t cur = 0;                                               \
+        int have = 0;                                                   \
+        p += i*bits/8;                                                  \
+        for(; i<n; i++) {                                               \
+            if (have >= bits) {                                         \
+                v[i] = cur & mask;                                      \
+                cur >>= bits;                                           \
+                have -= bits;                                           \
+            }                                                           \
+            else {                                                      \
+                uint64_t next = load_word(p, end);                      \
+                p += 8;                                                 \
+                v[i] = (cur | next<<have) & mask;                       \
+                cur = next >> (bits-have);                              \
+                have = 64-(bits-have);                                  \
+            }                                                           \
+        }                                                               \
+    }                                                                   \
+                                                                        \
+    static void unpack_padded_##name(type *v, ssize_t i, ssize_t n,     \
+                                     const uint8_t *p, int bits) {      \
+        uint64_t mask = ((uint64_t)1<<bits)-1;                          \
+        int per = 64/bits;                                              \
+        p += i/per*8;                                                   \
+        while (i<n) {                                                   \
+            uint64_t w = lh_parse_long_le((uint8_t *)p);                \
+            int j;                                                      \
+            p += 8;                                                     \
+            for(j=0; j<per && i<n; j++, i++) {                          \
+                v[i] = w & mask;                                        \
+                w >>= bits;                                             \
+            }                                                           \
+        }                                                               \
+    }
+
+def_unpack_scalar(32,uint32_t);
+def_unpack_scalar(16,uint16_t);
+
+#define def_pack_scalar(name,type)                                      \
+    static ssize_t pack_##name(uint8_t *p, const type *v, ssize_t n,    \
+                               int bits) {                              \
+        uint64_t mask = ((uint64_t)1<<bits)-1;                          \
+        uint64_t acc = 0;                                               \
+        uint8_t *start = p;                                             \
+        int have = 0;                                                   \
+        ssize_t i;                                                      \
+        for(i=0; i<n; i++) {                                            \
+            uint64_t x = v[i] & mask;                                   \
+            acc |= x << have;                                           \
+            have += bits;                                               \
+            if (have >= 64) {                                           \
+                p = lh_place_long_le(p, acc);                           \
+                have -= 64;                                             \
+                acc = have ? x >> (bits-have) : 0;                      \
+            }                                                           \
+        }                                                               \
+        if (have) p = lh_place_long_le(p, acc);                         \
+        return p-start;                                                 \
+    }                                                                   \
+                                                                        \
+    static ssize_t pack_padded_##name(uint8_t *p, const type *v,        \
+                                      ssize_t n, int bits) {            \
+        uint64_t mask = ((uint64_t)1<<bits)-1;                          \
+        int per = 64/bits;                                              \
+        uint8_t *start = p;                                             \
+        ssize_t i = 0;                                                  \
+        while (i<n) {                                                   \
+            uint64_t w = 0;                                             \
+            int j;                                                      \
+            for(j=0; j<per && i<n; j++, i++)                            \
+                w |= (v[i] & mask) << (j*bits);                         \
+            p = lh_place_long_le(p, w);                                 \
+        }                                                               \
+        return p-start;                                                 \
+    }
+
+def_pack_scalar(32,uint32_t);
+def_pack_scalar(16,uint16_t);
+
+////////////////////////////////////////////////////////////////////////////////
+/// SIMD implementations
+
+#ifdef HAVE_X86_SIMD
+
+// Widths up to 25 bits are unpacked 8 values at a time: pshufb gathers
+// the 4 bytes containing each value into its 32-bit lane, and the lanes
+// are shifted by the bit offsets of the values and masked.
+#define SIMD_BITS 25
+
+typedef struct {
+    int8_t  shuf[3][32];    // pshufb masks of up to 3 groups of 8 values
+    int32_t shift[3][8];    // bit offsets within the gathered bytes
+    int     off;            // byte offset of the second 128-bit lane
+    int     groups;         // number of groups per word in the padded layout
+} bits_kernel;
+
+static bits_kernel kern_c[SIMD_BITS+1];
+static bits_kernel kern_p[SIMD_BITS+1];
+static pthread_once_t kern_once = PTHREAD_ONCE_INIT;
+
+static void set_lane(bits_kernel *k, int g, int lane, int s) {
+    int b;
+    for(b=0; b<4; b++) k->shuf[g][4*lane+b] = (s>>3)+b;
+    k->shift[g][lane] = s&7;
+}
+
+static void lh_bits_init() {
+    int bits, g, lane;
+    for(bits=1; bits<=SIMD_BITS; bits++) {
+        // contiguous: 8 values span exactly bits bytes, the upper 128-bit
+        // lane is loaded from the byte of the 5th value
+        bits_kernel *k = &kern_c[bits];
+        k->off = (4*bits)>>3;
+        k->groups = 1;
+        for(lane=0; lane<8; lane++)
+            set_lane(k, 0, lane, lane*bits - ((lane<4) ? 0 : 8*k->off));
+
+        // padded: both 128-bit lanes are loaded from the word. Widths
+        // that divide 64 use the contiguous kernel, the others leave at
+        // most 21 values per word
+        if (64%bits == 0) continue;
+        int per = 64/bits;
+        k = &kern_p[bits];
+        k->off = 0;
+        k->groups = (per+7)/8;
+        memset(k->shuf, 0x80, sizeof(k->shuf));     // pshufb zeroes these lanes
+        for(g=0; g<k->groups; g++)
+            for(lane=0; lane<8; lane++)
+                if (8*g+lane < per)
+                    set_lane(k, g, lane, (8*g+lane)*bits);
+    }
+}
+
+LH_TARGET("avx2")
+static inline __m256i unpack8(const uint8_t *p, const bits_kernel *k, int g, __m256i mask) {
+    __m256i d = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+        _mm_loadu_si128((const __m128i *)(p+k->off)), 1);
+    d = _mm256_shuffle_epi8(d, _mm256_loadu_si256((const __m256i *)k->shuf[g]));
+    d = _mm256_srlv_epi32(d, _mm256_loadu_si256((const __m256i *)k->shift[g]));
+    return _mm256_and_si256(d, mask);
+}
+
+LH_TARGET("avx2")
+static inline void store8_32(uint32_t *v, __m256i x) {
+    _mm256_storeu_si256((__m256i *)v, x);
+}
+
+LH_TARGET("avx2")
+static inline void store8_16(uint16_t *v, __m256i x) {
+    __m128i lo = _mm256_castsi256_si128(x);
+    __m128i hi = _mm256_extracti128_si256(x, 1);
+    _mm_storeu_si128((__m128i *)v, _mm_packus_epi32(lo, hi));
+}
+
+// Both kernels return the number of values done. The loads of 16 bytes
+// may read past the last value, so the kernels stop 32 bytes before the
+// end of the readable data and leave the rest to the scalar code.
+
+#define def_unpack_avx2(name,type)                                      \
+    LH_TARGET("avx2")                                                   \
+    static ssize_t unpack_avx2_##name(type *v, ssize_t n,               \
+                                      const uint8_t *p, ssize_t avail,  \
+                                      int bits) {                       \
+        const bits_kernel *k = &kern_c[bits];                           \
+        __m256i mask = _mm256_set1_epi32((1<<bits)-1);                  \
+        const uint8_t *end = p+avail-32;                                \
+        ssize_t i = 0;                                                  \
+        for(; i+16<=n && p+bits<=end; i+=16, p+=2*bits) {               \
+            store8_##name(v+i, unpack8(p, k, 0, mask));                 \
+            store8_##name(v+i+8, unpack8(p+bits, k, 0, mask));          \
+        }                                                               \
+        return i;                                                       \
+    }                                                                   \
+                                                                        \
+    LH_TARGET("avx2")                                                   \
+    static ssize_t unpack_padded_avx2_##name(type *v, ssize_t n,        \
+                                             const uint8_t *p,          \
+                                             ssize_t avail, int bits) { \
+        const bits_kernel *k = &kern_p[bits];                           \
+        __m256i mask = _mm256_set1_epi32((1<<bits)-1);                  \
+        const uint8_t *end = p+avail-32;                                \
+        int per = 64/bits, g;                                           \
+        ssize_t i = 0;                                                  \
+        /* the groups of a word overlap the values of the next words */ \
+        for(; i+8*k->groups<=n && p<=end; i+=per, p+=8)                 \
+            for(g=0; g<k->groups; g++)                                  \
+                store8_##name(v+i+8*g, unpack8(p, k, g, mask));         \
+        return i;                                                       \
+    }
+
+def_unpack_avx2(32,uint32_t);
+def_unpack_avx2(16,uint16_t);
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// Bulk functions
+
+// The SIMD kernels may read ahead up to avail bytes of src, the scalar
+// code reads only the size bytes of the packed data.
+#define def_unpack(name,type,maxbits)                                   \
+    static void bits_unpack_##name(type *v, ssize_t n,                  \
+                                   const uint8_t *src, ssize_t size,    \
+                                   ssize_t avail, int bits,             \
+                                   int padded) {                        \
+        ssize_t i = 0;                                                  \
+        if (bits == 0) {                                                \
+            memset(v, 0, n*sizeof(type));                               \
+            return;                                                     \
+        }                                                               \
+        SIMD_UNPACK(name);                                              \
+        if (padded)                                                     \
+            unpack_padded_##name(v, i, n, src, bits);                   \
+        else                                                            \
+            unpack_##name(v, i, n, src, src+size, bits);                \
+    }                                                                   \
+                                                                        \
+    ssize_t lh_bits_unpack##name(type *v, ssize_t n, const void *src,   \
+                                 ssize_t len, int bits, int flags) {    \
+        if (bits < 0 || bits > maxbits) return -1;                      \
+        ssize_t size = lh_bits_size(n, bits, flags);                    \
+        if (len < size) return -1;                                      \
+        bits_unpack_##name(v, n, src, size, size, bits,                 \
+                           bits && IS_PADDED(bits,flags));              \
+        return size;                                                    \
+    }
+
+#ifdef HAVE_X86_SIMD
+#define SIMD_UNPACK(name)                                               \
+    if (bits <= SIMD_BITS && lh_cpu_has(LH_CPU_AVX2)) {                 \
+        pthread_once(&kern_once, lh_bits_init);                         \
+        i = padded ? unpack_padded_avx2_##name(v, n, src, avail, bits)  \
+                   : unpack_avx2_##name(v, n, src, avail, bits);        \
+    }
+#else
+#define SIMD_UNPACK(name)
+#endif
+
+def_unpack(32,uint32_t,32);
+def_unpack(16,uint16_t,16);
+
+#define def_pack(name,type,maxbits)                                     \
+    ssize_t lh_bits_pack##name(void *dst, const type *v, ssize_t n,     \
+                               int bits, int flags) {                   \
+        if (bits < 0 || bits > maxbits) return -1;                      \
+        if (bits == 0) return 0;                                        \
+        if (IS_PADDED(bits,flags))                                      \
+            return pack_padded_##name(dst, v, n, bits);                 \
+        return pack_##name(dst, v, n, bits);                            \
+    }
+
+def_pack(32,uint32_t,32);
+def_pack(16,uint16_t,16);
+
+////////////////////////////////////////////////////////////////////////////////
+/// Frame-of-reference arrays
+
+#define FOR_MAXBLOCK 256
+
+static inline int for_bsize(int flags) {
+    return (flags & LH_FOR_256) ? 256 : 128;
+}
+
+// number of values in block k
+static inline ssize_t for_count(const lh_for_array *a, ssize_t k) {
+    ssize_t left = a->n-k*a->bsize;
+    return (left < a->bsize) ? left : a->bsize;
+}
+
+// number of width checkpoints of nblocks blocks
+static inline ssize_t for_nckpt(ssize_t nblocks) {
+    return (nblocks+LH_FOR_CKPT-1)/LH_FOR_CKPT;
+}
+
+// offset of the packed data of block k, from the checkpoint before it
+// and fewer than LH_FOR_CKPT widths
+static inline ssize_t for_offset(const lh_for_array *a, ssize_t k) {
+    ssize_t i = k-k%LH_FOR_CKPT;
+    ssize_t sum = lh_parse_int_le((uint8_t *)a->ckpt+4*(i/LH_FOR_CKPT));
+    for(; i<k; i++) sum += a->width[i];
+    return sum*(a->bsize/8);
+}
+
+static void for_add_scalar(uint32_t *v, ssize_t i, ssize_t n, uint32_t r) {
+    for(; i<n; i++) v[i] += r;
+}
+
+// the first difference of a block is 0, so v[0] becomes r
+static void for_prefix_scalar(uint32_t *v, ssize_t i, ssize_t n, uint32_t r) {
+    uint32_t prev = i ? v[i-1] : r;
+    for(; i<n; i++) v[i] = prev += v[i];
+}
+
+#ifdef HAVE_X86_SIMD
+
+LH_TARGET("sse2")
+static ssize_t for_add_sse2(uint32_t *v, ssize_t n, uint32_t r) {
+    __m128i ref = _mm_set1_epi32(r);
+    ssize_t i;
+    for(i=0; i+8<=n; i+=8) {
+        __m128i x0 = _mm_loadu_si128((__m128i *)(v+i));
+        __m128i x1 = _mm_loadu_si128((__m128i *)(v+i+4));
+        _mm_storeu_si128((__m128i *)(v+i),   _mm_add_epi32(x0, ref));
+        _mm_storeu_si128((__m128i *)(v+i+4), _mm_add_epi32(x1, ref));
+    }
+    return i;
+}
+
+// prefix sums of 4 values in 2 shifted additions, then the running total
+// of the preceding values is added
+LH_TARGET("sse2")
+static ssize_t for_prefix_sse2(uint32_t *v, ssize_t n, uint32_t r) {
+    __m128i run = _mm_set1_epi32(r);
+    ssize_t i;
+    for(i=0; i+4<=n; i+=4) {
+        __m128i x = _mm_loadu_si128((__m128i *)(v+i));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, run);
+        _mm_storeu_si128((__m128i *)(v+i), x);
+        run = _mm_shuffle_epi32(x, 0xff);
+    }
+    return i;
+}
+
+#endif
+
+static void for_restore(uint32_t *v, ssize_t n, uint32_t r, int flags) {
+    ssize_t i = 0;
+    if (flags & LH_FOR_DELTA) {
+#ifdef HAVE_X86_SIMD
+        if (lh_cpu_has(LH_CPU_SSE2)) i = for_prefix_sse2(v, n, r);
+#endif
+        for_prefix_scalar(v, i, n, r);
+    }
+    else {
+#ifdef HAVE_X86_SIMD
+        if (lh_cpu_has(LH_CPU_SSE2)) i = for_add_sse2(v, n, r);
+#endif
+        for_add_scalar(v, i, n, r);
+    }
+}
+
+ssize_t lh_buf_put_for_array(lh_buf_t *b, const uint32_t *v, ssize_t n, int flags) {
+    int bsize = for_bsize(flags);
+    ssize_t nblocks = (n+bsize-1)/bsize, nckpt = for_nckpt(nblocks), k, i;
+    uint32_t d[FOR_MAXBLOCK], wsum = 0;
+    flags &= LH_FOR_DELTA|LH_FOR_256;
+
+    // reserve for the worst case of 32-bit widths, trimmed at the end
+    ssize_t start = C(b->data);
+    uint8_t *p = lh_arr_add(GAR4(b->data), 6+5*nblocks+4*nckpt+4*n+8);
+    uint8_t *q = p;
+    q = lh_place_varint(q, n);
+    q = lh_place_char(q, flags);
+    uint8_t *width = q;
+    uint8_t *ref = width+nblocks;
+    uint8_t *ckpt = ref+4*nblocks;
+    q = ckpt+4*nckpt;
+
+    for(k=0; k<nblocks; k++) {
+        const uint32_t *s = v+k*bsize;
+        ssize_t cnt = (n-k*bsize < bsize) ? n-k*bsize : bsize;
+        uint32_t r = s[0], all = 0;
+        if (flags & LH_FOR_DELTA) {
+            d[0] = 0;
+            for(i=1; i<cnt; i++) d[i] = s[i]-s[i-1];
+        }
+        else {
+            for(i=1; i<cnt; i++) if (s[i] < r) r = s[i];
+            for(i=0; i<cnt; i++) d[i] = s[i]-r;
+        }
+        for(i=0; i<cnt; i++) all |= d[i];
+
+        width[k] = all ? 32-__builtin_clz(all) : 0;
+        lh_place_int_le(ref+4*k, r);
+        if (k%LH_FOR_CKPT == 0) lh_place_int_le(ckpt+4*(k/LH_FOR_CKPT), wsum);
+        wsum += width[k];
+        q += lh_bits_pack32(q, d, cnt, width[k], 0);
+    }
+
+    C(b->data) = start+(q-p);
+    return q-p;
+}
+
+int _lh_lread_for_array(uint8_t **p, uint8_t *l, lh_for_array *a) {
+    uint8_t *q = *p;
+    uint32_t n;
+    ssize_t k;
+
+    if (!_lh_lread_varint(&q, l, &n) || q >= l) return 0;
+    a->flags = *q++;
+    if (a->flags & ~(LH_FOR_DELTA|LH_FOR_256)) return 0;
+    a->bsize = for_bsize(a->flags);
+    a->n = n;
+    a->nblocks = (a->n+a->bsize-1)/a->bsize;
+    ssize_t nckpt = for_nckpt(a->nblocks);
+    if (l-q < 5*a->nblocks+4*nckpt) return 0;
+
+    a->width = q;
+    a->ref = q+a->nblocks;
+    a->ckpt = a->ref+4*a->nblocks;
+    a->data = a->ckpt+4*nckpt;
+
+    // the checkpoints must match the widths, so blocks can be located
+    // from them without further checks
+    uint32_t wsum = 0;
+    for(k=0; k<a->nblocks; k++) {
+        if (a->width[k] > 32) return 0;
+        if (k%LH_FOR_CKPT == 0 &&
+            lh_parse_int_le((uint8_t *)a->ckpt+4*(k/LH_FOR_CKPT)) != wsum) return 0;
+        wsum += a->width[k];
+    }
+
+    ssize_t size = 0;
+    if (a->nblocks > 0) {
+        k = a->nblocks-1;
+        size = for_offset(a, k) + lh_bits_size(for_count(a, k), a->width[k], 0);
+    }
+    if (l-a->data < size) return 0;
+
+    a->end = a->data+size;
+    *p = (uint8_t *)a->end;
+    return 1;
+}
+
+ssize_t lh_for_decode_block(const lh_for_array *a, ssize_t k, uint32_t *v) {
+    const uint8_t *s = a->data+for_offset(a, k);
+    ssize_t cnt = for_count(a, k);
+    int w = a->width[k];
+
+    bits_unpack_32(v, cnt, s, lh_bits_size(cnt, w, 0), a->end-s, w, 0);
+    for_restore(v, cnt, lh_parse_int_le((uint8_t *)a->ref+4*k), a->flags);
+    return cnt;
+}
+
+ssize_t lh_for_decode(const lh_for_array *a, uint32_t *v) {
+    const uint8_t *s = a->data;
+    ssize_t k;
+    for(k=0; k<a->nblocks; k++) {
+        ssize_t cnt = for_count(a, k);
+        int w = a->width[k];
+        ssize_t size = lh_bits_size(cnt, w, 0);
+
+        bits_unpack_32(v, cnt, s, size, a->end-s, w, 0);
+        for_restore(v, cnt, lh_parse_int_le((uint8_t *)a->ref+4*k), a->flags);
+        v += cnt;
+        s += size;
+    }
+    return a->n;
+}
+
+uint32_t lh_for_get(const lh_for_array *a, ssize_t i) {
+    ssize_t k = i/a->bsize, j = i%a->bsize;
+    const uint8_t *s = a->data+for_offset(a, k);
+    uint32_t r = lh_parse_int_le((uint8_t *)a->ref+4*k);
+    int w = a->width[k];
+
+    if (!(a->flags & LH_FOR_DELTA))
+        return r+lh_bits_get(s, j, w, 0);
+
+    ssize_t t;
+    for(t=1; t<=j; t++) r += lh_bits_get(s, t, w, 0);
+    return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// XOR-compressed time series
+
+// values wider than LH_BITS_MAX are written in two parts
+static inline void put_long(lh_bitwriter *w, uint64_t v, int n) {
+    if (n > 32) {
+        lh_bitwriter_put(w, v, 32);
+        v >>= 32;
+        n -= 32;
+    }
+    lh_bitwriter_put(w, v, n);
+}
+
+static inline uint64_t get_long(lh_bitreader *r, int n) {
+    if (n > 32) {
+        uint64_t lo = lh_bitreader_get(r, 32);
+        return lo | lh_bitreader_get(r, n-32)<<32;
+    }
+    return lh_bitreader_get(r, n);
+}
+
+// Values of 32 or 64 bits. The codes, in the order of the bits:
+//   0                              same as the previous value
+//   1 0 <bits>                     XOR in the window of the previous value
+//   1 1 <lead:5> <len:5/6> <bits>  XOR in a new window, len 0 is the full width
+// The leading zeros are limited to 31, so they fit in 5 bits.
+static inline void xor_put(lh_bitwriter *w, lh_xor_state *s, uint64_t v, int bits) {
+    uint64_t x = v ^ s->prev;
+    s->prev = v;
+    if (x == 0) {
+        lh_bitwriter_put(w, 0, 1);
+        return;
+    }
+
+    int lead = __builtin_clzll(x)-(64-bits);
+    int trail = __builtin_ctzll(x);
+    if (lead > 31) lead = 31;
+
+    if (s->lead >= 0 && lead >= s->lead && trail >= s->trail) {
+        lh_bitwriter_put(w, 1, 2);
+        put_long(w, x >> s->trail, bits-s->lead-s->trail);
+    }
+    else {
+        int len = bits-lead-trail;
+        int lbits = (bits == 64) ? 6 : 5;
+        lh_bitwriter_put(w, 3 | lead<<2 | (uint64_t)(len & ((1<<lbits)-1))<<7, 7+lbits);
+        put_long(w, x >> trail, len);
+        s->lead = lead;
+        s->trail = trail;
+    }
+}
+
+static inline uint64_t xor_get(lh_bitreader *r, lh_xor_state *s, int bits) {
+    uint64_t c = lh_bitreader_peek(r, 2);
+    if (!(c & 1)) {
+        lh_bitreader_skip(r, 1);
+        return s->prev;
+    }
+
+    if (c & 2) {
+        int lbits = (bits == 64) ? 6 : 5;
+        uint64_t h = lh_bitreader_get(r, 7+lbits);
+        int lead = (h>>2) & 31;
+        int len = h>>7;
+        if (len == 0) len = bits;
+        if (lead+len > bits) {
+            lh_bitreader_fail(r);
+            return 0;
+        }
+        s->lead = lead;
+        s->trail = bits-lead-len;
+    }
+    else {
+        lh_bitreader_skip(r, 2);
+        if (s->lead < 0) {
+            // no window yet
+            lh_bitreader_fail(r);
+            return 0;
+        }
+    }
+
+    s->prev ^= get_long(r, bits-s->lead-s->trail) << s->trail;
+    return r->error ? 0 : s->prev;
+}
+
+void lh_xor_put_double(lh_bitwriter *w, lh_xor_state *s, double v) {
+    uint64_t x;
+    memcpy(&x, &v, 8);
+    xor_put(w, s, x, 64);
+}
+
+void lh_xor_put_float(lh_bitwriter *w, lh_xor_state *s, float v) {
+    uint32_t x;
+    memcpy(&x, &v, 4);
+    xor_put(w, s, x, 32);
+}
+
+double lh_xor_get_double(lh_bitreader *r, lh_xor_state *s) {
+    uint64_t x = xor_get(r, s, 64);
+    double v;
+    memcpy(&v, &x, 8);
+    return v;
+}
+
+float lh_xor_get_float(lh_bitreader *r, lh_xor_state *s) {
+    uint32_t x = xor_get(r, s, 32);
+    float v;
+    memcpy(&v, &x, 4);
+    return v;
+}
+
+// Delta-of-delta codes, in the order of the bits:
+//   0                  0
+//   1 0 <7 bits>       -63..64
+//   1 1 0 <9 bits>     -255..256
+//   1 1 1 0 <12 bits>  -2047..2048
+//   1 1 1 1 0 <32 bits>
+//   1 1 1 1 1 0 <64 bits>
+//   1 1 1 1 1 1        end marker
+// The arithmetic is unsigned, so any timestamps wrap around consistently.
+void lh_dod_put(lh_bitwriter *w, lh_dod_state *s, int64_t t) {
+    int64_t delta = (int64_t)((uint64_t)t-(uint64_t)s->prev);
+    int64_t dod = (int64_t)((uint64_t)delta-(uint64_t)s->delta);
+    s->prev = t;
+    s->delta = delta;
+
+    if (dod == 0)
+        lh_bitwriter_put(w, 0, 1);
+    else if (dod >= -63 && dod <= 64)
+        lh_bitwriter_put(w, 1 | (uint64_t)(dod+63)<<2, 9);
+    else if (dod >= -255 && dod <= 256)
+        lh_bitwriter_put(w, 3 | (uint64_t)(dod+255)<<3, 12);
+    else if (dod >= -2047 && dod <= 2048)
+        lh_bitwriter_put(w, 7 | (uint64_t)(dod+2047)<<4, 16);
+    else if (dod >= INT32_MIN && dod <= INT32_MAX)
+        lh_bitwriter_put(w, 15 | (uint64_t)(uint32_t)dod<<5, 37);
+    else {
+        lh_bitwriter_put(w, 31, 6);
+        put_long(w, dod, 64);
+    }
+}
+
+void lh_dod_put_end(lh_bitwriter *w) {
+    lh_bitwriter_put(w, 63, 6);
+}
+
+int lh_dod_get(lh_bitreader *r, lh_dod_state *s, int64_t *t) {
+    uint64_t c = lh_bitreader_peek(r, 6);
+    int64_t dod;
+
+    switch (__builtin_ctzll(~c)) {
+        case 0:
+            lh_bitreader_skip(r, 1);
+            dod = 0;
+            break;
+        case 1:
+            dod = (int64_t)(lh_bitreader_get(r, 9)>>2)-63;
+            break;
+        case 2:
+            dod = (int64_t)(lh_bitreader_get(r, 12)>>3)-255;
+            break;
+        case 3:
+            dod = (int64_t)(lh_bitreader_get(r, 16)>>4)-2047;
+            break;
+        case 4:
+            dod = (int32_t)(uint32_t)(lh_bitreader_get(r, 37)>>5);
+            break;
+        case 5:
+            lh_bitreader_skip(r, 6);
+            dod = (int64_t)get_long(r, 64);
+            break;
+        default:
+            lh_bitreader_skip(r, 6);
+            return 0;
+    }
+    if (r->error) return 0;
+
+    s->delta = (int64_t)((uint64_t)s->delta+(uint64_t)dod);
+    s->prev = (int64_t)((uint64_t)s->prev+(uint64_t)s->delta);
+    *t = s->prev;
+    return 1;
+}
@@ -0,0 +1,476 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+/*! \file
+ * Bit-level streams and bit-packed integer arrays
+ *
+ * All bit streams are LSB-first: the first value occupies the lowest bits
+ * of the first byte. This is the same as a sequence of little-endian
+ * 64-bit words with the values packed from the lowest bit up, e.g. the
+ * block state arrays of Minecraft chunks, once their longs are in host
+ * order on a little-endian machine.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "lh_buffers.h"
+#include "lh_bytes.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @name Bit Reader
+ * Reads values of up to 56 bits from a byte stream. The bits are buffered
+ * in a 64-bit accumulator, which is refilled with a single unaligned load
+ * as long as 8 bytes remain. Like lh_reader, a read past the end sets a
+ * sticky error and returns 0.
+ *
+ * EXAMPLE:
+ * lh_bitreader r;
+ * lh_bitreader_init(&r, data, len);
+ * int type = lh_bitreader_get(&r, 3);
+ * int len  = lh_bitreader_get(&r, 13);
+ * if (r.error) ...
+ */
+
+typedef struct {
+    const uint8_t * ptr;    // next byte to load into the accumulator
+    const uint8_t * end;    // end of the data
+    uint64_t acc;           // buffered bits, the next bit is bit 0
+    int nbits;              // number of valid bits in acc
+    int error;              // a read went past the end
+} lh_bitreader;
+
+#define LH_BITS_MAX 56
+
+static inline void lh_bitreader_init(lh_bitreader *r, const void *data, ssize_t len) {
+    r->ptr = data;
+    r->end = r->ptr+len;
+    r->acc = 0;
+    r->nbits = 0;
+    r->error = 0;
+}
+
+// Fill the accumulator with at least 56 bits, or as many as remain.
+// The fast path loads a whole word and advances only over the bytes that
+// fit completely - the partial byte is loaded again by the next refill.
+static inline void _lh_bitreader_refill(lh_bitreader *r) {
+    if (__builtin_expect(r->end-r->ptr >= 8, 1)) {
+        r->acc |= lh_parse_long_le((uint8_t *)r->ptr) << r->nbits;
+        r->ptr += (63-r->nbits)>>3;
+        r->nbits |= 56;
+    }
+    else {
+        while (r->nbits <= 56 && r->ptr < r->end) {
+            r->acc |= (uint64_t)*r->ptr++ << r->nbits;
+            r->nbits += 8;
+        }
+    }
+}
+
+/*! \brief Get the next n bits without consuming them
+ * \param n Number of bits, 1 to LH_BITS_MAX
+ * \return The bits, zero-padded if less than n bits remain
+ */
+static inline uint64_t lh_bitreader_peek(lh_bitreader *r, int n) {
+    if (r->nbits < n) _lh_bitreader_refill(r);
+    return r->acc & (((uint64_t)1<<n)-1);
+}
+
+/*! \brief Set the error, e.g. on a malformed value */
+static inline void lh_bitreader_fail(lh_bitreader *r) {
+    r->error = 1;
+    r->ptr = r->end;
+    r->acc = 0;
+    r->nbits = 0;
+}
+
+/*! \brief Consume n bits, after they were examined with lh_bitreader_peek() */
+static inline void lh_bitreader_skip(lh_bitreader *r, int n) {
+    if (__builtin_expect(r->nbits < n, 0)) {
+        lh_bitreader_fail(r);
+        return;
+    }
+    r->acc >>= n;
+    r->nbits -= n;
+}
+
+/*! \brief Read an n-bit value
+ * \param n Number of bits, 0 to LH_BITS_MAX
+ * \return The value, 0 on error
+ */
+static inline uint64_t lh_bitreader_get(lh_bitreader *r, int n) {
+    uint64_t v = lh_bitreader_peek(r, n);
+    lh_bitreader_skip(r, n);
+    return r->error ? 0 : v;
+}
+
+/*! \brief Read a single bit */
+static inline int lh_bitreader_bit(lh_bitreader *r) {
+    return (int)lh_bitreader_get(r, 1);
+}
+
+/*! \brief Number of bits left to read */
+static inline ssize_t lh_bitreader_left(const lh_bitreader *r) {
+    return (r->end-r->ptr)*8+r->nbits;
+}
+
+/*! \brief Skip to the next byte boundary */
+static inline void lh_bitreader_align(lh_bitreader *r) {
+    lh_bitreader_skip(r, r->nbits&7);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @name Bit Writer
+ * Appends values of up to 56 bits to a buffer, through an lh_writer. The
+ * accumulator is flushed with a single 8-byte store whenever the next
+ * value does not fit. lh_bitwriter_finish() writes the last partial byte,
+ * with the unused high bits set to 0.
+ *
+ * EXAMPLE:
+ * lh_bitwriter w;
+ * lh_bitwriter_init(&w, &buf);
+ * lh_bitwriter_put(&w, type, 3);
+ * lh_bitwriter_put(&w, len, 13);
+ * lh_bitwriter_finish(&w);
+ */
+
+typedef struct {
+    lh_writer w;            // byte output
+    uint64_t acc;           // pending bits, from bit 0 up
+    int nbits;              // number of pending bits
+} lh_bitwriter;
+
+/*! \brief Start appending to a buffer, after its current data */
+static inline void lh_bitwriter_init(lh_bitwriter *w, lh_buf_t *b) {
+    lh_writer_init(&w->w, b);
+    w->acc = 0;
+    w->nbits = 0;
+}
+
+// store the whole bytes of the accumulator
+static inline void _lh_bitwriter_flush(lh_bitwriter *w) {
+    lh_writer_reserve(&w->w, 8);
+    lh_place_long_le(w->w.ptr, w->acc);
+    w->w.ptr += w->nbits>>3;
+    w->acc = (w->nbits >= 64) ? 0 : w->acc >> (w->nbits&~7);
+    w->nbits &= 7;
+}
+
+/*! \brief Write an n-bit value
+ * \param v Value, the bits above n are ignored
+ * \param n Number of bits, 0 to LH_BITS_MAX
+ */
+static inline void lh_bitwriter_put(lh_bitwriter *w, uint64_t v, int n) {
+    if (w->nbits+n >= 64) _lh_bitwriter_flush(w);
+    w->acc |= (v & (((uint64_t)1<<n)-1)) << w->nbits;
+    w->nbits += n;
+}
+
+/*! \brief Write a single bit */
+static inline void lh_bitwriter_bit(lh_bitwriter *w, int b) {
+    lh_bitwriter_put(w, b!=0, 1);
+}
+
+/*! \brief Pad with 0 bits to the next byte boundary */
+static inline void lh_bitwriter_align(lh_bitwriter *w) {
+    w->nbits = (w->nbits+7)&~7;
+}
+
+/*! \brief Write the pending bits, padded to a whole byte, and set the
+ * length of the buffer data
+ * \return Length of the buffer data
+ */
+static inline ssize_t lh_bitwriter_finish(lh_bitwriter *w) {
+    lh_bitwriter_align(w);
+    _lh_bitwriter_flush(w);
+    return lh_writer_finish(&w->w);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @name Bit-packed Arrays
+ * Arrays of fixed-width unsigned integers, packed LSB-first into
+ * little-endian 64-bit words. By default the values are packed
+ * contiguously and may span two words. With LH_BITS_PADDED, a value never
+ * spans words: each word holds 64/bits values and its remaining high bits
+ * are unused. This is the layout of the Minecraft block states since 1.16,
+ * the contiguous one is that of the older versions. Both are the same if
+ * bits divides 64.
+ *
+ * The source and destination of the packed data need not be aligned.
+ */
+
+#define LH_BITS_PADDED  1
+
+/*! \brief Size of a packed array
+ * \param n Number of values
+ * \param bits Width of the values, 0 to 32
+ * \param flags LH_BITS_PADDED or 0
+ * \return Size in bytes, always a multiple of 8
+ */
+ssize_t lh_bits_size(ssize_t n, int bits, int flags);
+
+/*! \brief Unpack a bit-packed array
+ * \param v Destination array of n values
+ * \param n Number of values
+ * \param src Packed data
+ * \param len Length of the packed data, at least lh_bits_size()
+ * \param bits Width of the values, 0 to 32 (0 to 16 for lh_bits_unpack16)
+ * \param flags LH_BITS_PADDED or 0
+ * \return Number of bytes used from src, -1 if len is too short or
+ * bits is out of range
+ */
+ssize_t lh_bits_unpack32(uint32_t *v, ssize_t n, const void *src, ssize_t len, int bits, int flags);
+ssize_t lh_bits_unpack16(uint16_t *v, ssize_t n, const void *src, ssize_t len, int bits, int flags);
+
+/*! \brief Pack an array into lh_bits_size() bytes
+ * \param dst Destination for the packed data
+ * \param v Array of n values, the bits above bits are ignored
+ * \param n Number of values
+ * \param bits Width of the values, 0 to 32 (0 to 16 for lh_bits_pack16)
+ * \param flags LH_BITS_PADDED or 0
+ * \return Number of bytes written, -1 if bits is out of range
+ */
+ssize_t lh_bits_pack32(void *dst, const uint32_t *v, ssize_t n, int bits, int flags);
+ssize_t lh_bits_pack16(void *dst, const uint16_t *v, ssize_t n, int bits, int flags);
+
+/*! \brief Get a single value of a packed array
+ * \param src Packed data, of at least lh_bits_size() bytes
+ * \param i Index of the value
+ */
+static inline uint32_t lh_bits_get(const void *src, ssize_t i, int bits, int flags) {
+    if (bits == 0) return 0;
+    const uint8_t *p = src;
+    ssize_t bit;
+    if (flags & LH_BITS_PADDED) {
+        int per = 64/bits;
+        bit = (i/per)*64 + (i%per)*bits;
+    }
+    else {
+        bit = i*bits;
+    }
+    // a value spans at most 5 bytes, read them without going past its last byte
+    uint64_t w = 0;
+    int k, nb = ((bit&7)+bits+7)>>3;
+    for(k=0; k<nb; k++)
+        w |= (uint64_t)p[(bit>>3)+k] << (8*k);
+    return (uint32_t)((w >> (bit&7)) & (((uint64_t)1<<bits)-1));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @name Frame-of-Reference Arrays
+ * A codec for arrays of 32-bit integers that are clustered or sorted, like
+ * IDs, offsets or timestamps. The array is split into blocks of 128 (or
+ * 256) values, and each block is stored as a reference value and the
+ * differences of its values to it, bit-packed with the minimal width for
+ * the block. The reference is the block minimum. With LH_FOR_DELTA it is
+ * the first value of the block, and the differences are to the previous
+ * value, which keeps them small for sorted arrays.
+ *
+ * Format, all integers little-endian:
+ *   varint  n          number of values
+ *   uint8   flags      LH_FOR_* flags
+ *   uint8   width[B]   bit width of each of the B blocks
+ *   uint32  ref[B]     reference value of each block
+ *   uint32  ckpt[C]    sum of the widths before every LH_FOR_CKPT-th block,
+ *                      C = (B+LH_FOR_CKPT-1)/LH_FOR_CKPT
+ *   packed data of the blocks, in the contiguous layout of lh_bits_pack32()
+ *
+ * All blocks except the last have 128/8*width (or 256/8*width) bytes of
+ * packed data, so a single block is located from the checkpoint before it
+ * and fewer than LH_FOR_CKPT widths, and decoded without decoding the
+ * others.
+ *
+ * EXAMPLE:
+ * lh_buf_put_for_array(&buf, ids, n, LH_FOR_DELTA);
+ * ...
+ * lh_for_array a;
+ * if (!lh_lread_for_array(p, l, a)) ... // malformed
+ * uint32_t *ids = malloc(a.n*sizeof(uint32_t));
+ * lh_for_decode(&a, ids);
+ */
+
+#define LH_FOR_DELTA    (1<<0)
+#define LH_FOR_256      (1<<1)
+
+#define LH_FOR_CKPT     16      /* blocks per width checkpoint */
+
+typedef struct {
+    const uint8_t * width;  // widths of the blocks
+    const uint8_t * ref;    // references of the blocks
+    const uint8_t * ckpt;   // width checkpoints
+    const uint8_t * data;   // packed data of the first block
+    const uint8_t * end;    // end of the encoded array
+    ssize_t n;              // number of values
+    ssize_t nblocks;        // number of blocks
+    int bsize;              // number of values per block
+    int flags;              // LH_FOR_* flags
+} lh_for_array;
+
+/*! \brief Append an array in the frame-of-reference format to a buffer
+ * \param b Buffer, the data is appended after C(b->data)
+ * \param v Values
+ * \param n Number of values
+ * \param flags LH_FOR_* flags
+ * \return Number of bytes appended
+ */
+ssize_t lh_buf_put_for_array(lh_buf_t *b, const uint32_t *v, ssize_t n, int flags);
+
+/*! \brief Parse and check the header of an encoded array
+ * \param p Pointer to the source pointer, advanced past the whole array
+ * \param l Limit of the source data
+ * \param a Array descriptor to fill in
+ * \return 1 on success, 0 if the data is truncated or malformed
+ */
+int _lh_lread_for_array(uint8_t **p, uint8_t *l, lh_for_array *a);
+
+#define lh_lread_for_array(p,l,a)   _lh_lread_for_array(&p,l,&a)
+
+/*! \brief Decode all values of an array
+ * \param v Output array of a->n values
+ * \return Number of values decoded
+ */
+ssize_t lh_for_decode(const lh_for_array *a, uint32_t *v);
+
+/*! \brief Decode a single block of an array
+ * \param k Index of the block, 0 to a->nblocks-1
+ * \param v Output array of a->bsize values
+ * \return Number of values decoded, less than a->bsize for the last block
+ */
+ssize_t lh_for_decode_block(const lh_for_array *a, ssize_t k, uint32_t *v);
+
+/*! \brief Get a single value of an array, without decoding its block
+ * With LH_FOR_DELTA, the differences before the value in its block are
+ * summed up.
+ * \param i Index of the value, 0 to a->n-1
+ */
+uint32_t lh_for_get(const lh_for_array *a, ssize_t i);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @name XOR-compressed Time Series
+ * Compression of timestamped measurements as in the Gorilla time series
+ * database. A floating point value is XORed with the previous one, and
+ * only the bits between the leading and trailing zeros of the result are
+ * stored, in the same bit window as for the previous value if they fit.
+ * A timestamp is stored as the difference of its delta to the previous
+ * delta, in a prefix code of 1 to 70 bits - 1 bit for regular intervals.
+ *
+ * The value and timestamp coders keep their state in lh_xor_state and
+ * lh_dod_state and write to a bit writer, so they can be combined into
+ * other layouts. The first value and timestamp are coded against 0.
+ *
+ * lh_series_writer and lh_series_reader code (timestamp, double) pairs
+ * into a single stream, closed by an end marker. The reader returns one
+ * pair at a time, so a stream need not be decoded completely.
+ *
+ * EXAMPLE:
+ * lh_series_writer sw;
+ * lh_series_writer_init(&sw, &buf);
+ * lh_series_put(&sw, now_ms, latency);
+ * ...
+ * lh_series_finish(&sw);
+ *
+ * lh_series_reader sr;
+ * lh_series_reader_init(&sr, P(buf.data), C(buf.data));
+ * while (lh_series_next(&sr, &t, &v)) ...
+ * if (sr.r.error) ... // truncated
+ */
+
+typedef struct {
+    uint64_t prev;          // bits of the previous value
+    int lead, trail;        // bit window of the previous value
+} lh_xor_state;
+
+typedef struct {
+    int64_t prev;           // previous timestamp
+    int64_t delta;          // previous difference of timestamps
+} lh_dod_state;
+
+static inline void lh_xor_init(lh_xor_state *s) {
+    s->prev = 0;
+    s->lead = s->trail = -1;
+}
+
+static inline void lh_dod_init(lh_dod_state *s) {
+    s->prev = s->delta = 0;
+}
+
+void   lh_xor_put_double(lh_bitwriter *w, lh_xor_state *s, double v);
+void   lh_xor_put_float(lh_bitwriter *w, lh_xor_state *s, float v);
+double lh_xor_get_double(lh_bitreader *r, lh_xor_state *s);
+float  lh_xor_get_float(lh_bitreader *r, lh_xor_state *s);
+
+void    lh_dod_put(lh_bitwriter *w, lh_dod_state *s, int64_t t);
+/*! \brief Write the end marker of a timestamp stream */
+void    lh_dod_put_end(lh_bitwriter *w);
+/*! \brief Read a timestamp
+ * \param t Receives the timestamp
+ * \return 1 on success, 0 at the end marker or on a read error
+ */
+int     lh_dod_get(lh_bitreader *r, lh_dod_state *s, int64_t *t);
+
+typedef struct {
+    lh_bitwriter w;
+    lh_dod_state t;
+    lh_xor_state v;
+} lh_series_writer;
+
+typedef struct {
+    lh_bitreader r;
+    lh_dod_state t;
+    lh_xor_state v;
+} lh_series_reader;
+
+/*! \brief Start appending a series to a buffer, after its current data */
+static inline void lh_series_writer_init(lh_series_writer *sw, lh_buf_t *b) {
+    lh_bitwriter_init(&sw->w, b);
+    lh_dod_init(&sw->t);
+    lh_xor_init(&sw->v);
+}
+
+static inline void lh_series_put(lh_series_writer *sw, int64_t t, double v) {
+    lh_dod_put(&sw->w, &sw->t, t);
+    lh_xor_put_double(&sw->w, &sw->v, v);
+}
+
+/*! \brief Write the end marker and set the length of the buffer data
+ * \return Length of the buffer data
+ */
+static inline ssize_t lh_series_finish(lh_series_writer *sw) {
+    lh_dod_put_end(&sw->w);
+    return lh_bitwriter_finish(&sw->w);
+}
+
+static inline void lh_series_reader_init(lh_series_reader *sr, const void *data, ssize_t len) {
+    lh_bitreader_init(&sr->r, data, len);
+    lh_dod_init(&sr->t);
+    lh_xor_init(&sr->v);
+}
+
+/*! \brief Read the next pair of a series
+ * \return 1 on success, 0 at the end of the series or on a read error
+ * (sr->r.error is set then)
+ */
+static inline int lh_series_next(lh_series_reader *sr, int64_t *t, double *v) {
+    if (!lh_dod_get(&sr->r, &sr->t, t)) return 0;
+    *v = lh_xor_get_double(&sr->r, &sr->v);
+    return !sr->r.error;
+}
@@ -0,0 +1,992 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include <pthread.h>
+
+#include "lh_bytes.h"
+#include "lh_cpu.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// Scalar implementations
+
+// the elements are loaded with memcpy, as src and dst may be unaligned
+
+static void bswap16_scalar(uint8_t *d, const uint8_t *s, ssize_t n) {
+    ssize_t i;
+    for(i=0; i<n; i++) {
+        uint16_t v;
+        memcpy(&v, s+2*i, 2);
+        v = lh_bswap_short(v);
+        memcpy(d+2*i, &v, 2);
+    }
+}
+
+static void bswap32_scalar(uint8_t *d, const uint8_t *s, ssize_t n) {
+    ssize_t i;
+    for(i=0; i<n; i++) {
+        uint32_t v;
+        memcpy(&v, s+4*i, 4);
+        v = lh_bswap_int(v);
+        memcpy(d+4*i, &v, 4);
+    }
+}
+
+static void bswap64_scalar(uint8_t *d, const uint8_t *s, ssize_t n) {
+    ssize_t i;
+    for(i=0; i<n; i++) {
+        uint64_t v;
+        memcpy(&v, s+8*i, 8);
+        v = lh_bswap_long(v);
+        memcpy(d+8*i, &v, 8);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// SIMD implementations
+
+#ifdef HAVE_X86_SIMD
+
+// pshufb masks reversing the bytes within each element
+static const int8_t bswap_mask[3][16] __attribute__((aligned(16))) = {
+    { 1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14 },
+    { 3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12 },
+    { 7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8 },
+};
+
+// swap the whole 16-byte blocks of size bytes, returns the bytes done
+LH_TARGET("ssse3")
+static ssize_t bswap_ssse3(uint8_t *d, const uint8_t *s, ssize_t size, int m) {
+    __m128i mask = _mm_load_si128((const __m128i *)bswap_mask[m]);
+    ssize_t i = 0;
+    for(; i+64<=size; i+=64) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(s+i));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(s+i+16));
+        __m128i v2 = _mm_loadu_si128((const __m128i *)(s+i+32));
+        __m128i v3 = _mm_loadu_si128((const __m128i *)(s+i+48));
+        _mm_storeu_si128((__m128i *)(d+i),    _mm_shuffle_epi8(v0, mask));
+        _mm_storeu_si128((__m128i *)(d+i+16), _mm_shuffle_epi8(v1, mask));
+        _mm_storeu_si128((__m128i *)(d+i+32), _mm_shuffle_epi8(v2, mask));
+        _mm_storeu_si128((__m128i *)(d+i+48), _mm_shuffle_epi8(v3, mask));
+    }
+    for(; i+16<=size; i+=16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s+i));
+        _mm_storeu_si128((__m128i *)(d+i), _mm_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+
+LH_TARGET("avx2")
+static ssize_t bswap_avx2(uint8_t *d, const uint8_t *s, ssize_t size, int m) {
+    __m256i mask = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)bswap_mask[m]));
+    ssize_t i = 0;
+    for(; i+128<=size; i+=128) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)(s+i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(s+i+32));
+        __m256i v2 = _mm256_loadu_si256((const __m256i *)(s+i+64));
+        __m256i v3 = _mm256_loadu_si256((const __m256i *)(s+i+96));
+        _mm256_storeu_si256((__m256i *)(d+i),    _mm256_shuffle_epi8(v0, mask));
+        _mm256_storeu_si256((__m256i *)(d+i+32), _mm256_shuffle_epi8(v1, mask));
+        _mm256_storeu_si256((__m256i *)(d+i+64), _mm256_shuffle_epi8(v2, mask));
+        _mm256_storeu_si256((__m256i *)(d+i+96), _mm256_shuffle_epi8(v3, mask));
+    }
+    for(; i+32<=size; i+=32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s+i));
+        _mm256_storeu_si256((__m256i *)(d+i), _mm256_shuffle_epi8(v, mask));
+    }
+    _mm256_zeroupper();
+    return i;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// Dispatch
+
+// swap n elements of 2<<m bytes
+static inline ssize_t bswap_simd(uint8_t *d, const uint8_t *s, ssize_t n, int m) {
+    ssize_t done = 0;
+#ifdef HAVE_X86_SIMD
+    ssize_t size = n<<(m+1);
+    if (lh_cpu_has(LH_CPU_AVX2))
+        done = bswap_avx2(d, s, size, m);
+    else if (lh_cpu_has(LH_CPU_SSSE3))
+        done = bswap_ssse3(d, s, size, m);
+#endif
+    return done>>(m+1);
+}
+
+void lh_bswap_copy_short(void *dst, const void *src, ssize_t n) {
+    ssize_t i = bswap_simd(dst, src, n, 0);
+    bswap16_scalar((uint8_t *)dst+2*i, (const uint8_t *)src+2*i, n-i);
+}
+
+void lh_bswap_copy_int(void *dst, const void *src, ssize_t n) {
+    ssize_t i = bswap_simd(dst, src, n, 1);
+    bswap32_scalar((uint8_t *)dst+4*i, (const uint8_t *)src+4*i, n-i);
+}
+
+void lh_bswap_copy_long(void *dst, const void *src, ssize_t n) {
+    ssize_t i = bswap_simd(dst, src, n, 2);
+    bswap64_scalar((uint8_t *)dst+8*i, (const uint8_t *)src+8*i, n-i);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Bulk numeric conversion
+
+// Scalar conversions of single elements, rounding like the SIMD ones:
+// adding and subtracting 1.5*2^23 rounds a float of smaller magnitude to
+// the nearest even integer, and the clamping returns the lower bound for
+// NaN, like maxps.
+
+#define ROUND_MAGIC 12582912.0f
+
+static inline int32_t round_float(float x) {
+    return (int32_t)((x+ROUND_MAGIC)-ROUND_MAGIC);
+}
+
+static inline float clamp_float(float x, float lo, float hi) {
+    x = (x > lo) ? x : lo;
+    return (x < hi) ? x : hi;
+}
+
+// round to nearest even, NaN keeps the high bits of its payload and is
+// made quiet, as with vcvtps2ph
+static inline uint16_t float_to_half(float x) {
+    uint32_t f, sign;
+    uint16_t h;
+    memcpy(&f, &x, 4);
+    sign = (f>>16) & 0x8000;
+    f &= 0x7fffffff;
+
+    if (f >= 0x47800000) {
+        // too large for a half, infinity or NaN
+        h = (f > 0x7f800000) ? 0x7e00 | ((f>>13) & 0x3ff) : 0x7c00;
+    }
+    else if (f < 0x38800000) {
+        // a subnormal half or zero: adding 0.5 aligns the mantissa and
+        // rounds it in the FPU
+        float v;
+        memcpy(&v, &f, 4);
+        v += 0.5f;
+        memcpy(&f, &v, 4);
+        h = f-0x3f000000;
+    }
+    else {
+        uint32_t odd = (f>>13) & 1;
+        f += ((uint32_t)(15-127)<<23) + 0xfff + odd;
+        h = f>>13;
+    }
+    return sign | h;
+}
+
+static inline float half_to_float(uint16_t h) {
+    uint32_t f = (uint32_t)(h & 0x7fff)<<13;
+    uint32_t exp = f & 0x0f800000;
+    float v;
+
+    f += (uint32_t)(127-15)<<23;
+    if (exp == 0x0f800000) {
+        // infinity or NaN, made quiet as with vcvtph2ps
+        f += (uint32_t)(128-16)<<23;
+        if (f & 0x7fffff) f |= 0x400000;
+    }
+    else if (exp == 0) {
+        // zero or subnormal: renormalize in the FPU
+        f += 1<<23;
+        memcpy(&v, &f, 4);
+        v -= 6.10351562e-05f;       // 2^-14
+        memcpy(&f, &v, 4);
+    }
+    f |= (uint32_t)(h & 0x8000)<<16;
+    memcpy(&v, &f, 4);
+    return v;
+}
+
+static inline uint16_t float_snorm16(float x) { return round_float(clamp_float(x, -1, 1)*32767.0f); }
+static inline uint16_t float_unorm16(float x) { return round_float(clamp_float(x, 0, 1)*65535.0f); }
+static inline uint8_t  float_snorm8(float x)  { return round_float(clamp_float(x, -1, 1)*127.0f); }
+static inline uint8_t  float_unorm8(float x)  { return round_float(clamp_float(x, 0, 1)*255.0f); }
+
+static inline float snorm16_float(uint16_t v) {
+    float x = (int16_t)v*(1.0f/32767);
+    return (x > -1) ? x : -1;
+}
+static inline float unorm16_float(uint16_t v) { return v*(1.0f/65535); }
+static inline float snorm8_float(uint8_t v) {
+    float x = (int8_t)v*(1.0f/127);
+    return (x > -1) ? x : -1;
+}
+static inline float unorm8_float(uint8_t v)   { return v*(1.0f/255); }
+
+static inline float  double_float(double x)   { return (float)x; }
+static inline double float_double(float x)    { return x; }
+
+// scalar loops over the elements from i on, stored elements may be unaligned
+#define def_conv_scalar(name,stype,dtype,conv)                          \
+    static void name##_scalar(void *dst, const void *src,               \
+                              ssize_t i, ssize_t n) {                   \
+        for(; i<n; i++) {                                               \
+            stype s;                                                    \
+            dtype d;                                                    \
+            memcpy(&s, (const uint8_t *)src+i*sizeof(stype), sizeof(stype)); \
+            d = conv(s);                                                \
+            memcpy((uint8_t *)dst+i*sizeof(dtype), &d, sizeof(dtype));  \
+        }                                                               \
+    }
+
+def_conv_scalar(half_enc,    float,    uint16_t, float_to_half);
+def_conv_scalar(half_dec,    uint16_t, float,    half_to_float);
+def_conv_scalar(snorm16_enc, float,    uint16_t, float_snorm16);
+def_conv_scalar(unorm16_enc, float,    uint16_t, float_unorm16);
+def_conv_scalar(snorm8_enc,  float,    uint8_t,  float_snorm8);
+def_conv_scalar(unorm8_enc,  float,    uint8_t,  float_unorm8);
+def_conv_scalar(snorm16_dec, uint16_t, float,    snorm16_float);
+def_conv_scalar(unorm16_dec, uint16_t, float,    unorm16_float);
+def_conv_scalar(snorm8_dec,  uint8_t,  float,    snorm8_float);
+def_conv_scalar(unorm8_dec,  uint8_t,  float,    unorm8_float);
+def_conv_scalar(float_enc,   double,   float,    double_float);
+def_conv_scalar(float_dec,   float,    double,   float_double);
+
+#ifdef HAVE_X86_SIMD
+
+// The kernels convert whole vectors and return the number of elements done
+
+LH_TARGET("avx2,f16c")
+static ssize_t half_enc_f16c(void *dst, const void *src, ssize_t n) {
+    uint8_t *d = dst;
+    const float *s = src;
+    ssize_t i;
+    for(i=0; i+16<=n; i+=16) {
+        __m128i a = _mm256_cvtps_ph(_mm256_loadu_ps(s+i), _MM_FROUND_TO_NEAREST_INT);
+        __m128i b = _mm256_cvtps_ph(_mm256_loadu_ps(s+i+8), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i *)(d+2*i), a);
+        _mm_storeu_si128((__m128i *)(d+2*i+16), b);
+    }
+    return i;
+}
+
+LH_TARGET("avx2,f16c")
+static ssize_t half_dec_f16c(void *dst, const void *src, ssize_t n) {
+    float *d = dst;
+    const uint8_t *s = src;
+    ssize_t i;
+    for(i=0; i+16<=n; i+=16) {
+        __m256 a = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(s+2*i)));
+        __m256 b = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(s+2*i+16)));
+        _mm256_storeu_ps(d+i, a);
+        _mm256_storeu_ps(d+i+8, b);
+    }
+    return i;
+}
+
+// 8 floats, clamped, scaled and rounded to 32-bit integers
+#define NORM_LOAD(s,lo,hi,sc,a,b)                                       \
+    __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(       \
+                    _mm_loadu_ps(s), lo), hi), sc));                    \
+    __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(       \
+                    _mm_loadu_ps((s)+4), lo), hi), sc))
+
+LH_TARGET("sse2")
+static ssize_t snorm16_enc_sse2(void *dst, const void *src, ssize_t n) {
+    __m128 lo = _mm_set1_ps(-1), hi = _mm_set1_ps(1), sc = _mm_set1_ps(32767);
+    uint8_t *d = dst;
+    const float *s = src;
+    ssize_t i;
+    for(i=0; i+8<=n; i+=8) {
+        NORM_LOAD(s+i,lo,hi,sc,a,b);
+        _mm_storeu_si128((__m128i *)(d+2*i), _mm_packs_epi32(a, b));
+    }
+    return i;
+}
+
+// packssdw saturates signed, so the values are biased to the signed range
+LH_TARGET("sse2")
+static ssize_t unorm16_enc_sse2(void *dst, const void *src, ssize_t n) {
+    __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(1), sc = _mm_set1_ps(65535);
+    __m128i bias = _mm_set1_epi32(32768), flip = _mm_set1_epi16(-32768);
+    uint8_t *d = dst;
+    const float *s = src;
+    ssize_t i;
+    for(i=0; i+8<=n; i+=8) {
+        NORM_LOAD(s+i,lo,hi,sc,a,b);
+        __m128i x = _mm_packs_epi32(_mm_sub_epi32(a, bias), _mm_sub_epi32(b, bias));
+        _mm_storeu_si128((__m128i *)(d+2*i), _mm_xor_si128(x, flip));
+    }
+    return i;
+}
+
+LH_TARGET("sse2")
+static ssize_t snorm8_enc_sse2(void *dst, const void *src, ssize_t n) {
+    __m128 lo = _mm_set1_ps(-1), hi = _mm_set1_ps(1), sc = _mm_set1_ps(127);
+    uint8_t *d = dst;
+    const float *s = src;
+    ssize_t i;
+    for(i=0; i+16<=n; i+=16) {
+        NORM_LOAD(s+i,lo,hi,sc,a,b);
+        NORM_LOAD(s+i+8,lo,hi,sc,c,e);
+        __m128i x = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, e));
+        _mm_storeu_si128((__m128i *)(d+i), x);
+    }
+    return i;
+}
+
+LH_TARGET("sse2")
+static ssize_t unorm8_enc_sse2(void *dst, const void *src, ssize_t n) {
+    __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(1), sc = _mm_set1_ps(255);
+    uint8_t *d = dst;
+    const float *s = src;
+    ssize_t i;
+    for(i=0; i+16<=n; i+=16) {
+        NORM_LOAD(s+i,lo,hi,sc,a,b);
+        NORM_LOAD(s+i+8,lo,hi,sc,c,e);
+        __m128i x = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, e));
+        _mm_storeu_si128((__m128i *)(d+i), x);
+    }
+    return i;
+}
+
+// 4 32-bit integers to floats, scaled and clamped to the lower bound
+#define NORM_STORE(d,x,sc,lo)                                           \
+    _mm_storeu_ps(d, _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(x), sc), lo))
+
+LH_TARGET("sse2")
+static ssize_t snorm16_dec_sse2(void *dst, const void *src, ssize_t n) {
+    __m128 sc = _mm_set1_ps(1.0f/32767), lo = _mm_set1_ps(-1);
+    float *d = dst;
+    const uint8_t *s = src;
+    ssize_t i;
+    for(i=0; i+8<=n; i+=8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s+2*i));
+        NORM_STORE(d+i,   _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16), sc, lo);
+        NORM_STORE(d+i+4, _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16), sc, lo);
+    }
+    return i;
+}
+
+LH_TARGET("sse2")
+static ssize_t unorm16_dec_sse2(void *dst, const void *src, ssize_t n) {
+    __m128 sc = _mm_set1_ps(1.0f/65535), lo = _mm_setzero_ps();
+    __m128i z = _mm_setzero_si128();
+    float *d = dst;
+    const uint8_t *s = src;
+    ssize_t i;
+    for(i=0; i+8<=n; i+=8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s+2*i));
+        NORM_STORE(d+i,   _mm_unpacklo_epi16(x, z), sc, lo);
+        NORM_STORE(d+i+4, _mm_unpackhi_epi16(x, z), sc, lo);
+    }
+    return i;
+}
+
+LH_TARGET("sse2")
+static ssize_t snorm8_dec_sse2(void *dst, const void *src, ssize_t n) {
+    __m128 sc = _mm_set1_ps(1.0f/127), lo = _mm_set1_ps(-1);
+    float *d = dst;
+    const uint8_t *s = src;
+    ssize_t i;
+    for(i=0; i+16<=n; i+=16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s+i));
+        __m128i l = _mm_unpacklo_epi8(x, x), h = _mm_unpackhi_epi8(x, x);
+        NORM_STORE(d+i,    _mm_srai_epi32(_mm_unpacklo_epi16(l, l), 24), sc, lo);
+        NORM_STORE(d+i+4,  _mm_srai_epi32(_mm_unpackhi_epi16(l, l), 24), sc, lo);
+        NORM_STORE(d+i+8,  _mm_srai_epi32(_mm_unpacklo_epi16(h, h), 24), sc, lo);
+        NORM_STORE(d+i+12, _mm_srai_epi32(_mm_unpackhi_epi16(h, h), 24), sc, lo);
+    }
+    return i;
+}
+
+LH_TARGET("sse2")
+static ssize_t unorm8_dec_sse2(void *dst, const void *src, ssize_t n) {
+    __m128 sc = _mm_set1_ps(1.0f/255), lo = _mm_setzero_ps();
+    __m128i z = _mm_setzero_si128();
+    float *d = dst;
+    const uint8_t *s = src;
+    ssize_t i;
+    for(i=0; i+16<=n; i+=16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s+i));
+        __m128i l = _mm_unpacklo_epi8(x, z), h = _mm_unpackhi_epi8(x, z);
+        NORM_STORE(d+i,    _mm_unpacklo_epi16(l, z), sc, lo);
+        NORM_STORE(d+i+4,  _mm_unpackhi_epi16(l, z), sc, lo);
+        NORM_STORE(d+i+8,  _mm_unpacklo_epi16(h, z), sc, lo);
+        NORM_STORE(d+i+12, _mm_unpackhi_epi16(h, z), sc, lo);
+    }
+    return i;
+}
+
+LH_TARGET("sse2")
+static ssize_t float_enc_sse2(void *dst, const void *src, ssize_t n) {
+    float *d = dst;
+    const double *s = src;
+    ssize_t i;
+    for(i=0; i+4<=n; i+=4) {
+        __m128 a = _mm_cvtpd_ps(_mm_loadu_pd(s+i));
+        __m128 b = _mm_cvtpd_ps(_mm_loadu_pd(s+i+2));
+        _mm_storeu_ps(d+i, _mm_movelh_ps(a, b));
+    }
+    return i;
+}
+
+LH_TARGET("sse2")
+static ssize_t float_dec_sse2(void *dst, const void *src, ssize_t n) {
+    double *d = dst;
+    const float *s = src;
+    ssize_t i;
+    for(i=0; i+4<=n; i+=4) {
+        __m128 x = _mm_loadu_ps(s+i);
+        _mm_storeu_pd(d+i, _mm_cvtps_pd(x));
+        _mm_storeu_pd(d+i+2, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+    }
+    return i;
+}
+
+#define CONV_SIMD(name,isa,mask) \
+    if (lh_cpu_has(mask)) i = name##_##isa(dst, src, n);
+#else
+#define CONV_SIMD(name,isa,mask)
+#endif
+
+// a kernel with the scalar code for the rest
+#define def_conv(name,isa,mask)                                         \
+    static void name(void *dst, const void *src, ssize_t n) {           \
+        ssize_t i = 0;                                                  \
+        CONV_SIMD(name,isa,mask);                                       \
+        name##_scalar(dst, src, i, n);                                  \
+    }
+
+def_conv(half_enc,    f16c, LH_CPU_AVX2|LH_CPU_F16C);
+def_conv(half_dec,    f16c, LH_CPU_AVX2|LH_CPU_F16C);
+def_conv(snorm16_enc, sse2, LH_CPU_SSE2);
+def_conv(unorm16_enc, sse2, LH_CPU_SSE2);
+def_conv(snorm8_enc,  sse2, LH_CPU_SSE2);
+def_conv(unorm8_enc,  sse2, LH_CPU_SSE2);
+def_conv(snorm16_dec, sse2, LH_CPU_SSE2);
+def_conv(unorm16_dec, sse2, LH_CPU_SSE2);
+def_conv(snorm8_dec,  sse2, LH_CPU_SSE2);
+def_conv(unorm8_dec,  sse2, LH_CPU_SSE2);
+def_conv(float_enc,   sse2, LH_CPU_SSE2);
+def_conv(float_dec,   sse2, LH_CPU_SSE2);
+
+// The stored elements are swapped in chunks, while they are in the cache:
+// after converting to them, or into a temporary before converting from them
+
+#define CONV_CHUNK 256
+
+typedef void (*conv_fn)(void *dst, const void *src, ssize_t n);
+
+static inline void conv_swap(void *dst, const void *src, ssize_t n, int size) {
+    if (size == 2)
+        lh_bswap_copy_short(dst, src, n);
+    else
+        lh_bswap_copy_int(dst, src, n);
+}
+
+static void conv_store(uint8_t *d, int dsize, const uint8_t *s, int ssize,
+                       ssize_t n, int flags, conv_fn f) {
+    ssize_t i;
+    if (!(flags & LH_CONV_SWAP)) {
+        f(d, s, n);
+        return;
+    }
+    for(i=0; i<n; i+=CONV_CHUNK) {
+        ssize_t c = (n-i < CONV_CHUNK) ? n-i : CONV_CHUNK;
+        f(d+i*dsize, s+i*ssize, c);
+        conv_swap(d+i*dsize, d+i*dsize, c, dsize);
+    }
+}
+
+static void conv_load(uint8_t *d, int dsize, const uint8_t *s, int ssize,
+                      ssize_t n, int flags, conv_fn f) {
+    uint8_t tmp[CONV_CHUNK*4];
+    ssize_t i;
+    if (!(flags & LH_CONV_SWAP)) {
+        f(d, s, n);
+        return;
+    }
+    for(i=0; i<n; i+=CONV_CHUNK) {
+        ssize_t c = (n-i < CONV_CHUNK) ? n-i : CONV_CHUNK;
+        conv_swap(tmp, s+i*ssize, c, ssize);
+        f(d+i*dsize, tmp, c);
+    }
+}
+
+void lh_float_to_half(void *dst, const float *src, ssize_t n, int flags) {
+    conv_store(dst, 2, (const uint8_t *)src, 4, n, flags, half_enc);
+}
+
+void lh_half_to_float(float *dst, const void *src, ssize_t n, int flags) {
+    conv_load((uint8_t *)dst, 4, src, 2, n, flags, half_dec);
+}
+
+void lh_float_to_snorm16(void *dst, const float *src, ssize_t n, int flags) {
+    conv_store(dst, 2, (const uint8_t *)src, 4, n, flags, snorm16_enc);
+}
+
+void lh_float_to_unorm16(void *dst, const float *src, ssize_t n, int flags) {
+    conv_store(dst, 2, (const uint8_t *)src, 4, n, flags, unorm16_enc);
+}
+
+void lh_snorm16_to_float(float *dst, const void *src, ssize_t n, int flags) {
+    conv_load((uint8_t *)dst, 4, src, 2, n, flags, snorm16_dec);
+}
+
+void lh_unorm16_to_float(float *dst, const void *src, ssize_t n, int flags) {
+    conv_load((uint8_t *)dst, 4, src, 2, n, flags, unorm16_dec);
+}
+
+void lh_float_to_snorm8(void *dst, const float *src, ssize_t n) {
+    snorm8_enc(dst, src, n);
+}
+
+void lh_float_to_unorm8(void *dst, const float *src, ssize_t n) {
+    unorm8_enc(dst, src, n);
+}
+
+void lh_snorm8_to_float(float *dst, const void *src, ssize_t n) {
+    snorm8_dec(dst, src, n);
+}
+
+void lh_unorm8_to_float(float *dst, const void *src, ssize_t n) {
+    unorm8_dec(dst, src, n);
+}
+
+void lh_double_to_float(void *dst, const double *src, ssize_t n, int flags) {
+    conv_store(dst, 4, (const uint8_t *)src, 8, n, flags, float_enc);
+}
+
+void lh_float_to_double(double *dst, const void *src, ssize_t n, int flags) {
+    conv_load((uint8_t *)dst, 8, src, 4, n, flags, float_dec);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Typed array views
+
+// copy between a range of a view and a native array, the conversion is
+// the same in both directions
+static ssize_t view_conv(const lh_view *v, ssize_t off, void *native, ssize_t n, int store) {
+    if (off < 0 || off > v->n) return 0;
+    if (n > v->n-off) n = v->n-off;
+    if (n <= 0) return 0;
+
+    uint8_t *p = v->ptr+off*v->size;
+    void *dst = store ? p : native;
+    const void *src = store ? native : p;
+
+    if (!v->swap || v->size == 1)
+        memmove(dst, src, n*v->size);
+    else if (v->size == 2)
+        lh_bswap_copy_short(dst, src, n);
+    else if (v->size == 4)
+        lh_bswap_copy_int(dst, src, n);
+    else
+        lh_bswap_copy_long(dst, src, n);
+    return n;
+}
+
+ssize_t lh_view_read(const lh_view *v, ssize_t off, void *dst, ssize_t n) {
+    return view_conv(v, off, dst, n, 0);
+}
+
+ssize_t lh_view_write(const lh_view *v, ssize_t off, const void *src, ssize_t n) {
+    return view_conv(v, off, (void *)src, n, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Bulk varint decoding
+
+#ifdef HAVE_X86_SIMD
+
+// The decoder looks at the termination bits (high bit clear) of the next
+// 12 bytes and finds an entry in a table, which tells how to shuffle the
+// bytes of the leading varints into 16-bit or 32-bit lanes, how many
+// varints that decodes and how many bytes they take.
+
+#define VB_SCALAR   0   // first varint longer than 4 bytes
+#define VB_SHORT    1   // up to 8 varints of 1-2 bytes into 16-bit lanes
+#define VB_INT      2   // up to 4 varints of 1-4 bytes into 32-bit lanes
+
+typedef struct {
+    uint8_t shuf[16];
+    uint8_t count;
+    uint8_t bytes;
+    uint8_t shape;
+} vb_entry;
+
+static vb_entry vb_table[1<<12];
+static pthread_once_t vb_once = PTHREAD_ONCE_INIT;
+
+static void lh_varint_init() {
+    int m, i, j;
+    for(m=0; m<(1<<12); m++) {
+        vb_entry *e = &vb_table[m];
+        int len[12], start[12], nv = 0, pos = 0;
+
+        // lengths of the varints terminated within the 12 bytes
+        for(i=0; i<12; i++)
+            if (m & (1<<i)) {
+                start[nv] = pos;
+                len[nv++] = i+1-pos;
+                pos = i+1;
+            }
+
+        memset(e->shuf, 0x80, 16);  // pshufb zeroes these lanes
+        e->shape = VB_SCALAR;
+        if (nv == 0 || len[0] > 4) continue;
+
+        int k2 = 0, k4 = 0;
+        while (k2 < nv && k2 < 8 && len[k2] <= 2) k2++;
+        while (k4 < nv && k4 < 4 && len[k4] <= 4) k4++;
+
+        if (k2 >= k4) {
+            e->shape = VB_SHORT;
+            e->count = k2;
+            for(i=0; i<k2; i++)
+                for(j=0; j<len[i]; j++)
+                    e->shuf[2*i+j] = start[i]+j;
+        }
+        else {
+            e->shape = VB_INT;
+            e->count = k4;
+            for(i=0; i<k4; i++)
+                for(j=0; j<len[i]; j++)
+                    e->shuf[4*i+j] = start[i]+j;
+        }
+        e->bytes = start[e->count-1]+len[e->count-1];
+    }
+}
+
+// store 4 32-bit lanes as uint32_t or uint64_t values
+LH_TARGET("ssse3")
+static inline void vb_store4(void *out, ssize_t i, __m128i v, int wide) {
+    if (wide) {
+        __m128i z = _mm_setzero_si128();
+        _mm_storeu_si128((__m128i *)((uint64_t *)out+i),   _mm_unpacklo_epi32(v, z));
+        _mm_storeu_si128((__m128i *)((uint64_t *)out+i+2), _mm_unpackhi_epi32(v, z));
+    }
+    else
+        _mm_storeu_si128((__m128i *)((uint32_t *)out+i), v);
+}
+
+// decode as many varints as possible while 16 input bytes can be loaded
+// and the output has room for 16 values, returns the number decoded
+LH_TARGET("ssse3")
+static ssize_t vb_decode_ssse3(const uint8_t **pp, const uint8_t *end,
+                               void *out, ssize_t n, int wide) {
+    const uint8_t *p = *pp;
+    const __m128i z = _mm_setzero_si128();
+    ssize_t i = 0;
+
+    while (end-p >= 16 && n-i >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        unsigned cont = _mm_movemask_epi8(v);
+
+        if (!cont) {
+            // 16 single-byte varints
+            __m128i lo = _mm_unpacklo_epi8(v, z), hi = _mm_unpackhi_epi8(v, z);
+            vb_store4(out, i,    _mm_unpacklo_epi16(lo, z), wide);
+            vb_store4(out, i+4,  _mm_unpackhi_epi16(lo, z), wide);
+            vb_store4(out, i+8,  _mm_unpacklo_epi16(hi, z), wide);
+            vb_store4(out, i+12, _mm_unpackhi_epi16(hi, z), wide);
+            p += 16;
+            i += 16;
+            continue;
+        }
+
+        const vb_entry *e = &vb_table[~cont & 0xfff];
+        if (e->shape == VB_SHORT) {
+            __m128i s = _mm_shuffle_epi8(v, _mm_loadu_si128((const __m128i *)e->shuf));
+            s = _mm_or_si128(_mm_and_si128(s, _mm_set1_epi16(0x7f)),
+                             _mm_srli_epi16(_mm_and_si128(s, _mm_set1_epi16(0x7f00)), 1));
+            vb_store4(out, i,   _mm_unpacklo_epi16(s, z), wide);
+            vb_store4(out, i+4, _mm_unpackhi_epi16(s, z), wide);
+        }
+        else if (e->shape == VB_INT) {
+            __m128i s = _mm_shuffle_epi8(v, _mm_loadu_si128((const __m128i *)e->shuf));
+            __m128i r = _mm_and_si128(s, _mm_set1_epi32(0x7f));
+            r = _mm_or_si128(r, _mm_srli_epi32(_mm_and_si128(s, _mm_set1_epi32(0x7f00)), 1));
+            r = _mm_or_si128(r, _mm_srli_epi32(_mm_and_si128(s, _mm_set1_epi32(0x7f0000)), 2));
+            r = _mm_or_si128(r, _mm_srli_epi32(_mm_and_si128(s, _mm_set1_epi32(0x7f000000)), 3));
+            vb_store4(out, i, r, wide);
+        }
+        else {
+            // a long varint
+            uint64_t w;
+            int len = _lh_varint_word(p, &w);
+            if (!len) break;    // longer than 8 bytes, left to the scalar code
+            if (wide)
+                ((uint64_t *)out)[i] = w;
+            else
+                ((uint32_t *)out)[i] = (uint32_t)w;
+            p += len;
+            i++;
+            continue;
+        }
+        p += e->bytes;
+        i += e->count;
+    }
+
+    *pp = p;
+    return i;
+}
+
+#endif
+
+static inline ssize_t vb_decode_simd(uint8_t **p, uint8_t *l, void *v, ssize_t n, int wide) {
+#ifdef HAVE_X86_SIMD
+    if (n >= 16 && lh_cpu_has(LH_CPU_SSSE3)) {
+        pthread_once(&vb_once, lh_varint_init);
+        return vb_decode_ssse3((const uint8_t **)p, l, v, n, wide);
+    }
+#endif
+    return 0;
+}
+
+ssize_t _lh_lread_varint_array(uint8_t **p, uint8_t *l, uint32_t *v, ssize_t n) {
+    ssize_t i = vb_decode_simd(p, l, v, n, 0);
+    for(; i<n; i++)
+        if (!_lh_lread_varint(p, l, v+i)) break;
+    return i;
+}
+
+ssize_t _lh_lread_varlong_array(uint8_t **p, uint8_t *l, uint64_t *v, ssize_t n) {
+    ssize_t i = vb_decode_simd(p, l, v, n, 1);
+    for(; i<n; i++)
+        if (!_lh_lread_varlong(p, l, v+i)) break;
+    return i;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Bulk varint encoding
+
+static inline uint32_t vt_int(const uint32_t *v, ssize_t i, int flags) {
+    uint32_t x = v[i];
+    if (flags&LH_VARINT_DELTA) x -= i ? v[i-1] : 0;
+    if (flags&LH_VARINT_ZIGZAG) x = lh_zigzag_int((int32_t)x);
+    return x;
+}
+
+static inline uint64_t vt_long(const uint64_t *v, ssize_t i, int flags) {
+    uint64_t x = v[i];
+    if (flags&LH_VARINT_DELTA) x -= i ? v[i-1] : 0;
+    if (flags&LH_VARINT_ZIGZAG) x = lh_zigzag_long((int64_t)x);
+    return x;
+}
+
+#ifdef HAVE_X86_SIMD
+
+// The sizes are counted with unsigned compares against the thresholds
+// 2^7-1, 2^14-1, ... (signed compares on values with a flipped sign bit).
+// Each lane sums the -1 masks of the compares it exceeds. The kernels
+// start at element 1, as the first has no predecessor for the delta, and
+// return the size of the elements 1 to *done-1.
+
+LH_TARGET("avx2")
+static ssize_t vsize_int_avx2(const uint32_t *v, ssize_t n, int flags, ssize_t *done) {
+    const __m256i bias = _mm256_set1_epi32(0x80000000);
+    __m256i t[4];
+    int k;
+    for(k=0; k<4; k++)
+        t[k] = _mm256_set1_epi32(((1u<<(7*k+7))-1)^0x80000000);
+
+    ssize_t i = 1, total = 0;
+    while (i+8 <= n) {
+        // lanes count at most 4 per vector - sum them up in blocks
+        ssize_t bend = (n-i > (1<<20)) ? i+(1<<20) : n;
+        __m256i acc = _mm256_setzero_si256();
+        for(; i+8<=bend; i+=8) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(v+i));
+            if (flags&LH_VARINT_DELTA)
+                x = _mm256_sub_epi32(x, _mm256_loadu_si256((const __m256i *)(v+i-1)));
+            if (flags&LH_VARINT_ZIGZAG)
+                x = _mm256_xor_si256(_mm256_slli_epi32(x, 1), _mm256_srai_epi32(x, 31));
+            x = _mm256_xor_si256(x, bias);
+            for(k=0; k<4; k++)
+                acc = _mm256_sub_epi32(acc, _mm256_cmpgt_epi32(x, t[k]));
+        }
+        __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+        total += (uint32_t)_mm_cvtsi128_si32(s);
+        if (bend == n) break;
+    }
+    _mm256_zeroupper();
+
+    *done = i;
+    return total + (i-1);
+}
+
+LH_TARGET("avx2")
+static ssize_t vsize_long_avx2(const uint64_t *v, ssize_t n, int flags, ssize_t *done) {
+    const __m256i bias = _mm256_set1_epi64x(0x8000000000000000LL);
+    __m256i t[9];
+    int k;
+    for(k=0; k<9; k++)
+        t[k] = _mm256_set1_epi64x((int64_t)(((1ULL<<(7*k+7))-1)^0x8000000000000000ULL));
+
+    ssize_t i = 1, total = 0;
+    __m256i acc = _mm256_setzero_si256();
+    for(; i+4<=n; i+=4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(v+i));
+        if (flags&LH_VARINT_DELTA)
+            x = _mm256_sub_epi64(x, _mm256_loadu_si256((const __m256i *)(v+i-1)));
+        if (flags&LH_VARINT_ZIGZAG) {
+            __m256i sign = _mm256_cmpgt_epi64(_mm256_setzero_si256(), x);
+            x = _mm256_xor_si256(_mm256_slli_epi64(x, 1), sign);
+        }
+        x = _mm256_xor_si256(x, bias);
+        for(k=0; k<9; k++)
+            acc = _mm256_sub_epi64(acc, _mm256_cmpgt_epi64(x, t[k]));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    total = lanes[0]+lanes[1]+lanes[2]+lanes[3];
+    _mm256_zeroupper();
+
+    *done = i;
+    return total + (i-1);
+}
+
+#endif
+
+ssize_t lh_varint_size_array(const uint32_t *v, ssize_t n, int flags) {
+    ssize_t i = 0, total = 0;
+#ifdef HAVE_X86_SIMD
+    if (n > 8 && lh_cpu_has(LH_CPU_AVX2))
+        total = lh_varint_size(vt_int(v, 0, flags)) + vsize_int_avx2(v, n, flags, &i);
+#endif
+    for(; i<n; i++)
+        total += lh_varint_size(vt_int(v, i, flags));
+    return total;
+}
+
+ssize_t lh_varlong_size_array(const uint64_t *v, ssize_t n, int flags) {
+    ssize_t i = 0, total = 0;
+#ifdef HAVE_X86_SIMD
+    if (n > 4 && lh_cpu_has(LH_CPU_AVX2))
+        total = lh_varlong_size(vt_long(v, 0, flags)) + vsize_long_avx2(v, n, flags, &i);
+#endif
+    for(; i<n; i++)
+        total += lh_varlong_size(vt_long(v, i, flags));
+    return total;
+}
+
+// Write a varint of a value below 2^56 as a single 8-byte word: the 7-bit
+// groups are spread to bytes and the continuation bits are set on all
+// but the last byte. The buffer must have 8 bytes of room.
+static inline uint8_t * vput_word(uint8_t *p, uint64_t x) {
+#ifdef LH_LITTLE_ENDIAN
+    int len = lh_varlong_size(x);
+    x = ((x & 0x00fffffff0000000ULL) << 4) | (x & 0x000000000fffffffULL);
+    x = ((x & 0x0fffc0000fffc000ULL) << 2) | (x & 0x00003fff00003fffULL);
+    x = ((x & 0x3f803f803f803f80ULL) << 1) | (x & 0x007f007f007f007fULL);
+    x |= 0x8080808080808080ULL & ((1ULL<<(8*len-8))-1);
+    memcpy(p, &x, 8);
+    return p+len;
+#else
+    return lh_place_varlong(p, x);
+#endif
+}
+
+// reserve the exact size plus room for the word stores past the end
+static uint8_t * vput_reserve(lh_buf_t *b, ssize_t size) {
+    uint8_t *p = lh_arr_add(GAR4(b->data), size+8);
+    C(b->data) -= 8;
+    return p;
+}
+
+ssize_t lh_buf_put_varint_array(lh_buf_t *b, const uint32_t *v, ssize_t n, int flags) {
+    ssize_t i, size = lh_varint_size_array(v, n, flags);
+    uint8_t *p = vput_reserve(b, size);
+
+    // separate loops, so the transforms are not tested per element
+    switch (flags&(LH_VARINT_DELTA|LH_VARINT_ZIGZAG)) {
+        case 0:
+            for(i=0; i<n; i++) p = vput_word(p, vt_int(v, i, 0));
+            break;
+        case LH_VARINT_ZIGZAG:
+            for(i=0; i<n; i++) p = vput_word(p, vt_int(v, i, LH_VARINT_ZIGZAG));
+            break;
+        case LH_VARINT_DELTA:
+            for(i=0; i<n; i++) p = vput_word(p, vt_int(v, i, LH_VARINT_DELTA));
+            break;
+        default:
+            for(i=0; i<n; i++) p = vput_word(p, vt_int(v, i, LH_VARINT_DELTA|LH_VARINT_ZIGZAG));
+    }
+    return size;
+}
+
+static inline uint8_t * vput_long(uint8_t *p, uint64_t x) {
+    return (x >> 56) ? lh_place_varlong(p, x) : vput_word(p, x);
+}
+
+ssize_t lh_buf_put_varlong_array(lh_buf_t *b, const uint64_t *v, ssize_t n, int flags) {
+    ssize_t i, size = lh_varlong_size_array(v, n, flags);
+    uint8_t *p = vput_reserve(b, size);
+
+    switch (flags&(LH_VARINT_DELTA|LH_VARINT_ZIGZAG)) {
+        case 0:
+            for(i=0; i<n; i++) p = vput_long(p, vt_long(v, i, 0));
+            break;
+        case LH_VARINT_ZIGZAG:
+            for(i=0; i<n; i++) p = vput_long(p, vt_long(v, i, LH_VARINT_ZIGZAG));
+            break;
+        case LH_VARINT_DELTA:
+            for(i=0; i<n; i++) p = vput_long(p, vt_long(v, i, LH_VARINT_DELTA));
+            break;
+        default:
+            for(i=0; i<n; i++) p = vput_long(p, vt_long(v, i, LH_VARINT_DELTA|LH_VARINT_ZIGZAG));
+    }
+    return size;
+}
+
+void lh_varint_restore(uint32_t *v, ssize_t n, int flags) {
+    ssize_t i;
+    uint32_t prev = 0;
+    for(i=0; i<n; i++) {
+        if (flags&LH_VARINT_ZIGZAG) v[i] = lh_unzigzag_int(v[i]);
+        if (flags&LH_VARINT_DELTA) v[i] = prev += v[i];
+    }
+}
+
+void lh_varlong_restore(uint64_t *v, ssize_t n, int flags) {
+    ssize_t i;
+    uint64_t prev = 0;
+    for(i=0; i<n; i++) {
+        if (flags&LH_VARINT_ZIGZAG) v[i] = lh_unzigzag_long(v[i]);
+        if (flags&LH_VARINT_DELTA) v[i] = prev += v[i];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Writer cursor
+
+void _lh_writer_grow(lh_writer *w, ssize_t n) {
+    lh_buf_t *b = w->buf;
+    ssize_t pos = lh_writer_pos(w);
+
+    // at least double the size, so appending many messages stays linear
+    ssize_t size = pos+n;
+    if (size < 2*pos) size = 2*pos;
+    size = lh_align(size, LH_WRITER_STEP);
+
+    lh_arr_add(GAR4(b->data), size-C(b->data));
+    w->ptr = P(b->data)+pos;
+    w->end = P(b->data)+C(b->data);
+}
+
+void lh_writer_end_varlen(lh_writer *w, ssize_t off) {
+    ssize_t len = lh_writer_since(w, off, 5);
+    int size = lh_varint_size(len);
+    uint8_t *p = lh_writer_at(w, off);
+    if (size < 5) {
+        memmove(p+size, p+5, len);
+        w->ptr -= 5-size;
+    }
+    lh_place_varint(p, len);
+}
@@ -17,7 +17,14 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "lh_files.h"
+#include "lh_strings.h"
+#include "lh_search.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 /**
@@ -107,6 +114,274 @@ static inline double lh_bswap_double(double v) {
 #define lh_ibswap_float(v)  v=lh_bswap_float(v)
 #define lh_ibswap_double(v) v=lh_bswap_double(v)
 
+/**
+ * @name Bulk Byte Swapping
+ * Swap the byteorder of all elements of an array. The copying functions
+ * read n elements from src (any alignment) and write them to dst, which
+ * may be the same pointer as src, but must not overlap it otherwise.
+ */
+void lh_bswap_copy_short(void *dst, const void *src, ssize_t n);
+void lh_bswap_copy_int(void *dst, const void *src, ssize_t n);
+void lh_bswap_copy_long(void *dst, const void *src, ssize_t n);
+
+#define lh_bswap_copy_float(dst,src,n)  lh_bswap_copy_int(dst,src,n)
+#define lh_bswap_copy_double(dst,src,n) lh_bswap_copy_long(dst,src,n)
+
+#define lh_ibswap_array_short(ptr,n)    lh_bswap_copy_short(ptr,ptr,n)
+#define lh_ibswap_array_int(ptr,n)      lh_bswap_copy_int(ptr,ptr,n)
+#define lh_ibswap_array_long(ptr,n)     lh_bswap_copy_long(ptr,ptr,n)
+#define lh_ibswap_array_float(ptr,n)    lh_bswap_copy_int(ptr,ptr,n)
+#define lh_ibswap_array_double(ptr,n)   lh_bswap_copy_long(ptr,ptr,n)
+
+// copy, unless converting in place
+static inline void _lh_bytes_copy(void *dst, const void *src, ssize_t size) {
+    if (dst != src) memmove(dst, src, size);
+}
+
+/**
+ * @name Bulk Byteorder Conversion
+ * Convert arrays between big- or little-endian and the host byteorder
+ * (the conversion is the same in both directions). If the byteorder
+ * matches the host, the data is only copied, or nothing is done in place.
+ */
+#ifdef LH_BIG_ENDIAN
+#define _LH_CONV_BE(bits,dst,src,n) _lh_bytes_copy(dst,src,(n)*(bits/8))
+#define _LH_CONV_LE(bits,dst,src,n) lh_bswap_copy_##bits(dst,src,n)
+#else
+#define _LH_CONV_BE(bits,dst,src,n) lh_bswap_copy_##bits(dst,src,n)
+#define _LH_CONV_LE(bits,dst,src,n) _lh_bytes_copy(dst,src,(n)*(bits/8))
+#endif
+
+#define lh_bswap_copy_16 lh_bswap_copy_short
+#define lh_bswap_copy_32 lh_bswap_copy_int
+#define lh_bswap_copy_64 lh_bswap_copy_long
+
+#define lh_conv_be_short(dst,src,n)     _LH_CONV_BE(16,dst,src,n)
+#define lh_conv_be_int(dst,src,n)       _LH_CONV_BE(32,dst,src,n)
+#define lh_conv_be_long(dst,src,n)      _LH_CONV_BE(64,dst,src,n)
+#define lh_conv_be_float(dst,src,n)     _LH_CONV_BE(32,dst,src,n)
+#define lh_conv_be_double(dst,src,n)    _LH_CONV_BE(64,dst,src,n)
+#define lh_conv_le_short(dst,src,n)     _LH_CONV_LE(16,dst,src,n)
+#define lh_conv_le_int(dst,src,n)       _LH_CONV_LE(32,dst,src,n)
+#define lh_conv_le_long(dst,src,n)      _LH_CONV_LE(64,dst,src,n)
+#define lh_conv_le_float(dst,src,n)     _LH_CONV_LE(32,dst,src,n)
+#define lh_conv_le_double(dst,src,n)    _LH_CONV_LE(64,dst,src,n)
+
+/**
+ * @name Bulk Numeric Conversion
+ * Convert float arrays to and from compact storage formats: IEEE half
+ * precision, normalized fixed point and float from double. The stored
+ * side may have any alignment, and its elements are byte-swapped with
+ * LH_CONV_SWAP - use LH_CONV_BE or LH_CONV_LE to store in a given
+ * byteorder. The conversions round to nearest even.
+ *
+ * Normalized values map [-1,1] (snorm) or [0,1] (unorm) to the full range
+ * of the integer type, -32767..32767 or 0..65535 for 16 bits. Values out
+ * of the range are clamped and NaN becomes the lower bound. Half floats
+ * keep infinities and NaN, and overflow to infinity.
+ */
+#define LH_CONV_SWAP    1
+
+#ifdef LH_BIG_ENDIAN
+#define LH_CONV_BE      0
+#define LH_CONV_LE      LH_CONV_SWAP
+#else
+#define LH_CONV_BE      LH_CONV_SWAP
+#define LH_CONV_LE      0
+#endif
+
+void lh_float_to_half(void *dst, const float *src, ssize_t n, int flags);
+void lh_half_to_float(float *dst, const void *src, ssize_t n, int flags);
+
+void lh_float_to_snorm16(void *dst, const float *src, ssize_t n, int flags);
+void lh_float_to_unorm16(void *dst, const float *src, ssize_t n, int flags);
+void lh_snorm16_to_float(float *dst, const void *src, ssize_t n, int flags);
+void lh_unorm16_to_float(float *dst, const void *src, ssize_t n, int flags);
+
+// single bytes are never swapped
+void lh_float_to_snorm8(void *dst, const float *src, ssize_t n);
+void lh_float_to_unorm8(void *dst, const float *src, ssize_t n);
+void lh_snorm8_to_float(float *dst, const void *src, ssize_t n);
+void lh_unorm8_to_float(float *dst, const void *src, ssize_t n);
+
+void lh_double_to_float(void *dst, const double *src, ssize_t n, int flags);
+void lh_float_to_double(double *dst, const void *src, ssize_t n, int flags);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @name Typed Array Views
+ * A view describes an array of numbers stored in a buffer, e.g. a mapped
+ * file or a received message, in a given byteorder and at any alignment.
+ * Elements are converted when they are accessed, so the data can stay in
+ * its stored form. lh_view_read() and lh_view_write() convert ranges of
+ * elements at once with the bulk byteorder conversion.
+ *
+ * Element types are given as characters, like the column types of
+ * lh_colfile:
+ *   'b' int8_t,  'h' int16_t,  'i' int32_t,  'l' int64_t,  'f' float
+ *   'B' uint8_t, 'H' uint16_t, 'I' uint32_t, 'L' uint64_t, 'd' double
+ *
+ * EXAMPLE:
+ * lh_view v = lh_view_make(data, n, 'i', LH_CONV_BE);
+ * int64_t x = lh_view_int(&v, 5);
+ * ...
+ * int32_t tmp[256];
+ * for(i=0; i<v.n; i+=m) {
+ *     m = lh_view_read(&v, i, tmp, 256);
+ *     for(k=0; k<m; k++) sum += tmp[k];
+ * }
+ */
+
+typedef struct {
+    uint8_t *   ptr;        // first element
+    ssize_t     n;          // number of elements
+    uint8_t     type;       // type character
+    uint8_t     size;       // size of an element
+    uint8_t     swap;       // LH_CONV_SWAP if not in the host byteorder
+} lh_view;
+
+/*! \brief Size of the elements of a type, 0 if the type is invalid */
+static inline int lh_view_type_size(int type) {
+    switch (type) {
+        case 'b': case 'B':             return 1;
+        case 'h': case 'H':             return 2;
+        case 'i': case 'I': case 'f':   return 4;
+        case 'l': case 'L': case 'd':   return 8;
+    }
+    return 0;
+}
+
+/*! \brief Make a view of n elements
+ * \param ptr Stored data, the view is writable if it is
+ * \param n Number of elements
+ * \param type Type character, invalid types make an empty view
+ * \param flags LH_CONV_BE or LH_CONV_LE
+ */
+static inline lh_view lh_view_make(const void *ptr, ssize_t n, int type, int flags) {
+    lh_view v = { (uint8_t *)ptr, n, type, lh_view_type_size(type), flags & LH_CONV_SWAP };
+    if (!v.size) v.n = 0;
+    return v;
+}
+
+/*! \brief A range of elements of a view, clipped to the view */
+static inline lh_view lh_view_slice(const lh_view *v, ssize_t off, ssize_t n) {
+    lh_view s = *v;
+    if (off < 0) off = 0;
+    if (off > v->n) off = v->n;
+    if (n > v->n-off) n = v->n-off;
+    s.ptr += off*v->size;
+    s.n = n < 0 ? 0 : n;
+    return s;
+}
+
+/*
+ * Element i as the unsigned or floating point type of its size, for loops
+ * over views of a known type. Neither the type nor the index is checked.
+ */
+#define def_view(name,type,utype,bswap)                                 \
+    static inline type lh_view_get_##name(const lh_view *v, ssize_t i) { \
+        utype u;                                                        \
+        type x;                                                         \
+        memcpy(&u, v->ptr+i*sizeof(utype), sizeof(utype));              \
+        if (v->swap) u = bswap(u);                                      \
+        memcpy(&x, &u, sizeof(x));                                      \
+        return x;                                                       \
+    }                                                                   \
+    static inline void lh_view_set_##name(const lh_view *v, ssize_t i, type x) { \
+        utype u;                                                        \
+        memcpy(&u, &x, sizeof(u));                                      \
+        if (v->swap) u = bswap(u);                                      \
+        memcpy(v->ptr+i*sizeof(utype), &u, sizeof(utype));              \
+    }
+
+// floating point elements are swapped as integers, a swapped value may be
+// a signalling NaN that a floating point load would change
+def_view(short,uint16_t,uint16_t,lh_bswap_short)
+def_view(int,uint32_t,uint32_t,lh_bswap_int)
+def_view(long,uint64_t,uint64_t,lh_bswap_long)
+def_view(float,float,uint32_t,lh_bswap_int)
+def_view(double,double,uint64_t,lh_bswap_long)
+
+#undef def_view
+
+/*! \brief Element i of a view of any type, converted to an integer
+ * The index is not checked.
+ */
+static inline int64_t lh_view_int(const lh_view *v, ssize_t i) {
+    switch (v->type) {
+        case 'b': return (int8_t)v->ptr[i];
+        case 'B': return v->ptr[i];
+        case 'h': return (int16_t)lh_view_get_short(v, i);
+        case 'H': return lh_view_get_short(v, i);
+        case 'i': return (int32_t)lh_view_get_int(v, i);
+        case 'I': return lh_view_get_int(v, i);
+        case 'l':
+        case 'L': return (int64_t)lh_view_get_long(v, i);
+        case 'f': return (int64_t)lh_view_get_float(v, i);
+        case 'd': return (int64_t)lh_view_get_double(v, i);
+    }
+    return 0;
+}
+
+/*! \brief Element i of a view of any type, converted to a double
+ * The index is not checked.
+ */
+static inline double lh_view_double(const lh_view *v, ssize_t i) {
+    switch (v->type) {
+        case 'L': return lh_view_get_long(v, i);
+        case 'f': return lh_view_get_float(v, i);
+        case 'd': return lh_view_get_double(v, i);
+    }
+    return lh_view_int(v, i);
+}
+
+/*! \brief Store an integer as element i of a view of any type
+ * The index is not checked.
+ */
+static inline void lh_view_put_int(const lh_view *v, ssize_t i, int64_t x) {
+    switch (v->size) {
+        case 1: v->ptr[i] = x; return;
+        case 2: lh_view_set_short(v, i, x); return;
+    }
+    switch (v->type) {
+        case 'i': case 'I': lh_view_set_int(v, i, x); return;
+        case 'l': case 'L': lh_view_set_long(v, i, x); return;
+        case 'f': lh_view_set_float(v, i, x); return;
+        case 'd': lh_view_set_double(v, i, x); return;
+    }
+}
+
+/*! \brief Store a double as element i of a view of any type
+ * The index is not checked.
+ */
+static inline void lh_view_put_double(const lh_view *v, ssize_t i, double x) {
+    switch (v->type) {
+        case 'f': lh_view_set_float(v, i, x); return;
+        case 'd': lh_view_set_double(v, i, x); return;
+        case 'L': lh_view_set_long(v, i, x); return;
+    }
+    lh_view_put_int(v, i, (int64_t)x);
+}
+
+/*! \brief Convert a range of elements into a native array
+ * \param v View
+ * \param off Index of the first element
+ * \param dst Array of the type of the view
+ * \param n Number of elements
+ * \return Number of elements converted, clipped to the view
+ */
+ssize_t lh_view_read(const lh_view *v, ssize_t off, void *dst, ssize_t n);
+
+/*! \brief Store a native array as a range of elements
+ * \param v View
+ * \param off Index of the first element
+ * \param src Array of the type of the view
+ * \param n Number of elements
+ * \return Number of elements stored, clipped to the view
+ */
+ssize_t lh_view_write(const lh_view *v, ssize_t off, const void *src, ssize_t n);
+
 ////////////////////////////////////////////////////////////////////////////////
 
 /**
@@ -114,13 +389,61 @@ static inline double lh_bswap_double(double v) {
  * Functions for parsing values from a bytestream
  */
 
-#define GETBE v = (v<<8)|(*((*p)++));
-
 static inline uint8_t _lh_read_char(uint8_t **p) {
     uint8_t v = *((*p)++);
     return v;
 }
 
+#if defined(LH_LITTLE_ENDIAN) || defined(LH_BIG_ENDIAN)
+
+// Multi-byte values are loaded and stored as whole words with memcpy,
+// which compiles to a single (unaligned) move, and then byte-swapped
+// if the byteorder does not match the host.
+
+static inline uint16_t _lh_load_16(const uint8_t *p) { uint16_t v; memcpy(&v,p,2); return v; }
+static inline uint32_t _lh_load_32(const uint8_t *p) { uint32_t v; memcpy(&v,p,4); return v; }
+static inline uint64_t _lh_load_64(const uint8_t *p) { uint64_t v; memcpy(&v,p,8); return v; }
+
+static inline void _lh_store_16(uint8_t *p, uint16_t v) { memcpy(p,&v,2); }
+static inline void _lh_store_32(uint8_t *p, uint32_t v) { memcpy(p,&v,4); }
+static inline void _lh_store_64(uint8_t *p, uint64_t v) { memcpy(p,&v,8); }
+
+#ifdef LH_BIG_ENDIAN
+#define _lh_be16(v) (v)
+#define _lh_be32(v) (v)
+#define _lh_be64(v) (v)
+#define _lh_le16(v) lh_bswap_short(v)
+#define _lh_le32(v) lh_bswap_int(v)
+#define _lh_le64(v) lh_bswap_long(v)
+#else
+#define _lh_be16(v) lh_bswap_short(v)
+#define _lh_be32(v) lh_bswap_int(v)
+#define _lh_be64(v) lh_bswap_long(v)
+#define _lh_le16(v) (v)
+#define _lh_le32(v) (v)
+#define _lh_le64(v) (v)
+#endif
+
+#define def_read_word(name,bits,order)                                  \
+    static inline uint##bits##_t _lh_read_##name##_##order(uint8_t **p) { \
+        uint##bits##_t v = _lh_load_##bits(*p);                         \
+        *p += bits/8;                                                   \
+        return _lh_##order##bits(v);                                    \
+    }
+
+def_read_word(short,16,be)
+def_read_word(short,16,le)
+def_read_word(int,32,be)
+def_read_word(int,32,le)
+def_read_word(long,64,be)
+def_read_word(long,64,le)
+
+#undef def_read_word
+
+#else
+
+#define GETBE v = (v<<8)|(*((*p)++));
+
 static inline uint16_t _lh_read_short_be(uint8_t **p) {
     uint16_t v=(uint16_t)*((*p)++);
     GETBE;
@@ -141,7 +464,7 @@ static inline uint32_t _lh_read_int_be(uint8_t **p) {
 
 static inline uint32_t _lh_read_int_le(uint8_t **p) {
     uint32_t v=(uint32_t)*((*p)++);
-    v |= ((*((*p)++))<<8); v |= ((*((*p)++))<<16); v |= ((*((*p)++))<<24);
+    v |= ((*((*p)++))<<8); v |= ((*((*p)++))<<16); v |= ((uint32_t)(*((*p)++))<<24);
     return v;
 }
 
@@ -153,12 +476,14 @@ static inline uint64_t _lh_read_long_be(uint8_t **p) {
 
 static inline uint64_t _lh_read_long_le(uint8_t **p) {
     uint64_t v=(uint64_t)*((*p)++);
-    v |= ((*((*p)++))<<8); v |= ((*((*p)++))<<16); v |= ((*((*p)++))<<24);
+    v |= ((*((*p)++))<<8); v |= ((*((*p)++))<<16); v |= ((uint32_t)(*((*p)++))<<24);
     v |= ((uint64_t)(*((*p)++))<<32); v |= ((uint64_t)(*((*p)++))<<40);
     v |= ((uint64_t)(*((*p)++))<<48); v |= ((uint64_t)(*((*p)++))<<56);
     return v;
 }
 
+#endif
+
 static inline float _lh_read_float_be(uint8_t **p) {
     union { uint32_t i; float f; } temp;
     temp.i = _lh_read_int_be(p);
@@ -195,6 +520,51 @@ static inline uint32_t _lh_read_varint(uint8_t **p) {
     return v;
 }
 
+static inline uint64_t _lh_read_varlong(uint8_t **p) {
+    uint64_t v=0;
+    int s=0;
+    uint8_t c;
+    do {
+        c = *(*p)++;
+        v += ((uint64_t)(c&0x7f)<<s);
+        s += 7;
+    } while (c&0x80);
+    return v;
+}
+
+/*! \brief Decode a varint of up to 8 bytes with a single word load.
+ * The 8 bytes at p must be readable.
+ * \param p Source pointer
+ * \param v Returns the decoded value
+ * \return Length of the varint, 0 if it is longer than 8 bytes
+ */
+static inline int _lh_varint_word(const uint8_t *p, uint64_t *v) {
+#ifdef LH_LITTLE_ENDIAN
+    uint64_t w;
+    memcpy(&w, p, 8);
+    uint64_t stop = ~w & 0x8080808080808080ULL;
+    if (!stop) return 0;
+
+    // keep the 7-bit groups up to the first byte without continuation bit
+    w &= 0x7f7f7f7f7f7f7f7fULL & (stop^(stop-1));
+
+    // and pack them together
+    w = ((w & 0x7f007f007f007f00ULL) >> 1) | (w & 0x007f007f007f007fULL);
+    w = ((w & 0x3fff00003fff0000ULL) >> 2) | (w & 0x00003fff00003fffULL);
+    w = ((w & 0x0fffffff00000000ULL) >> 4) | (w & 0x000000000fffffffULL);
+    *v = w;
+    return (__builtin_ctzll(stop)+1)/8;
+#else
+    int i;
+    *v = 0;
+    for(i=0; i<8; i++) {
+        *v |= (uint64_t)(p[i]&0x7f)<<(7*i);
+        if (!(p[i]&0x80)) return i+1;
+    }
+    return 0;
+#endif
+}
+
 #define lh_read_char(p)         _lh_read_char(&p)
 #define lh_read_short_be(p)     _lh_read_short_be(&p)
 #define lh_read_short_le(p)     _lh_read_short_le(&p)
@@ -207,6 +577,7 @@ static inline uint32_t _lh_read_varint(uint8_t **p) {
 #define lh_read_double_be(p)    _lh_read_double_be(&p)
 #define lh_read_double_le(p)    _lh_read_double_le(&p)
 #define lh_read_varint(p)       _lh_read_varint(&p)
+#define lh_read_varlong(p)      _lh_read_varlong(&p)
 
 static inline uint8_t  lh_parse_char(uint8_t *p)      { return _lh_read_char(&p); }
 static inline uint16_t lh_parse_short_be(uint8_t *p)  { return _lh_read_short_be(&p); }
@@ -220,8 +591,7 @@ static inline float    lh_parse_float_le(uint8_t *p)  { return _lh_read_float_le
 static inline double   lh_parse_double_be(uint8_t *p) { return _lh_read_double_be(&p); }
 static inline double   lh_parse_double_le(uint8_t *p) { return _lh_read_double_le(&p); }
 static inline uint32_t lh_parse_varint(uint8_t *p)    { return _lh_read_varint(&p); }
-
-//TODO: zstring, lstring
+static inline uint64_t lh_parse_varlong(uint8_t *p)   { return _lh_read_varlong(&p); }
 
 #define def_lread(name,type)                                            \
     static inline int _lh_lread_##name(uint8_t **p, uint8_t *l, type *v) { \
@@ -243,6 +613,21 @@ def_lread(double_be,double);
 def_lread(double_le,double);
 
 static inline int _lh_lread_varint(uint8_t **p, uint8_t *l, uint32_t *v) {
+    if (*p<l && !(**p&0x80)) {
+        *v = *(*p)++;
+        return 1;
+    }
+
+    uint64_t w;
+    if (l-*p >= 8) {
+        int n = _lh_varint_word(*p, &w);
+        if (n) {
+            *v = (uint32_t)w;
+            *p += n;
+            return 1;
+        }
+    }
+
     *v=0;
     int s=0;
     uint8_t c;
@@ -259,6 +644,47 @@ static inline int _lh_lread_varint(uint8_t **p, uint8_t *l, uint32_t *v) {
     return 1;
 }
 
+static inline int _lh_lread_varlong(uint8_t **p, uint8_t *l, uint64_t *v) {
+    if (*p<l && !(**p&0x80)) {
+        *v = *(*p)++;
+        return 1;
+    }
+
+    if (l-*p >= 8) {
+        int n = _lh_varint_word(*p, v);
+        if (n) {
+            *p += n;
+            return 1;
+        }
+    }
+
+    // long varints, or close to the limit - at most 10 bytes
+    *v=0;
+    int s=0;
+    uint8_t c;
+    uint8_t *temp = *p;
+    do {
+        if (*p>=l || s>63) {
+            *p = temp;
+            return 0;
+        }
+        c = *(*p)++;
+        *v += ((uint64_t)(c&0x7f)<<s);
+        s += 7;
+    } while (c&0x80);
+    return 1;
+}
+
+/*! \brief Decode an array of varints
+ * \param p Pointer to the source pointer, advanced past the decoded varints
+ * \param l Limit of the source data
+ * \param v Output array
+ * \param n Number of varints to decode
+ * \return Number of varints decoded, less than n if the data ends before
+ */
+ssize_t _lh_lread_varint_array(uint8_t **p, uint8_t *l, uint32_t *v, ssize_t n);
+ssize_t _lh_lread_varlong_array(uint8_t **p, uint8_t *l, uint64_t *v, ssize_t n);
+
 #define lh_lread_char(p,l,v)        _lh_lread_char(&p,l,&v)
 #define lh_lread_short_be(p,l,v)    _lh_lread_short_be(&p,l,&v)
 #define lh_lread_short_le(p,l,v)    _lh_lread_short_le(&p,l,&v)
@@ -271,16 +697,223 @@ static inline int _lh_lread_varint(uint8_t **p, uint8_t *l, uint32_t *v) {
 #define lh_lread_double_be(p,l,v)   _lh_lread_double_be(&p,l,&v)
 #define lh_lread_double_le(p,l,v)   _lh_lread_double_le(&p,l,&v)
 #define lh_lread_varint(p,l,v)      _lh_lread_varint(&p,l,&v)
+#define lh_lread_varlong(p,l,v)     _lh_lread_varlong(&p,l,&v)
+#define lh_lread_varint_array(p,l,v,n)  _lh_lread_varint_array(&p,l,v,n)
+#define lh_lread_varlong_array(p,l,v,n) _lh_lread_varlong_array(&p,l,v,n)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-#define PUTLE *p++=(uint8_t)v; v>>=8;
+/**
+ * @name Strings
+ * Strings are read as spans pointing into the source data, nothing is
+ * copied or allocated. An lstring has a length prefix of the type in its
+ * name (char is a single byte), a zstring is terminated by a NUL byte,
+ * which is not part of the span. The readers fail without moving the
+ * source pointer if the string does not fit the limit.
+ */
+
+#define def_lread_lstring(name,type)                                    \
+    static inline int _lh_lread_lstring_##name(uint8_t **p, uint8_t *l, lh_span *s) { \
+        uint8_t *temp = *p;                                             \
+        type len;                                                       \
+        if (!_lh_lread_##name(p, l, &len) || len > l-*p) {              \
+            *p = temp;                                                  \
+            return 0;                                                   \
+        }                                                               \
+        *s = lh_span_make(*p, len);                                     \
+        *p += len;                                                      \
+        return 1;                                                       \
+    }
+
+def_lread_lstring(char,uint8_t);
+def_lread_lstring(short_be,uint16_t);
+def_lread_lstring(short_le,uint16_t);
+def_lread_lstring(int_be,uint32_t);
+def_lread_lstring(int_le,uint32_t);
+def_lread_lstring(varint,uint32_t);
+
+static inline int _lh_lread_zstring(uint8_t **p, uint8_t *l, lh_span *s) {
+    ssize_t len = lh_find_byte(*p, l-*p, 0);
+    if (len < 0) return 0;
+    *s = lh_span_make(*p, len);
+    *p += len+1;
+    return 1;
+}
+
+#define lh_lread_lstring_char(p,l,s)        _lh_lread_lstring_char(&p,l,&s)
+#define lh_lread_lstring_short_be(p,l,s)    _lh_lread_lstring_short_be(&p,l,&s)
+#define lh_lread_lstring_short_le(p,l,s)    _lh_lread_lstring_short_le(&p,l,&s)
+#define lh_lread_lstring_int_be(p,l,s)      _lh_lread_lstring_int_be(&p,l,&s)
+#define lh_lread_lstring_int_le(p,l,s)      _lh_lread_lstring_int_le(&p,l,&s)
+#define lh_lread_lstring_varint(p,l,s)      _lh_lread_lstring_varint(&p,l,&s)
+#define lh_lread_zstring(p,l,s)             _lh_lread_zstring(&p,l,&s)
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @name Reader Cursor
+ * A cursor over a byte stream with a sticky error flag. A read past the
+ * end sets the error, moves the cursor to the end and returns 0, so all
+ * following reads fail as well. A message can be parsed without checking
+ * every field, and the error is checked once at the end.
+ *
+ * The checked getters compare the remaining length on every call. The _u
+ * getters do not check at all - use them after lh_reader_need() has
+ * ensured the length of a whole fixed-size record.
+ *
+ * EXAMPLE:
+ * lh_reader r;
+ * lh_reader_init(&r, data, len);
+ * if (lh_reader_need(&r, 10)) {
+ *     id = lh_reader_int_be_u(&r);
+ *     x  = lh_reader_double_be_u(&r);
+ *     t  = lh_reader_short_be_u(&r);
+ * }
+ * lh_reader name = lh_reader_sub(&r, lh_reader_varint(&r));
+ * if (r.error) ...
+ */
+
+typedef struct {
+    uint8_t * ptr;      // current position
+    uint8_t * end;      // end of the data
+    int error;          // a read went past the end
+} lh_reader;
+
+static inline void lh_reader_init(lh_reader *r, uint8_t *data, ssize_t len) {
+    r->ptr = data;
+    r->end = data+len;
+    r->error = 0;
+}
+
+static inline ssize_t lh_reader_left(const lh_reader *r) {
+    return r->end-r->ptr;
+}
+
+static inline void lh_reader_fail(lh_reader *r) {
+    r->error = 1;
+    r->ptr = r->end;
+}
+
+/*! \brief Check that n bytes remain, set the error otherwise
+ * \return 1 if the bytes are available, 0 if not */
+static inline int lh_reader_need(lh_reader *r, ssize_t n) {
+    if (__builtin_expect(r->end-r->ptr >= n, 1)) return 1;
+    lh_reader_fail(r);
+    return 0;
+}
+
+#define def_reader(name,type)                                           \
+    static inline type lh_reader_##name##_u(lh_reader *r) {             \
+        return _lh_read_##name(&r->ptr);                                \
+    }                                                                   \
+    static inline type lh_reader_##name(lh_reader *r) {                 \
+        if (!lh_reader_need(r, sizeof(type))) return 0;                 \
+        return _lh_read_##name(&r->ptr);                                \
+    }
+
+def_reader(char,uint8_t);
+def_reader(short_be,uint16_t);
+def_reader(short_le,uint16_t);
+def_reader(int_be,uint32_t);
+def_reader(int_le,uint32_t);
+def_reader(long_be,uint64_t);
+def_reader(long_le,uint64_t);
+def_reader(float_be,float);
+def_reader(float_le,float);
+def_reader(double_be,double);
+def_reader(double_le,double);
+
+static inline uint32_t lh_reader_varint(lh_reader *r) {
+    uint32_t v;
+    if (_lh_lread_varint(&r->ptr, r->end, &v)) return v;
+    lh_reader_fail(r);
+    return 0;
+}
+
+static inline uint64_t lh_reader_varlong(lh_reader *r) {
+    uint64_t v;
+    if (_lh_lread_varlong(&r->ptr, r->end, &v)) return v;
+    lh_reader_fail(r);
+    return 0;
+}
+
+/*! \brief Get a pointer to the next n bytes without consuming them
+ * \return Pointer to the data, NULL if less than n bytes remain (this
+ * does not set the error) */
+static inline uint8_t * lh_reader_peek(const lh_reader *r, ssize_t n) {
+    return (r->end-r->ptr >= n) ? r->ptr : NULL;
+}
+
+/*! \brief Consume n bytes
+ * \return Pointer to the consumed data, NULL on error */
+static inline uint8_t * lh_reader_bytes(lh_reader *r, ssize_t n) {
+    if (n < 0 || !lh_reader_need(r, n)) {
+        lh_reader_fail(r);
+        return NULL;
+    }
+    uint8_t *p = r->ptr;
+    r->ptr += n;
+    return p;
+}
+
+#define lh_reader_skip(r,n) ((void)lh_reader_bytes(r,n))
+
+#define def_reader_string(name)                                         \
+    static inline lh_span lh_reader_##name(lh_reader *r) {              \
+        lh_span s;                                                      \
+        if (_lh_lread_##name(&r->ptr, r->end, &s)) return s;            \
+        lh_reader_fail(r);                                              \
+        return lh_span_make(r->end, 0);                                 \
+    }
+
+def_reader_string(lstring_char)
+def_reader_string(lstring_short_be)
+def_reader_string(lstring_short_le)
+def_reader_string(lstring_int_be)
+def_reader_string(lstring_int_le)
+def_reader_string(lstring_varint)
+def_reader_string(zstring)
+
+#undef def_reader_string
+
+/*! \brief Consume n bytes and return a reader over them. If less than n
+ * bytes remain, both the reader and the returned sub-reader fail. */
+static inline lh_reader lh_reader_sub(lh_reader *r, ssize_t n) {
+    lh_reader sub;
+    uint8_t *p = lh_reader_bytes(r, n);
+    lh_reader_init(&sub, p ? p : r->end, p ? n : 0);
+    sub.error = r->error;
+    return sub;
+}
+
+////////////////////////////////////////////////////////////////////////////////
 
 static inline uint8_t * lh_place_char(uint8_t *p, uint8_t v) {
     *p++=(uint8_t)v;
     return p;
 }
 
+#if defined(LH_LITTLE_ENDIAN) || defined(LH_BIG_ENDIAN)
+
+#define def_place_word(name,bits,order)                                 \
+    static inline uint8_t * lh_place_##name##_##order(uint8_t *p, uint##bits##_t v) { \
+        _lh_store_##bits(p, _lh_##order##bits(v));                      \
+        return p+bits/8;                                                \
+    }
+
+def_place_word(short,16,le)
+def_place_word(short,16,be)
+def_place_word(int,32,le)
+def_place_word(int,32,be)
+def_place_word(long,64,le)
+def_place_word(long,64,be)
+
+#undef def_place_word
+
+#else
+
+#define PUTLE *p++=(uint8_t)v; v>>=8;
+
 static inline uint8_t * lh_place_short_le(uint8_t *p, uint16_t v) {
     PUTLE;PUTLE;
     return p;
@@ -315,6 +948,8 @@ static inline uint8_t * lh_place_long_be(uint8_t *p, uint64_t v) {
     return p;
 }
 
+#endif
+
 static inline uint8_t * lh_place_float_le(uint8_t *p, float v) {
     union { float f; uint32_t i; } temp;
     temp.f = v;
@@ -348,6 +983,15 @@ static inline uint8_t * lh_place_varint(uint8_t *p, uint32_t v) {
     return p;
 }
 
+static inline uint8_t * lh_place_varlong(uint8_t *p, uint64_t v) {
+    while (v >= 0x80) {
+        *p++ = (v&0x7f)|0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
 #define lh_write_char(ptr,val)          ptr=lh_place_char(ptr,val)
 #define lh_write_short_be(ptr,val)      ptr=lh_place_short_be(ptr,val)
 #define lh_write_short_le(ptr,val)      ptr=lh_place_short_le(ptr,val)
@@ -360,6 +1004,7 @@ static inline uint8_t * lh_place_varint(uint8_t *p, uint32_t v) {
 #define lh_write_double_be(ptr,val)     ptr=lh_place_double_be(ptr,val)
 #define lh_write_double_le(ptr,val)     ptr=lh_place_double_le(ptr,val)
 #define lh_write_varint(ptr,val)        ptr=lh_place_varint(ptr,val)
+#define lh_write_varlong(ptr,val)       ptr=lh_place_varlong(ptr,val)
 
 #define def_lwrite(name,type)                                           \
     static inline int _lh_lwrite_##name(uint8_t **p, uint8_t *l, type v) { \
@@ -394,6 +1039,20 @@ static inline int _lh_lwrite_varint(uint8_t **p, uint8_t *l, uint32_t v) {
     return 1;
 }
 
+static inline int _lh_lwrite_varlong(uint8_t **p, uint8_t *l, uint64_t v) {
+    uint8_t *temp = *p;
+    do {
+        if (*p>=l) {
+            *p = temp;
+            return 0;
+        }
+        *(*p)++ = (v&0x7f)|0x80;
+        v >>= 7;
+    } while (v>0);
+    *((*p)-1) &= 0x7f;
+    return 1;
+}
+
 #define lh_lwrite_char(p,l,v)       _lh_lwrite_char(&p,l,v)
 #define lh_lwrite_short_be(p,l,v)   _lh_lwrite_short_be(&p,l,v)
 #define lh_lwrite_short_le(p,l,v)   _lh_lwrite_short_le(&p,l,v)
@@ -406,6 +1065,69 @@ static inline int _lh_lwrite_varint(uint8_t **p, uint8_t *l, uint32_t v) {
 #define lh_lwrite_double_be(p,l,v)  _lh_lwrite_double_be(&p,l,v)
 #define lh_lwrite_double_le(p,l,v)  _lh_lwrite_double_le(&p,l,v)
 #define lh_lwrite_varint(p,l,v)     _lh_lwrite_varint(&p,l,v)
+#define lh_lwrite_varlong(p,l,v)    _lh_lwrite_varlong(&p,l,v)
+
+/**
+ * @name Writing Strings
+ * The string data is copied with a single memcpy. The length must fit the
+ * prefix type, this is only checked by the bounded lh_lwrite_* variants.
+ * A zstring must not contain a NUL byte.
+ */
+
+#define def_place_lstring(name,type)                                    \
+    static inline uint8_t * lh_place_lstring_##name(uint8_t *p, lh_span s) { \
+        p = lh_place_##name(p, (type)s.len);                            \
+        memcpy(p, s.ptr, s.len);                                        \
+        return p+s.len;                                                 \
+    }                                                                   \
+    static inline int _lh_lwrite_lstring_##name(uint8_t **p, uint8_t *l, lh_span s) { \
+        uint8_t *temp = *p;                                             \
+        if ((uint64_t)s.len > (type)-1 ||                               \
+            !_lh_lwrite_##name(p, l, (type)s.len) || l-*p < s.len) {    \
+            *p = temp;                                                  \
+            return 0;                                                   \
+        }                                                               \
+        memcpy(*p, s.ptr, s.len);                                       \
+        *p += s.len;                                                    \
+        return 1;                                                       \
+    }
+
+def_place_lstring(char,uint8_t)
+def_place_lstring(short_be,uint16_t)
+def_place_lstring(short_le,uint16_t)
+def_place_lstring(int_be,uint32_t)
+def_place_lstring(int_le,uint32_t)
+def_place_lstring(varint,uint32_t)
+
+#undef def_place_lstring
+
+static inline uint8_t * lh_place_zstring(uint8_t *p, lh_span s) {
+    memcpy(p, s.ptr, s.len);
+    p[s.len] = 0;
+    return p+s.len+1;
+}
+
+static inline int _lh_lwrite_zstring(uint8_t **p, uint8_t *l, lh_span s) {
+    if (l-*p <= s.len) return 0;
+    *p = lh_place_zstring(*p, s);
+    return 1;
+}
+
+#define lh_write_lstring_char(ptr,s)        ptr=lh_place_lstring_char(ptr,s)
+#define lh_write_lstring_short_be(ptr,s)    ptr=lh_place_lstring_short_be(ptr,s)
+#define lh_write_lstring_short_le(ptr,s)    ptr=lh_place_lstring_short_le(ptr,s)
+#define lh_write_lstring_int_be(ptr,s)      ptr=lh_place_lstring_int_be(ptr,s)
+#define lh_write_lstring_int_le(ptr,s)      ptr=lh_place_lstring_int_le(ptr,s)
+#define lh_write_lstring_varint(ptr,s)      ptr=lh_place_lstring_varint(ptr,s)
+#define lh_write_zstring(ptr,s)             ptr=lh_place_zstring(ptr,s)
+
+#define lh_lwrite_lstring_char(p,l,s)       _lh_lwrite_lstring_char(&p,l,s)
+#define lh_lwrite_lstring_short_be(p,l,s)   _lh_lwrite_lstring_short_be(&p,l,s)
+#define lh_lwrite_lstring_short_le(p,l,s)   _lh_lwrite_lstring_short_le(&p,l,s)
+#define lh_lwrite_lstring_int_be(p,l,s)     _lh_lwrite_lstring_int_be(&p,l,s)
+#define lh_lwrite_lstring_int_le(p,l,s)     _lh_lwrite_lstring_int_le(&p,l,s)
+#define lh_lwrite_lstring_varint(p,l,s)     _lh_lwrite_lstring_varint(&p,l,s)
+#define lh_lwrite_zstring(p,l,s)            _lh_lwrite_zstring(&p,l,s)
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -418,6 +1140,468 @@ static inline int lh_varint_size(uint32_t v) {
     return size;
 }
 
+static inline int lh_varlong_size(uint64_t v) {
+    // 1 byte per 7 significant bits: (bits*9+64)/64 == ceil(bits/7) for bits <= 64
+    int bits = 64-__builtin_clzll(v|1);
+    return (bits*9+64)/64;
+}
+
+/**
+ * @name Bulk Varint Encoding
+ * Append a whole array of values as varints to a buffer. The values can be
+ * transformed before encoding: LH_VARINT_DELTA encodes the difference to
+ * the previous value (the first to 0), which keeps sorted sequences small.
+ * LH_VARINT_ZIGZAG maps signed values (or differences) of small magnitude
+ * to small unsigned ones: 0,-1,1,-2,... become 0,1,2,3,...
+ * The encoded size is computed first, so the buffer is resized only once.
+ */
+#define LH_VARINT_ZIGZAG    (1<<0)
+#define LH_VARINT_DELTA     (1<<1)
+
+static inline uint32_t lh_zigzag_int(int32_t v)    { return ((uint32_t)v<<1) ^ (uint32_t)(v>>31); }
+static inline int32_t  lh_unzigzag_int(uint32_t v) { return (int32_t)((v>>1) ^ -(v&1)); }
+static inline uint64_t lh_zigzag_long(int64_t v)   { return ((uint64_t)v<<1) ^ (uint64_t)(v>>63); }
+static inline int64_t  lh_unzigzag_long(uint64_t v){ return (int64_t)((v>>1) ^ -(v&1)); }
+
+/*! \brief Compute the encoded size of an array of values
+ * \param v Values
+ * \param n Number of values
+ * \param flags LH_VARINT_* transforms
+ * \return Total size of the varints in bytes
+ */
+ssize_t lh_varint_size_array(const uint32_t *v, ssize_t n, int flags);
+ssize_t lh_varlong_size_array(const uint64_t *v, ssize_t n, int flags);
+
+/*! \brief Append an array of values as varints to a buffer
+ * \param b Buffer, the data is appended after C(b->data)
+ * \param v Values
+ * \param n Number of values
+ * \param flags LH_VARINT_* transforms
+ * \return Number of bytes appended
+ */
+ssize_t lh_buf_put_varint_array(lh_buf_t *b, const uint32_t *v, ssize_t n, int flags);
+ssize_t lh_buf_put_varlong_array(lh_buf_t *b, const uint64_t *v, ssize_t n, int flags);
+
+static inline ssize_t lh_buf_put_svarlong_array(lh_buf_t *b, const int64_t *v, ssize_t n, int flags) {
+    // the transforms work the same on the two's complement representation
+    return lh_buf_put_varlong_array(b, (const uint64_t *)v, n, flags);
+}
+
+/*! \brief Undo the LH_VARINT_* transforms on decoded values, in place */
+void lh_varint_restore(uint32_t *v, ssize_t n, int flags);
+void lh_varlong_restore(uint64_t *v, ssize_t n, int flags);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @name Writer Cursor
+ * A cursor appending to a lh_buf_t. The buffer is grown in large steps,
+ * and the typed writes store into the reserved space without a check.
+ * A message of known maximum size is built with a single reservation:
+ *
+ * EXAMPLE:
+ * lh_writer w;
+ * lh_writer_init(&w, &buf);
+ * lh_writer_reserve(&w, 14);
+ * lh_writer_int_be_u(&w, id);
+ * lh_writer_double_be_u(&w, x);
+ * lh_writer_short_be_u(&w, t);
+ * ssize_t len = lh_writer_begin_varlen(&w);
+ * lh_writer_bytes(&w, name, strlen(name));
+ * lh_writer_end_varlen(&w, len);
+ * lh_writer_finish(&w);
+ *
+ * The checked writes (without _u) reserve the space for the value
+ * themselves. While writing, C(buf->data) does not match the written
+ * length - lh_writer_finish() sets it.
+ *
+ * The buffer may be reallocated by any reservation, so the length slots
+ * for back-patching are identified by their offset, not a pointer.
+ */
+
+typedef struct {
+    lh_buf_t * buf;     // the buffer written to
+    uint8_t * ptr;      // current position
+    uint8_t * end;      // end of the reserved space
+} lh_writer;
+
+#define LH_WRITER_STEP  65536
+
+void _lh_writer_grow(lh_writer *w, ssize_t n);
+
+/*! \brief Start appending to a buffer, after its current data */
+static inline void lh_writer_init(lh_writer *w, lh_buf_t *b) {
+    w->buf = b;
+    w->ptr = w->end = P(b->data)+C(b->data);
+}
+
+/*! \brief Ensure that at least n bytes can be written without a check */
+static inline void lh_writer_reserve(lh_writer *w, ssize_t n) {
+    if (__builtin_expect(w->end-w->ptr < n, 0))
+        _lh_writer_grow(w, n);
+}
+
+/*! \brief Current position as an offset in the buffer */
+static inline ssize_t lh_writer_pos(const lh_writer *w) {
+    return w->ptr-P(w->buf->data);
+}
+
+/*! \brief Pointer to an offset in the buffer, valid until the next reservation */
+static inline uint8_t * lh_writer_at(const lh_writer *w, ssize_t off) {
+    return P(w->buf->data)+off;
+}
+
+/*! \brief Set the length of the buffer data to the written data
+ * The writer keeps its reservation, so it can continue to append, as long
+ * as the buffer is not modified otherwise.
+ * \return Length of the buffer data
+ */
+static inline ssize_t lh_writer_finish(lh_writer *w) {
+    C(w->buf->data) = lh_writer_pos(w);
+    return C(w->buf->data);
+}
+
+/*! \brief Discard the buffer data and write from its start again
+ * The reserved space is reused, e.g. for a send buffer emptied after
+ * every message.
+ */
+static inline void lh_writer_reset(lh_writer *w) {
+    C(w->buf->data) = 0;
+    w->ptr = P(w->buf->data);
+}
+
+#define def_writer(name,type,size)                                      \
+    static inline void lh_writer_##name##_u(lh_writer *w, type v) {     \
+        w->ptr = lh_place_##name(w->ptr, v);                            \
+    }                                                                   \
+    static inline void lh_writer_##name(lh_writer *w, type v) {         \
+        lh_writer_reserve(w, size);                                     \
+        w->ptr = lh_place_##name(w->ptr, v);                            \
+    }
+
+def_writer(char,uint8_t,1)
+def_writer(short_be,uint16_t,2)
+def_writer(short_le,uint16_t,2)
+def_writer(int_be,uint32_t,4)
+def_writer(int_le,uint32_t,4)
+def_writer(long_be,uint64_t,8)
+def_writer(long_le,uint64_t,8)
+def_writer(float_be,float,4)
+def_writer(float_le,float,4)
+def_writer(double_be,double,8)
+def_writer(double_le,double,8)
+def_writer(varint,uint32_t,5)
+def_writer(varlong,uint64_t,10)
+
+#undef def_writer
+
+static inline void lh_writer_bytes_u(lh_writer *w, const void *data, ssize_t n) {
+    memcpy(w->ptr, data, n);
+    w->ptr += n;
+}
+
+static inline void lh_writer_bytes(lh_writer *w, const void *data, ssize_t n) {
+    lh_writer_reserve(w, n);
+    lh_writer_bytes_u(w, data, n);
+}
+
+#define def_writer_lstring(name,size)                                   \
+    static inline void lh_writer_lstring_##name(lh_writer *w, lh_span s) { \
+        lh_writer_reserve(w, size+s.len);                               \
+        w->ptr = lh_place_lstring_##name(w->ptr, s);                    \
+    }
+
+def_writer_lstring(char,1)
+def_writer_lstring(short_be,2)
+def_writer_lstring(short_le,2)
+def_writer_lstring(int_be,4)
+def_writer_lstring(int_le,4)
+def_writer_lstring(varint,5)
+
+#undef def_writer_lstring
+
+static inline void lh_writer_zstring(lh_writer *w, lh_span s) {
+    lh_writer_reserve(w, s.len+1);
+    w->ptr = lh_place_zstring(w->ptr, s);
+}
+
+/*! \brief Skip a slot of n bytes, to be filled in later
+ * \return Offset of the slot, use lh_writer_at() to fill it
+ */
+static inline ssize_t lh_writer_slot(lh_writer *w, ssize_t n) {
+    lh_writer_reserve(w, n);
+    ssize_t off = lh_writer_pos(w);
+    w->ptr += n;
+    return off;
+}
+
+/*! \brief Length of the data written after a slot of n bytes */
+static inline ssize_t lh_writer_since(const lh_writer *w, ssize_t off, ssize_t n) {
+    return lh_writer_pos(w)-off-n;
+}
+
+/*! \brief Begin data with a varint length prefix
+ * A slot for the largest varint is skipped. lh_writer_end_varlen() moves
+ * the data back to fit the actual size of the prefix. Prefixed data may
+ * be nested, as long as the inner data is ended first.
+ * \return Offset of the length slot
+ */
+static inline ssize_t lh_writer_begin_varlen(lh_writer *w) {
+    return lh_writer_slot(w, 5);
+}
+
+/*! \brief End data with a varint length prefix and write the prefix
+ * \param off Offset returned by lh_writer_begin_varlen()
+ */
+void lh_writer_end_varlen(lh_writer *w, ssize_t off);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @name Records
+ * Pack and unpack arrays of structs. The layout of a record type is
+ * described once as an X-macro, listing the struct fields with their
+ * encoding (any of the lh_read_* types: char, short_be, ..., double_le,
+ * varint, varlong):
+ *
+ * EXAMPLE:
+ * typedef struct { float x, y, z; uint32_t id; } point;
+ * #define POINT_FIELDS(F) F(x,float_be) F(y,float_be) F(z,float_be) F(id,varint)
+ * lh_def_record(point, POINT_FIELDS)
+ *
+ * This defines specialized functions for the record type:
+ * lh_record_place_point(p, r)       - write one record, unchecked
+ * lh_record_write_point(w, v, n)    - write n records to a lh_writer
+ * lh_record_pack_point(b, v, n)     - append n records to a lh_buf_t
+ * lh_record_unpack_point(&p, l, v, n) - read up to n records, bounded
+ * lh_record_read_point(r, v, n)     - read n records from a lh_reader
+ * and the constant lh_record_maxsize_point.
+ *
+ * The fields are converted one by one, with a single bounds check for as
+ * many records as fit at their maximum size. If the encoding matches the
+ * struct in memory (no padding, fields in order, fixed-size types of the
+ * same size and kind), the whole array is copied with memcpy, or with the
+ * SIMD byte swapping if all fields have the same size and the opposite
+ * byteorder. The choice is a constant, so the other paths are optimized
+ * away.
+ */
+
+#define _LH_RTYPE_char      uint8_t
+#define _LH_RTYPE_short_be  uint16_t
+#define _LH_RTYPE_short_le  uint16_t
+#define _LH_RTYPE_int_be    uint32_t
+#define _LH_RTYPE_int_le    uint32_t
+#define _LH_RTYPE_long_be   uint64_t
+#define _LH_RTYPE_long_le   uint64_t
+#define _LH_RTYPE_float_be  float
+#define _LH_RTYPE_float_le  float
+#define _LH_RTYPE_double_be double
+#define _LH_RTYPE_double_le double
+#define _LH_RTYPE_varint    uint32_t
+#define _LH_RTYPE_varlong   uint64_t
+
+// maximum encoded size
+#define _LH_RSIZE_char      1
+#define _LH_RSIZE_short_be  2
+#define _LH_RSIZE_short_le  2
+#define _LH_RSIZE_int_be    4
+#define _LH_RSIZE_int_le    4
+#define _LH_RSIZE_long_be   8
+#define _LH_RSIZE_long_le   8
+#define _LH_RSIZE_float_be  4
+#define _LH_RSIZE_float_le  4
+#define _LH_RSIZE_double_be 8
+#define _LH_RSIZE_double_le 8
+#define _LH_RSIZE_varint    5
+#define _LH_RSIZE_varlong   10
+
+// encoded as in memory: 1, byte-swapped: 0, variable size: -1
+#ifdef LH_BIG_ENDIAN
+#define _LH_RBE 1
+#define _LH_RLE 0
+#else
+#define _LH_RBE 0
+#define _LH_RLE 1
+#endif
+
+#define _LH_RNATIVE_char        1
+#define _LH_RNATIVE_short_be    _LH_RBE
+#define _LH_RNATIVE_short_le    _LH_RLE
+#define _LH_RNATIVE_int_be      _LH_RBE
+#define _LH_RNATIVE_int_le      _LH_RLE
+#define _LH_RNATIVE_long_be     _LH_RBE
+#define _LH_RNATIVE_long_le     _LH_RLE
+#define _LH_RNATIVE_float_be    _LH_RBE
+#define _LH_RNATIVE_float_le    _LH_RLE
+#define _LH_RNATIVE_double_be   _LH_RBE
+#define _LH_RNATIVE_double_le   _LH_RLE
+#define _LH_RNATIVE_varint      -1
+#define _LH_RNATIVE_varlong     -1
+
+#define _lh_rec_isfloat(type) ((type)0.5 != 0)
+
+#define _lh_rec_size(f,codec) +_LH_RSIZE_##codec
+
+#define _lh_rec_put(f,codec) p = lh_place_##codec(p, r->f);
+
+// unchecked reads, with the word access of the bounded varint readers
+#define _lh_rget_char(pp,l)         _lh_read_char(pp)
+#define _lh_rget_short_be(pp,l)     _lh_read_short_be(pp)
+#define _lh_rget_short_le(pp,l)     _lh_read_short_le(pp)
+#define _lh_rget_int_be(pp,l)       _lh_read_int_be(pp)
+#define _lh_rget_int_le(pp,l)       _lh_read_int_le(pp)
+#define _lh_rget_long_be(pp,l)      _lh_read_long_be(pp)
+#define _lh_rget_long_le(pp,l)      _lh_read_long_le(pp)
+#define _lh_rget_float_be(pp,l)     _lh_read_float_be(pp)
+#define _lh_rget_float_le(pp,l)     _lh_read_float_le(pp)
+#define _lh_rget_double_be(pp,l)    _lh_read_double_be(pp)
+#define _lh_rget_double_le(pp,l)    _lh_read_double_le(pp)
+
+// varints are cut off at their maximum size, so a record never exceeds it
+static inline uint32_t _lh_rget_varint(uint8_t **p, uint8_t *l) {
+    uint64_t w;
+    int n, i;
+    if (!(**p&0x80)) return *(*p)++;
+    if (l-*p >= 8 && (n = _lh_varint_word(*p, &w)) && n <= 5) {
+        *p += n;
+        return (uint32_t)w;
+    }
+    uint32_t v = 0;
+    for(i=0; i<5; i++) {
+        uint8_t c = *(*p)++;
+        v |= (uint32_t)(c&0x7f)<<(7*i);
+        if (!(c&0x80)) break;
+    }
+    return v;
+}
+
+static inline uint64_t _lh_rget_varlong(uint8_t **p, uint8_t *l) {
+    uint64_t v;
+    int i;
+    if (!(**p&0x80)) return *(*p)++;
+    if (l-*p >= 8 && (i = _lh_varint_word(*p, &v))) {
+        *p += i;
+        return v;
+    }
+    v = 0;
+    for(i=0; i<10; i++) {
+        uint8_t c = *(*p)++;
+        v |= (uint64_t)(c&0x7f)<<(7*i);
+        if (!(c&0x80)) break;
+    }
+    return v;
+}
+
+#define _lh_rec_get(f,codec) r->f = _lh_rget_##codec(&p, l);
+
+#define _lh_rec_lget(f,codec) {                                         \
+        _LH_RTYPE_##codec t;                                            \
+        if (!_lh_lread_##codec(&p, l, &t)) return 0;                    \
+        r->f = t;                                                       \
+    }
+
+#define _lh_rec_layout(f,codec) {                                       \
+        int size = _LH_RSIZE_##codec, native = _LH_RNATIVE_##codec;     \
+        exact &= native >= 0 && offsetof(_lh_rec_t, f) == pos &&         \
+            sizeof(((_lh_rec_t *)0)->f) == size &&                      \
+            _lh_rec_isfloat(__typeof__(((_lh_rec_t *)0)->f)) ==         \
+            _lh_rec_isfloat(_LH_RTYPE_##codec);                         \
+        if (!width) width = size;                                       \
+        same &= native;                                                 \
+        swapped &= !native && size == width;                            \
+        pos += size;                                                    \
+    }
+
+/*! \brief Define the pack/unpack functions for a record type
+ * \param name Struct type name, used as suffix for the functions
+ * \param FIELDS X-macro listing the fields as F(field,encoding)
+ */
+#define lh_def_record(name,FIELDS)                                      \
+    enum { lh_record_maxsize_##name = 0 FIELDS(_lh_rec_size) };         \
+                                                                        \
+    /* 0: per field, 1: memcpy, 2/4/8: byte swap of this width */       \
+    static inline int _lh_record_layout_##name(void) {                  \
+        typedef name _lh_rec_t;                                         \
+        size_t pos = 0;                                                 \
+        int exact = 1, same = 1, swapped = 1, width = 0;                \
+        FIELDS(_lh_rec_layout)                                          \
+        if (!exact || pos != sizeof(name)) return 0;                    \
+        return same ? 1 : swapped && width > 1 ? width : 0;             \
+    }                                                                   \
+                                                                        \
+    static inline uint8_t * lh_record_place_##name(uint8_t *p, const name *r) { \
+        FIELDS(_lh_rec_put)                                             \
+        return p;                                                       \
+    }                                                                   \
+                                                                        \
+    static inline uint8_t * _lh_record_get_##name(uint8_t *p, uint8_t *l, name *r) { \
+        FIELDS(_lh_rec_get)                                             \
+        return p;                                                       \
+    }                                                                   \
+                                                                        \
+    static inline int _lh_record_lget_##name(uint8_t **pp, uint8_t *l, name *r) { \
+        uint8_t *p = *pp;                                               \
+        FIELDS(_lh_rec_lget)                                            \
+        *pp = p;                                                        \
+        return 1;                                                       \
+    }                                                                   \
+                                                                        \
+    static inline ssize_t lh_record_write_##name(lh_writer *w, const name *v, ssize_t n) { \
+        lh_writer_reserve(w, n*lh_record_maxsize_##name);               \
+        uint8_t *p = w->ptr;                                            \
+        ssize_t i;                                                      \
+        switch (_lh_record_layout_##name()) {                           \
+            case 0: for(i=0; i<n; i++) p = lh_record_place_##name(p, v+i); break; \
+            case 1: memcpy(p, v, n*sizeof(name)); p += n*sizeof(name); break; \
+            case 2: lh_bswap_copy_short(p, v, n*sizeof(name)/2); p += n*sizeof(name); break; \
+            case 4: lh_bswap_copy_int(p, v, n*sizeof(name)/4); p += n*sizeof(name); break; \
+            case 8: lh_bswap_copy_long(p, v, n*sizeof(name)/8); p += n*sizeof(name); break; \
+        }                                                               \
+        i = p-w->ptr;                                                   \
+        w->ptr = p;                                                     \
+        return i;                                                       \
+    }                                                                   \
+                                                                        \
+    static inline ssize_t lh_record_pack_##name(lh_buf_t *b, const name *v, ssize_t n) { \
+        lh_writer w;                                                    \
+        lh_writer_init(&w, b);                                          \
+        ssize_t size = lh_record_write_##name(&w, v, n);                \
+        lh_writer_finish(&w);                                           \
+        return size;                                                    \
+    }                                                                   \
+                                                                        \
+    static inline ssize_t lh_record_unpack_##name(uint8_t **pp, uint8_t *l, name *v, ssize_t n) { \
+        ssize_t i = 0, m;                                               \
+        uint8_t *p = *pp;                                               \
+        int layout = _lh_record_layout_##name();                        \
+        if (layout) {                                                   \
+            m = (l-p)/(ssize_t)sizeof(name);                            \
+            if (m > n) m = n;                                           \
+            if (layout == 1) memcpy(v, p, m*sizeof(name));              \
+            if (layout == 2) lh_bswap_copy_short(v, p, m*sizeof(name)/2); \
+            if (layout == 4) lh_bswap_copy_int(v, p, m*sizeof(name)/4); \
+            if (layout == 8) lh_bswap_copy_long(v, p, m*sizeof(name)/8); \
+            *pp = p+m*sizeof(name);                                     \
+            return m;                                                   \
+        }                                                               \
+        /* as many records as fit at the maximum size, without checks */ \
+        while (i<n && (m = (l-p)/lh_record_maxsize_##name) > 0) {       \
+            if (m > n-i) m = n-i;                                       \
+            for(m+=i; i<m; i++) p = _lh_record_get_##name(p, l, v+i);      \
+        }                                                               \
+        /* the rest one by one */                                       \
+        for(; i<n; i++)                                                 \
+            if (!_lh_record_lget_##name(&p, l, v+i)) break;             \
+        *pp = p;                                                        \
+        return i;                                                       \
+    }                                                                   \
+                                                                        \
+    static inline ssize_t lh_record_read_##name(lh_reader *r, name *v, ssize_t n) { \
+        ssize_t m = lh_record_unpack_##name(&r->ptr, r->end, v, n);     \
+        if (m < n) lh_reader_fail(r);                                   \
+        return m;                                                       \
+    }
+
 ////////////////////////////////////////////////////////////////////////////////
 
 #if 0
@@ -0,0 +1,366 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include <pthread.h>
+
+#include "lh_checksum.h"
+#include "lh_bytes.h"
+#include "lh_cpu.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// CRC tables and GF(2) arithmetic
+
+// The CRCs are computed in the bit-reflected representation, the state
+// is the inverted checksum.
+
+// length of the interleaved streams of the SSE4.2 CRC32C
+#define CRC_BLOCK 4096
+
+typedef struct {
+    uint32_t    poly;           // reflected polynomial
+    uint32_t    table[8][256];  // slicing-by-8
+    uint32_t    x2n[32];        // x^(2^n) mod poly
+    uint32_t    kblock[2];      // x^(8*CRC_BLOCK), x^(16*CRC_BLOCK) mod poly
+} crc_tables;
+
+static crc_tables crc32_tab  = { 0xedb88320 };
+static crc_tables crc32c_tab = { 0x82f63b78 };
+
+// multiply a and b modulo poly, a must not be 0
+static uint32_t multmodp(uint32_t a, uint32_t b, uint32_t poly) {
+    uint32_t m = 1u<<31, p = 0;
+    for(;;) {
+        if (a & m) {
+            p ^= b;
+            if (!(a & (m-1))) break;
+        }
+        m >>= 1;
+        b = (b & 1) ? (b>>1)^poly : b>>1;
+    }
+    return p;
+}
+
+// x^(8*n) mod poly
+static uint32_t x8nmodp(const crc_tables *t, ssize_t n) {
+    uint32_t p = 1u<<31;
+    int k = 3;
+    while (n) {
+        if (n & 1) p = multmodp(t->x2n[k&31], p, t->poly);
+        n >>= 1;
+        k++;
+    }
+    return p;
+}
+
+static void crc_init(crc_tables *t) {
+    int n, k;
+    for(n=0; n<256; n++) {
+        uint32_t c = n;
+        for(k=0; k<8; k++) c = (c & 1) ? (c>>1)^t->poly : c>>1;
+        t->table[0][n] = c;
+    }
+    for(n=0; n<256; n++) {
+        uint32_t c = t->table[0][n];
+        for(k=1; k<8; k++) {
+            c = t->table[0][c&0xff] ^ (c>>8);
+            t->table[k][n] = c;
+        }
+    }
+
+    uint32_t p = 1u<<30; // x^1
+    t->x2n[0] = p;
+    for(n=1; n<32; n++) t->x2n[n] = p = multmodp(p, p, t->poly);
+
+    t->kblock[0] = x8nmodp(t, CRC_BLOCK);
+    t->kblock[1] = x8nmodp(t, 2*CRC_BLOCK);
+}
+
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init_all() {
+    crc_init(&crc32_tab);
+    crc_init(&crc32c_tab);
+}
+
+// the tables are filled once, also if the first calls are concurrent
+static inline crc_tables * crc_get(crc_tables *t) {
+    pthread_once(&crc_once, crc_init_all);
+    return t;
+}
+
+static uint32_t crc_slice8(const crc_tables *t, uint32_t c, const uint8_t *p, ssize_t len) {
+    while (len > 0 && ((uintptr_t)p & 7)) {
+        c = t->table[0][(c ^ *p++) & 0xff] ^ (c>>8);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t w = lh_parse_long_le((uint8_t *)p) ^ c;
+        // xor as a tree, not as a chain of dependent operations
+        c = ((t->table[7][w&0xff]       ^ t->table[6][(w>>8)&0xff])  ^
+             (t->table[5][(w>>16)&0xff] ^ t->table[4][(w>>24)&0xff])) ^
+            ((t->table[3][(w>>32)&0xff] ^ t->table[2][(w>>40)&0xff]) ^
+             (t->table[1][(w>>48)&0xff] ^ t->table[0][w>>56]));
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0)
+        c = t->table[0][(c ^ *p++) & 0xff] ^ (c>>8);
+    return c;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// SIMD implementations
+
+#ifdef HAVE_X86_SIMD
+
+// CRC32C with the crc32 instruction. Its latency is 3 cycles, so long
+// data is processed as three interleaved streams, which are combined by
+// shifting the first two over the length of the following streams.
+LH_TARGET("sse4.2")
+static uint32_t crc32c_sse42(const crc_tables *t, uint32_t c, const uint8_t *p, ssize_t len) {
+    while (len > 0 && ((uintptr_t)p & 7)) {
+        c = _mm_crc32_u8(c, *p++);
+        len--;
+    }
+
+    while (len >= 3*CRC_BLOCK) {
+        uint64_t c0 = c, c1 = 0, c2 = 0;
+        const uint8_t *e = p+CRC_BLOCK;
+        for(; p<e; p+=8) {
+            c0 = _mm_crc32_u64(c0, lh_parse_long_le((uint8_t *)p));
+            c1 = _mm_crc32_u64(c1, lh_parse_long_le((uint8_t *)p+CRC_BLOCK));
+            c2 = _mm_crc32_u64(c2, lh_parse_long_le((uint8_t *)p+2*CRC_BLOCK));
+        }
+        c = multmodp(t->kblock[1], c0, t->poly) ^ multmodp(t->kblock[0], c1, t->poly) ^ c2;
+        p += 2*CRC_BLOCK;
+        len -= 3*CRC_BLOCK;
+    }
+
+    uint64_t c64 = c;
+    for(; len>=8; len-=8, p+=8)
+        c64 = _mm_crc32_u64(c64, lh_parse_long_le((uint8_t *)p));
+    c = c64;
+    while (len-- > 0)
+        c = _mm_crc32_u8(c, *p++);
+    return c;
+}
+
+// fold 128 bits of x forward by the distance of the constants in k
+LH_TARGET("pclmul")
+static inline __m128i crc_fold(__m128i x, __m128i k, __m128i data) {
+    __m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+    __m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(lo, hi), data);
+}
+
+// CRC32 with carry-less multiplication: four 128-bit lanes are folded
+// forward over 64 bytes, then into one lane, which is reduced to 32 bits
+// with a Barrett reduction. len must be a multiple of 16, at least 64.
+LH_TARGET("pclmul,sse4.1")
+static uint32_t crc32_pclmul(uint32_t c, const uint8_t *p, ssize_t len) {
+    const __m128i k1k2   = _mm_set_epi64x(0x1c6e41596LL, 0x154442bd4LL);
+    const __m128i k3k4   = _mm_set_epi64x(0x0ccaa009eLL, 0x1751997d0LL);
+    const __m128i k5     = _mm_set_epi64x(0, 0x163cd6124LL);
+    const __m128i poly   = _mm_set_epi64x(0x1f7011641LL, 0x1db710641LL);
+    const __m128i mask32 = _mm_set_epi32(0, 0, 0, -1);
+
+    __m128i x1 = _mm_loadu_si128((const __m128i *)p);
+    __m128i x2 = _mm_loadu_si128((const __m128i *)(p+16));
+    __m128i x3 = _mm_loadu_si128((const __m128i *)(p+32));
+    __m128i x4 = _mm_loadu_si128((const __m128i *)(p+48));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(c));
+    p += 64;
+    len -= 64;
+
+    for(; len>=64; len-=64, p+=64) {
+        x1 = crc_fold(x1, k1k2, _mm_loadu_si128((const __m128i *)p));
+        x2 = crc_fold(x2, k1k2, _mm_loadu_si128((const __m128i *)(p+16)));
+        x3 = crc_fold(x3, k1k2, _mm_loadu_si128((const __m128i *)(p+32)));
+        x4 = crc_fold(x4, k1k2, _mm_loadu_si128((const __m128i *)(p+48)));
+    }
+
+    x1 = crc_fold(x1, k3k4, x2);
+    x1 = crc_fold(x1, k3k4, x3);
+    x1 = crc_fold(x1, k3k4, x4);
+    for(; len>=16; len-=16, p+=16)
+        x1 = crc_fold(x1, k3k4, _mm_loadu_si128((const __m128i *)p));
+
+    // 128 -> 64 bits
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+    // 64 -> 32 bits
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5, 0x00);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 4), x2);
+
+    // Barrett reduction
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return _mm_extract_epi32(x1, 1);
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// CRC32C, CRC32
+
+uint32_t lh_crc32c_update(uint32_t crc, const void *data, ssize_t len) {
+    crc_tables *t = crc_get(&crc32c_tab);
+    const uint8_t *p = data;
+    uint32_t c = ~crc;
+#ifdef HAVE_X86_SIMD
+    if (lh_cpu_has(LH_CPU_SSE42))
+        return ~crc32c_sse42(t, c, p, len);
+#endif
+    return ~crc_slice8(t, c, p, len);
+}
+
+uint32_t lh_crc32c_shift(uint32_t crc, ssize_t len) {
+    crc_tables *t = crc_get(&crc32c_tab);
+    return multmodp(x8nmodp(t, len), crc, t->poly);
+}
+
+uint32_t lh_crc32_update(uint32_t crc, const void *data, ssize_t len) {
+    crc_tables *t = crc_get(&crc32_tab);
+    const uint8_t *p = data;
+    uint32_t c = ~crc;
+#ifdef HAVE_X86_SIMD
+    if (len >= 64 && lh_cpu_has(LH_CPU_PCLMUL|LH_CPU_SSE41)) {
+        ssize_t n = len & ~(ssize_t)15;
+        c = crc32_pclmul(c, p, n);
+        p += n;
+        len -= n;
+    }
+#endif
+    return ~crc_slice8(t, c, p, len);
+}
+
+uint32_t lh_crc32_shift(uint32_t crc, ssize_t len) {
+    crc_tables *t = crc_get(&crc32_tab);
+    return multmodp(x8nmodp(t, len), crc, t->poly);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// xxHash64
+
+#define XXH_P1 0x9e3779b185ebca87ULL
+#define XXH_P2 0xc2b2ae3d27d4eb4fULL
+#define XXH_P3 0x165667b19e3779f9ULL
+#define XXH_P4 0x85ebca77c2b2ae63ULL
+#define XXH_P5 0x27d4eb2f165667c5ULL
+
+static inline uint64_t xxh_rotl(uint64_t v, int r) {
+    return (v<<r) | (v>>(64-r));
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    acc += input*XXH_P2;
+    return xxh_rotl(acc, 31)*XXH_P1;
+}
+
+static inline uint64_t xxh_merge(uint64_t h, uint64_t acc) {
+    h ^= xxh_round(0, acc);
+    return h*XXH_P1 + XXH_P4;
+}
+
+// process the 32-byte stripes, returns the length processed
+static ssize_t xxh_stripes(uint64_t *v, const uint8_t *p, ssize_t len) {
+    uint64_t v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+    ssize_t i;
+    for(i=0; i+32<=len; i+=32) {
+        v0 = xxh_round(v0, lh_parse_long_le((uint8_t *)p+i));
+        v1 = xxh_round(v1, lh_parse_long_le((uint8_t *)p+i+8));
+        v2 = xxh_round(v2, lh_parse_long_le((uint8_t *)p+i+16));
+        v3 = xxh_round(v3, lh_parse_long_le((uint8_t *)p+i+24));
+    }
+    v[0] = v0; v[1] = v1; v[2] = v2; v[3] = v3;
+    return i;
+}
+
+static uint64_t xxh_finish(const uint64_t *v, uint64_t seed, uint64_t total,
+                           const uint8_t *p, ssize_t len) {
+    uint64_t h;
+    if (total >= 32) {
+        h = xxh_rotl(v[0], 1) + xxh_rotl(v[1], 7) + xxh_rotl(v[2], 12) + xxh_rotl(v[3], 18);
+        h = xxh_merge(h, v[0]);
+        h = xxh_merge(h, v[1]);
+        h = xxh_merge(h, v[2]);
+        h = xxh_merge(h, v[3]);
+    }
+    else
+        h = seed + XXH_P5;
+    h += total;
+
+    for(; len>=8; len-=8, p+=8) {
+        h ^= xxh_round(0, lh_parse_long_le((uint8_t *)p));
+        h = xxh_rotl(h, 27)*XXH_P1 + XXH_P4;
+    }
+    if (len >= 4) {
+        h ^= (uint64_t)lh_parse_int_le((uint8_t *)p)*XXH_P1;
+        h = xxh_rotl(h, 23)*XXH_P2 + XXH_P3;
+        p += 4;
+        len -= 4;
+    }
+    for(; len>0; len--, p++) {
+        h ^= *p*XXH_P5;
+        h = xxh_rotl(h, 11)*XXH_P1;
+    }
+
+    h ^= h>>33;
+    h *= XXH_P2;
+    h ^= h>>29;
+    h *= XXH_P3;
+    h ^= h>>32;
+    return h;
+}
+
+void lh_xxh64_init(lh_xxh64_state *s, uint64_t seed) {
+    s->v[0] = seed + XXH_P1 + XXH_P2;
+    s->v[1] = seed + XXH_P2;
+    s->v[2] = seed;
+    s->v[3] = seed - XXH_P1;
+    s->total = 0;
+    s->seed = seed;
+    s->nbuf = 0;
+}
+
+void lh_xxh64_update(lh_xxh64_state *s, const void *data, ssize_t len) {
+    const uint8_t *p = data;
+    s->total += len;
+
+    // complete a buffered stripe
+    if (s->nbuf) {
+        ssize_t n = 32-s->nbuf;
+        if (n > len) n = len;
+        memcpy(s->buf+s->nbuf, p, n);
+        s->nbuf += n;
+        p += n;
+        len -= n;
+        if (s->nbuf < 32) return;
+        xxh_stripes(s->v, s->buf, 32);
+        s->nbuf = 0;
+    }
+
+    ssize_t n = xxh_stripes(s->v, p, len);
+    memcpy(s->buf, p+n, len-n);
+    s->nbuf = len-n;
+}
+
+uint64_t lh_xxh64_digest(const lh_xxh64_state *s) {
+    return xxh_finish(s->v, s->seed, s->total, s->buf, s->nbuf);
+}
+
+uint64_t lh_xxh64(const void *data, ssize_t len, uint64_t seed) {
+    lh_xxh64_state s;
+    lh_xxh64_init(&s, seed);
+    ssize_t n = xxh_stripes(s.v, data, len);
+    return xxh_finish(s.v, seed, len, (const uint8_t *)data+n, len-n);
+}
@@ -0,0 +1,111 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+/*! \file
+ * Checksums and fast non-cryptographic hashing
+ *
+ * CRC32C (Castagnoli, as in iSCSI, ext4, SCTP), CRC32 (IEEE 802.3, as
+ * in zlib, gzip, PNG) and xxHash64. The CRCs use the SSE4.2 crc32
+ * instruction and PCLMUL folding, selected at runtime (see lh_cpu.h),
+ * with a slicing-by-8 table implementation as fallback.
+ *
+ * The CRC values follow the zlib convention: the checksum of no data is
+ * 0, and data is added by passing the previous value to the update
+ * function. Checksums of separately processed chunks can be combined,
+ * e.g. to checksum parts of a file in parallel.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+////////////////////////////////////////////////////////////////////////////////
+/// CRC32C
+
+/*! \brief Add data to a CRC32C checksum
+ * \param crc Checksum of the preceding data, 0 to start
+ * \param data Data
+ * \param len Length of data
+ * \return Checksum including the data
+ */
+uint32_t lh_crc32c_update(uint32_t crc, const void *data, ssize_t len);
+
+static inline uint32_t lh_crc32c(const void *data, ssize_t len) {
+    return lh_crc32c_update(0, data, len);
+}
+
+/*! \brief Shift a CRC32C over len zero bytes, without the pre- and
+ * post-conditioning. The checksum of the concatenation A+B is
+ * lh_crc32c_shift(crc(A), len(B)) ^ crc(B).
+ */
+uint32_t lh_crc32c_shift(uint32_t crc, ssize_t len);
+
+/*! \brief Combine the CRC32C of two consecutive blocks
+ * \param crc1 Checksum of the first block
+ * \param crc2 Checksum of the second block
+ * \param len2 Length of the second block
+ * \return Checksum of both blocks
+ */
+static inline uint32_t lh_crc32c_combine(uint32_t crc1, uint32_t crc2, ssize_t len2) {
+    return lh_crc32c_shift(crc1, len2) ^ crc2;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// CRC32
+
+/*! \brief Add data to a CRC32 (IEEE) checksum, compatible with zlib crc32()
+ * \param crc Checksum of the preceding data, 0 to start
+ * \param data Data
+ * \param len Length of data
+ * \return Checksum including the data
+ */
+uint32_t lh_crc32_update(uint32_t crc, const void *data, ssize_t len);
+
+static inline uint32_t lh_crc32(const void *data, ssize_t len) {
+    return lh_crc32_update(0, data, len);
+}
+
+/*! \brief Shift a CRC32 over len zero bytes, see lh_crc32c_shift() */
+uint32_t lh_crc32_shift(uint32_t crc, ssize_t len);
+
+/*! \brief Combine the CRC32 of two consecutive blocks, like zlib crc32_combine() */
+static inline uint32_t lh_crc32_combine(uint32_t crc1, uint32_t crc2, ssize_t len2) {
+    return lh_crc32_shift(crc1, len2) ^ crc2;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// xxHash64
+
+/*! Incremental xxHash64 state. The hash is not linear like a CRC, so the
+ * hashes of chunks cannot be combined - use a single state, or hash the
+ * chunk hashes. */
+typedef struct {
+    uint64_t    v[4];       // accumulators
+    uint64_t    total;      // total length of the data
+    uint64_t    seed;
+    uint8_t     buf[32];    // incomplete stripe
+    int         nbuf;
+} lh_xxh64_state;
+
+void lh_xxh64_init(lh_xxh64_state *s, uint64_t seed);
+void lh_xxh64_update(lh_xxh64_state *s, const void *data, ssize_t len);
+
+/*! \brief Get the hash of the data added so far, the state can be
+ * updated further */
+uint64_t lh_xxh64_digest(const lh_xxh64_state *s);
+
+/*! \brief Hash a block of data
+ * \param data Data
+ * \param len Length of data
+ * \param seed Seed value, 0 for the standard hash
+ * \return 64-bit hash
+ */
+uint64_t lh_xxh64(const void *data, ssize_t len, uint64_t seed);
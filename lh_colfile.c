@@ -0,0 +1,408 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "lh_colfile.h"
+#include "lh_bytes.h"
+#include "lh_checksum.h"
+#include "lh_debug.h"
+
+#define COL_MAGIC       "LHCOLF01"
+#define COL_TMAGIC      "LHCF"
+#define COL_HEADER      64
+#define COL_TRAILER     16
+#define COL_DESCMIN     27      // size of a descriptor with an empty name
+#define COL_CHUNK       16384   // buffer for the byte-swapped columns
+#define COL_MAXLOAD     64      // columns loaded at once
+
+#ifdef LH_BIG_ENDIAN
+#define COL_HOST        LH_COL_BE
+#else
+#define COL_HOST        LH_COL_LE
+#endif
+
+// element size of a type character, 0 for raw and unknown types
+static ssize_t type_size(int type) {
+    switch (type) {
+        case 'b': case 'B':             return 1;
+        case 'h': case 'H':             return 2;
+        case 'i': case 'I': case 'f':   return 4;
+        case 'l': case 'L': case 'd':   return 8;
+    }
+    return 0;
+}
+
+static void bswap_copy(void *dst, const void *src, ssize_t n, ssize_t elsize) {
+    switch (elsize) {
+        case 2: lh_bswap_copy_short(dst, src, n); break;
+        case 4: lh_bswap_copy_int(dst, src, n); break;
+        case 8: lh_bswap_copy_long(dst, src, n); break;
+    }
+}
+
+// copy the next name of a comma-separated list
+// returns the rest of the list, NULL if the name is too long
+static const char * next_name(const char *names, char *name) {
+    const char *end = strchr(names, ',');
+    ssize_t len = end ? end-names : strlen(names);
+    if (len >= LH_COL_NAMELEN) return NULL;
+    memcpy(name, names, len);
+    name[len] = 0;
+    return end ? end+1 : names+len;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Writing
+
+static void write_all(lh_colfile_writer *w, const void *data, ssize_t len) {
+    const uint8_t *p = data;
+    while (len > 0 && !w->error) {
+        ssize_t n = write(w->fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            w->error = 1;
+            break;
+        }
+        p += n;
+        len -= n;
+        w->pos += n;
+    }
+}
+
+static void write_pad(lh_colfile_writer *w) {
+    static const uint8_t zero[LH_COL_ALIGN];
+    ssize_t pad = lh_align(w->pos, LH_COL_ALIGN)-w->pos;
+    write_all(w, zero, pad);
+}
+
+int lh_colfile_create(lh_colfile_writer *w, const char *path, int64_t nrows) {
+    uint8_t header[COL_HEADER];
+
+    lh_clear_ptr(w);
+    w->nrows = nrows;
+    w->fd = lh_open_write(path);
+    if (w->fd < 0) return -1;
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, COL_MAGIC, 8);
+    write_all(w, header, sizeof(header));
+    return w->error ? -1 : 0;
+}
+
+int lh_colfile_add(lh_colfile_writer *w, const char *name, int type, int flags,
+                   const void *data, ssize_t elsize) {
+    ssize_t nlen = strlen(name), size = w->nrows*elsize;
+    off_t offset = w->pos;
+    uint32_t crc = 0;
+
+    if (!(flags & LH_COL_FOR)) flags &= ~LH_COL_DELTA;
+    if (!(flags & (LH_COL_BE|LH_COL_LE))) flags |= COL_HOST;
+
+    if (w->error || nlen >= LH_COL_NAMELEN || elsize <= 0 ||
+        (type == 'r' ? 0 : type_size(type) != elsize) ||
+        (flags & (LH_COL_BE|LH_COL_LE)) == (LH_COL_BE|LH_COL_LE) ||
+        ((flags & LH_COL_FOR) && type != 'i' && type != 'I')) {
+        w->error = 1;
+        return -1;
+    }
+
+    if (flags & LH_COL_FOR) {
+        // the format is little-endian by itself
+        lh_buf_t b;
+        lh_clear_obj(b);
+        size = lh_buf_put_for_array(&b, data, w->nrows,
+                                    (flags & LH_COL_DELTA) ? LH_FOR_DELTA : 0);
+        crc = lh_crc32c(P(b.data), size);
+        write_all(w, P(b.data), size);
+        lh_arr_free(AR(b.data));
+        flags = (flags & ~LH_COL_BE) | LH_COL_LE;
+    }
+    else if (!(flags & COL_HOST) && type != 'r' && elsize > 1) {
+        // swap in chunks, the checksum is of the stored data
+        uint8_t tmp[COL_CHUNK];
+        const uint8_t *p = data;
+        int64_t i, n = COL_CHUNK/elsize;
+        for(i=0; i<w->nrows; i+=n) {
+            ssize_t c = (w->nrows-i < n) ? w->nrows-i : n;
+            bswap_copy(tmp, p+i*elsize, c, elsize);
+            crc = lh_crc32c_update(crc, tmp, c*elsize);
+            write_all(w, tmp, c*elsize);
+        }
+    }
+    else {
+        crc = lh_crc32c(data, size);
+        write_all(w, data, size);
+    }
+    write_pad(w);
+
+    lh_writer iw;
+    lh_writer_init(&iw, &w->index);
+    lh_writer_lstring_char(&iw, lh_span_make(name, nlen));
+    lh_writer_char(&iw, type);
+    lh_writer_char(&iw, flags);
+    lh_writer_int_le(&iw, elsize);
+    lh_writer_long_le(&iw, offset);
+    lh_writer_long_le(&iw, size);
+    lh_writer_int_le(&iw, crc);
+    lh_writer_finish(&iw);
+    w->ncols++;
+
+    return w->error ? -1 : 0;
+}
+
+off_t lh_colfile_finish(lh_colfile_writer *w) {
+    lh_buf_t b;
+    lh_writer fw;
+    off_t offset = w->pos;
+
+    lh_clear_obj(b);
+    lh_writer_init(&fw, &b);
+    lh_writer_long_le(&fw, w->nrows);
+    lh_writer_int_le(&fw, w->ncols);
+    if (w->ncols) lh_writer_bytes(&fw, P(w->index.data), C(w->index.data));
+    uint32_t crc = lh_crc32c(P(b.data), lh_writer_pos(&fw));
+    lh_writer_long_le(&fw, offset);
+    lh_writer_int_le(&fw, crc);
+    lh_writer_bytes(&fw, COL_TMAGIC, 4);
+    lh_writer_finish(&fw);
+
+    write_all(w, P(b.data), C(b.data));
+    if (close(w->fd) < 0) w->error = 1;
+    w->fd = -1;
+
+    lh_arr_free(AR(b.data));
+    lh_arr_free(AR(w->index.data));
+    return w->error ? -1 : w->pos;
+}
+
+off_t lh_colfile_save_internal(const char *path, int cnt, const char *names,
+                               const char *types, ...) {
+    lh_colfile_writer w;
+    char name[LH_COL_NAMELEN];
+    int i;
+
+    if (lh_colfile_create(&w, path, cnt) < 0) return -1;
+
+    va_list fields;
+    va_start( fields, types );
+    for(i=0; types[i]; i++) {
+        void **ptrp = va_arg(fields, void **);
+        assert(ptrp);
+        ssize_t so = va_arg(fields, ssize_t);
+        names = names ? next_name(names, name) : NULL;
+        if (!names)
+            w.error = 1;
+        else
+            lh_colfile_add(&w, name, types[i], 0, *ptrp, so);
+    }
+    assert(va_arg(fields, void **) == NULL);
+    va_end( fields );
+
+    return lh_colfile_finish(&w);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Reading
+
+static int parse_footer(lh_colfile *f) {
+    uint8_t *t = f->map+f->size-COL_TRAILER;
+    int i;
+
+    if (memcmp(f->map, COL_MAGIC, 8) || memcmp(t+12, COL_TMAGIC, 4)) return -1;
+
+    uint64_t foff = lh_parse_long_le(t);
+    if (foff < COL_HEADER || foff > f->size-COL_TRAILER) return -1;
+    ssize_t flen = f->size-COL_TRAILER-foff;
+    if (lh_crc32c(f->map+foff, flen) != lh_parse_int_le(t+8)) return -1;
+
+    lh_reader r;
+    lh_reader_init(&r, f->map+foff, flen);
+    f->nrows = lh_reader_long_le(&r);
+    uint32_t ncols = lh_reader_int_le(&r);
+    if (r.error || f->nrows < 0 || ncols > lh_reader_left(&r)/COL_DESCMIN) return -1;
+
+    f->cols = calloc(ncols, sizeof(*f->cols));
+    f->ncols = ncols;
+    for(i=0; i<ncols; i++) {
+        lh_colfile_column *c = f->cols+i;
+        lh_span name = lh_reader_lstring_char(&r);
+        c->type   = lh_reader_char(&r);
+        c->flags  = lh_reader_char(&r);
+        c->elsize = lh_reader_int_le(&r);
+        uint64_t offset = lh_reader_long_le(&r);
+        uint64_t size   = lh_reader_long_le(&r);
+        c->crc    = lh_reader_int_le(&r);
+        if (r.error || name.len >= LH_COL_NAMELEN) return -1;
+
+        memcpy(c->name, name.ptr, name.len);
+        c->name[name.len] = 0;
+
+        // the data must lie between the header and the footer
+        if (offset < COL_HEADER || offset > foff || size > foff-offset ||
+            offset%LH_COL_ALIGN) return -1;
+        c->offset = offset;
+        c->size = size;
+
+        int order = c->flags & (LH_COL_BE|LH_COL_LE);
+        if (order != LH_COL_BE && order != LH_COL_LE) return -1;
+        if (c->type == 'r' ? c->elsize <= 0 : type_size(c->type) != c->elsize)
+            return -1;
+        if (c->flags & LH_COL_FOR) {
+            if (c->type != 'i' && c->type != 'I') return -1;
+        }
+        else if (f->nrows > size/c->elsize || f->nrows*c->elsize != size)
+            return -1;
+    }
+    return lh_reader_left(&r) ? -1 : 0;
+}
+
+int lh_colfile_open(lh_colfile *f, const char *path) {
+    off_t size;
+
+    lh_clear_ptr(f);
+    int fd = lh_open_read(path, &size);
+    if (fd < 0) return -1;
+    if (size < COL_HEADER+COL_TRAILER) {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) LH_ERROR(-1, "Failed to map %s", path);
+    f->map = map;
+    f->size = size;
+
+    if (parse_footer(f) < 0) {
+        lh_colfile_close(f);
+        return -1;
+    }
+    return 0;
+}
+
+void lh_colfile_close(lh_colfile *f) {
+    if (f->map) munmap(f->map, f->size);
+    free(f->cols);
+    lh_clear_ptr(f);
+}
+
+int lh_colfile_find(const lh_colfile *f, const char *name) {
+    int i;
+    for(i=0; i<f->ncols; i++)
+        if (!strcmp(f->cols[i].name, name)) return i;
+    return -1;
+}
+
+// whether the stored elements must be swapped to the host byteorder
+static inline int col_swapped(const lh_colfile_column *c) {
+    return !(c->flags & COL_HOST) && c->type != 'r' && c->elsize > 1;
+}
+
+const void * lh_colfile_data(const lh_colfile *f, int col) {
+    if (col < 0 || col >= f->ncols) return NULL;
+    const lh_colfile_column *c = f->cols+col;
+    if ((c->flags & LH_COL_FOR) || col_swapped(c)) return NULL;
+
+    // the mapping starts at a page boundary
+    if (c->size > 0) {
+        off_t page = sysconf(_SC_PAGESIZE);
+        off_t start = c->offset/page*page;
+        madvise(f->map+start, c->offset+c->size-start, MADV_WILLNEED);
+    }
+    return f->map+c->offset;
+}
+
+int lh_colfile_for_array(const lh_colfile *f, int col, lh_for_array *a) {
+    if (col < 0 || col >= f->ncols) return 0;
+    const lh_colfile_column *c = f->cols+col;
+    if (!(c->flags & LH_COL_FOR)) return 0;
+
+    uint8_t *p = f->map+c->offset;
+    if (!_lh_lread_for_array(&p, f->map+c->offset+c->size, a)) return 0;
+    return a->n == f->nrows;
+}
+
+int lh_colfile_view(const lh_colfile *f, int col, lh_view *v) {
+    if (col < 0 || col >= f->ncols) return 0;
+    const lh_colfile_column *c = f->cols+col;
+    if (c->type == 'r' || (c->flags & LH_COL_FOR)) return 0;
+
+    *v = lh_view_make(f->map+c->offset, f->nrows, c->type,
+                      (c->flags & LH_COL_BE) ? LH_CONV_BE : LH_CONV_LE);
+    return 1;
+}
+
+ssize_t lh_colfile_read(const lh_colfile *f, int col, void *dst) {
+    if (col < 0 || col >= f->ncols) return -1;
+    const lh_colfile_column *c = f->cols+col;
+
+    if (c->flags & LH_COL_FOR) {
+        lh_for_array a;
+        if (!lh_colfile_for_array(f, col, &a)) return -1;
+        lh_for_decode(&a, dst);
+        return f->nrows*c->elsize;
+    }
+
+    if (col_swapped(c))
+        bswap_copy(dst, f->map+c->offset, f->nrows, c->elsize);
+    else
+        memcpy(dst, f->map+c->offset, c->size);
+    return c->size;
+}
+
+int lh_colfile_verify(const lh_colfile *f, int col) {
+    if (col < 0 || col >= f->ncols) return 0;
+    const lh_colfile_column *c = f->cols+col;
+    return lh_crc32c(f->map+c->offset, c->size) == c->crc;
+}
+
+int lh_colfile_load_internal(const lh_colfile *f, int *cnt, const char *names, ...) {
+    uint8_t **ptrs[COL_MAXLOAD];
+    int cols[COL_MAXLOAD];
+    char name[LH_COL_NAMELEN];
+    int ncol = 0, i, ok = f->nrows <= INT_MAX;
+
+    // find all columns before allocating
+    va_list fields;
+    va_start( fields, names );
+    do {
+        uint8_t **ptrp = va_arg(fields, uint8_t **);
+        if (!ptrp) break;
+        assert(ncol < COL_MAXLOAD);
+        ssize_t so = va_arg(fields, ssize_t);
+        names = names ? next_name(names, name) : NULL;
+        cols[ncol] = names ? lh_colfile_find(f, name) : -1;
+        if (cols[ncol] < 0 || f->cols[cols[ncol]].elsize != so) ok = 0;
+        ptrs[ncol++] = ptrp;
+    } while (1);
+    va_end( fields );
+    if (!ok) return -1;
+
+    for(i=0; i<ncol; i++) {
+        const lh_colfile_column *c = f->cols+cols[i];
+        *ptrs[i] = malloc(c->elsize*f->nrows);
+        if (lh_colfile_read(f, cols[i], *ptrs[i]) < 0) {
+            for(; i>=0; i--) {
+                free(*ptrs[i]);
+                *ptrs[i] = NULL;
+            }
+            return -1;
+        }
+    }
+    *cnt = f->nrows;
+    return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+/*! \file
+ * Columnar container files
+ *
+ * A file stores the columns of a multi-array with a common number of
+ * rows. Each column is stored contiguously at a 64-byte aligned offset,
+ * so a reader that maps the file can use the columns in place, and reads
+ * from the disk only the pages of the columns it accesses.
+ *
+ * Format, all integers little-endian:
+ *   header, 64 bytes: "LHCOLF01", zero padding
+ *   column data, each starting at a multiple of 64 bytes
+ *   footer:
+ *     uint64  nrows
+ *     uint32  ncols
+ *     per column:
+ *       lstring_char name
+ *       uint8   type       type character, see below
+ *       uint8   flags      LH_COL_* flags of the stored data
+ *       uint32  elsize     size of an element
+ *       uint64  offset     offset of the stored data
+ *       uint64  size       size of the stored data
+ *       uint32  crc        CRC32C of the stored data
+ *   trailer, 16 bytes:
+ *     uint64  offset of the footer
+ *     uint32  CRC32C of the footer
+ *     "LHCF"
+ *
+ * Column types are given as characters, like the types of
+ * lh_csv_columns():
+ *   'b' int8_t,  'h' int16_t,  'i' int32_t,  'l' int64_t,  'f' float
+ *   'B' uint8_t, 'H' uint16_t, 'I' uint32_t, 'L' uint64_t, 'd' double
+ *   'r' raw elements of any size (e.g. structs), never byte-swapped
+ *
+ * Columns are stored in the host byteorder, unless LH_COL_BE or LH_COL_LE
+ * is given. Integer columns of 32 bits may be stored in the
+ * frame-of-reference format of lh_buf_put_for_array() with LH_COL_FOR.
+ * Such columns, and columns in the other byteorder, are not accessible in
+ * place - lh_colfile_read() converts them.
+ *
+ * EXAMPLE:
+ * int cnt; uint32_t *id; float *x, *y;
+ * ...
+ * lh_colfile_save("points.col", cnt, "id,x,y", "Iff", MAF(id), MAF(x), MAF(y));
+ * ...
+ * lh_colfile f;
+ * if (lh_colfile_open(&f, "points.col") < 0) ...
+ * const float *x = lh_colfile_data(&f, lh_colfile_find(&f, "x"));
+ * for(i=0; i<f.nrows; i++) sum += x[i];    // reads only the pages of x
+ * lh_colfile_close(&f);
+ */
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "lh_files.h"
+#include "lh_bits.h"
+#include "lh_bytes.h"
+
+#define LH_COL_BE       (1<<0)  /* stored big-endian */
+#define LH_COL_LE       (1<<1)  /* stored little-endian */
+#define LH_COL_FOR      (1<<2)  /* frame-of-reference format, 'i' and 'I' only */
+#define LH_COL_DELTA    (1<<3)  /* with LH_COL_FOR: of the deltas, for sorted columns */
+
+#define LH_COL_ALIGN    64      /* alignment of the column data */
+#define LH_COL_NAMELEN  64      /* maximum length of the names, with the terminator */
+
+typedef struct {
+    char            name[LH_COL_NAMELEN];
+    int             type;       // type character
+    int             flags;      // LH_COL_* flags, exactly one of BE and LE
+    ssize_t         elsize;     // size of an element
+    off_t           offset;     // offset of the stored data
+    ssize_t         size;       // size of the stored data
+    uint32_t        crc;        // CRC32C of the stored data
+} lh_colfile_column;
+
+typedef struct {
+    uint8_t *       map;        // the mapped file
+    ssize_t         size;
+    int64_t         nrows;
+    int             ncols;
+    lh_colfile_column * cols;
+} lh_colfile;
+
+typedef struct {
+    int             fd;
+    off_t           pos;        // end of the column data written so far
+    int64_t         nrows;
+    int             ncols;
+    lh_buf_t        index;      // column descriptors of the footer
+    int             error;
+} lh_colfile_writer;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Writing
+
+/*! \brief Create a file and write its header
+ * \param w Writer
+ * \param path Path of the file, it is truncated if it exists
+ * \param nrows Number of rows of all columns
+ * \return 0 on success, -1 on error
+ */
+int lh_colfile_create(lh_colfile_writer *w, const char *path, int64_t nrows);
+
+/*! \brief Write a column
+ * \param w Writer
+ * \param name Name of the column, less than LH_COL_NAMELEN characters
+ * \param type Type character
+ * \param flags LH_COL_* flags
+ * \param data nrows elements of the column
+ * \param elsize Size of an element, it must match the type
+ * \return 0 on success, -1 on error - the file is not finished then
+ */
+int lh_colfile_add(lh_colfile_writer *w, const char *name, int type, int flags,
+                   const void *data, ssize_t elsize);
+
+/*! \brief Write the footer and close the file
+ * \return Size of the file, -1 if any write has failed
+ */
+off_t lh_colfile_finish(lh_colfile_writer *w);
+
+/*! \brief Write the columns of a multi-array to a file.
+ * This is an internal function used by the macros, do not use it directly.
+ */
+off_t lh_colfile_save_internal(const char *path, int cnt, const char *names,
+                               const char *types, ...);
+
+/*! \brief Write the columns of a multi-array to a file, in host byteorder
+ * \param path Path of the file
+ * \param cnt Number of elements
+ * \param names Comma-separated names of the columns
+ * \param types Type characters of the columns
+ * \param ... MAF() of the array variables
+ * \return Size of the file, -1 on error
+ */
+#define lh_colfile_save(path,cnt,names,types,...)                       \
+    lh_colfile_save_internal(path,cnt,names,types,__VA_ARGS__,NULL)
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Reading
+
+/*! \brief Map a file and parse its footer
+ * Only the header and the footer are read - the pages of the columns are
+ * read when they are accessed.
+ * \return 0 on success, -1 if the file cannot be mapped or is malformed
+ */
+int lh_colfile_open(lh_colfile *f, const char *path);
+
+void lh_colfile_close(lh_colfile *f);
+
+/*! \brief Find a column by name
+ * \return Index of the column, -1 if there is none
+ */
+int lh_colfile_find(const lh_colfile *f, const char *name);
+
+/*! \brief Access the data of a column in place
+ * The pages of the column are requested from the disk ahead.
+ * \param col Index of the column
+ * \return Pointer to the nrows elements, aligned to LH_COL_ALIGN, valid
+ * until lh_colfile_close(). NULL if the column is stored in the other
+ * byteorder or in the frame-of-reference format, or col is invalid.
+ */
+const void * lh_colfile_data(const lh_colfile *f, int col);
+
+/*! \brief Access a frame-of-reference column in place, to decode single
+ * blocks or values with lh_for_decode_block() and lh_for_get()
+ * \return 1 on success, 0 if the column is not in this format or malformed
+ */
+int lh_colfile_for_array(const lh_colfile *f, int col, lh_for_array *a);
+
+/*! \brief Access a column of numbers in place in any byteorder, to convert
+ * single values or ranges with lh_view_int() or lh_view_read()
+ * \return 1 on success, 0 if the column is raw, in the frame-of-reference
+ * format, or col is invalid. The view is read-only.
+ */
+int lh_colfile_view(const lh_colfile *f, int col, lh_view *v);
+
+/*! \brief Read the data of a column into an array in host byteorder
+ * \param dst Array of nrows elements
+ * \return Number of bytes written to dst, -1 if the column is malformed
+ */
+ssize_t lh_colfile_read(const lh_colfile *f, int col, void *dst);
+
+/*! \brief Check the stored data of a column against its checksum
+ * \return 1 if it matches, 0 if not
+ */
+int lh_colfile_verify(const lh_colfile *f, int col);
+
+/*! \brief Read columns of a file into a multi-array.
+ * This is an internal function used by the macros, do not use it directly.
+ */
+int lh_colfile_load_internal(const lh_colfile *f, int *cnt, const char *names, ...);
+
+/*! \brief Read columns of a file into newly allocated arrays
+ * \param f File
+ * \param cnt Name of the counter variable, set to the number of rows
+ * \param names Comma-separated names of the columns
+ * \param ... MAF() of the array variables, their element size must match
+ * \return 0 on success, -1 if a column is missing or does not match - no
+ * arrays are allocated then
+ */
+#define lh_colfile_load(f,cnt,names,...)                                \
+    lh_colfile_load_internal(f,&cnt,names,__VA_ARGS__,NULL)
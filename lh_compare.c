@@ -0,0 +1,317 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include "lh_compare.h"
+#include "lh_cpu.h"
+
+#include <string.h>
+
+static inline int cmp_isdigit(uint8_t c) {
+    return (uint8_t)(c-'0') < 10;
+}
+
+static inline uint8_t cmp_fold(uint8_t c) {
+    return ((uint8_t)(c-'A') < 26) ? c+0x20 : c;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Common prefix
+
+#define CMP_ONES  0x0101010101010101ULL
+#define CMP_HIGH  0x8080808080808080ULL
+
+// fold the ASCII uppercase letters of 8 bytes at once
+static inline uint64_t cmp_fold64(uint64_t w) {
+    uint64_t h = w & ~CMP_HIGH;
+    uint64_t ge_a = h + CMP_ONES*(0x80-'A');
+    uint64_t gt_z = h + CMP_ONES*(0x7f-'Z');
+    return w | ((ge_a & ~gt_z & ~w & CMP_HIGH) >> 2);
+}
+
+static ssize_t cmp_mismatch_scalar(const uint8_t *a, const uint8_t *b, ssize_t n, int fold) {
+    ssize_t i = 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for(; i+8<=n; i+=8) {
+        uint64_t wa, wb;
+        memcpy(&wa, a+i, 8);
+        memcpy(&wb, b+i, 8);
+        if (wa == wb) continue;
+        if (fold) {
+            wa = cmp_fold64(wa);
+            wb = cmp_fold64(wb);
+            if (wa == wb) continue;
+        }
+        return i+__builtin_ctzll(wa^wb)/8;
+    }
+#endif
+    if (fold) {
+        for(; i<n; i++)
+            if (cmp_fold(a[i]) != cmp_fold(b[i])) return i;
+    }
+    else {
+        for(; i<n; i++)
+            if (a[i] != b[i]) return i;
+    }
+    return n;
+}
+
+#ifdef HAVE_X86_SIMD
+
+// set bit 5 of the uppercase ASCII letters
+#define FOLD_SSE2(v)                                                    \
+    _mm_or_si128(v, _mm_and_si128(_mm_cmplt_epi8(_mm_add_epi8(v, _mm_set1_epi8(0x80-'A')), \
+                                                 _mm_set1_epi8(-0x80+26)), \
+                                  _mm_set1_epi8(0x20)))
+
+#define FOLD_AVX2(v)                                                    \
+    _mm256_or_si256(v, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(-0x80+26), \
+                                                          _mm256_add_epi8(v, _mm256_set1_epi8(0x80-'A'))), \
+                                        _mm256_set1_epi8(0x20)))
+
+LH_TARGET("sse2")
+static ssize_t cmp_mismatch_sse2(const uint8_t *a, const uint8_t *b, ssize_t n, int fold) {
+    ssize_t i;
+    for(i=0; i+16<=n; i+=16) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a+i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b+i));
+        if (fold) {
+            va = FOLD_SSE2(va);
+            vb = FOLD_SSE2(vb);
+        }
+        unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) ^ 0xffff;
+        if (m) return i+__builtin_ctz(m);
+    }
+    return i;
+}
+
+LH_TARGET("avx2")
+static ssize_t cmp_mismatch_avx2(const uint8_t *a, const uint8_t *b, ssize_t n, int fold) {
+    ssize_t i;
+    for(i=0; i+32<=n; i+=32) {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a+i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b+i));
+        if (fold) {
+            va = FOLD_AVX2(va);
+            vb = FOLD_AVX2(vb);
+        }
+        uint32_t m = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+        if (m) return i+__builtin_ctz(m);
+    }
+    return i;
+}
+
+#endif
+
+// length of the common prefix of a and b
+static inline ssize_t cmp_mismatch(const uint8_t *a, const uint8_t *b, ssize_t n, int fold) {
+#ifdef HAVE_X86_SIMD
+    // names are mostly short and differ early - only a long common prefix
+    // is worth a vector loop
+    if (n >= 64) {
+        ssize_t i = cmp_mismatch_scalar(a, b, 16, fold);
+        if (i < 16) return i;
+        if (lh_cpu_has(LH_CPU_AVX2))      i = cmp_mismatch_avx2(a, b, n, fold);
+        else if (lh_cpu_has(LH_CPU_SSE2)) i = cmp_mismatch_sse2(a, b, n, fold);
+        return i + cmp_mismatch_scalar(a+i, b+i, n-i, fold);
+    }
+#endif
+    return cmp_mismatch_scalar(a, b, n, fold);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Comparison
+
+// natural order comparison, starting at the beginning of a digit run or
+// at a non-digit
+static int cmp_natural(const uint8_t *p, const uint8_t *pe,
+                       const uint8_t *q, const uint8_t *qe, int fold) {
+    while (p < pe && q < qe) {
+        if (cmp_isdigit(*p) && cmp_isdigit(*q)) {
+            const uint8_t *ps = p, *qs = q;
+            while (p < pe && *p == '0') p++;
+            while (q < qe && *q == '0') q++;
+            ssize_t zp = p-ps, zq = q-qs;
+
+            ps = p;
+            qs = q;
+            while (p < pe && cmp_isdigit(*p)) p++;
+            while (q < qe && cmp_isdigit(*q)) q++;
+
+            // more significant digits - larger number
+            if (p-ps != q-qs) return (p-ps < q-qs) ? -1 : 1;
+            int r = memcmp(ps, qs, p-ps);
+            if (r) return r;
+            if (zp != zq) return (zp < zq) ? -1 : 1;
+            continue;
+        }
+
+        uint8_t a = fold ? cmp_fold(*p) : *p;
+        uint8_t b = fold ? cmp_fold(*q) : *q;
+        if (a != b) return a-b;
+        p++;
+        q++;
+    }
+    return (p < pe) - (q < qe);
+}
+
+int lh_strcmp_f(lh_span a, lh_span b, int flags) {
+    int fold = flags & LH_CMP_IGNORECASE;
+    ssize_t n = (a.len < b.len) ? a.len : b.len;
+    ssize_t i = cmp_mismatch(a.ptr, b.ptr, n, fold);
+
+    if (flags & LH_CMP_NATURAL) {
+        // a difference within a number needs the whole digit run
+        while (i > 0 && cmp_isdigit(a.ptr[i-1])) i--;
+        return cmp_natural(a.ptr+i, a.ptr+a.len, b.ptr+i, b.ptr+b.len, fold);
+    }
+
+    if (i == n) return (a.len > b.len) - (a.len < b.len);
+    return fold ? cmp_fold(a.ptr[i]) - cmp_fold(b.ptr[i]) : a.ptr[i] - b.ptr[i];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Sort keys
+
+ssize_t lh_sortkey(lh_span s, int flags, uint8_t *out) {
+    const uint8_t *p = s.ptr, *end = p+s.len;
+    int fold = flags & LH_CMP_IGNORECASE;
+    ssize_t o = 0;
+
+    if (!(flags & LH_CMP_NATURAL)) {
+        if (!fold) {
+            memcpy(out, p, s.len);
+            return s.len;
+        }
+        for(; p<end; p++) out[o++] = cmp_fold(*p);
+        return o;
+    }
+
+    while (p < end) {
+        if (!cmp_isdigit(*p)) {
+            out[o++] = fold ? cmp_fold(*p) : *p;
+            p++;
+            continue;
+        }
+
+        // a digit run becomes: a class byte within '0'..'9' (so it orders
+        // against other characters like a digit) encoding the number of
+        // significant digits, the digits, and the count of leading zeros
+        const uint8_t *z = p;
+        while (p < end && *p == '0') p++;
+        ssize_t nz = p-z;
+        const uint8_t *d = p;
+        while (p < end && cmp_isdigit(*p)) p++;
+        ssize_t nd = p-d;
+
+        if (nd < 9)
+            out[o++] = '0'+nd;
+        else {
+            if (nd > 0xffff) nd = 0xffff;
+            out[o++] = '9';
+            out[o++] = nd>>8;
+            out[o++] = nd;
+        }
+        memcpy(out+o, d, p-d);
+        o += p-d;
+        out[o++] = (nz > 0xff) ? 0xff : nz;
+    }
+    return o;
+}
+
+typedef struct {
+    const uint8_t * key;
+    ssize_t         len;
+    ssize_t         idx;
+} cmp_keyed;
+
+// compare two keys whose first d bytes are equal
+static inline int cmp_keyed_cmp(const cmp_keyed *a, const cmp_keyed *b, ssize_t d) {
+    ssize_t n = (a->len < b->len) ? a->len : b->len;
+    int r = memcmp(a->key+d, b->key+d, n-d);
+    if (r) return r;
+    if (a->len != b->len) return (a->len < b->len) ? -1 : 1;
+    return (a->idx > b->idx) - (a->idx < b->idx);
+}
+
+static int cmp_keyed_idx(const void *pa, const void *pb) {
+    const cmp_keyed *a = pa, *b = pb;
+    return (a->idx > b->idx) - (a->idx < b->idx);
+}
+
+// key byte at depth d, -1 past the end so shorter keys sort first
+static inline int cmp_keyed_at(const cmp_keyed *k, ssize_t d) {
+    return (d < k->len) ? k->key[d] : -1;
+}
+
+#define CMP_SWAP(a,b) { cmp_keyed _t = a; a = b; b = _t; }
+
+// multikey quicksort: partition by the byte at depth d, so the bytes of a
+// common prefix are looked at once per partition instead of in every compare
+static void cmp_keyed_sort(cmp_keyed *k, ssize_t n, ssize_t d) {
+    while (n > 1) {
+        ssize_t i, j;
+        if (n < 12) {
+            for(i=1; i<n; i++)
+                for(j=i; j>0 && cmp_keyed_cmp(&k[j-1], &k[j], d) > 0; j--)
+                    CMP_SWAP(k[j-1], k[j]);
+            return;
+        }
+
+        // median of three pivot, moved to k[0]
+        int a = cmp_keyed_at(&k[0], d), b = cmp_keyed_at(&k[n/2], d), c = cmp_keyed_at(&k[n-1], d);
+        ssize_t m = (a < b) ? ((b < c) ? n/2 : (a < c) ? n-1 : 0)
+                            : ((a < c) ? 0 : (b < c) ? n-1 : n/2);
+        CMP_SWAP(k[0], k[m]);
+        int v = cmp_keyed_at(&k[0], d);
+
+        // three-way partition: [0,lt) < v, [lt,gt) == v, [gt,n) > v
+        ssize_t lt = 0, gt = n;
+        i = 1;
+        while (i < gt) {
+            int x = cmp_keyed_at(&k[i], d);
+            if (x < v)      { CMP_SWAP(k[lt], k[i]); lt++; i++; }
+            else if (x > v) { gt--; CMP_SWAP(k[i], k[gt]); }
+            else            i++;
+        }
+
+        cmp_keyed_sort(k, lt, d);
+        cmp_keyed_sort(k+gt, n-gt, d);
+
+        if (v < 0) {
+            // equal keys keep their original order
+            qsort(k+lt, gt-lt, sizeof(*k), cmp_keyed_idx);
+            return;
+        }
+        k += lt;
+        n = gt-lt;
+        d++;
+    }
+}
+
+void lh_sort_order(const lh_span *names, ssize_t n, int flags, ssize_t *order) {
+    ssize_t i, size = 0, off = 0;
+    for(i=0; i<n; i++) size += lh_sortkey_size(names[i].len);
+
+    // all keys in a single allocation
+    uint8_t *arena = malloc(size ? size : 1);
+    cmp_keyed *k = malloc((n ? n : 1)*sizeof(*k));
+    for(i=0; i<n; i++) {
+        k[i].key = arena+off;
+        k[i].len = lh_sortkey(names[i], flags, arena+off);
+        k[i].idx = i;
+        off += k[i].len;
+    }
+
+    cmp_keyed_sort(k, n, 0);
+    for(i=0; i<n; i++) order[i] = k[i].idx;
+
+    free(k);
+    free(arena);
+}
@@ -0,0 +1,71 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+/*! \file
+ * Locale-free string comparison and sort keys
+ *
+ * Case-insensitive comparison folds only the ASCII letters, so it does
+ * not depend on the locale and bytes >= 0x80 compare as they are.
+ * Natural order compares runs of digits by their numeric value, so
+ * "file2" sorts before "file10". Leading zeros do not change the value,
+ * but of two equal numbers the one with fewer zeros sorts first.
+ *
+ * The common prefix of two strings is skipped with SIMD compares, so long
+ * shared paths or prefixes cost little. For sorting many strings,
+ * lh_sortkey() transforms each string once into a key that orders the
+ * same way under a plain bytewise compare.
+ *
+ * EXAMPLE:
+ * ssize_t order[n];
+ * lh_sort_order(names, n, LH_CMP_NATURAL|LH_CMP_IGNORECASE, order);
+ * for(i=0; i<n; i++) printf("%.*s\n", (int)names[order[i]].len, names[order[i]].ptr);
+ */
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lh_strings.h"
+
+#define LH_CMP_IGNORECASE   (1<<0)  /* fold ASCII letters to lowercase */
+#define LH_CMP_NATURAL      (1<<1)  /* compare digit runs numerically */
+
+/*! \brief Compare two strings
+ * \param flags LH_CMP_* flags, 0 for a bytewise compare
+ * \return <0, 0 or >0 if a sorts before, equal to or after b */
+int lh_strcmp_f(lh_span a, lh_span b, int flags);
+
+static inline int lh_casecmp(lh_span a, lh_span b) {
+    return lh_strcmp_f(a, b, LH_CMP_IGNORECASE);
+}
+
+static inline int lh_natcmp(lh_span a, lh_span b) {
+    return lh_strcmp_f(a, b, LH_CMP_NATURAL);
+}
+
+/*! \brief Maximum length of a sort key for a string of the given length */
+#define lh_sortkey_size(len) (3*(len))
+
+/*! \brief Compute a sort key. Keys compared with lh_span_cmp() order like
+ * the strings compared with lh_strcmp_f() with the same flags (digit runs
+ * longer than 65535 digits or with more than 255 leading zeros excepted).
+ * \param s String
+ * \param flags LH_CMP_* flags
+ * \param out Output buffer, lh_sortkey_size(s.len) bytes
+ * \return Length of the key */
+ssize_t lh_sortkey(lh_span s, int flags, uint8_t *out);
+
+/*! \brief Sort strings using precomputed keys. The sort is stable.
+ * \param names Strings to sort
+ * \param n Number of strings
+ * \param flags LH_CMP_* flags
+ * \param order Returns the indexes of the strings in sorted order */
+void lh_sort_order(const lh_span *names, ssize_t n, int flags, ssize_t *order);
@@ -0,0 +1,38 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include "lh_cpu.h"
+
+int lh_cpu_flags = -1;
+
+static int lh_cpu_supported() {
+    int flags = 0;
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    flags |= LH_CPU_SSE2;
+    if (__builtin_cpu_supports("ssse3"))  flags |= LH_CPU_SSSE3;
+    if (__builtin_cpu_supports("sse4.1")) flags |= LH_CPU_SSE41;
+    if (__builtin_cpu_supports("sse4.2")) flags |= LH_CPU_SSE42;
+    if (__builtin_cpu_supports("pclmul")) flags |= LH_CPU_PCLMUL;
+    if (__builtin_cpu_supports("avx2"))   flags |= LH_CPU_AVX2;
+    if (__builtin_cpu_supports("bmi2"))   flags |= LH_CPU_BMI2;
+    if (__builtin_cpu_supports("f16c"))   flags |= LH_CPU_F16C;
+#endif
+    return flags;
+}
+
+int lh_cpu_detect() {
+    lh_cpu_flags = lh_cpu_supported();
+    return lh_cpu_flags;
+}
+
+void lh_cpu_restrict(int mask) {
+    lh_cpu_flags = lh_cpu_supported() & mask;
+}
@@ -0,0 +1,53 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+/*! \file
+ * CPU feature detection for the runtime dispatch of SIMD kernels
+ *
+ * The kernels are compiled for their instruction set with the
+ * LH_TARGET() attribute, and the public function selects one of them
+ * with lh_cpu_has(). Every kernel has a scalar fallback, which is used
+ * on other architectures or if HAVE_X86_SIMD is not defined.
+ */
+
+#pragma once
+
+#define LH_CPU_SSE2     (1<<0)
+#define LH_CPU_SSSE3    (1<<1)
+#define LH_CPU_SSE41    (1<<2)
+#define LH_CPU_SSE42    (1<<3)
+#define LH_CPU_PCLMUL   (1<<4)
+#define LH_CPU_AVX2     (1<<5)
+#define LH_CPU_BMI2     (1<<6)
+#define LH_CPU_F16C     (1<<7)
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#define LH_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// detected CPU features, -1 if not yet detected
+extern int lh_cpu_flags;
+
+int lh_cpu_detect();
+
+/*! \brief Get the set of the CPU features usable by the library
+ * \return Bitmask of LH_CPU_* flags */
+static inline int lh_cpu_features() {
+    return (lh_cpu_flags < 0) ? lh_cpu_detect() : lh_cpu_flags;
+}
+
+#define lh_cpu_has(f) ((lh_cpu_features() & (f)) == (f))
+
+/*! \brief Restrict the features used by the library.
+ * This can be used to test or benchmark the fallback implementations.
+ * \param mask Bitmask of LH_CPU_* flags that may be used, -1 to re-enable
+ * all features supported by the CPU */
+void lh_cpu_restrict(int mask);
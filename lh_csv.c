@@ -0,0 +1,514 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include "lh_csv.h"
+#include "lh_cpu.h"
+#include "lh_search.h"
+#include "lh_buffers.h"
+
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <locale.h>
+#include <pthread.h>
+
+#define CSV_MAXCOLS 64
+
+////////////////////////////////////////////////////////////////////////////////
+/// Indexing kernels
+
+// bit i is set if an odd number of quotes precedes or is at position i,
+// i.e. if position i lies within quotes
+static inline uint64_t csv_prefix_xor(uint64_t x) {
+    x ^= x<<1;
+    x ^= x<<2;
+    x ^= x<<4;
+    x ^= x<<8;
+    x ^= x<<16;
+    x ^= x<<32;
+    return x;
+}
+
+// store the positions of the unquoted structural characters of a 64-byte
+// block, given the bitmasks of its quotes and its separators and newlines
+static inline ssize_t csv_flatten(uint32_t *out, uint32_t off,
+                                  uint64_t quote, uint64_t st, uint64_t *inq) {
+    uint64_t inside = csv_prefix_xor(quote) ^ *inq;
+    *inq = (uint64_t)((int64_t)inside >> 63);
+    st &= ~inside;
+
+    ssize_t n = 0;
+    while (st) {
+        out[n++] = off + __builtin_ctzll(st);
+        st &= st-1;
+    }
+    return n;
+}
+
+static ssize_t csv_index_scalar(const uint8_t *p, ssize_t len, uint8_t sep, uint64_t qm,
+                                uint32_t off, uint32_t *out, uint64_t *inq) {
+    ssize_t i, j, n = 0;
+    for(i=0; i<len; i+=64) {
+        uint64_t q = 0, s = 0;
+        for(j=0; j<64; j++) {
+            uint8_t c = p[i+j];
+            q |= (uint64_t)(c == '"') << j;
+            s |= (uint64_t)(c == sep || c == '\n') << j;
+        }
+        n += csv_flatten(out+n, off+i, q&qm, s, inq);
+    }
+    return n;
+}
+
+#ifdef HAVE_X86_SIMD
+
+LH_TARGET("sse2")
+static ssize_t csv_index_sse2(const uint8_t *p, ssize_t len, uint8_t sep, uint64_t qm,
+                              uint32_t off, uint32_t *out, uint64_t *inq) {
+    const __m128i vq = _mm_set1_epi8('"');
+    const __m128i vs = _mm_set1_epi8(sep);
+    const __m128i vn = _mm_set1_epi8('\n');
+    ssize_t i, j, n = 0;
+    for(i=0; i<len; i+=64) {
+        uint64_t q = 0, s = 0;
+        for(j=0; j<64; j+=16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(p+i+j));
+            q |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, vq)) << j;
+            s |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, vs),
+                                                                    _mm_cmpeq_epi8(v, vn))) << j;
+        }
+        n += csv_flatten(out+n, off+i, q&qm, s, inq);
+    }
+    return n;
+}
+
+LH_TARGET("avx2")
+static ssize_t csv_index_avx2(const uint8_t *p, ssize_t len, uint8_t sep, uint64_t qm,
+                              uint32_t off, uint32_t *out, uint64_t *inq) {
+    const __m256i vq = _mm256_set1_epi8('"');
+    const __m256i vs = _mm256_set1_epi8(sep);
+    const __m256i vn = _mm256_set1_epi8('\n');
+    ssize_t i, n = 0;
+    for(i=0; i<len; i+=64) {
+        __m256i lo = _mm256_loadu_si256((const __m256i *)(p+i));
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(p+i+32));
+        uint64_t q = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, vq)) |
+            (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, vq)) << 32;
+        uint64_t s = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(lo, vs),
+                                                                    _mm256_cmpeq_epi8(lo, vn))) |
+            (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(hi, vs),
+                                                                     _mm256_cmpeq_epi8(hi, vn))) << 32;
+        n += csv_flatten(out+n, off+i, q&qm, s, inq);
+    }
+    return n;
+}
+
+#endif
+
+// index a multiple of 64 bytes, the positions are stored relative to p-off
+static inline ssize_t csv_index(lh_csv_reader *r, const uint8_t *p, ssize_t len,
+                                uint32_t off, uint32_t *out) {
+    uint64_t qm = (r->flags & LH_CSV_NOQUOTE) ? 0 : ~0ULL;
+#ifdef HAVE_X86_SIMD
+    if (lh_cpu_has(LH_CPU_AVX2)) return csv_index_avx2(p, len, r->sep, qm, off, out, &r->inq);
+    if (lh_cpu_has(LH_CPU_SSE2)) return csv_index_sse2(p, len, r->sep, qm, off, out, &r->inq);
+#endif
+    return csv_index_scalar(p, len, r->sep, qm, off, out, &r->inq);
+}
+
+// index the next window of the chunk
+static void csv_index_window(lh_csv_reader *r) {
+    ssize_t len = r->end - r->scan;
+    if (len > LH_CSV_WINDOW) len = LH_CSV_WINDOW;
+    ssize_t full = len & ~(ssize_t)63;
+
+    r->base = r->scan;
+    r->nidx = csv_index(r, r->scan, full, 0, r->index);
+    if (full < len) {
+        // the end of the chunk - pad the last block with zeros
+        uint8_t tail[64];
+        memset(tail, 0, sizeof(tail));
+        memcpy(tail, r->scan+full, len-full);
+        r->nidx += csv_index(r, tail, 64, full, r->index+r->nidx);
+    }
+    r->inext = 0;
+    r->scan += len;
+}
+
+// next unquoted separator or newline in the chunk, NULL if there is none
+static inline const uint8_t *csv_next_pos(lh_csv_reader *r) {
+    while (r->inext == r->nidx) {
+        if (r->scan == r->end) return NULL;
+        csv_index_window(r);
+    }
+    return r->base + r->index[r->inext++];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Reader
+
+void lh_csv_init(lh_csv_reader *r, uint8_t sep, int flags) {
+    lh_clear_ptr(r);
+    r->sep = sep;
+    r->flags = flags;
+    r->index = malloc(LH_CSV_WINDOW*sizeof(*r->index));
+}
+
+void lh_csv_free(lh_csv_reader *r) {
+    free(r->index);
+    lh_arr_free(AR(r->sel));
+    lh_arr_free(AR(r->field));
+    lh_arr_free(AR(r->fixup));
+    lh_arr_free(AR(r->unq));
+    lh_arr_free(AR(r->carry));
+}
+
+void lh_csv_select(lh_csv_reader *r, const int *cols, int n) {
+    int i, max = -1;
+    for(i=0; i<n; i++)
+        if (cols[i] > max) max = cols[i];
+
+    lh_arr_resize(GAR1(r->sel), max+1);
+    for(i=0; i<=max; i++) P(r->sel)[i] = -1;
+    for(i=0; i<n; i++) P(r->sel)[cols[i]] = i;
+    r->nsel = n;
+}
+
+void lh_csv_feed(lh_csv_reader *r, const uint8_t *data, ssize_t len) {
+    assert(r->ptr == r->end);
+    assert(!r->eof);
+    r->ptr = r->scan = r->base = data;
+    r->end = data+len;
+    r->nidx = r->inext = 0;
+}
+
+void lh_csv_finish(lh_csv_reader *r) {
+    r->eof = 1;
+}
+
+// append bytes to the carry buffer
+static void csv_keep(lh_csv_reader *r, const uint8_t *data, ssize_t len) {
+    if (len <= 0) return;
+    memcpy(lh_arr_add(GAR4(r->carry), len), data, len);
+}
+
+// decode a quoted field into the unq buffer
+static void csv_unquote(lh_csv_reader *r, int slot, const uint8_t *p, const uint8_t *e) {
+    ssize_t off = C(r->unq), n = 0;
+    uint8_t *out = lh_arr_add(GAR2(r->unq), e-p);
+    int inq = 0;
+
+    for(; p<e; p++) {
+        if (*p != '"')
+            out[n++] = *p;
+        else if (inq && p+1<e && p[1] == '"')
+            out[n++] = *p++;
+        else
+            inq = !inq;
+    }
+    C(r->unq) = off+n;
+
+    // the buffer may still move - store the offset, fixed up at the end of the record
+    P(r->field)[slot] = lh_span_make((uintptr_t)off, n);
+    *lh_arr_new(GAR1(r->fixup)) = slot;
+}
+
+// store the field of a column, if it is selected
+static inline void csv_field(lh_csv_reader *r, int col, const uint8_t *p, const uint8_t *e) {
+    int slot = col;
+    if (r->nsel) {
+        if (col >= C(r->sel) || (slot = P(r->sel)[col]) < 0) return;
+    }
+    else
+        lh_arr_new(GAR1(r->field));
+
+    ssize_t len = e-p;
+    if (len > 0 && *p == '"' && !(r->flags & LH_CSV_NOQUOTE)) {
+        // the quotes can be stripped unless the field contains escaped quotes
+        if (len < 2 || e[-1] != '"' || lh_find_byte(p+1, len-2, '"') >= 0) {
+            csv_unquote(r, slot, p, e);
+            return;
+        }
+        p++;
+        len -= 2;
+    }
+    P(r->field)[slot] = lh_span_make(p, len);
+}
+
+static void csv_begin(lh_csv_reader *r) {
+    C(r->fixup) = 0;
+    C(r->unq) = 0;
+    if (r->nsel) {
+        lh_arr_resize(GAR1(r->field), r->nsel);
+        memset(P(r->field), 0, r->nsel*sizeof(*P(r->field)));
+    }
+    else
+        C(r->field) = 0;
+}
+
+static int csv_end(lh_csv_reader *r) {
+    int i;
+    for(i=0; i<C(r->fixup); i++) {
+        lh_span *f = P(r->field)+P(r->fixup)[i];
+        f->ptr = P(r->unq) + (uintptr_t)f->ptr;
+    }
+    r->nrec++;
+    return C(r->field);
+}
+
+// split a record assembled in the carry buffer, return 0 if it is empty
+static int csv_split(lh_csv_reader *r, const uint8_t *p, const uint8_t *e) {
+    if (e > p && e[-1] == '\r') e--;
+    if (e == p) return 0;
+
+    int col = 0, inq = 0;
+    const uint8_t *fs = p;
+    for(; p<e; p++) {
+        if (*p == '"' && !(r->flags & LH_CSV_NOQUOTE))
+            inq = !inq;
+        else if (*p == r->sep && !inq) {
+            csv_field(r, col++, fs, p);
+            fs = p+1;
+        }
+    }
+    csv_field(r, col, fs, e);
+    return 1;
+}
+
+int lh_csv_next(lh_csv_reader *r) {
+    // the record returned in the last call was assembled in the carry buffer
+    if (r->used) {
+        C(r->carry) = 0;
+        r->used = 0;
+    }
+
+    while (1) {
+        const uint8_t *pos;
+        csv_begin(r);
+
+        if (C(r->carry)) {
+            // complete the record started in a previous chunk
+            while ((pos = csv_next_pos(r)) && *pos != '\n');
+            if (pos) {
+                csv_keep(r, r->ptr, pos-r->ptr);
+                r->ptr = pos+1;
+            }
+            else {
+                csv_keep(r, r->ptr, r->end-r->ptr);
+                r->ptr = r->end;
+                if (!r->eof) return 0;
+            }
+            r->used = 1;
+            if (csv_split(r, P(r->carry), P(r->carry)+C(r->carry)))
+                return csv_end(r);
+            C(r->carry) = 0;
+            r->used = 0;
+            continue;
+        }
+
+        // record within the chunk - no copying
+        const uint8_t *start = r->ptr, *fs = start;
+        int col = 0;
+        while ((pos = csv_next_pos(r)) && *pos != '\n') {
+            csv_field(r, col++, fs, pos);
+            fs = pos+1;
+        }
+
+        if (pos)
+            r->ptr = pos+1;
+        else {
+            // no newline in the rest of the chunk - keep it for the next one
+            if (!r->eof) {
+                csv_keep(r, start, r->end-start);
+                r->ptr = r->end;
+                return 0;
+            }
+            // at the end of data, the remainder is the last record
+            if (start == r->end) return 0;
+            pos = r->ptr = r->end;
+        }
+
+        if (pos > fs && pos[-1] == '\r') pos--;
+        if (col == 0 && pos == fs) continue;    // empty line
+        csv_field(r, col, fs, pos);
+        return csv_end(r);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Number conversion
+
+// strtod is called with a "C" numeric locale, like the fast path parses
+static locale_t c_locale;
+static pthread_once_t c_locale_once = PTHREAD_ONCE_INIT;
+
+static void csv_locale_init() {
+    c_locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+}
+
+static inline locale_t csv_c_locale() {
+    pthread_once(&c_locale_once, csv_locale_init);
+    return c_locale;
+}
+
+static const double csv_pow10[23] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+int lh_csv_int(lh_span f, int64_t *v) {
+    const uint8_t *p = f.ptr, *end = p+f.len;
+    int neg = 0;
+    uint64_t u = 0;
+
+    if (p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+    if (p == end) return 0;
+    for(; p<end; p++) {
+        if (*p<'0' || *p>'9') return 0;
+        if (u > (UINT64_MAX-9)/10) return 0;
+        u = u*10 + (*p-'0');
+    }
+
+    if (u > (uint64_t)INT64_MAX + neg) return 0;
+    *v = neg ? -u : u;
+    return 1;
+}
+
+int lh_csv_double(lh_span f, double *v) {
+    const uint8_t *p = f.ptr, *end = p+f.len;
+    uint64_t m = 0;
+    int neg = 0, nd = 0, exp = 0, exact = 1;
+
+    // fast path: up to 19 significant digits and a small exponent give an
+    // exactly representable mantissa and power of ten, so a single
+    // multiplication or division is correctly rounded
+    if (p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+    for(; p<end && *p>='0' && *p<='9'; p++, nd++) {
+        if (m < 1000000000000000000ULL) m = m*10 + (*p-'0');
+        else { exp++; exact = 0; }
+    }
+    if (p<end && *p == '.') {
+        for(p++; p<end && *p>='0' && *p<='9'; p++, nd++) {
+            if (m < 1000000000000000000ULL) { m = m*10 + (*p-'0'); exp--; }
+            else exact = 0;
+        }
+    }
+    if (nd > 0 && p<end && (*p == 'e' || *p == 'E')) {
+        int eneg = 0, e = 0;
+        p++;
+        if (p < end && (*p == '-' || *p == '+')) eneg = (*p++ == '-');
+        if (p == end) return 0;
+        for(; p<end && *p>='0' && *p<='9'; p++)
+            if (e < 10000) e = e*10 + (*p-'0');
+        exp += eneg ? -e : e;
+    }
+
+    if (p == end && nd > 0 && exact && m <= (1ULL<<53) && exp >= -22 && exp <= 22) {
+        double d = (double)m;
+        d = (exp < 0) ? d / csv_pow10[-exp] : d * csv_pow10[exp];
+        *v = neg ? -d : d;
+        return 1;
+    }
+
+    // everything else - long mantissas, large exponents, inf and nan
+    char tmp[64], *s = tmp, *ep;
+    if (f.len == 0) return 0;
+    if (f.len >= sizeof(tmp)) s = malloc(f.len+1);
+    memcpy(s, f.ptr, f.len);
+    s[f.len] = 0;
+
+    locale_t old = uselocale(csv_c_locale());
+    *v = strtod(s, &ep);
+    uselocale(old);
+
+    int ok = (ep == s+f.len);
+    if (s != tmp) free(s);
+    return ok;
+}
+
+// convert a field to a column element
+static inline int csv_convert(lh_span f, char type, void *out) {
+    int64_t i;
+    double d;
+
+    switch (type) {
+    case 'i':
+        if (f.len == 0) i = 0;
+        else if (!lh_csv_int(f, &i) || i < INT32_MIN || i > INT32_MAX) return 0;
+        *(int32_t *)out = i;
+        return 1;
+    case 'l':
+        if (f.len == 0) i = 0;
+        else if (!lh_csv_int(f, &i)) return 0;
+        *(int64_t *)out = i;
+        return 1;
+    case 'f':
+        if (f.len == 0) d = NAN;
+        else if (!lh_csv_double(f, &d)) return 0;
+        *(float *)out = d;
+        return 1;
+    case 'd':
+        if (f.len == 0) d = NAN;
+        else if (!lh_csv_double(f, &d)) return 0;
+        *(double *)out = d;
+        return 1;
+    }
+    return 0;
+}
+
+ssize_t lh_csv_columns_internal(lh_csv_reader *r, int *cnt, int gran, const char *types, ...) {
+    uint8_t **cols[CSV_MAXCOLS];
+    ssize_t size[CSV_MAXCOLS];
+    int ncol = 0, i, nf;
+
+    va_list fields;
+    va_start( fields, types );
+    do {
+        uint8_t **ptrp = va_arg(fields, uint8_t **);
+        if (!ptrp) break;
+        assert(ncol < CSV_MAXCOLS);
+        cols[ncol] = ptrp;
+        size[ncol] = va_arg(fields, ssize_t);
+        assert(size[ncol] == ((types[ncol] == 'i' || types[ncol] == 'f') ? 4 : 8));
+        ncol++;
+    } while (1);
+    va_end( fields );
+    assert(ncol == strlen(types));
+
+    ssize_t rows = 0;
+    while ((nf = lh_csv_next(r)) > 0) {
+        int row = *cnt;
+
+        // grow the arrays like lh_multiarray_add_g()
+        if (lh_align(row+1,gran) > lh_align(row,gran)) {
+            for(i=0; i<ncol; i++) {
+                *cols[i] = realloc(*cols[i], size[i]*lh_align(row+1,gran));
+                memset(*cols[i]+size[i]*lh_align(row,gran), 0,
+                       size[i]*(lh_align(row+1,gran)-lh_align(row,gran)));
+            }
+        }
+
+        for(i=0; i<ncol; i++) {
+            lh_span f = (i < nf) ? P(r->field)[i] : lh_span_make("", 0);
+            if (!csv_convert(f, types[i], *cols[i]+size[i]*row)) {
+                r->error = "invalid number";
+                r->errrec = r->nrec-1;
+                r->errcol = i;
+                // leave the unused elements zeroed
+                while (--i >= 0) memset(*cols[i]+size[i]*row, 0, size[i]);
+                return -1;
+            }
+        }
+        *cnt = row+1;
+        rows++;
+    }
+    return rows;
+}
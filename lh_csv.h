@@ -0,0 +1,149 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+/*! \file
+ * Zero-copy CSV/TSV reader
+ *
+ * The reader is fed with chunks of data, like the lh_splitter, and yields
+ * the records as arrays of field spans. A whole mmap'ed file can be fed as
+ * a single chunk. Fields point directly into the chunk - only a record
+ * crossing a chunk boundary is assembled in an internal buffer, and only
+ * a quoted field containing escaped quotes ("") is copied to be unescaped.
+ *
+ * Quoting follows RFC 4180: fields may be enclosed in double quotes and
+ * then contain separators, newlines and doubled quotes. Records end with
+ * \n or \r\n, empty lines are skipped.
+ *
+ * The positions of the separators and newlines are located with SIMD
+ * compares 64 bytes at a time, masking out the quoted regions with a
+ * prefix XOR of the quote bits, so the splitting does not branch on
+ * every byte.
+ *
+ * EXAMPLE:
+ * lh_csv_reader r;
+ * lh_csv_init(&r, ',', 0);
+ * int cols[] = { 0, 3 };
+ * lh_csv_select(&r, cols, 2);
+ * lh_csv_feed(&r, map, size);         // the whole mmap'ed file
+ * lh_csv_finish(&r);
+ * while (lh_csv_next(&r) > 0)
+ *     process(r.field_p[0], r.field_p[1]);
+ * lh_csv_free(&r);
+ *
+ * Numeric columns can be converted directly into a multi-array:
+ *
+ * int cnt = 0; int64_t *id = NULL; double *val = NULL;
+ * while ((len = read(fd, buf, sizeof(buf))) > 0) {
+ *     lh_csv_feed(&r, buf, len);
+ *     if (lh_csv_columns(&r, cnt, 4096, "ld", MAF(id), MAF(val)) < 0) break;
+ * }
+ */
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lh_arr.h"
+#include "lh_strings.h"
+
+#define LH_CSV_NOQUOTE  (1<<0)  /* quotes have no special meaning (plain TSV) */
+
+#define LH_CSV_WINDOW   (1<<16) /* bytes indexed at once */
+
+typedef struct {
+    uint8_t         sep;        // field separator
+    int             flags;      // LH_CSV_* flags
+    int             eof;        // no more data will be fed
+    int             used;       // carry buffer was returned as a record
+    uint64_t        inq;        // scanning position is within quotes (all ones)
+
+    const uint8_t * ptr;        // unprocessed part of the current chunk
+    const uint8_t * end;
+    const uint8_t * scan;       // the chunk is indexed up to here
+
+    const uint8_t * base;       // index positions are relative to this
+    uint32_t *      index;      // positions of unquoted separators and newlines
+    ssize_t         nidx;       // number of positions in the index
+    ssize_t         inext;      // next unused position
+
+    lh_arr_declare(int,sel);    // output field of each column, -1 if skipped
+    int             nsel;       // number of selected columns, 0 for all
+
+    lh_arr_declare(lh_span,field); // fields of the current record
+    lh_arr_declare(int,fixup);  // fields pointing into the unq buffer
+    lh_buf_declare(unq);        // unescaped quoted fields
+    lh_buf_declare(carry);      // partial record from the previous chunks
+
+    ssize_t         nrec;       // number of records returned
+    const char *    error;      // conversion error message
+    ssize_t         errrec;     // record and field of the error
+    int             errcol;
+} lh_csv_reader;
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Initialize a reader
+ * \param r Reader
+ * \param sep Field separator, usually ',' or '\t'
+ * \param flags LH_CSV_* flags */
+void lh_csv_init(lh_csv_reader *r, uint8_t sep, int flags);
+void lh_csv_free(lh_csv_reader *r);
+
+/*! \brief Select the columns to return. The other columns are skipped
+ * without processing their quoting. Columns missing in a record are
+ * returned as empty fields.
+ * \param r Reader
+ * \param cols Indexes of the columns, in the order they should be returned
+ * \param n Number of columns, 0 to return all columns */
+void lh_csv_select(lh_csv_reader *r, const int *cols, int n);
+
+/*! \brief Feed the next chunk of data to the reader.
+ * The chunk must stay valid until lh_csv_next() returns 0.
+ * All records from the previous chunk must have been retrieved. */
+void lh_csv_feed(lh_csv_reader *r, const uint8_t *data, ssize_t len);
+
+/*! \brief Signal the end of data. A last record without a newline
+ * will be returned by the next call to lh_csv_next() */
+void lh_csv_finish(lh_csv_reader *r);
+
+/*! \brief Get the next complete record.
+ * The fields are stored in r->field_p, they are valid until the next
+ * call to lh_csv_next() or lh_csv_feed(). Quoted fields are returned
+ * without the quotes and with the escaped quotes decoded.
+ * \param r Reader
+ * \return Number of fields in the record, or the number of selected
+ * columns; 0 if more data must be fed */
+int lh_csv_next(lh_csv_reader *r);
+
+/*! \brief Read all complete records of the current chunk and append their
+ * fields as numbers to the columns of a multi-array.
+ * \param r Reader
+ * \param cnt Name of the counter variable of the multi-array
+ * \param gran Allocation granularity of the multi-array, power of 2
+ * \param types Type of each column: 'i' int32_t, 'l' int64_t,
+ * 'f' float, 'd' double. Empty fields are stored as 0 or NaN.
+ * \param ... List of the array variables, enclosed in MAF()
+ * \return Number of rows added, -1 if a field is not a valid number -
+ * the rows up to the faulty record are kept, and the message and
+ * position are stored in the reader */
+#define lh_csv_columns(r,cnt,gran,types,...)                            \
+    lh_csv_columns_internal(r,&(cnt),gran,types,__VA_ARGS__,NULL)
+
+ssize_t lh_csv_columns_internal(lh_csv_reader *r, int *cnt, int gran, const char *types, ...);
+
+/*! \brief Parse an integer field
+ * \return 1 on success, 0 if the field is not an integer or out of range */
+int lh_csv_int(lh_span f, int64_t *v);
+
+/*! \brief Parse a floating point field.
+ * A '.' is the decimal point whatever the locale, and there is no length limit.
+ * \return 1 on success, 0 if the field is not a number */
+int lh_csv_double(lh_span f, double *v);
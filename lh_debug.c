@@ -1,6 +1,8 @@
 #include "lh_debug.h"
+#include "lh_encode.h"
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 
 #define PARAALIGN(ptr) (const uint8_t *)(((size_t)(ptr))&(-1L<<4))
 
@@ -37,19 +39,10 @@ void hexprint(const void * data, ssize_t length) {
         printf("%02x%s",*ptr++,(length==i+1)?"\n":" ");
 }
 
-#define HEXDIGIT(h) \
-    (h>='0' && h<='9') ? ( h-'0') :                 \
-        ( (h>='a' && h<='f') ? ( h-'a'+10) :        \
-          (h>='A' && h<='F') ? ( h-'A'+10) : -1)
-                                                     
 ssize_t hex_import(const char *hex, uint8_t *bin, ssize_t maxlen) {
-    ssize_t i;
-    for(i=0; i<maxlen; i++) {
-        char h = HEXDIGIT(*hex); hex++;
-        if (h<0) break;
-        char l = HEXDIGIT(*hex); hex++;
-        if (l<0) break;
-        bin[i]=(h<<4)|l;
-    }
-    return i;
+    // decode the leading hex digit pairs, up to maxlen bytes
+    ssize_t len = strnlen(hex, 2*maxlen) & ~1, pos;
+    if (lh_hex_decode(hex, len, bin, &pos) >= 0) return len/2;
+    lh_hex_decode(hex, pos&~1, bin, NULL);
+    return pos/2;
 }
@@ -18,6 +18,8 @@
 #include <stddef.h>
 
 #include "lh_dir.h"
+#include "lh_path.h"
+#include "lh_compare.h"
 
 #define LH_DIR_ALLOCGRAN 256
 
@@ -26,12 +28,14 @@
 typedef struct lh_dwfile {
     struct stat * st;           // stat data
     char * name;                // file name (w/o path)
+    ssize_t namelen;            // length of the name
 } lh_dwfile;
 
 // object representing a single directory being processed
 // dirwalker object maintains a stack of these objects
 typedef struct lh_dwdir {
     char          * path;       // full path of the directory
+    ssize_t         pathlen;    // length of the path
     //struct stat   * st;
 
     lh_dwfile     * files;      // list of files
@@ -54,6 +58,8 @@ struct lh_dirwalk {
     int             flags;      // flags supplied to lh_dirwalk_create
 
     lh_dwdir      * current;    // currently processed directory
+
+    lh_pathbuf      pb;         // path of the entry being processed
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -87,11 +93,11 @@ lh_dirwalk * lh_dirwalk_create(const char * basepath, int flags) {
         LH_ERROR(NULL,"Path too long: %s\n",basepath);
 #endif
 
+    // strip the trailing slashes, but keep a single "/"
+    while (nlen>1 && basepath[nlen-1] == '/') nlen--;
     lh_alloc_buf(df->name, nlen+1);
     memcpy(df->name, basepath, nlen);
-    do {
-        df->name[nlen--] = 0;
-    } while(nlen>0 && df->name[nlen] == '/');
+    df->namelen = nlen;
 
     lh_alloc_obj(df->st);
     int res;
@@ -130,6 +136,7 @@ void lh_dirwalk_destroy(lh_dirwalk * dw) {
         }
         free(ds);
     }
+    lh_pathbuf_free(&dw->pb);
     free(dw);
 }
 
@@ -149,46 +156,41 @@ void lh_dirwalk_dump(lh_dirwalk * dw) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
-#ifdef HAVE_QSORT_R
-
-static int lh_dirwalk_cmp(const void *pa, const void *pb, void *priv) {
-    lh_dwfile *a =(lh_dwfile *)pa;
-    lh_dwfile *b =(lh_dwfile *)pb;
-    int flags = (intptr_t)priv;
-
-    if (flags&LH_DW_SORT_DIRFIRST) {
-        // sort directories first
-        if ( S_ISDIR(a->st->st_mode) > S_ISDIR(b->st->st_mode) ) return -1;
-        if ( S_ISDIR(a->st->st_mode) < S_ISDIR(b->st->st_mode) ) return 1;
+// sort the file list of a directory by name with precomputed sort keys
+static void lh_dirwalk_sort(lh_dirwalk *dw, lh_dwdir *ds) {
+    ssize_t i, n = ds->nfiles, nd = 0;
+    int cflags = 0;
+    if (dw->flags&LH_DW_SORT_IGNORECASE) cflags |= LH_CMP_IGNORECASE;
+    if (dw->flags&LH_DW_SORT_NATURAL)    cflags |= LH_CMP_NATURAL;
+
+    lh_dwfile *tmp = malloc(n*sizeof(*tmp));
+    lh_span *names = malloc(n*sizeof(*names));
+    ssize_t *order = malloc(n*sizeof(*order));
+
+    if (dw->flags&LH_DW_SORT_DIRFIRST) {
+        // directories first - the names are then sorted within each group
+        for(i=0; i<n; i++)
+            if (S_ISDIR(ds->files[i].st->st_mode)) tmp[nd++] = ds->files[i];
+        ssize_t j = nd;
+        for(i=0; i<n; i++)
+            if (!S_ISDIR(ds->files[i].st->st_mode)) tmp[j++] = ds->files[i];
     }
-
-    // sort files alphabetically
-    assert(a->name);
-    assert(b->name);
-    if (flags&LH_DW_SORT_IGNORECASE)
-        return strcasecmp(a->name, b->name);
     else
-        return strcmp(a->name, b->name);
-}
+        memcpy(tmp, ds->files, n*sizeof(*tmp));
 
-#else
-
-static int lh_dirwalk_cmp(const void *pa, const void *pb) {
-    lh_dwfile *a =(lh_dwfile *)pa;
-    lh_dwfile *b =(lh_dwfile *)pb;
+    for(i=0; i<n; i++)
+        names[i] = lh_span_make(tmp[i].name, tmp[i].namelen);
+    lh_sort_order(names, nd, cflags, order);
+    lh_sort_order(names+nd, n-nd, cflags, order+nd);
 
-    // sort directories first
-    if ( S_ISDIR(a->st->st_mode) > S_ISDIR(b->st->st_mode) ) return -1;
-    if ( S_ISDIR(a->st->st_mode) < S_ISDIR(b->st->st_mode) ) return 1;
+    for(i=0; i<nd; i++) ds->files[i] = tmp[order[i]];
+    for(i=nd; i<n; i++) ds->files[i] = tmp[nd+order[i]];
 
-    // sort files alphabetically
-    assert(a->name);
-    assert(b->name);
-    return strcmp(a->name, b->name);
+    free(order);
+    free(names);
+    free(tmp);
 }
 
-#endif
-
 static int lh_dirwalk_readdir(lh_dirwalk *dw) {
     lh_dwdir *ds = dw->current;
 
@@ -200,11 +202,12 @@ static int lh_dirwalk_readdir(lh_dirwalk *dw) {
 
     // dirent pointers for the readdir_r result
     struct dirent *dep, *de;
-    de = malloc(offsetof(struct dirent, d_name)+dw->name_max+1);
-    lh_clear_ptr(de);
+    ssize_t desize = offsetof(struct dirent, d_name)+dw->name_max+1;
+    de = malloc(desize);
+    memset(de, 0, desize);
 
-    char *path = malloc(dw->path_max+1);
-    ssize_t npos = sprintf(path, "%s/", ds->path);
+    // the entries are stat'ed by appending their names to the directory path
+    lh_pathbuf_set(&dw->pb, lh_span_make(ds->path, ds->pathlen));
 
     while (1) {
         // read next dirent
@@ -222,34 +225,31 @@ static int lh_dirwalk_readdir(lh_dirwalk *dw) {
         // allocate a new entry in the file list
         lh_dwfile * newfile = lh_arr_new(ds->files, ds->nfiles, LH_DIR_ALLOCGRAN);
 
-        newfile->name = strdup(name);
+        newfile->namelen = strlen(name);
+        lh_alloc_buf(newfile->name, newfile->namelen+1);
+        memcpy(newfile->name, name, newfile->namelen);
 
         // stat it
-        assert(npos+strlen(name) <= dw->path_max);
-        sprintf(path+npos, "%s", name);
+        ssize_t plen = lh_pathbuf_push(&dw->pb, lh_span_make(name, newfile->namelen));
+        assert(dw->pb.len <= dw->path_max);
 
         int res;
         lh_alloc_obj(newfile->st);
         if (dw->flags&LH_DW_FOLLOW_SYMLINK)
-            res = stat(path, newfile->st);
+            res = stat(dw->pb.path, newfile->st);
         else
-            res = lstat(path, newfile->st);
+            res = lstat(dw->pb.path, newfile->st);
+
+        lh_pathbuf_trunc(&dw->pb, plen);
     }
 
     // sort the files if necessary
-    if (ds->files && dw->flags&LH_DW_SORT) {
-#ifdef HAVE_QSORT_R
-        qsort_r(ds->files, ds->nfiles, sizeof(*ds->files),
-                lh_dirwalk_cmp, (void *)(intptr_t)dw->flags);
-#else
-        qsort(ds->files, ds->nfiles, sizeof(*ds->files), lh_dirwalk_cmp);
-#endif
-    }
+    if (ds->files && dw->flags&LH_DW_SORT)
+        lh_dirwalk_sort(dw, ds);
 
     // the directory is now initialized
     ds->init = 1;
     closedir(dir);
-    free(path);
     free(de);
 
     return 0;
@@ -299,6 +299,8 @@ int lh_dirwalk_next_p(lh_dirwalk *dw, lh_dwres_p *dr) {
                 lh_dwfile * df = ds->files+ds->nextfile-1;
                 dr->path = ds->path;
                 dr->name = df->name;
+                dr->pathlen = ds->pathlen;
+                dr->namelen = df->namelen;
                 dr->st = df->st;
                 return LH_DW_DIREND;
             }
@@ -317,18 +319,14 @@ int lh_dirwalk_next_p(lh_dirwalk *dw, lh_dwres_p *dr) {
             lh_alloc_obj(dw->current);
             dw->current->parent = ds;
 
-            lh_alloc_buf(dw->current->path,dw->path_max);
-            if (ds->path) {
-                if (ds->path[0]=='/' && ds->path[1]==0)
-                    sprintf(dw->current->path, "/%s",df->name);
-                else
-                    sprintf(dw->current->path, "%s/%s",ds->path,df->name);
-            }
-            else {
-                // there is no path for the top dwdir, since it's
-                // an explicitly defined file list
-                sprintf(dw->current->path, "%s",df->name);
-            }
+            // there is no path for the top dwdir, since it's
+            // an explicitly defined file list
+            lh_pathbuf_set(&dw->pb, lh_span_make(ds->path, ds->pathlen));
+            lh_pathbuf_push(&dw->pb, lh_span_make(df->name, df->namelen));
+
+            lh_alloc_buf(dw->current->path, dw->pb.len+1);
+            memcpy(dw->current->path, dw->pb.path, dw->pb.len);
+            dw->current->pathlen = dw->pb.len;
 
             dw->level++;
             // everything else stays zeroed - it will be initialized
@@ -343,6 +341,8 @@ int lh_dirwalk_next_p(lh_dirwalk *dw, lh_dwres_p *dr) {
                 dr->level = dw->level-1;
                 dr->path = ds->path;
                 dr->name = df->name;
+                dr->pathlen = ds->pathlen;
+                dr->namelen = df->namelen;
                 dr->st   = df->st;
                 return LH_DW_DIR;
             }
@@ -357,6 +357,8 @@ int lh_dirwalk_next_p(lh_dirwalk *dw, lh_dwres_p *dr) {
                 dr->level = dw->level;
                 dr->path = ds->path;
                 dr->name = df->name;
+                dr->pathlen = ds->pathlen;
+                dr->namelen = df->namelen;
                 dr->st   = df->st;
                 return LH_DW_FILE;
             }
@@ -369,6 +371,8 @@ int lh_dirwalk_next_p(lh_dirwalk *dw, lh_dwres_p *dr) {
             dr->level = dw->level;
             dr->path = ds->path;
             dr->name = df->name;
+            dr->pathlen = ds->pathlen;
+            dr->namelen = df->namelen;
             dr->st   = df->st;
             return LH_DW_SPECIAL;
         }
@@ -389,11 +393,13 @@ int lh_dirwalk_next(lh_dirwalk *dw, lh_dwres *dr) {
     dr->type = drp.type;
     if (res>0) {
         dr->level = drp.level;
-        if (drp.path)
-            strncpy(dr->path, drp.path, sizeof(dr->path));
-        else
-            dr->path[0] = 0;
-        strncpy(dr->name, drp.name, sizeof(dr->name));
+        // the lengths are known, no need to scan the strings again
+        ssize_t plen = (drp.pathlen < PATH_MAX) ? drp.pathlen : PATH_MAX;
+        ssize_t nlen = (drp.namelen < NAME_MAX) ? drp.namelen : NAME_MAX;
+        if (plen) memcpy(dr->path, drp.path, plen);
+        dr->path[plen] = 0;
+        if (nlen) memcpy(dr->name, drp.name, nlen);
+        dr->name[nlen] = 0;
         memcpy(&dr->st, drp.st, sizeof(dr->st));
     }
     return res;
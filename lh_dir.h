@@ -39,6 +39,7 @@
 #define LH_DW_SORT             (1<<8)  /* sort files alphabetically */
 #define LH_DW_SORT_DIRFIRST    (1<<9)  /* sort directories first */
 #define LH_DW_SORT_IGNORECASE  (1<<10) /* ignore case when sorting */
+#define LH_DW_SORT_NATURAL     (1<<11) /* sort numbers in names by value */
 
 #define LH_DW_DEFAULTS                                          \
     (LH_DW_REPORT_FILE|LH_DW_REPORT_DIR|LH_DW_REPORT_DIREND|    \
@@ -62,6 +63,8 @@ typedef struct {
     struct stat * st;
     int level;
     int type;
+    ssize_t pathlen;    // lengths of path and name
+    ssize_t namelen;
 } lh_dwres_p;
 
 typedef struct {
@@ -0,0 +1,536 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include "lh_encode.h"
+#include "lh_cpu.h"
+#include "lh_arr.h"
+
+#include <string.h>
+#include <pthread.h>
+
+static const char hex_lower[16] = "0123456789abcdef";
+static const char hex_upper[16] = "0123456789ABCDEF";
+
+static const char b64_std[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char b64_url[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// reverse lookup tables, -1 for characters outside of the alphabet
+static int8_t hex_dec[256];
+static int8_t b64_dec[2][256];
+static pthread_once_t dec_once = PTHREAD_ONCE_INIT;
+
+static void lh_encode_init() {
+    int i;
+    memset(hex_dec, -1, sizeof(hex_dec));
+    memset(b64_dec, -1, sizeof(b64_dec));
+    for(i=0; i<16; i++) {
+        hex_dec[(uint8_t)hex_lower[i]] = i;
+        hex_dec[(uint8_t)hex_upper[i]] = i;
+    }
+    for(i=0; i<64; i++) {
+        b64_dec[0][(uint8_t)b64_std[i]] = i;
+        b64_dec[1][(uint8_t)b64_url[i]] = i;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Scalar implementations
+
+static void lh_hex_encode_scalar(const uint8_t *p, ssize_t len, char *out, const char *digits) {
+    ssize_t i;
+    for(i=0; i<len; i++) {
+        out[2*i]   = digits[p[i]>>4];
+        out[2*i+1] = digits[p[i]&15];
+    }
+}
+
+// decode len/2 bytes, returns the offset of the first invalid character or -1
+static ssize_t lh_hex_decode_scalar(const char *s, ssize_t len, uint8_t *out) {
+    ssize_t i;
+    for(i=0; i+2<=len; i+=2) {
+        int8_t h = hex_dec[(uint8_t)s[i]];
+        int8_t l = hex_dec[(uint8_t)s[i+1]];
+        if ((h|l) < 0) return (h<0) ? i : i+1;
+        out[i/2] = (h<<4)|l;
+    }
+    return -1;
+}
+
+// encode complete triplets only
+static void lh_base64_encode_scalar(const uint8_t *p, ssize_t len, char *out, const char *abc) {
+    ssize_t i;
+    for(i=0; i+3<=len; i+=3, out+=4) {
+        uint32_t v = (p[i]<<16) | (p[i+1]<<8) | p[i+2];
+        out[0] = abc[v>>18];
+        out[1] = abc[(v>>12)&63];
+        out[2] = abc[(v>>6)&63];
+        out[3] = abc[v&63];
+    }
+}
+
+// decode complete quads only, returns the offset of the first invalid character or -1
+static ssize_t lh_base64_decode_scalar(const char *s, ssize_t len, uint8_t *out,
+                                       const int8_t *dec) {
+    ssize_t i;
+    for(i=0; i+4<=len; i+=4, out+=3) {
+        int8_t a = dec[(uint8_t)s[i]];
+        int8_t b = dec[(uint8_t)s[i+1]];
+        int8_t c = dec[(uint8_t)s[i+2]];
+        int8_t d = dec[(uint8_t)s[i+3]];
+        if ((a|b|c|d) < 0) {
+            int k;
+            for(k=0; k<4; k++)
+                if (dec[(uint8_t)s[i+k]] < 0) return i+k;
+        }
+        uint32_t v = (a<<18) | (b<<12) | (c<<6) | d;
+        out[0] = v>>16;
+        out[1] = v>>8;
+        out[2] = v;
+    }
+    return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// SIMD implementations
+
+#ifdef HAVE_X86_SIMD
+
+// Each kernel processes the complete vector blocks and returns the number
+// of input bytes consumed; the caller finishes the rest with the scalar code.
+
+LH_TARGET("ssse3")
+static ssize_t lh_hex_encode_ssse3(const uint8_t *p, ssize_t len, char *out, const char *digits) {
+    const __m128i lut = _mm_loadu_si128((const __m128i *)digits);
+    const __m128i nib = _mm_set1_epi8(0x0f);
+    ssize_t i;
+    for(i=0; i+16<=len; i+=16) {
+        __m128i v  = _mm_loadu_si128((const __m128i *)(p+i));
+        __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), nib));
+        __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, nib));
+        _mm_storeu_si128((__m128i *)(out+2*i),    _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(out+2*i+16), _mm_unpackhi_epi8(hi, lo));
+    }
+    return i;
+}
+
+LH_TARGET("avx2")
+static ssize_t lh_hex_encode_avx2(const uint8_t *p, ssize_t len, char *out, const char *digits) {
+    const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)digits));
+    const __m256i nib = _mm256_set1_epi8(0x0f);
+    ssize_t i;
+    for(i=0; i+32<=len; i+=32) {
+        __m256i v  = _mm256_loadu_si256((const __m256i *)(p+i));
+        __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), nib));
+        __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, nib));
+        // unpack works within the lanes: a = bytes 0-7,16-23  b = 8-15,24-31
+        __m256i a = _mm256_unpacklo_epi8(hi, lo);
+        __m256i b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i *)(out+2*i),    _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i *)(out+2*i+32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    return i;
+}
+
+// convert hex digits to their values, sets *bad if any character is invalid
+LH_TARGET("ssse3")
+static inline __m128i lh_hex_values_ssse3(__m128i c, int *bad) {
+    // range checks with signed compares after shifting the range to -128
+    __m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'+128));
+    __m128i a = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'+128));
+    __m128i isdig = _mm_cmpgt_epi8(_mm_set1_epi8(-128+10), d);
+    __m128i isalp = _mm_cmpgt_epi8(_mm_set1_epi8(-128+6), a);
+    *bad |= _mm_movemask_epi8(_mm_or_si128(isdig, isalp)) ^ 0xffff;
+    __m128i vd = _mm_and_si128(isdig, _mm_add_epi8(d, _mm_set1_epi8(-128)));
+    __m128i va = _mm_and_si128(isalp, _mm_add_epi8(a, _mm_set1_epi8(-128+10)));
+    return _mm_or_si128(vd, va);
+}
+
+LH_TARGET("ssse3")
+static ssize_t lh_hex_decode_ssse3(const char *s, ssize_t len, uint8_t *out) {
+    const __m128i mul = _mm_set1_epi16(0x0110);   // high nibble *16, low *1
+    ssize_t i;
+    for(i=0; i+32<=len; i+=32) {
+        int bad = 0;
+        __m128i a = lh_hex_values_ssse3(_mm_loadu_si128((const __m128i *)(s+i)), &bad);
+        __m128i b = lh_hex_values_ssse3(_mm_loadu_si128((const __m128i *)(s+i+16)), &bad);
+        if (bad) break;
+        a = _mm_maddubs_epi16(a, mul);
+        b = _mm_maddubs_epi16(b, mul);
+        _mm_storeu_si128((__m128i *)(out+i/2), _mm_packus_epi16(a, b));
+    }
+    return i;
+}
+
+LH_TARGET("avx2")
+static inline __m256i lh_hex_values_avx2(__m256i c, int *bad) {
+    __m256i d = _mm256_sub_epi8(c, _mm256_set1_epi8('0'+128));
+    __m256i a = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'+128));
+    __m256i isdig = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128+10), d);
+    __m256i isalp = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128+6), a);
+    *bad |= ~_mm256_movemask_epi8(_mm256_or_si256(isdig, isalp));
+    __m256i vd = _mm256_and_si256(isdig, _mm256_add_epi8(d, _mm256_set1_epi8(-128)));
+    __m256i va = _mm256_and_si256(isalp, _mm256_add_epi8(a, _mm256_set1_epi8(-128+10)));
+    return _mm256_or_si256(vd, va);
+}
+
+LH_TARGET("avx2")
+static ssize_t lh_hex_decode_avx2(const char *s, ssize_t len, uint8_t *out) {
+    const __m256i mul = _mm256_set1_epi16(0x0110);
+    ssize_t i;
+    for(i=0; i+64<=len; i+=64) {
+        int bad = 0;
+        __m256i a = lh_hex_values_avx2(_mm256_loadu_si256((const __m256i *)(s+i)), &bad);
+        __m256i b = lh_hex_values_avx2(_mm256_loadu_si256((const __m256i *)(s+i+32)), &bad);
+        if (bad) break;
+        a = _mm256_maddubs_epi16(a, mul);
+        b = _mm256_maddubs_epi16(b, mul);
+        // packus works within the lanes, restore the order of the quadwords
+        __m256i r = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8);
+        _mm256_storeu_si256((__m256i *)(out+i/2), r);
+    }
+    return i;
+}
+
+// split 12 bytes (in 4-byte groups as 1,0,2,1) into 16 6-bit indices
+// and translate them to the alphabet
+LH_TARGET("ssse3")
+static inline __m128i lh_base64_enc_ssse3(__m128i in, __m128i shift_lut) {
+    __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    __m128i idx = _mm_or_si128(t1, t3);
+
+    // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+    __m128i red = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+    __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+    red = _mm_or_si128(red, _mm_and_si128(less, _mm_set1_epi8(13)));
+    return _mm_add_epi8(idx, _mm_shuffle_epi8(shift_lut, red));
+}
+
+LH_TARGET("ssse3")
+static inline __m128i lh_base64_shift_lut_ssse3(const char *abc) {
+    return _mm_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+                         '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+                         abc[62]-62, abc[63]-63, 'A', 0, 0);
+}
+
+LH_TARGET("ssse3")
+static ssize_t lh_base64_encode_ssse3(const uint8_t *p, ssize_t len, char *out, const char *abc) {
+    const __m128i lut = lh_base64_shift_lut_ssse3(abc);
+    const __m128i shuf = _mm_setr_epi8(1,0,2,1, 4,3,5,4, 7,6,8,7, 10,9,11,10);
+    ssize_t i;
+    // 12 bytes per iteration, but the load reads 16
+    for(i=0; i+16<=len; i+=12, out+=16) {
+        __m128i in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p+i)), shuf);
+        _mm_storeu_si128((__m128i *)out, lh_base64_enc_ssse3(in, lut));
+    }
+    return i;
+}
+
+LH_TARGET("avx2")
+static inline __m256i lh_base64_enc_avx2(__m256i in, __m256i shift_lut) {
+    __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+    __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+    __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    __m256i idx = _mm256_or_si256(t1, t3);
+
+    __m256i red = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+    __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx);
+    red = _mm256_or_si256(red, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+    return _mm256_add_epi8(idx, _mm256_shuffle_epi8(shift_lut, red));
+}
+
+LH_TARGET("avx2")
+static ssize_t lh_base64_encode_avx2(const uint8_t *p, ssize_t len, char *out, const char *abc) {
+    const __m256i lut = _mm256_broadcastsi128_si256(lh_base64_shift_lut_ssse3(abc));
+    const __m256i shuf = _mm256_setr_epi8(1,0,2,1, 4,3,5,4, 7,6,8,7, 10,9,11,10,
+                                          1,0,2,1, 4,3,5,4, 7,6,8,7, 10,9,11,10);
+    ssize_t i;
+    // 24 bytes per iteration, 12 in each lane
+    for(i=0; i+28<=len; i+=24, out+=32) {
+        __m256i in = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(p+i))),
+            _mm_loadu_si128((const __m128i *)(p+i+12)), 1);
+        in = _mm256_shuffle_epi8(in, shuf);
+        _mm256_storeu_si256((__m256i *)out, lh_base64_enc_avx2(in, lut));
+    }
+    return i;
+}
+
+// replace the URL-safe characters with the standard ones, so the same
+// lookup tables can be used. Standard characters are rejected.
+LH_TARGET("ssse3")
+static inline __m128i lh_base64_url_ssse3(__m128i in, int *bad) {
+    __m128i std = _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('+')),
+                               _mm_cmpeq_epi8(in, _mm_set1_epi8('/')));
+    *bad |= _mm_movemask_epi8(std);
+    __m128i m1 = _mm_cmpeq_epi8(in, _mm_set1_epi8('-'));
+    __m128i m2 = _mm_cmpeq_epi8(in, _mm_set1_epi8('_'));
+    in = _mm_add_epi8(in, _mm_and_si128(m1, _mm_set1_epi8('+'-'-')));
+    in = _mm_add_epi8(in, _mm_and_si128(m2, _mm_set1_epi8('/'-'_')));
+    return in;
+}
+
+LH_TARGET("ssse3")
+static ssize_t lh_base64_decode_ssse3(const char *s, ssize_t len, uint8_t *out, int url) {
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                         0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                         0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                           0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+    const __m128i pack = _mm_setr_epi8(2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1);
+    ssize_t i;
+
+    // the store writes 16 bytes for 12 decoded, keep clear of the last
+    // quads so it stays within the output and padding is never seen here
+    for(i=0; i+24<=len; i+=16, out+=12) {
+        int bad = 0;
+        __m128i in = _mm_loadu_si128((const __m128i *)(s+i));
+        if (url) in = lh_base64_url_ssse3(in, &bad);
+
+        __m128i hi_nib = _mm_and_si128(_mm_srli_epi32(in, 4), mask_2f);
+        __m128i lo_nib = _mm_and_si128(in, mask_2f);
+        __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nib);
+        __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nib);
+        __m128i inv = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128());
+        bad |= _mm_movemask_epi8(inv) ^ 0xffff;
+        if (bad) break;
+
+        __m128i eq_2f = _mm_cmpeq_epi8(in, mask_2f);
+        __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nib));
+        __m128i v = _mm_add_epi8(in, roll);
+
+        // merge the 6-bit values into 24-bit groups
+        __m128i ab = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+        __m128i abc = _mm_madd_epi16(ab, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(abc, pack));
+    }
+    return i;
+}
+
+LH_TARGET("avx2")
+static ssize_t lh_base64_decode_avx2(const char *s, ssize_t len, uint8_t *out, int url) {
+    const __m256i lut_lo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i lut_hi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    const __m256i pack = _mm256_setr_epi8(
+        2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1,
+        2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1);
+    const __m256i perm = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+    ssize_t i;
+
+    for(i=0; i+48<=len; i+=32, out+=24) {
+        __m256i in = _mm256_loadu_si256((const __m256i *)(s+i));
+        int bad = 0;
+        if (url) {
+            __m256i std = _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('+')),
+                                          _mm256_cmpeq_epi8(in, _mm256_set1_epi8('/')));
+            bad = _mm256_movemask_epi8(std);
+            __m256i m1 = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('-'));
+            __m256i m2 = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('_'));
+            in = _mm256_add_epi8(in, _mm256_and_si256(m1, _mm256_set1_epi8('+'-'-')));
+            in = _mm256_add_epi8(in, _mm256_and_si256(m2, _mm256_set1_epi8('/'-'_')));
+        }
+
+        __m256i hi_nib = _mm256_and_si256(_mm256_srli_epi32(in, 4), mask_2f);
+        __m256i lo_nib = _mm256_and_si256(in, mask_2f);
+        __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nib);
+        __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nib);
+        if (bad || !_mm256_testz_si256(lo, hi)) break;
+
+        __m256i eq_2f = _mm256_cmpeq_epi8(in, mask_2f);
+        __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nib));
+        __m256i v = _mm256_add_epi8(in, roll);
+
+        __m256i ab = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        __m256i abc = _mm256_madd_epi16(ab, _mm256_set1_epi32(0x00011000));
+        abc = _mm256_shuffle_epi8(abc, pack);
+        _mm256_storeu_si256((__m256i *)out, _mm256_permutevar8x32_epi32(abc, perm));
+    }
+    return i;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// Hex
+
+ssize_t lh_hex_encode(const uint8_t *p, ssize_t len, char *out, int flags) {
+    const char *digits = (flags&LH_HEX_UPPER) ? hex_upper : hex_lower;
+    ssize_t i = 0;
+#ifdef HAVE_X86_SIMD
+    if (lh_cpu_has(LH_CPU_AVX2))
+        i = lh_hex_encode_avx2(p, len, out, digits);
+    else if (lh_cpu_has(LH_CPU_SSSE3))
+        i = lh_hex_encode_ssse3(p, len, out, digits);
+#endif
+    lh_hex_encode_scalar(p+i, len-i, out+2*i, digits);
+    return 2*len;
+}
+
+ssize_t lh_hex_decode(const char *s, ssize_t len, uint8_t *out, ssize_t *errpos) {
+    pthread_once(&dec_once, lh_encode_init);
+
+    ssize_t i = 0;
+#ifdef HAVE_X86_SIMD
+    if (lh_cpu_has(LH_CPU_AVX2))
+        i = lh_hex_decode_avx2(s, len, out);
+    else if (lh_cpu_has(LH_CPU_SSSE3))
+        i = lh_hex_decode_ssse3(s, len, out);
+#endif
+    // the scalar code continues at an invalid block to locate the error
+    ssize_t err = lh_hex_decode_scalar(s+i, len-i, out+i/2);
+    if (err < 0 && (len&1)) err = len-i;
+
+    if (err >= 0) {
+        if (errpos) *errpos = i+err;
+        return -1;
+    }
+    return len/2;
+}
+
+ssize_t lh_hex_encode_buf(lh_buf_t *bo, const uint8_t *p, ssize_t len, int flags) {
+    ssize_t widx = C(bo->data);
+    lh_arr_add(GAR4(bo->data), 2*len);
+    return lh_hex_encode(p, len, (char *)P(bo->data)+widx, flags);
+}
+
+ssize_t lh_hex_decode_buf(lh_buf_t *bo, const char *s, ssize_t len, ssize_t *errpos) {
+    ssize_t widx = C(bo->data);
+    lh_arr_add(GAR4(bo->data), len/2);
+    ssize_t n = lh_hex_decode(s, len, P(bo->data)+widx, errpos);
+    C(bo->data) = widx + (n>0 ? n : 0);
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Base64
+
+ssize_t lh_base64_encode(const uint8_t *p, ssize_t len, char *out, int flags) {
+    const char *abc = (flags&LH_B64_URL) ? b64_url : b64_std;
+    ssize_t i = 0, o = 0;
+#ifdef HAVE_X86_SIMD
+    if (lh_cpu_has(LH_CPU_AVX2))
+        i = lh_base64_encode_avx2(p, len, out, abc);
+    else if (lh_cpu_has(LH_CPU_SSSE3))
+        i = lh_base64_encode_ssse3(p, len, out, abc);
+#endif
+    o = i/3*4;
+    lh_base64_encode_scalar(p+i, len-i, out+o, abc);
+    i += (len-i)/3*3;
+    o = i/3*4;
+
+    // the last incomplete triplet
+    switch (len-i) {
+        case 1:
+            out[o++] = abc[p[i]>>2];
+            out[o++] = abc[(p[i]&3)<<4];
+            if (!(flags&LH_B64_NOPAD)) {
+                out[o++] = '=';
+                out[o++] = '=';
+            }
+            break;
+        case 2:
+            out[o++] = abc[p[i]>>2];
+            out[o++] = abc[((p[i]&3)<<4) | (p[i+1]>>4)];
+            out[o++] = abc[(p[i+1]&15)<<2];
+            if (!(flags&LH_B64_NOPAD))
+                out[o++] = '=';
+            break;
+    }
+    return o;
+}
+
+ssize_t lh_base64_decode(const char *s, ssize_t len, uint8_t *out, int flags, ssize_t *errpos) {
+    pthread_once(&dec_once, lh_encode_init);
+    const int8_t *dec = b64_dec[(flags&LH_B64_URL) ? 1 : 0];
+
+    // determine the length of the data without the padding
+    ssize_t dlen = len, err = -1;
+    if (flags&LH_B64_NOPAD) {
+        if ((len&3) == 1) err = len;
+    }
+    else {
+        if (len&3)
+            err = len;
+        else if (len>0 && s[len-1]=='=')
+            dlen -= (s[len-2]=='=') ? 2 : 1;
+    }
+    if (err >= 0) {
+        if (errpos) *errpos = err;
+        return -1;
+    }
+
+    ssize_t i = 0;
+#ifdef HAVE_X86_SIMD
+    if (lh_cpu_has(LH_CPU_AVX2))
+        i = lh_base64_decode_avx2(s, dlen, out, flags&LH_B64_URL);
+    else if (lh_cpu_has(LH_CPU_SSSE3))
+        i = lh_base64_decode_ssse3(s, dlen, out, flags&LH_B64_URL);
+#endif
+    ssize_t o = i/4*3;
+    err = lh_base64_decode_scalar(s+i, dlen-i, out+o, dec);
+    if (err >= 0) {
+        if (errpos) *errpos = i+err;
+        return -1;
+    }
+    i += (dlen-i)/4*4;
+    o = i/4*3;
+
+    // the last incomplete quad, the unused bits must be zero
+    int rem = dlen-i;
+    if (rem >= 2) {
+        int k;
+        int8_t v[3] = { 0, 0, 0 };
+        for(k=0; k<rem; k++) {
+            v[k] = dec[(uint8_t)s[i+k]];
+            if (v[k] < 0) {
+                if (errpos) *errpos = i+k;
+                return -1;
+            }
+        }
+        if ((rem==2 && (v[1]&15)) || (rem==3 && (v[2]&3))) {
+            if (errpos) *errpos = i+rem-1;
+            return -1;
+        }
+        out[o++] = (v[0]<<2) | (v[1]>>4);
+        if (rem == 3)
+            out[o++] = (v[1]<<4) | (v[2]>>2);
+    }
+    return o;
+}
+
+ssize_t lh_base64_encode_buf(lh_buf_t *bo, const uint8_t *p, ssize_t len, int flags) {
+    ssize_t widx = C(bo->data);
+    lh_arr_add(GAR4(bo->data), lh_base64_encoded_len(len, flags));
+    return lh_base64_encode(p, len, (char *)P(bo->data)+widx, flags);
+}
+
+ssize_t lh_base64_decode_buf(lh_buf_t *bo, const char *s, ssize_t len, int flags,
+                             ssize_t *errpos) {
+    ssize_t widx = C(bo->data);
+    lh_arr_add(GAR4(bo->data), lh_base64_decoded_len(len));
+    ssize_t n = lh_base64_decode(s, len, P(bo->data)+widx, flags, errpos);
+    C(bo->data) = widx + (n>0 ? n : 0);
+    return n;
+}
@@ -0,0 +1,107 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+/*! \file
+ * Hex and Base64 encoding and decoding
+ *
+ * The functions encode into caller-supplied buffers, the *_buf variants
+ * append to a lh_buf_t. Decoding is strict: any character outside of the
+ * alphabet (including whitespace), a wrong length, misplaced padding or
+ * non-zero trailing bits make the decoder fail and report the offset of
+ * the offending character.
+ *
+ * Base64 uses the SSSE3/AVX2 algorithms by W. Muła and D. Lemire, hex
+ * uses pshufb for the digit lookup and pmaddubsw to merge the nibbles.
+ */
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lh_files.h"
+
+#define LH_HEX_UPPER    (1<<0)  /* encode hex with uppercase digits */
+
+#define LH_B64_URL      (1<<0)  /* URL-safe alphabet (RFC 4648 section 5) */
+#define LH_B64_NOPAD    (1<<1)  /* no '=' padding - omitted when encoding,
+                                   rejected when decoding */
+
+////////////////////////////////////////////////////////////////////////////////
+/// Hex
+
+/*! \brief Encode data as hex
+ * \param p Data to encode
+ * \param len Length of the data
+ * \param out Output buffer, must have space for 2*len characters.
+ * The output is not NUL-terminated.
+ * \param flags LH_HEX_* flags
+ * \return Number of characters written */
+ssize_t lh_hex_encode(const uint8_t *p, ssize_t len, char *out, int flags);
+
+/*! \brief Decode hex data. Both upper and lowercase digits are accepted.
+ * \param s Hex string
+ * \param len Length of the string, must be even
+ * \param out Output buffer, must have space for len/2 bytes
+ * \param errpos If not NULL, receives the offset of the first invalid
+ * character on error, or len if the length is odd
+ * \return Number of bytes written, -1 on error */
+ssize_t lh_hex_decode(const char *s, ssize_t len, uint8_t *out, ssize_t *errpos);
+
+/*! \brief Append hex-encoded data to a buffer
+ * \return Number of characters appended */
+ssize_t lh_hex_encode_buf(lh_buf_t *bo, const uint8_t *p, ssize_t len, int flags);
+
+/*! \brief Decode hex data and append it to a buffer.
+ * On error the buffer is left unchanged.
+ * \return Number of bytes appended, -1 on error */
+ssize_t lh_hex_decode_buf(lh_buf_t *bo, const char *s, ssize_t len, ssize_t *errpos);
+
+////////////////////////////////////////////////////////////////////////////////
+/// Base64
+
+/*! \brief Length of the Base64 encoding of len bytes */
+static inline ssize_t lh_base64_encoded_len(ssize_t len, int flags) {
+    return (flags&LH_B64_NOPAD) ? (len*4+2)/3 : (len+2)/3*4;
+}
+
+/*! \brief Maximum length of the decoded data for len Base64 characters */
+static inline ssize_t lh_base64_decoded_len(ssize_t len) {
+    return (len+3)/4*3;
+}
+
+/*! \brief Encode data as Base64
+ * \param p Data to encode
+ * \param len Length of the data
+ * \param out Output buffer, must have space for lh_base64_encoded_len()
+ * characters. The output is not NUL-terminated.
+ * \param flags LH_B64_* flags
+ * \return Number of characters written */
+ssize_t lh_base64_encode(const uint8_t *p, ssize_t len, char *out, int flags);
+
+/*! \brief Decode Base64 data
+ * \param s Base64 string
+ * \param len Length of the string
+ * \param out Output buffer, must have space for lh_base64_decoded_len() bytes
+ * \param flags LH_B64_* flags
+ * \param errpos If not NULL, receives the offset of the first invalid
+ * character on error, or len if the input is truncated
+ * \return Number of bytes written, -1 on error */
+ssize_t lh_base64_decode(const char *s, ssize_t len, uint8_t *out, int flags, ssize_t *errpos);
+
+/*! \brief Append Base64-encoded data to a buffer
+ * \return Number of characters appended */
+ssize_t lh_base64_encode_buf(lh_buf_t *bo, const uint8_t *p, ssize_t len, int flags);
+
+/*! \brief Decode Base64 data and append it to a buffer.
+ * On error the buffer is left unchanged.
+ * \return Number of bytes appended, -1 on error */
+ssize_t lh_base64_decode_buf(lh_buf_t *bo, const char *s, ssize_t len, int flags,
+                             ssize_t *errpos);
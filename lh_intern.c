@@ -0,0 +1,148 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include "lh_intern.h"
+#include "lh_buffers.h"
+#include "lh_debug.h"
+
+#include <string.h>
+#include <assert.h>
+
+#define LH_INTERN_ENTGRAN   1024
+#define LH_INTERN_MINSLOTS  1024
+
+////////////////////////////////////////////////////////////////////////////////
+
+// hash a string processing 8 bytes per step
+static uint64_t lh_intern_hash(const uint8_t *s, ssize_t len) {
+    const uint64_t m = 0x9E3779B97F4A7C15ULL;
+    uint64_t h = 0xCBF29CE484222325ULL ^ ((uint64_t)len * m);
+    uint64_t w;
+
+    for(; len>=8; s+=8, len-=8) {
+        memcpy(&w, s, 8);
+        h = (h ^ w) * m;
+        h ^= h>>29;
+    }
+
+    if (len > 0) {
+        w = 0;
+        memcpy(&w, s, len);
+        h = (h ^ w) * m;
+        h ^= h>>29;
+    }
+
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h>>32;
+    return h;
+}
+
+// store a string in the pool and return the canonical pointer
+static const char * lh_intern_store(lh_intern *t, const char *s, ssize_t len) {
+    if (t->rem < len+1) {
+        ssize_t bsize = (len+1 > LH_INTERN_POOL_SIZE) ? len+1 : LH_INTERN_POOL_SIZE;
+        uint8_t **blk = lh_arr_new(GAR1(t->pool));
+        *blk = malloc(bsize);
+        t->pos = *blk;
+        t->rem = bsize;
+    }
+
+    char *str = (char *)t->pos;
+    memcpy(str, s, len);
+    str[len] = 0;
+    t->pos += len+1;
+    t->rem -= len+1;
+    return str;
+}
+
+// double the size of the hash table and re-insert all IDs
+static void lh_intern_rehash(lh_intern *t) {
+    uint32_t nslots = (t->mask+1)*2;
+    uint32_t *slots = calloc(nslots, sizeof(*slots));
+    uint32_t mask = nslots-1;
+
+    ssize_t id;
+    for(id=0; id<C(t->ent); id++) {
+        uint32_t i = P(t->ent)[id].hash & mask;
+        while (slots[i]) i = (i+1)&mask;
+        slots[i] = id+1;
+    }
+
+    free(t->slots);
+    t->slots = slots;
+    t->mask = mask;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+lh_intern * lh_intern_create() {
+    lh_create_obj(lh_intern, t);
+    lh_alloc_num(t->slots, LH_INTERN_MINSLOTS);
+    t->mask = LH_INTERN_MINSLOTS-1;
+    return t;
+}
+
+void lh_intern_destroy(lh_intern *t) {
+    if (!t) return;
+
+    ssize_t i;
+    for(i=0; i<C(t->pool); i++)
+        free(P(t->pool)[i]);
+    lh_arr_free(AR(t->pool));
+    lh_arr_free(AR(t->ent));
+    lh_free(t->slots);
+    free(t);
+}
+
+// find the slot containing the string, or the empty slot where it belongs
+static uint32_t * lh_intern_slot(lh_intern *t, const char *s, ssize_t len, uint32_t hash) {
+    uint32_t i = hash & t->mask;
+    while (t->slots[i]) {
+        lh_intern_entry *e = P(t->ent) + t->slots[i]-1;
+        if (e->hash == hash && e->len == len && !memcmp(e->str, s, len))
+            break;
+        i = (i+1) & t->mask;
+    }
+    return t->slots+i;
+}
+
+uint32_t lh_intern_find(lh_intern *t, const char *s, ssize_t len) {
+    assert(t);
+    if (len < 0) len = strlen(s);
+
+    uint32_t hash = (uint32_t)lh_intern_hash((const uint8_t *)s, len);
+    uint32_t *slot = lh_intern_slot(t, s, len, hash);
+    return *slot ? *slot-1 : LH_INTERN_NONE;
+}
+
+uint32_t lh_intern_id(lh_intern *t, const char *s, ssize_t len) {
+    assert(t);
+    if (len < 0) len = strlen(s);
+    if (len > UINT32_MAX-1)
+        LH_ERROR(LH_INTERN_NONE, "String too long to intern (%zd bytes)", len);
+
+    uint32_t hash = (uint32_t)lh_intern_hash((const uint8_t *)s, len);
+    uint32_t *slot = lh_intern_slot(t, s, len, hash);
+    if (*slot) return *slot-1;
+
+    // not found - add a new entry
+    uint32_t id = C(t->ent);
+    lh_intern_entry *e = lh_arr_new(AR(t->ent),LH_INTERN_ENTGRAN);
+    e->str  = lh_intern_store(t, s, len);
+    e->len  = len;
+    e->hash = hash;
+    *slot = id+1;
+
+    // keep the load factor of the hash table at 50% or below
+    if (C(t->ent)*2 > t->mask+1)
+        lh_intern_rehash(t);
+
+    return id;
+}
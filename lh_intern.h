@@ -0,0 +1,86 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+/*! \file
+ * String interning - map byte strings to stable 32-bit IDs
+ *
+ * Each distinct string is stored exactly once in a pool of large memory
+ * blocks and is assigned an ID, counting from 0 in the order of insertion.
+ * Both the ID and the canonical pointer stay valid until the table is
+ * destroyed, so two interned strings can be compared by comparing their
+ * IDs or pointers. The canonical strings are always NUL-terminated, but
+ * may contain embedded NUL bytes if they were interned with explicit length.
+ */
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lh_arr.h"
+
+#ifndef LH_INTERN_POOL_SIZE
+/*! Size of a single string pool block. Strings longer than this get
+ * their own block. */
+#define LH_INTERN_POOL_SIZE 65536
+#endif
+
+/*! ID returned by lookups that did not find the string */
+#define LH_INTERN_NONE 0xffffffffU
+
+typedef struct {
+    const char *    str;        // canonical copy of the string
+    uint32_t        len;        // length of the string, w/o terminator
+    uint32_t        hash;       // lower 32 bits of the string hash
+} lh_intern_entry;
+
+typedef struct {
+    lh_arr_declare(lh_intern_entry,ent);   // entries, indexed by ID
+
+    uint32_t      * slots;      // hash table, stores ID+1, 0 for empty
+    uint32_t        mask;       // number of slots - 1
+
+    lh_arr_declare(uint8_t *,pool);        // string pool blocks
+    uint8_t       * pos;        // free space in the current pool block
+    ssize_t         rem;        // bytes remaining in the current block
+} lh_intern;
+
+////////////////////////////////////////////////////////////////////////////////
+
+lh_intern * lh_intern_create();
+void lh_intern_destroy(lh_intern *t);
+
+/*! \brief Intern a string, adding it to the table if it's not present yet
+ * \param t Interning table
+ * \param s String to intern
+ * \param len Length of the string, or -1 to use strlen()
+ * \return ID of the string */
+uint32_t lh_intern_id(lh_intern *t, const char *s, ssize_t len);
+
+/*! \brief Look up a string without adding it
+ * \return ID of the string or LH_INTERN_NONE if it is not interned */
+uint32_t lh_intern_find(lh_intern *t, const char *s, ssize_t len);
+
+/*! \brief Get the canonical string for an ID */
+static inline const char * lh_intern_str(lh_intern *t, uint32_t id) {
+    return (id < C(t->ent)) ? P(t->ent)[id].str : NULL;
+}
+
+/*! \brief Get the length of the string for an ID */
+static inline ssize_t lh_intern_len(lh_intern *t, uint32_t id) {
+    return (id < C(t->ent)) ? P(t->ent)[id].len : -1;
+}
+
+/*! \brief Number of distinct strings in the table */
+#define lh_intern_count(t) (C((t)->ent))
+
+/*! \brief Intern a string and return its canonical pointer.
+ * This can be used in place of strdup() for frequently repeating strings */
+#define lh_intern_ptr(t,s,len) lh_intern_str((t),lh_intern_id((t),(s),(len)))
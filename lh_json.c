@@ -0,0 +1,763 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include "lh_json.h"
+#include "lh_cpu.h"
+#include "lh_buffers.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <locale.h>
+#include <pthread.h>
+
+// escape character for the bytes that must be escaped in strings, 0 otherwise
+static const uint8_t json_escape[256] = {
+    [0x00 ... 0x1f] = 'u',
+    ['\b'] = 'b', ['\f'] = 'f', ['\n'] = 'n', ['\r'] = 'r', ['\t'] = 't',
+    ['"'] = '"', ['\\'] = '\\',
+};
+
+static const uint8_t json_ws[256] = {
+    [' '] = 1, ['\t'] = 1, ['\n'] = 1, ['\r'] = 1,
+};
+
+// characters ending a number or literal
+static const uint8_t json_delim[256] = {
+    [' '] = 1, ['\t'] = 1, ['\n'] = 1, ['\r'] = 1,
+    [','] = 1, [':'] = 1, ['['] = 1, [']'] = 1, ['{'] = 1, ['}'] = 1, ['"'] = 1,
+};
+
+static const char hex_digits[16] = "0123456789abcdef";
+
+static const char digits2[201] =
+    "00010203040506070809" "10111213141516171819" "20212223242526272829"
+    "30313233343536373839" "40414243444546474849" "50515253545556575859"
+    "60616263646566676869" "70717273747576777879" "80818283848586878889"
+    "90919293949596979899";
+
+// JSON numbers always use a decimal point, whatever LC_NUMERIC says
+static locale_t c_locale;
+static pthread_once_t c_locale_once = PTHREAD_ONCE_INIT;
+
+static void json_locale_init() {
+    c_locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+}
+
+static inline locale_t json_c_locale() {
+    pthread_once(&c_locale_once, json_locale_init);
+    return c_locale;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Scanning kernels
+
+static ssize_t json_special_scalar(const uint8_t *p, ssize_t len) {
+    ssize_t i;
+    for(i=0; i<len; i++)
+        if (json_escape[p[i]]) return i;
+    return -1;
+}
+
+static ssize_t json_skip_ws_scalar(const uint8_t *p, ssize_t len) {
+    ssize_t i;
+    for(i=0; i<len; i++)
+        if (!json_ws[p[i]]) return i;
+    return len;
+}
+
+#ifdef HAVE_X86_SIMD
+
+LH_TARGET("sse2")
+static ssize_t json_special_sse2(const uint8_t *p, ssize_t len) {
+    const __m128i q = _mm_set1_epi8('"');
+    const __m128i b = _mm_set1_epi8('\\');
+    const __m128i c = _mm_set1_epi8(0x1f);
+    ssize_t i;
+    for(i=0; i+16<=len; i+=16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p+i));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, b)),
+                                 _mm_cmpeq_epi8(_mm_min_epu8(v, c), v));
+        int mm = _mm_movemask_epi8(m);
+        if (mm) return i+__builtin_ctz(mm);
+    }
+    ssize_t r = json_special_scalar(p+i, len-i);
+    return (r<0) ? r : i+r;
+}
+
+LH_TARGET("avx2")
+static ssize_t json_special_avx2(const uint8_t *p, ssize_t len) {
+    const __m256i q = _mm256_set1_epi8('"');
+    const __m256i b = _mm256_set1_epi8('\\');
+    const __m256i c = _mm256_set1_epi8(0x1f);
+    ssize_t i;
+    for(i=0; i+32<=len; i+=32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p+i));
+        __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, q), _mm256_cmpeq_epi8(v, b)),
+                                    _mm256_cmpeq_epi8(_mm256_min_epu8(v, c), v));
+        uint32_t mm = _mm256_movemask_epi8(m);
+        if (mm) return i+__builtin_ctz(mm);
+    }
+    ssize_t r = json_special_scalar(p+i, len-i);
+    return (r<0) ? r : i+r;
+}
+
+LH_TARGET("sse2")
+static ssize_t json_skip_ws_sse2(const uint8_t *p, ssize_t len) {
+    ssize_t i;
+    for(i=0; i+16<=len; i+=16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p+i));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                              _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                              _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        int mm = _mm_movemask_epi8(m) ^ 0xffff;
+        if (mm) return i+__builtin_ctz(mm);
+    }
+    return i+json_skip_ws_scalar(p+i, len-i);
+}
+
+#endif
+
+// find the first byte that must be escaped in a string, -1 if none
+static inline ssize_t json_find_special(const uint8_t *p, ssize_t len) {
+#ifdef HAVE_X86_SIMD
+    if (lh_cpu_has(LH_CPU_AVX2)) return json_special_avx2(p, len);
+    if (lh_cpu_has(LH_CPU_SSE2)) return json_special_sse2(p, len);
+#endif
+    return json_special_scalar(p, len);
+}
+
+// length of the leading whitespace
+static inline ssize_t json_skip_ws(const uint8_t *p, ssize_t len) {
+#ifdef HAVE_X86_SIMD
+    // runs of indentation are worth a vector, single spaces are not
+    if (len >= 16 && json_ws[p[1]] && lh_cpu_has(LH_CPU_SSE2))
+        return json_skip_ws_sse2(p, len);
+#endif
+    return json_skip_ws_scalar(p, len);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Writer
+
+void lh_json_writer_init_(lh_json_writer *w, uint8_t **bufp, ssize_t *lenp, ssize_t gran) {
+    lh_clear_ptr(w);
+    w->bufp = bufp;
+    w->lenp = lenp;
+    w->gran = gran;
+}
+
+// make room for n more bytes, returns the write position
+static inline uint8_t * json_reserve(lh_json_writer *w, ssize_t n) {
+    ssize_t len = *w->lenp;
+    if (!*w->bufp || lh_align(len+n, w->gran) > lh_align(len, w->gran))
+        *w->bufp = realloc(*w->bufp, lh_align(len+n, w->gran));
+    return *w->bufp + len;
+}
+
+// reserve space for a value of up to n bytes and write the comma if needed
+static inline uint8_t * json_begin_value(lh_json_writer *w, ssize_t n) {
+    uint8_t *o = json_reserve(w, n+1);
+    if (w->comma) *o++ = ',';
+    return o;
+}
+
+static inline void json_commit(lh_json_writer *w, uint8_t *o, int comma) {
+    *w->lenp = o - *w->bufp;
+    w->comma = comma;
+}
+
+static uint8_t * json_write_string(uint8_t *o, const uint8_t *s, ssize_t len) {
+    *o++ = '"';
+    while (len > 0) {
+        // copy the run of characters that need no escaping
+        ssize_t n = json_find_special(s, len);
+        if (n < 0) n = len;
+        memcpy(o, s, n);
+        o += n;
+        s += n;
+        len -= n;
+        if (!len) break;
+
+        uint8_t c = *s++;
+        uint8_t e = json_escape[c];
+        len--;
+        *o++ = '\\';
+        *o++ = e;
+        if (e == 'u') {
+            *o++ = '0';
+            *o++ = '0';
+            *o++ = hex_digits[c>>4];
+            *o++ = hex_digits[c&15];
+        }
+    }
+    *o++ = '"';
+    return o;
+}
+
+static uint8_t * json_write_uint(uint8_t *o, uint64_t v) {
+    char tmp[20];
+    char *e = tmp+sizeof(tmp), *q = e;
+
+    // two digits at a time
+    while (v >= 100) {
+        q -= 2;
+        memcpy(q, digits2+(v%100)*2, 2);
+        v /= 100;
+    }
+    if (v >= 10) {
+        q -= 2;
+        memcpy(q, digits2+v*2, 2);
+    }
+    else
+        *--q = '0'+v;
+
+    memcpy(o, q, e-q);
+    return o+(e-q);
+}
+
+void lh_json_begin_object(lh_json_writer *w) {
+    uint8_t *o = json_begin_value(w, 1);
+    *o++ = '{';
+    json_commit(w, o, 0);
+}
+
+void lh_json_end_object(lh_json_writer *w) {
+    uint8_t *o = json_reserve(w, 1);
+    *o++ = '}';
+    json_commit(w, o, 1);
+}
+
+void lh_json_begin_array(lh_json_writer *w) {
+    uint8_t *o = json_begin_value(w, 1);
+    *o++ = '[';
+    json_commit(w, o, 0);
+}
+
+void lh_json_end_array(lh_json_writer *w) {
+    uint8_t *o = json_reserve(w, 1);
+    *o++ = ']';
+    json_commit(w, o, 1);
+}
+
+void lh_json_key(lh_json_writer *w, const char *k, ssize_t len) {
+    if (len < 0) len = strlen(k);
+    uint8_t *o = json_begin_value(w, 6*len+3);
+    o = json_write_string(o, (const uint8_t *)k, len);
+    *o++ = ':';
+    json_commit(w, o, 0);
+}
+
+void lh_json_string(lh_json_writer *w, const char *s, ssize_t len) {
+    if (len < 0) len = strlen(s);
+    uint8_t *o = json_begin_value(w, 6*len+2);
+    o = json_write_string(o, (const uint8_t *)s, len);
+    json_commit(w, o, 1);
+}
+
+void lh_json_int(lh_json_writer *w, int64_t v) {
+    uint8_t *o = json_begin_value(w, 20);
+    if (v < 0) {
+        *o++ = '-';
+        o = json_write_uint(o, -(uint64_t)v);
+    }
+    else
+        o = json_write_uint(o, v);
+    json_commit(w, o, 1);
+}
+
+void lh_json_uint(lh_json_writer *w, uint64_t v) {
+    uint8_t *o = json_begin_value(w, 20);
+    o = json_write_uint(o, v);
+    json_commit(w, o, 1);
+}
+
+void lh_json_double(lh_json_writer *w, double v) {
+    if (!isfinite(v)) {
+        lh_json_null(w);
+        return;
+    }
+
+    // the shorter form is used if it converts back to the same value
+    char tmp[32];
+    locale_t old = uselocale(json_c_locale());
+    int n = snprintf(tmp, sizeof(tmp), "%.15g", v);
+    if (strtod(tmp, NULL) != v)
+        n = snprintf(tmp, sizeof(tmp), "%.17g", v);
+    uselocale(old);
+
+    uint8_t *o = json_begin_value(w, n);
+    memcpy(o, tmp, n);
+    json_commit(w, o+n, 1);
+}
+
+void lh_json_bool(lh_json_writer *w, int v) {
+    lh_json_raw(w, v ? "true" : "false", v ? 4 : 5);
+}
+
+void lh_json_null(lh_json_writer *w) {
+    lh_json_raw(w, "null", 4);
+}
+
+void lh_json_raw(lh_json_writer *w, const char *s, ssize_t len) {
+    if (len < 0) len = strlen(s);
+    uint8_t *o = json_begin_value(w, len);
+    memcpy(o, s, len);
+    json_commit(w, o+len, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Tokenizer
+
+// tokenizer states - the expected syntax element
+#define ST_VALUE        0   // a value: at the top level, after ':' or after ',' in an array
+#define ST_VALUE_OR_END 1   // after '['
+#define ST_KEY          2   // after ',' in an object
+#define ST_KEY_OR_END   3   // after '{'
+#define ST_COLON        4   // after a key
+#define ST_COMMA_OR_END 5   // after a value in a container
+#define ST_ERROR        6
+
+void lh_json_tok_init(lh_json_tokenizer *t) {
+    lh_clear_ptr(t);
+}
+
+void lh_json_tok_free(lh_json_tokenizer *t) {
+    lh_arr_free(AR(t->stack));
+    lh_arr_free(AR(t->carry));
+}
+
+void lh_json_tok_feed(lh_json_tokenizer *t, const uint8_t *data, ssize_t len) {
+    assert(t->ptr == t->end);
+    assert(!t->eof);
+    t->offset += t->end - t->start;
+    t->start = t->ptr = data;
+    t->end = data+len;
+}
+
+void lh_json_tok_finish(lh_json_tokenizer *t) {
+    t->eof = 1;
+}
+
+static int json_fail_at(lh_json_tokenizer *t, ssize_t offset, const char *msg) {
+    t->state = ST_ERROR;
+    t->error = msg;
+    t->errpos = offset;
+    return LH_JSON_ERROR;
+}
+
+static inline int json_fail(lh_json_tokenizer *t, const uint8_t *pos, const char *msg) {
+    return json_fail_at(t, t->offset + (pos - t->start), msg);
+}
+
+// append bytes to the carry buffer
+static void json_keep(lh_json_tokenizer *t, const uint8_t *data, ssize_t len) {
+    if (len <= 0) return;
+    memcpy(lh_arr_add(GAR3(t->carry), len), data, len);
+}
+
+static inline int json_hexval(uint8_t c) {
+    if (c>='0' && c<='9') return c-'0';
+    c |= 0x20;
+    if (c>='a' && c<='f') return c-'a'+10;
+    return -1;
+}
+
+// read the 4 hex digits of a \u escape, -1 if invalid
+static int json_hex4(const uint8_t *p, const uint8_t *end) {
+    if (end-p < 4) return -1;
+    int a=json_hexval(p[0]), b=json_hexval(p[1]), c=json_hexval(p[2]), d=json_hexval(p[3]);
+    if ((a|b|c|d) < 0) return -1;
+    return (a<<12)|(b<<8)|(c<<4)|d;
+}
+
+static int json_check_escapes(const uint8_t *p, ssize_t len) {
+    const uint8_t *end = p+len;
+    while ((p = memchr(p, '\\', end-p))) {
+        p++;
+        if (p >= end) return 0;
+        switch (*p++) {
+            case '"': case '\\': case '/':
+            case 'b': case 'f': case 'n': case 'r': case 't':
+                break;
+            case 'u':
+                if (json_hex4(p, end) < 0) return 0;
+                p += 4;
+                break;
+            default:
+                return 0;
+        }
+    }
+    return 1;
+}
+
+// determine the type of a number or literal, 0 if invalid
+static int json_scalar_type(const uint8_t *p, ssize_t len) {
+    const uint8_t *e = p+len;
+
+    switch (*p) {
+        case 't': return (len==4 && !memcmp(p, "true", 4))  ? LH_JSON_TRUE : 0;
+        case 'f': return (len==5 && !memcmp(p, "false", 5)) ? LH_JSON_FALSE : 0;
+        case 'n': return (len==4 && !memcmp(p, "null", 4))  ? LH_JSON_NULL : 0;
+    }
+
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    if (p<e && *p=='-') p++;
+    if (p>=e) return 0;
+    if (*p=='0')
+        p++;
+    else if (*p>='1' && *p<='9')
+        while (p<e && *p>='0' && *p<='9') p++;
+    else
+        return 0;
+
+    if (p<e && *p=='.') {
+        p++;
+        if (p>=e || *p<'0' || *p>'9') return 0;
+        while (p<e && *p>='0' && *p<='9') p++;
+    }
+    if (p<e && (*p=='e' || *p=='E')) {
+        p++;
+        if (p<e && (*p=='+' || *p=='-')) p++;
+        if (p>=e || *p<'0' || *p>'9') return 0;
+        while (p<e && *p>='0' && *p<='9') p++;
+    }
+    return (p==e) ? LH_JSON_NUMBER : 0;
+}
+
+// find the closing quote of a string, starting at *qp.
+// Returns 1 if found (*qp points to the quote), 0 if the string continues
+// beyond the end, -1 on a control character (*qp points to it)
+static int json_scan_string(lh_json_tokenizer *t, const uint8_t **qp, const uint8_t *end) {
+    const uint8_t *q = *qp;
+    while (1) {
+        ssize_t n = json_find_special(q, end-q);
+        if (n < 0) return 0;
+        q += n;
+        if (*q == '"') {
+            *qp = q;
+            return 1;
+        }
+        if (*q != '\\') {
+            *qp = q;
+            return -1;
+        }
+
+        // skip the escaped character
+        t->escaped = 1;
+        q += 2;
+        if (q > end) {
+            t->esc = 1;
+            return 0;
+        }
+    }
+}
+
+static inline void json_after_value(lh_json_tokenizer *t) {
+    t->state = C(t->stack) ? ST_COMMA_OR_END : ST_VALUE;
+}
+
+static inline int json_emit(lh_json_tokenizer *t, lh_json_token *tok, int type,
+                            const uint8_t *p, ssize_t len, int escaped) {
+    if (type == LH_JSON_KEY)
+        t->state = ST_COLON;
+    else
+        json_after_value(t);
+
+    tok->type = type;
+    tok->text = lh_span_make(p, len);
+    tok->escaped = escaped;
+    return type;
+}
+
+// continue the token started in a previous chunk.
+// Returns 1 if it is complete, 0 if more data is needed, -1 on error
+static int json_continue(lh_json_tokenizer *t) {
+    const uint8_t *p = t->ptr, *end = t->end;
+
+    if (t->partial == LH_JSON_NUMBER) {
+        const uint8_t *q = p;
+        while (q<end && !json_delim[*q]) q++;
+        json_keep(t, p, q-p);
+        t->ptr = q;
+        return (q<end || t->eof);
+    }
+
+    const uint8_t *q = p;
+    if (t->esc) {
+        if (q == end) goto more;
+        q++;
+        t->esc = 0;
+    }
+
+    int r = json_scan_string(t, &q, end);
+    if (r < 0) return json_fail(t, q, "control character in string");
+    if (r == 0) {
+        json_keep(t, p, end-p);
+        t->ptr = end;
+        goto more;
+    }
+
+    json_keep(t, p, q-p);
+    t->ptr = q+1;
+    return 1;
+
+ more:
+    if (t->eof) return json_fail(t, end, "unexpected end of data");
+    return 0;
+}
+
+#define VALUE_OK(t) ((t)->state == ST_VALUE || (t)->state == ST_VALUE_OR_END)
+
+int lh_json_tok_next(lh_json_tokenizer *t, lh_json_token *tok) {
+    // the token returned in the last call was assembled in the carry buffer
+    if (t->used) {
+        C(t->carry) = 0;
+        t->used = 0;
+    }
+    if (t->state == ST_ERROR) return LH_JSON_ERROR;
+
+    if (t->partial) {
+        int r = json_continue(t);
+        if (r <= 0) return r ? LH_JSON_ERROR : LH_JSON_NONE;
+
+        int type = t->partial;
+        const uint8_t *p = P(t->carry);
+        ssize_t len = C(t->carry);
+        t->partial = 0;
+        t->used = 1;
+
+        if (type == LH_JSON_NUMBER) {
+            type = json_scalar_type(p, len);
+            if (!type) return json_fail_at(t, t->tokpos, "invalid value");
+        }
+        else if (t->escaped && !json_check_escapes(p, len))
+            return json_fail_at(t, t->tokpos, "invalid escape sequence");
+
+        return json_emit(t, tok, type, p, len, t->escaped);
+    }
+
+    while (1) {
+        const uint8_t *p = t->ptr, *end = t->end;
+        if (p<end && json_ws[*p]) p += json_skip_ws(p, end-p);
+        t->ptr = p;
+
+        if (p == end) {
+            if (t->eof && (t->state != ST_VALUE || C(t->stack)))
+                return json_fail(t, p, "unexpected end of data");
+            return LH_JSON_NONE;
+        }
+
+        uint8_t c = *p;
+        switch (c) {
+            case '{':
+            case '[':
+                if (!VALUE_OK(t)) return json_fail(t, p, "unexpected character");
+                *lh_arr_new(GAR1(t->stack)) = c;
+                t->state = (c == '{') ? ST_KEY_OR_END : ST_VALUE_OR_END;
+                t->ptr = p+1;
+                tok->type = (c == '{') ? LH_JSON_OBJ_BEGIN : LH_JSON_ARR_BEGIN;
+                tok->text = lh_span_make(p, 1);
+                tok->escaped = 0;
+                return tok->type;
+
+            case '}':
+            case ']': {
+                uint8_t open = (c == '}') ? '{' : '[';
+                if (!C(t->stack) || P(t->stack)[C(t->stack)-1] != open)
+                    return json_fail(t, p, "mismatched bracket");
+                if (t->state != ST_COMMA_OR_END &&
+                    t->state != ((c == '}') ? ST_KEY_OR_END : ST_VALUE_OR_END))
+                    return json_fail(t, p, "unexpected character");
+                C(t->stack)--;
+                t->ptr = p+1;
+                return json_emit(t, tok, (c == '}') ? LH_JSON_OBJ_END : LH_JSON_ARR_END,
+                                 p, 1, 0);
+            }
+
+            case ':':
+                if (t->state != ST_COLON) return json_fail(t, p, "unexpected character");
+                t->state = ST_VALUE;
+                t->ptr = p+1;
+                continue;
+
+            case ',':
+                if (t->state != ST_COMMA_OR_END) return json_fail(t, p, "unexpected character");
+                t->state = (P(t->stack)[C(t->stack)-1] == '{') ? ST_KEY : ST_VALUE;
+                t->ptr = p+1;
+                continue;
+
+            case '"': {
+                int type;
+                if (t->state == ST_KEY || t->state == ST_KEY_OR_END)
+                    type = LH_JSON_KEY;
+                else if (VALUE_OK(t))
+                    type = LH_JSON_STRING;
+                else
+                    return json_fail(t, p, "unexpected character");
+
+                const uint8_t *s = p+1, *q = s;
+                t->escaped = 0;
+                int r = json_scan_string(t, &q, end);
+                if (r < 0) return json_fail(t, q, "control character in string");
+                if (r == 0) {
+                    // the string continues in the next chunk
+                    json_keep(t, s, end-s);
+                    t->partial = type;
+                    t->tokpos = t->offset + (p - t->start);
+                    t->ptr = end;
+                    if (t->eof) return json_fail(t, end, "unexpected end of data");
+                    return LH_JSON_NONE;
+                }
+
+                t->ptr = q+1;
+                if (t->escaped && !json_check_escapes(s, q-s))
+                    return json_fail(t, p, "invalid escape sequence");
+                return json_emit(t, tok, type, s, q-s, t->escaped);
+            }
+
+            default: {
+                if (!VALUE_OK(t)) return json_fail(t, p, "unexpected character");
+
+                const uint8_t *q = p;
+                while (q<end && !json_delim[*q]) q++;
+                if (q == end && !t->eof) {
+                    // the number or literal may continue in the next chunk
+                    json_keep(t, p, end-p);
+                    t->partial = LH_JSON_NUMBER;
+                    t->tokpos = t->offset + (p - t->start);
+                    t->ptr = end;
+                    return LH_JSON_NONE;
+                }
+
+                int type = json_scalar_type(p, q-p);
+                if (!type) return json_fail(t, p, "invalid value");
+                t->ptr = q;
+                return json_emit(t, tok, type, p, q-p, 0);
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static uint8_t * json_put_utf8(uint8_t *o, uint32_t cp) {
+    if (cp < 0x80) {
+        *o++ = cp;
+    }
+    else if (cp < 0x800) {
+        *o++ = 0xc0 | (cp>>6);
+        *o++ = 0x80 | (cp&0x3f);
+    }
+    else if (cp < 0x10000) {
+        *o++ = 0xe0 | (cp>>12);
+        *o++ = 0x80 | ((cp>>6)&0x3f);
+        *o++ = 0x80 | (cp&0x3f);
+    }
+    else {
+        *o++ = 0xf0 | (cp>>18);
+        *o++ = 0x80 | ((cp>>12)&0x3f);
+        *o++ = 0x80 | ((cp>>6)&0x3f);
+        *o++ = 0x80 | (cp&0x3f);
+    }
+    return o;
+}
+
+ssize_t lh_json_unescape(const lh_json_token *tok, uint8_t *out) {
+    const uint8_t *p = tok->text.ptr, *end = p+tok->text.len;
+    uint8_t *o = out;
+
+    if (!tok->escaped) {
+        if (tok->text.len) memcpy(out, p, tok->text.len);
+        return tok->text.len;
+    }
+
+    while (p < end) {
+        const uint8_t *b = memchr(p, '\\', end-p);
+        if (!b) b = end;
+        memcpy(o, p, b-p);
+        o += b-p;
+        p = b;
+        if (p == end) break;
+
+        if (end-p < 2) return -1;
+        p += 2;
+        switch (p[-1]) {
+            case '"':  *o++ = '"'; break;
+            case '\\': *o++ = '\\'; break;
+            case '/':  *o++ = '/'; break;
+            case 'b':  *o++ = '\b'; break;
+            case 'f':  *o++ = '\f'; break;
+            case 'n':  *o++ = '\n'; break;
+            case 'r':  *o++ = '\r'; break;
+            case 't':  *o++ = '\t'; break;
+            case 'u': {
+                int cp = json_hex4(p, end);
+                if (cp < 0) return -1;
+                p += 4;
+                if (cp >= 0xdc00 && cp <= 0xdfff) return -1;
+                if (cp >= 0xd800 && cp <= 0xdbff) {
+                    // must be followed by the low surrogate
+                    if (end-p < 6 || p[0] != '\\' || p[1] != 'u') return -1;
+                    int lo = json_hex4(p+2, end);
+                    if (lo < 0xdc00 || lo > 0xdfff) return -1;
+                    p += 6;
+                    cp = 0x10000 + ((cp-0xd800)<<10) + (lo-0xdc00);
+                }
+                o = json_put_utf8(o, cp);
+                break;
+            }
+            default:
+                return -1;
+        }
+    }
+
+    return o-out;
+}
+
+int lh_json_tok_int(const lh_json_token *tok, int64_t *v) {
+    const uint8_t *p = tok->text.ptr, *end = p+tok->text.len;
+    int neg = 0;
+    uint64_t u = 0;
+
+    if (tok->type != LH_JSON_NUMBER) return 0;
+    if (*p == '-') {
+        neg = 1;
+        p++;
+    }
+    for(; p<end; p++) {
+        if (*p<'0' || *p>'9') return 0;
+        if (u > (UINT64_MAX-9)/10) return 0;
+        u = u*10 + (*p-'0');
+    }
+
+    if (u > (uint64_t)INT64_MAX + neg) return 0;
+    *v = neg ? -u : u;
+    return 1;
+}
+
+double lh_json_tok_double(const lh_json_token *tok) {
+    char tmp[64], *s = tmp;
+    ssize_t len = tok->text.len;
+
+    // strtod needs a terminated string
+    if (len >= sizeof(tmp)) s = malloc(len+1);
+    memcpy(s, tok->text.ptr, len);
+    s[len] = 0;
+
+    locale_t old = uselocale(json_c_locale());
+    double v = strtod(s, NULL);
+    uselocale(old);
+
+    if (s != tmp) free(s);
+    return v;
+}
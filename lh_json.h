@@ -0,0 +1,186 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+/*! \file
+ * Streaming JSON writer and incremental tokenizer
+ *
+ * The writer appends to a resizable buffer - the same kind of buffer that
+ * is used with lh_bufprintf() or a lh_buf_t. Commas and colons are inserted
+ * automatically, the caller only has to emit the elements in order.
+ *
+ * EXAMPLE:
+ * lh_json_writer w;
+ * lh_json_writer_init(&w, GAR4(bo.data));
+ * lh_json_begin_object(&w);
+ * lh_json_key(&w, "uptime", -1);  lh_json_int(&w, uptime);
+ * lh_json_key(&w, "name", -1);    lh_json_string(&w, name, -1);
+ * lh_json_end_object(&w);
+ *
+ * The tokenizer is fed with chunks of data, like the lh_splitter, and
+ * returns the tokens one by one (SAX style). Strings, numbers and literals
+ * that lie within a chunk point directly into it, only a token crossing a
+ * chunk boundary is assembled in an internal buffer. The syntax is checked
+ * while tokenizing, except for the UTF-8 validity of the strings.
+ * A stream may contain any number of top-level values.
+ *
+ * Only two scans are vectorized (SSE2/AVX2): the search for the end of a
+ * string, or for the next character to escape in the writer, and skipping
+ * runs of whitespace. Brackets, colons, commas, numbers and literals are
+ * classified one byte at a time. A lh_csv-style bitmap of the structural
+ * characters, with the quoted parts masked out by a prefix XOR, was tried
+ * and measured slower: tokens are returned one at a time, so the state
+ * machine and not the classification dominates on compact input, and the
+ * full classification costs more than the string search on long strings.
+ *
+ * EXAMPLE:
+ * lh_json_tok_init(&t);
+ * lh_json_tok_feed(&t, P(conn->rbuf.data)+conn->rbuf.ridx,
+ *                  C(conn->rbuf.data)-conn->rbuf.ridx);
+ * while ((type = lh_json_tok_next(&t, &tok)) > 0)
+ *     process(type, &tok);
+ * if (type < 0) printf("%s at offset %zd\n", t.error, t.errpos);
+ */
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lh_arr.h"
+#include "lh_strings.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// Writer
+
+typedef struct {
+    uint8_t **      bufp;       // output buffer
+    ssize_t *       lenp;
+    ssize_t         gran;       // granularity the buffer is allocated with
+    int             comma;      // a comma must precede the next element
+} lh_json_writer;
+
+/*! \brief Initialize a writer appending to a resizable buffer
+ * \param w Writer
+ * \param ... Buffer with its granularity, as supplied by the GAR*() macros */
+#define lh_json_writer_init(w,...) _lh_json_writer_init(w,__VA_ARGS__)
+#define _lh_json_writer_init(w,ptr,cnt,gran) lh_json_writer_init_(w,&(ptr),&(cnt),gran)
+
+void lh_json_writer_init_(lh_json_writer *w, uint8_t **bufp, ssize_t *lenp, ssize_t gran);
+
+void lh_json_begin_object(lh_json_writer *w);
+void lh_json_end_object(lh_json_writer *w);
+void lh_json_begin_array(lh_json_writer *w);
+void lh_json_end_array(lh_json_writer *w);
+
+/*! \brief Write an object key
+ * \param k Key string
+ * \param len Length of the key, -1 if NUL-terminated */
+void lh_json_key(lh_json_writer *w, const char *k, ssize_t len);
+
+/*! \brief Write a string value, escaping it as needed
+ * \param s String, expected to be UTF-8
+ * \param len Length of the string, -1 if NUL-terminated */
+void lh_json_string(lh_json_writer *w, const char *s, ssize_t len);
+
+void lh_json_int(lh_json_writer *w, int64_t v);
+void lh_json_uint(lh_json_writer *w, uint64_t v);
+
+/*! \brief Write a floating point value with enough digits to be read back
+ * exactly. NaN and infinities are written as null. */
+void lh_json_double(lh_json_writer *w, double v);
+
+void lh_json_bool(lh_json_writer *w, int v);
+void lh_json_null(lh_json_writer *w);
+
+/*! \brief Write an already encoded JSON value */
+void lh_json_raw(lh_json_writer *w, const char *s, ssize_t len);
+
+////////////////////////////////////////////////////////////////////////////////
+/// Tokenizer
+
+// token types
+#define LH_JSON_ERROR       -1
+#define LH_JSON_NONE         0  // no token - more data is needed, or end of data
+#define LH_JSON_OBJ_BEGIN    1
+#define LH_JSON_OBJ_END      2
+#define LH_JSON_ARR_BEGIN    3
+#define LH_JSON_ARR_END      4
+#define LH_JSON_KEY          5
+#define LH_JSON_STRING       6
+#define LH_JSON_NUMBER       7
+#define LH_JSON_TRUE         8
+#define LH_JSON_FALSE        9
+#define LH_JSON_NULL        10
+
+typedef struct {
+    int             type;       // LH_JSON_* token type
+    lh_span         text;       // strings and keys: the contents between the
+                                // quotes, with the escapes not decoded;
+                                // numbers and literals: their text
+    int             escaped;    // the string contains escape sequences
+} lh_json_token;
+
+typedef struct {
+    int             state;      // expected syntax element
+    int             eof;        // no more data will be fed
+    int             used;       // carry buffer was returned as a token
+
+    int             partial;    // type of the token in the carry buffer, 0 if none
+    int             esc;        // the partial string ends with a backslash
+    int             escaped;    // the partial string contains escapes
+    ssize_t         tokpos;     // stream offset of the partial token
+
+    const uint8_t * start;      // current chunk
+    const uint8_t * ptr;        // unprocessed part of the current chunk
+    const uint8_t * end;
+    ssize_t         offset;     // stream offset of the current chunk
+
+    lh_arr_declare(uint8_t,stack); // open containers, '{' or '['
+    lh_buf_declare(carry);      // partial token from the previous chunks
+
+    const char *    error;      // error message
+    ssize_t         errpos;     // stream offset of the error
+} lh_json_tokenizer;
+
+void lh_json_tok_init(lh_json_tokenizer *t);
+void lh_json_tok_free(lh_json_tokenizer *t);
+
+/*! \brief Feed the next chunk of data to the tokenizer.
+ * The chunk must stay valid until lh_json_tok_next() returns LH_JSON_NONE.
+ * \param t Tokenizer
+ * \param data Chunk data
+ * \param len Chunk length */
+void lh_json_tok_feed(lh_json_tokenizer *t, const uint8_t *data, ssize_t len);
+
+/*! \brief Signal the end of data */
+void lh_json_tok_finish(lh_json_tokenizer *t);
+
+/*! \brief Get the next token.
+ * The token text is valid until the next call to lh_json_tok_next()
+ * or lh_json_tok_feed().
+ * \param t Tokenizer
+ * \param tok Returns the token
+ * \return Token type, LH_JSON_NONE if more data must be fed (or, after
+ * lh_json_tok_finish(), at the end of data), LH_JSON_ERROR on a syntax
+ * error - the message and position are stored in the tokenizer */
+int lh_json_tok_next(lh_json_tokenizer *t, lh_json_token *tok);
+
+/*! \brief Decode the escape sequences of a string token
+ * \param tok String or key token
+ * \param out Output buffer, must have space for tok->text.len bytes
+ * \return Length of the decoded string, -1 on an invalid escape sequence */
+ssize_t lh_json_unescape(const lh_json_token *tok, uint8_t *out);
+
+/*! \brief Get the value of an integer number token
+ * \return 1 on success, 0 if the number is not an integer or out of range */
+int lh_json_tok_int(const lh_json_token *tok, int64_t *v);
+
+/*! \brief Get the value of a number token */
+double lh_json_tok_double(const lh_json_token *tok);
@@ -0,0 +1,443 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include <string.h>
+
+#include "lh_nbt.h"
+#include "lh_bytes.h"
+
+// size of the numbers, and of the elements of arrays
+static const int8_t tag_size[] = { 0, 1, 2, 4, 8, 4, 8, 1, 0, 0, 0, 4, 8 };
+
+#define IS_NUMBER(type) ((type) >= LH_NBT_BYTE && (type) <= LH_NBT_DOUBLE)
+#define IS_ARRAY(type)  ((type) == LH_NBT_BYTE_ARRAY || (type) == LH_NBT_INT_ARRAY || \
+                         (type) == LH_NBT_LONG_ARRAY)
+#define IS_VALID(type)  ((type) > LH_NBT_END && (type) <= LH_NBT_LONG_ARRAY)
+
+void lh_nbt_init(lh_nbt *t) {
+    lh_clear_ptr(t);
+    t->open = -1;
+}
+
+void lh_nbt_free(lh_nbt *t) {
+    lh_arr_free(AR(t->ent));
+    t->open = -1;
+}
+
+static int new_entry(lh_nbt *t, int type, lh_span name, int parent) {
+    lh_nbt_entry *e = lh_arr_new_c(GAR(t->ent));
+    e->type = type;
+    e->name = name;
+    e->parent = parent;
+    e->next = C(t->ent);
+    return C(t->ent)-1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Parsing
+
+// skip a payload, level counts the enclosing containers
+static void skip_payload(lh_reader *r, int type, int level) {
+    int32_t n;
+
+    if (level > LH_NBT_MAXDEPTH) {
+        lh_reader_fail(r);
+        return;
+    }
+
+    switch (type) {
+        case LH_NBT_BYTE:
+        case LH_NBT_SHORT:
+        case LH_NBT_INT:
+        case LH_NBT_LONG:
+        case LH_NBT_FLOAT:
+        case LH_NBT_DOUBLE:
+            lh_reader_skip(r, tag_size[type]);
+            break;
+        case LH_NBT_BYTE_ARRAY:
+        case LH_NBT_INT_ARRAY:
+        case LH_NBT_LONG_ARRAY:
+            n = lh_reader_int_be(r);
+            lh_reader_skip(r, (ssize_t)n*tag_size[type]);
+            break;
+        case LH_NBT_STRING:
+            lh_reader_skip(r, lh_reader_short_be(r));
+            break;
+        case LH_NBT_LIST: {
+            int etype = lh_reader_char(r);
+            n = lh_reader_int_be(r);
+            if (n < 0 || (n > 0 && !IS_VALID(etype))) {
+                lh_reader_fail(r);
+            }
+            else if (IS_NUMBER(etype)) {
+                lh_reader_skip(r, (ssize_t)n*tag_size[etype]);
+            }
+            else {
+                // an element is at least one byte, the count cannot
+                // exceed the data
+                while (n-- > 0 && !r->error)
+                    skip_payload(r, etype, level+1);
+            }
+            break;
+        }
+        case LH_NBT_COMPOUND:
+            while (!r->error) {
+                int ctype = lh_reader_char(r);
+                if (ctype == LH_NBT_END) break;
+                lh_reader_skip(r, lh_reader_short_be(r));
+                if (!IS_VALID(ctype))
+                    lh_reader_fail(r);
+                else
+                    skip_payload(r, ctype, level+1);
+            }
+            break;
+        default:
+            lh_reader_fail(r);
+    }
+}
+
+ssize_t lh_nbt_skip(const uint8_t *p, const uint8_t *end, int type) {
+    lh_reader r;
+    lh_reader_init(&r, (uint8_t *)p, end-p);
+    skip_payload(&r, type, 0);
+    return r.error ? -1 : r.ptr-p;
+}
+
+// index the payload of entry i, depth < 0 indexes all levels
+static void parse_payload(lh_nbt *t, lh_reader *r, int i, int depth, int level) {
+    lh_nbt_entry *e = P(t->ent)+i;
+    uint8_t *start = r->ptr;
+    int type = e->type;
+    int32_t n = 0;
+
+    if (level > LH_NBT_MAXDEPTH) {
+        lh_reader_fail(r);
+        return;
+    }
+
+    switch (type) {
+        case LH_NBT_BYTE:
+        case LH_NBT_SHORT:
+        case LH_NBT_INT:
+        case LH_NBT_LONG:
+        case LH_NBT_FLOAT:
+        case LH_NBT_DOUBLE:
+            lh_reader_skip(r, tag_size[type]);
+            break;
+        case LH_NBT_BYTE_ARRAY:
+        case LH_NBT_INT_ARRAY:
+        case LH_NBT_LONG_ARRAY:
+            n = lh_reader_int_be(r);
+            start = r->ptr;
+            lh_reader_skip(r, (ssize_t)n*tag_size[type]);
+            break;
+        case LH_NBT_STRING:
+            n = lh_reader_short_be(r);
+            start = r->ptr;
+            lh_reader_skip(r, n);
+            break;
+        case LH_NBT_LIST: {
+            uint8_t *hdr = r->ptr;
+            int etype = lh_reader_char(r);
+            n = lh_reader_int_be(r);
+            e->etype = etype;
+            if (r->error || n < 0 || (n > 0 && !IS_VALID(etype))) {
+                lh_reader_fail(r);
+                break;
+            }
+            start = r->ptr;
+            if (IS_NUMBER(etype) || depth == 0) {
+                // skip the elements with the header again
+                r->ptr = hdr;
+                skip_payload(r, type, level);
+                e->flags |= LH_NBT_RAW;
+                break;
+            }
+            int k;
+            for(k=0; k<n && !r->error; k++) {
+                int j = new_entry(t, etype, lh_span_make(r->ptr, 0), i);
+                parse_payload(t, r, j, depth-(depth > 0), level+1);
+            }
+            break;
+        }
+        case LH_NBT_COMPOUND:
+            if (depth == 0) {
+                skip_payload(r, type, level);
+                n = -1;
+                e->flags |= LH_NBT_RAW;
+                break;
+            }
+            while (!r->error) {
+                int ctype = lh_reader_char(r);
+                if (ctype == LH_NBT_END) break;
+                lh_span name = lh_reader_lstring_short_be(r);
+                if (!IS_VALID(ctype)) {
+                    lh_reader_fail(r);
+                    break;
+                }
+                int j = new_entry(t, ctype, name, i);
+                parse_payload(t, r, j, depth-(depth > 0), level+1);
+                n++;
+            }
+            break;
+        default:
+            lh_reader_fail(r);
+    }
+
+    e = P(t->ent)+i;
+    e->value = lh_span_make(start, r->ptr-start);
+    e->count = n;
+    e->next = C(t->ent);
+}
+
+static int parse_root(lh_nbt *t, lh_reader *r, int type, lh_span name, int depth) {
+    C(t->ent) = 0;
+    t->open = -1;
+    int i = new_entry(t, type, name, -1);
+    parse_payload(t, r, i, depth, 0);
+    if (r->error) C(t->ent) = 0;
+    return r->error ? -1 : 0;
+}
+
+ssize_t lh_nbt_parse(lh_nbt *t, const uint8_t *data, ssize_t len, int depth) {
+    lh_reader r;
+    lh_reader_init(&r, (uint8_t *)data, len);
+    int type = lh_reader_char(&r);
+    lh_span name = lh_reader_lstring_short_be(&r);
+    if (!IS_VALID(type)) lh_reader_fail(&r);
+    if (parse_root(t, &r, type, name, depth) < 0) return -1;
+    return r.ptr-data;
+}
+
+int lh_nbt_expand(lh_nbt *sub, const lh_nbt *t, int i, int depth) {
+    const lh_nbt_entry *e = P(t->ent)+i;
+    if (!(e->flags & LH_NBT_RAW)) return -1;
+
+    // the value of lists starts after the tag and count of the elements
+    lh_reader r;
+    if (e->type == LH_NBT_LIST)
+        lh_reader_init(&r, (uint8_t *)e->value.ptr-5, e->value.len+5);
+    else
+        lh_reader_init(&r, (uint8_t *)e->value.ptr, e->value.len);
+    return parse_root(sub, &r, e->type, e->name, depth);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Navigation
+
+static inline int span_eq(lh_span s, const char *p, ssize_t len) {
+    return s.len == len && !memcmp(s.ptr, p, len);
+}
+
+static int find_child(const lh_nbt *t, int i, const char *name, ssize_t len) {
+    int j;
+    for(j=lh_nbt_first(t, i); j>=0; j=lh_nbt_next(t, j))
+        if (span_eq(P(t->ent)[j].name, name, len)) return j;
+    return -1;
+}
+
+int lh_nbt_find(const lh_nbt *t, int i, const char *name) {
+    if (i < 0 || P(t->ent)[i].type != LH_NBT_COMPOUND) return -1;
+    return find_child(t, i, name, strlen(name));
+}
+
+int lh_nbt_path(const lh_nbt *t, int i, const char *path) {
+    while (i >= 0 && *path) {
+        const char *end = strchr(path, '/');
+        ssize_t len = end ? end-path : strlen(path);
+        ssize_t k, n = 0;
+
+        for(k=0; k<len && path[k] >= '0' && path[k] <= '9'; k++)
+            n = n*10+path[k]-'0';
+
+        if (len > 0 && k == len) {
+            // the n-th child
+            for(i=lh_nbt_first(t, i); i>=0 && n>0; n--) i = lh_nbt_next(t, i);
+        }
+        else {
+            i = (P(t->ent)[i].type == LH_NBT_COMPOUND) ? find_child(t, i, path, len) : -1;
+        }
+        path += len+(end != NULL);
+    }
+    return i;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Values
+
+// view type characters of the number tags
+static const char view_type[] = "\0bhilfd";
+
+// a number entry as a view of one element
+static lh_view number_view(const lh_nbt *t, int i) {
+    return lh_view_make(lh_nbt_value(t, i).ptr, 1, view_type[P(t->ent)[i].type], LH_CONV_BE);
+}
+
+// tag of the elements of an array or a list of numbers, lists built
+// from entries have no elements in the value
+static int elem_type(const lh_nbt_entry *e) {
+    switch (e->type) {
+        case LH_NBT_BYTE_ARRAY: return LH_NBT_BYTE;
+        case LH_NBT_INT_ARRAY:  return LH_NBT_INT;
+        case LH_NBT_LONG_ARRAY: return LH_NBT_LONG;
+        case LH_NBT_LIST:
+            return (IS_NUMBER(e->etype) && (e->flags & LH_NBT_RAW)) ? e->etype : LH_NBT_END;
+    }
+    return LH_NBT_END;
+}
+
+int64_t lh_nbt_int(const lh_nbt *t, int i) {
+    if (i < 0 || !IS_NUMBER(P(t->ent)[i].type)) return 0;
+    lh_view v = number_view(t, i);
+    return lh_view_int(&v, 0);
+}
+
+double lh_nbt_double(const lh_nbt *t, int i) {
+    if (i < 0 || !IS_NUMBER(P(t->ent)[i].type)) return 0;
+    lh_view v = number_view(t, i);
+    return lh_view_double(&v, 0);
+}
+
+lh_span lh_nbt_string(const lh_nbt *t, int i) {
+    if (i < 0 || P(t->ent)[i].type != LH_NBT_STRING) return lh_span_make("", 0);
+    return P(t->ent)[i].value;
+}
+
+lh_view lh_nbt_view(const lh_nbt *t, int i) {
+    if (i < 0) return lh_view_make(NULL, 0, 0, 0);
+    const lh_nbt_entry *e = P(t->ent)+i;
+    int type = elem_type(e);
+    if (type == LH_NBT_END) return lh_view_make(NULL, 0, 0, 0);
+    return lh_view_make(e->value.ptr, e->count, view_type[type], LH_CONV_BE);
+}
+
+int64_t lh_nbt_elem_int(const lh_nbt *t, int i, int k) {
+    lh_view v = lh_nbt_view(t, i);
+    return (k >= 0 && k < v.n) ? lh_view_int(&v, k) : 0;
+}
+
+double lh_nbt_elem_double(const lh_nbt *t, int i, int k) {
+    lh_view v = lh_nbt_view(t, i);
+    return (k >= 0 && k < v.n) ? lh_view_double(&v, k) : 0;
+}
+
+// store a number in the entry itself
+static void set_number(lh_nbt_entry *e, int64_t v, double d) {
+    uint8_t *p = e->num;
+    switch (e->type) {
+        case LH_NBT_BYTE:   lh_write_char(p, v); break;
+        case LH_NBT_SHORT:  lh_write_short_be(p, v); break;
+        case LH_NBT_INT:    lh_write_int_be(p, v); break;
+        case LH_NBT_LONG:   lh_write_long_be(p, v); break;
+        case LH_NBT_FLOAT:  lh_write_float_be(p, d); break;
+        case LH_NBT_DOUBLE: lh_write_double_be(p, d); break;
+        default: return;
+    }
+    e->value = lh_span_make(NULL, tag_size[e->type]);
+}
+
+void lh_nbt_set_int(lh_nbt *t, int i, int64_t v) {
+    set_number(P(t->ent)+i, v, v);
+}
+
+void lh_nbt_set_double(lh_nbt *t, int i, double v) {
+    set_number(P(t->ent)+i, (int64_t)v, v);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Building
+
+int lh_nbt_begin(lh_nbt *t, int type, lh_span name) {
+    int i = new_entry(t, type, name, t->open);
+    t->open = i;
+    return i;
+}
+
+int lh_nbt_end(lh_nbt *t) {
+    int i = t->open, j, n = 0, res = 0;
+    if (i < 0) return -1;
+    lh_nbt_entry *e = P(t->ent)+i;
+
+    e->next = C(t->ent);
+    for(j=lh_nbt_first(t, i); j>=0; j=lh_nbt_next(t, j), n++) {
+        if (n == 0) e->etype = P(t->ent)[j].type;
+        if (e->type == LH_NBT_LIST && P(t->ent)[j].type != e->etype) res = -1;
+    }
+    e->count = n;
+    t->open = e->parent;
+    return res;
+}
+
+int lh_nbt_add(lh_nbt *t, int type, lh_span name, lh_span value) {
+    int i = new_entry(t, type, name, t->open);
+    lh_nbt_entry *e = P(t->ent)+i;
+    e->value = value;
+    e->count = IS_ARRAY(type) ? value.len/tag_size[type] : value.len;
+    return i;
+}
+
+int lh_nbt_add_int(lh_nbt *t, int type, lh_span name, int64_t v) {
+    int i = new_entry(t, type, name, t->open);
+    set_number(P(t->ent)+i, v, v);
+    return i;
+}
+
+int lh_nbt_add_double(lh_nbt *t, int type, lh_span name, double v) {
+    int i = new_entry(t, type, name, t->open);
+    set_number(P(t->ent)+i, (int64_t)v, v);
+    return i;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Writing
+
+static void write_payload(lh_writer *w, const lh_nbt *t, int i) {
+    const lh_nbt_entry *e = P(t->ent)+i;
+    lh_span v = lh_nbt_value(t, i);
+    int j;
+
+    switch (e->type) {
+        case LH_NBT_STRING:
+            lh_writer_short_be(w, v.len);
+            break;
+        case LH_NBT_BYTE_ARRAY:
+        case LH_NBT_INT_ARRAY:
+        case LH_NBT_LONG_ARRAY:
+            lh_writer_int_be(w, e->count);
+            break;
+        case LH_NBT_LIST:
+            lh_writer_char(w, e->count ? e->etype : LH_NBT_END);
+            lh_writer_int_be(w, e->count);
+            if (e->flags & LH_NBT_RAW) break;
+            for(j=lh_nbt_first(t, i); j>=0; j=lh_nbt_next(t, j))
+                write_payload(w, t, j);
+            return;
+        case LH_NBT_COMPOUND:
+            if (e->flags & LH_NBT_RAW) break;
+            for(j=lh_nbt_first(t, i); j>=0; j=lh_nbt_next(t, j)) {
+                lh_writer_char(w, P(t->ent)[j].type);
+                lh_writer_lstring_short_be(w, P(t->ent)[j].name);
+                write_payload(w, t, j);
+            }
+            lh_writer_char(w, LH_NBT_END);
+            return;
+    }
+    lh_writer_bytes(w, v.ptr, v.len);
+}
+
+ssize_t lh_nbt_write(lh_buf_t *b, const lh_nbt *t, int i) {
+    lh_writer w;
+    ssize_t start = C(b->data);
+    lh_writer_init(&w, b);
+    lh_writer_char(&w, P(t->ent)[i].type);
+    lh_writer_lstring_short_be(&w, P(t->ent)[i].name);
+    write_payload(&w, t, i);
+    return lh_writer_finish(&w)-start;
+}
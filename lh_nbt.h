@@ -0,0 +1,231 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+/*! \file
+ * Tagged binary trees (NBT)
+ *
+ * A tree is parsed in one pass into a flat index of entries, in the
+ * pre-order of the tags, instead of a tree of allocated nodes. The entries
+ * hold the name and the value as spans into the parsed data, nothing is
+ * copied or converted until it is accessed. The children of a compound or
+ * list follow it directly, and every entry stores the index after its
+ * subtree, so siblings are found without looking at the subtrees between
+ * them.
+ *
+ * Containers below a given depth are not indexed at all, only skipped -
+ * their entries are marked LH_NBT_RAW and the value spans their whole
+ * payload, to be indexed on demand with lh_nbt_expand(). Lists of numbers
+ * are always kept like arrays: a single LH_NBT_RAW entry with the
+ * big-endian elements as the value.
+ *
+ * The same representation is serialized by lh_nbt_write(). Trees can be
+ * built with lh_nbt_begin(), lh_nbt_add*() and lh_nbt_end(), and parsed
+ * values can be changed with lh_nbt_set_*() before writing them back.
+ *
+ * EXAMPLE:
+ * lh_nbt t;
+ * lh_nbt_init(&t);
+ * if (lh_nbt_parse(&t, data, len, -1) < 0) ... // malformed
+ * int x = lh_nbt_int(&t, lh_nbt_path(&t, 0, "Level/xPos"));
+ * int s = lh_nbt_path(&t, 0, "Level/Sections");
+ * for(i=lh_nbt_first(&t, s); i>=0; i=lh_nbt_next(&t, i))
+ *     process(lh_nbt_int(&t, lh_nbt_find(&t, i, "Y")));
+ * lh_nbt_free(&t);
+ */
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lh_arr.h"
+#include "lh_files.h"
+#include "lh_strings.h"
+#include "lh_bytes.h"
+
+#define LH_NBT_END          0
+#define LH_NBT_BYTE         1
+#define LH_NBT_SHORT        2
+#define LH_NBT_INT          3
+#define LH_NBT_LONG         4
+#define LH_NBT_FLOAT        5
+#define LH_NBT_DOUBLE       6
+#define LH_NBT_BYTE_ARRAY   7
+#define LH_NBT_STRING       8
+#define LH_NBT_LIST         9
+#define LH_NBT_COMPOUND     10
+#define LH_NBT_INT_ARRAY    11
+#define LH_NBT_LONG_ARRAY   12
+
+#define LH_NBT_RAW          (1<<0)  /* container not indexed, the value is its payload */
+
+#define LH_NBT_MAXDEPTH     512     /* nesting of containers */
+
+typedef struct {
+    lh_span     name;       // name of the tag, empty in lists
+    lh_span     value;      // numbers: big-endian bytes, strings: the characters,
+                            // arrays: big-endian elements, compounds: the payload,
+                            // lists: the payload after the tag and count
+    int32_t     count;      // elements of arrays and lists, tags of compounds,
+                            // -1 for compounds not indexed, length of strings
+    int32_t     next;       // index of the entry after the subtree
+    int32_t     parent;     // index of the enclosing container, -1 for the root
+    uint8_t     type;       // LH_NBT_* tag
+    uint8_t     etype;      // tag of the list elements
+    uint8_t     flags;      // LH_NBT_RAW
+    uint8_t     num[8];     // a number set by lh_nbt_set_*, if value.ptr is NULL
+} lh_nbt_entry;
+
+typedef struct {
+    lh_arr_declare(lh_nbt_entry,ent);   // entries in pre-order
+    int         open;       // innermost container being built, -1 if none
+} lh_nbt;
+
+void lh_nbt_init(lh_nbt *t);
+void lh_nbt_free(lh_nbt *t);
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Parsing
+
+/*! \brief Index a named tag and its subtree, replacing the entries of t
+ * The data must stay valid while the entries are used.
+ * \param t Tree
+ * \param data Serialized tag
+ * \param len Length of the data
+ * \param depth Levels of containers to index below the root, -1 for all
+ * \return Length of the tag, -1 if it is truncated or malformed
+ */
+ssize_t lh_nbt_parse(lh_nbt *t, const uint8_t *data, ssize_t len, int depth);
+
+/*! \brief Index the payload of an entry marked LH_NBT_RAW
+ * \param sub Tree to index into, the root gets the name and tag of the entry
+ * \param t Tree of the entry
+ * \param i Index of the entry
+ * \param depth Levels of containers to index, -1 for all
+ * \return 0 on success, -1 if the payload is malformed
+ */
+int lh_nbt_expand(lh_nbt *sub, const lh_nbt *t, int i, int depth);
+
+/*! \brief Find the length of a payload without indexing it
+ * \param p Payload, after the tag and name
+ * \param end End of the data
+ * \param type Tag of the payload
+ * \return Length of the payload, -1 if it is truncated or malformed
+ */
+ssize_t lh_nbt_skip(const uint8_t *p, const uint8_t *end, int type);
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Navigation
+
+static inline lh_nbt_entry * lh_nbt_at(const lh_nbt *t, int i) {
+    return P(t->ent)+i;
+}
+
+/*! \brief First child of a container, -1 if none */
+static inline int lh_nbt_first(const lh_nbt *t, int i) {
+    if (i < 0 || i+1 >= P(t->ent)[i].next) return -1;
+    return i+1;
+}
+
+/*! \brief Next sibling of an entry, -1 if none */
+static inline int lh_nbt_next(const lh_nbt *t, int i) {
+    if (i < 0) return -1;
+    int p = P(t->ent)[i].parent, j = P(t->ent)[i].next;
+    return (p >= 0 && j < P(t->ent)[p].next) ? j : -1;
+}
+
+/*! \brief Find a child of a compound by name
+ * \return Index of the child, -1 if there is none
+ */
+int lh_nbt_find(const lh_nbt *t, int i, const char *name);
+
+/*! \brief Find a descendant by a path of /-separated names
+ * Components consisting of digits select the n-th child, e.g. the elements
+ * of lists: "Level/Sections/0/Y"
+ * \return Index of the descendant, -1 if there is none
+ */
+int lh_nbt_path(const lh_nbt *t, int i, const char *path);
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Values
+
+/*! \brief Value of an entry, valid until the tree is modified */
+static inline lh_span lh_nbt_value(const lh_nbt *t, int i) {
+    const lh_nbt_entry *e = P(t->ent)+i;
+    return e->value.ptr ? e->value : lh_span_make(e->num, e->value.len);
+}
+
+/*! \brief Value of an integer or floating point entry as an integer
+ * \return The value, 0 for other tags or i < 0
+ */
+int64_t lh_nbt_int(const lh_nbt *t, int i);
+
+/*! \brief Value of an integer or floating point entry as a double
+ * \return The value, 0 for other tags or i < 0
+ */
+double lh_nbt_double(const lh_nbt *t, int i);
+
+/*! \brief Characters of a string entry, empty for other tags or i < 0 */
+lh_span lh_nbt_string(const lh_nbt *t, int i);
+
+/*! \brief View of the big-endian elements of an array or a list of numbers
+ * \return The view, empty for other entries or i < 0
+ */
+lh_view lh_nbt_view(const lh_nbt *t, int i);
+
+/*! \brief Element k of an array or a list of numbers
+ * \return The element, 0 if k is out of range
+ */
+int64_t lh_nbt_elem_int(const lh_nbt *t, int i, int k);
+double lh_nbt_elem_double(const lh_nbt *t, int i, int k);
+
+/*! \brief Change the value of a number entry, keeping its tag */
+void lh_nbt_set_int(lh_nbt *t, int i, int64_t v);
+void lh_nbt_set_double(lh_nbt *t, int i, double v);
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Building
+
+/*! \brief Add a compound or list to the innermost open container, or as
+ * the root of an empty tree, and open it. The tag of a list is that of its
+ * first element.
+ * The name must stay valid while the entries are used.
+ * \return Index of the entry
+ */
+int lh_nbt_begin(lh_nbt *t, int type, lh_span name);
+
+/*! \brief Close the innermost open container
+ * \return 0 on success, -1 if no container is open or the elements of a
+ * list have different tags
+ */
+int lh_nbt_end(lh_nbt *t);
+
+/*! \brief Add a string or an array, the value must stay valid while the
+ * entries are used. The elements of arrays are big-endian.
+ * \return Index of the entry
+ */
+int lh_nbt_add(lh_nbt *t, int type, lh_span name, lh_span value);
+
+/*! \brief Add a number, LH_NBT_BYTE to LH_NBT_DOUBLE
+ * \return Index of the entry
+ */
+int lh_nbt_add_int(lh_nbt *t, int type, lh_span name, int64_t v);
+int lh_nbt_add_double(lh_nbt *t, int type, lh_span name, double v);
+
+////////////////////////////////////////////////////////////////////////////////
+/// @name Writing
+
+/*! \brief Serialize an entry and its subtree as a named tag
+ * \param b Buffer, the data is appended after C(b->data)
+ * \param t Tree
+ * \param i Index of the entry, 0 for the whole tree
+ * \return Number of bytes appended
+ */
+ssize_t lh_nbt_write(lh_buf_t *b, const lh_nbt *t, int i);
@@ -0,0 +1,155 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include "lh_path.h"
+#include "lh_buffers.h"
+
+#include <string.h>
+
+#define LH_PATHBUF_GRAN 256
+
+////////////////////////////////////////////////////////////////////////////////
+/// Path strings
+
+lh_span lh_path_basename(lh_span path) {
+    const uint8_t *p = path.ptr;
+    ssize_t e = path.len;
+
+    while (e > 1 && p[e-1] == '/') e--;
+    if (e == 0) return lh_span_make(".", 1);
+    if (e == 1) return lh_span_make(p, 1);
+
+    ssize_t s = e;
+    while (s > 0 && p[s-1] != '/') s--;
+    return lh_span_make(p+s, e-s);
+}
+
+lh_span lh_path_dirname(lh_span path) {
+    const uint8_t *p = path.ptr;
+    ssize_t e = path.len;
+
+    while (e > 1 && p[e-1] == '/') e--;     // trailing slashes
+    while (e > 0 && p[e-1] != '/') e--;     // last component
+    if (e == 0) return lh_span_make(".", 1);
+    while (e > 1 && p[e-1] == '/') e--;     // separating slashes
+    return lh_span_make(p, e);
+}
+
+int lh_path_prefix(lh_span path, lh_span dir) {
+    while (dir.len > 1 && dir.ptr[dir.len-1] == '/') dir.len--;
+    if (!lh_span_prefix(path, dir)) return 0;
+
+    // the prefix must end at a component boundary
+    return path.len == dir.len || path.ptr[dir.len] == '/' ||
+        (dir.len > 0 && dir.ptr[dir.len-1] == '/');
+}
+
+ssize_t lh_path_join(lh_span a, lh_span b, char *out) {
+    ssize_t o = 0;
+    if (b.len == 0 || b.ptr[0] != '/') {
+        memcpy(out, a.ptr, a.len);
+        o = a.len;
+        if (o > 0 && b.len > 0 && out[o-1] != '/') out[o++] = '/';
+    }
+    memmove(out+o, b.ptr, b.len);
+    o += b.len;
+    out[o] = 0;
+    return o;
+}
+
+ssize_t lh_path_normalize(lh_span path, char *out) {
+    const uint8_t *p = path.ptr, *end = p+path.len;
+    int abs = (path.len > 0 && p[0] == '/');
+    ssize_t o = 0, base;
+
+    if (abs) out[o++] = '/';
+    base = o;   // components before this cannot be removed by ".."
+
+    // the output never overtakes the input, so this works in place
+    while (p < end) {
+        while (p < end && *p == '/') p++;
+        const uint8_t *c = p;
+        while (p < end && *p != '/') p++;
+        ssize_t clen = p-c;
+
+        if (clen == 0 || (clen == 1 && c[0] == '.')) continue;
+
+        if (clen == 2 && c[0] == '.' && c[1] == '.') {
+            if (o > base) {
+                // remove the last component and its separator
+                while (o > base && out[o-1] != '/') o--;
+                if (o > base) o--;
+                continue;
+            }
+            if (abs) continue;  // ".." at the root is the root
+
+            // leading ".." of a relative path stays
+            if (o > 0) out[o++] = '/';
+            out[o++] = '.';
+            out[o++] = '.';
+            base = o;
+            continue;
+        }
+
+        if (o > 0 && out[o-1] != '/') out[o++] = '/';
+        memmove(out+o, c, clen);
+        o += clen;
+    }
+
+    if (o == 0) out[o++] = '.';
+    out[o] = 0;
+    return o;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Path builder
+
+static void lh_pathbuf_reserve(lh_pathbuf *pb, ssize_t len) {
+    if (len+1 <= pb->size) return;
+    pb->size = lh_align(len+1, LH_PATHBUF_GRAN);
+    lh_resize(pb->path, pb->size);
+}
+
+void lh_pathbuf_init(lh_pathbuf *pb, lh_span path) {
+    lh_clear_ptr(pb);
+    lh_pathbuf_set(pb, path);
+}
+
+void lh_pathbuf_free(lh_pathbuf *pb) {
+    if (pb->path) free(pb->path);
+    lh_clear_ptr(pb);
+}
+
+void lh_pathbuf_set(lh_pathbuf *pb, lh_span path) {
+    lh_pathbuf_reserve(pb, path.len);
+    if (path.len) memcpy(pb->path, path.ptr, path.len);
+    lh_pathbuf_trunc(pb, path.len);
+}
+
+ssize_t lh_pathbuf_push(lh_pathbuf *pb, lh_span name) {
+    ssize_t plen = pb->len;
+    int sep = (plen > 0 && pb->path[plen-1] != '/');
+
+    lh_pathbuf_reserve(pb, plen+sep+name.len);
+    if (sep) pb->path[plen] = '/';
+    if (name.len) memcpy(pb->path+plen+sep, name.ptr, name.len);
+    lh_pathbuf_trunc(pb, plen+sep+name.len);
+    return plen;
+}
+
+void lh_pathbuf_pop(lh_pathbuf *pb) {
+    const char *p = pb->path;
+    ssize_t e = pb->len;
+
+    while (e > 1 && p[e-1] == '/') e--;
+    while (e > 0 && p[e-1] != '/') e--;
+    while (e > 1 && p[e-1] == '/') e--;
+    lh_pathbuf_trunc(pb, e);
+}
@@ -0,0 +1,100 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+/*! \file
+ * Path manipulation on spans
+ *
+ * The functions work on lh_span path strings with known lengths, so they
+ * never scan for a NUL terminator, and the component functions return
+ * spans pointing into their argument instead of copying.
+ *
+ * The path builder keeps a path in a growing buffer and appends or
+ * truncates components in place, which is what a directory walk needs:
+ *
+ * EXAMPLE:
+ * lh_pathbuf pb;
+ * lh_pathbuf_init(&pb, lh_span_cstr("/var/log"));
+ * ssize_t plen = lh_pathbuf_push(&pb, lh_span_make(name, namelen));
+ * lstat(pb.path, &st);                 // "/var/log/<name>"
+ * lh_pathbuf_trunc(&pb, plen);         // back to "/var/log"
+ * lh_pathbuf_free(&pb);
+ */
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lh_strings.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// Path strings
+
+/*! \brief Get the last component of a path, like basename(3).
+ * Trailing slashes are ignored, "/" gives "/" and "" gives "." */
+lh_span lh_path_basename(lh_span path);
+
+/*! \brief Get the path without its last component, like dirname(3).
+ * A path without slashes gives ".", and "/" or "/a" gives "/" */
+lh_span lh_path_dirname(lh_span path);
+
+/*! \brief Check if a path lies within a directory, comparing whole
+ * components - "a/b" is within "a", but "ab" is not
+ * \param path Path to check
+ * \param dir Directory path, trailing slashes are ignored
+ * \return 1 if path equals dir or lies below it, 0 otherwise */
+int lh_path_prefix(lh_span path, lh_span dir);
+
+/*! \brief Join two paths. If b is absolute, the result is b.
+ * \param out Output buffer, must have space for a.len+b.len+2 bytes
+ * \return Length of the NUL-terminated result */
+ssize_t lh_path_join(lh_span a, lh_span b, char *out);
+
+/*! \brief Normalize a path lexically: remove repeated slashes, trailing
+ * slashes and "." components, and resolve ".." against the preceding
+ * component. Leading ".." of relative paths are kept, ".." at the root is
+ * dropped. Symlinks are not resolved.
+ * \param out Output buffer, must have space for path.len+2 bytes, may be
+ * the same as path.ptr
+ * \return Length of the NUL-terminated result, "." for an empty result */
+ssize_t lh_path_normalize(lh_span path, char *out);
+
+////////////////////////////////////////////////////////////////////////////////
+/// Path builder
+
+typedef struct {
+    char *          path;       // NUL-terminated path
+    ssize_t         len;        // length of the path
+    ssize_t         size;       // allocated size
+} lh_pathbuf;
+
+void lh_pathbuf_init(lh_pathbuf *pb, lh_span path);
+void lh_pathbuf_free(lh_pathbuf *pb);
+
+/*! \brief Replace the contents of the builder */
+void lh_pathbuf_set(lh_pathbuf *pb, lh_span path);
+
+/*! \brief Append a component, separated by a slash unless the path
+ * is empty or already ends with one
+ * \return Length of the path before appending, for lh_pathbuf_trunc() */
+ssize_t lh_pathbuf_push(lh_pathbuf *pb, lh_span name);
+
+/*! \brief Remove the last component, leaving "/" for an absolute path */
+void lh_pathbuf_pop(lh_pathbuf *pb);
+
+/*! \brief Truncate the path to a length returned by lh_pathbuf_push() */
+static inline void lh_pathbuf_trunc(lh_pathbuf *pb, ssize_t len) {
+    pb->len = len;
+    pb->path[len] = 0;
+}
+
+static inline lh_span lh_pathbuf_span(const lh_pathbuf *pb) {
+    return lh_span_make(pb->path, pb->len);
+}
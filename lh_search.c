@@ -0,0 +1,364 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include "lh_search.h"
+#include "lh_cpu.h"
+#include "lh_buffers.h"
+
+#include <string.h>
+
+#define ONES  0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+// non-zero if any of the bytes in the word is zero
+#define HASZERO(w) (((w)-ONES) & ~(w) & HIGHS)
+
+////////////////////////////////////////////////////////////////////////////////
+/// Scalar implementations
+
+static ssize_t lh_find_byte_scalar(const uint8_t *p, ssize_t len, uint8_t c) {
+    uint64_t pat = ONES*c;
+    ssize_t i=0;
+
+    // skip 8 bytes at a time while there is no match in the word
+    for(; i+8<=len; i+=8) {
+        uint64_t w;
+        memcpy(&w, p+i, 8);
+        if (HASZERO(w^pat)) break;
+    }
+
+    for(; i<len; i++)
+        if (p[i]==c) return i;
+    return -1;
+}
+
+static ssize_t lh_count_byte_scalar(const uint8_t *p, ssize_t len, uint8_t c) {
+    ssize_t i, cnt=0;
+    for(i=0; i<len; i++)
+        cnt += (p[i]==c);
+    return cnt;
+}
+
+static ssize_t lh_find_set_scalar(const uint8_t *p, ssize_t len, const lh_byteset *bs) {
+    ssize_t i;
+    for(i=0; i<len; i++)
+        if (bs->map[p[i]>>3] & (1<<(p[i]&7))) return i;
+    return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// SSE2/SSSE3 implementations
+
+#ifdef HAVE_X86_SIMD
+
+LH_TARGET("sse2")
+static ssize_t lh_find_byte_sse2(const uint8_t *p, ssize_t len, uint8_t c) {
+    __m128i vc = _mm_set1_epi8(c);
+    ssize_t i=0;
+
+    for(; i+16<=len; i+=16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p+i));
+        int m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, vc));
+        if (m) return i+__builtin_ctz(m);
+    }
+
+    for(; i<len; i++)
+        if (p[i]==c) return i;
+    return -1;
+}
+
+LH_TARGET("sse2")
+static ssize_t lh_count_byte_sse2(const uint8_t *p, ssize_t len, uint8_t c) {
+    __m128i vc = _mm_set1_epi8(c);
+    __m128i zero = _mm_setzero_si128();
+    __m128i total = zero;
+    ssize_t i=0, cnt=0;
+
+    while (i+16<=len) {
+        // the 8-bit counters can take at most 255 matches before they
+        // have to be summed up into the 64-bit counters
+        __m128i acc = zero;
+        int n;
+        for(n=0; n<255 && i+16<=len; n++, i+=16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(p+i));
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(v, vc));
+        }
+        total = _mm_add_epi64(total, _mm_sad_epu8(acc, zero));
+    }
+    cnt = _mm_cvtsi128_si64(total) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(total, total));
+
+    for(; i<len; i++)
+        cnt += (p[i]==c);
+    return cnt;
+}
+
+LH_TARGET("sse2")
+static ssize_t lh_find_set_sse2(const uint8_t *p, ssize_t len, const lh_byteset *bs) {
+    ssize_t i=0;
+    __m128i vb[16];
+    int j;
+    for(j=0; j<bs->nbytes; j++)
+        vb[j] = _mm_set1_epi8(bs->bytes[j]);
+
+    for(; i+16<=len; i+=16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p+i));
+        __m128i m = _mm_cmpeq_epi8(v, vb[0]);
+        for(j=1; j<bs->nbytes; j++)
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, vb[j]));
+        int mask = _mm_movemask_epi8(m);
+        if (mask) return i+__builtin_ctz(mask);
+    }
+
+    ssize_t r = lh_find_set_scalar(p+i, len-i, bs);
+    return (r<0) ? r : i+r;
+}
+
+// match all bytes of v against the nibble tables, returns a mask of matches
+LH_TARGET("ssse3")
+static inline int lh_set_match_ssse3(__m128i v, __m128i tlo, __m128i thi, __m128i bits) {
+    __m128i nib = _mm_set1_epi8(0x0f);
+    __m128i lo = _mm_and_si128(v, nib);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nib);
+
+    // row bitmasks for the low nibble, select by the top bit of the byte
+    __m128i upper = _mm_cmpgt_epi8(hi, _mm_set1_epi8(7));
+    __m128i row = _mm_or_si128(_mm_andnot_si128(upper, _mm_shuffle_epi8(tlo, lo)),
+                               _mm_and_si128(upper, _mm_shuffle_epi8(thi, lo)));
+
+    // test the bit for the high nibble
+    __m128i bit = _mm_shuffle_epi8(bits, hi);
+    __m128i m = _mm_cmpeq_epi8(_mm_and_si128(row, bit), _mm_setzero_si128());
+    return _mm_movemask_epi8(m) ^ 0xffff;
+}
+
+LH_TARGET("ssse3")
+static ssize_t lh_find_set_ssse3(const uint8_t *p, ssize_t len, const lh_byteset *bs) {
+    __m128i tlo = _mm_loadu_si128((const __m128i *)bs->lo);
+    __m128i thi = _mm_loadu_si128((const __m128i *)bs->hi);
+    __m128i bits = _mm_setr_epi8(1,2,4,8,16,32,64,-128,1,2,4,8,16,32,64,-128);
+    ssize_t i=0;
+
+    for(; i+16<=len; i+=16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p+i));
+        int mask = lh_set_match_ssse3(v, tlo, thi, bits);
+        if (mask) return i+__builtin_ctz(mask);
+    }
+
+    ssize_t r = lh_find_set_scalar(p+i, len-i, bs);
+    return (r<0) ? r : i+r;
+}
+
+// Substring search with a SIMD prefilter: compare the first and the last
+// byte of the needle at 16 positions at once and only verify the positions
+// where both match
+LH_TARGET("sse2")
+static ssize_t lh_find_substr_sse2(const uint8_t *p, ssize_t len, const uint8_t *s, ssize_t slen) {
+    __m128i first = _mm_set1_epi8(s[0]);
+    __m128i last  = _mm_set1_epi8(s[slen-1]);
+    ssize_t i=0;
+
+    for(; i+slen-1+16<=len; i+=16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(p+i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(p+i+slen-1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first),
+                                                   _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (!memcmp(p+i+bit+1, s+1, slen-2)) return i+bit;
+            mask &= mask-1;
+        }
+    }
+
+    for(; i+slen<=len; i++)
+        if (p[i]==s[0] && !memcmp(p+i+1, s+1, slen-1)) return i;
+    return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// AVX2 implementations
+
+LH_TARGET("avx2")
+static ssize_t lh_find_byte_avx2(const uint8_t *p, ssize_t len, uint8_t c) {
+    __m256i vc = _mm256_set1_epi8(c);
+    ssize_t i=0;
+
+    for(; i+32<=len; i+=32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p+i));
+        uint32_t m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, vc));
+        if (m) return i+__builtin_ctz(m);
+    }
+
+    // the SSE2 tail uses legacy encodings - clear the upper halves first,
+    // or every SSE instruction after this call pays a transition penalty
+    _mm256_zeroupper();
+    ssize_t r = lh_find_byte_sse2(p+i, len-i, c);
+    return (r<0) ? r : i+r;
+}
+
+LH_TARGET("avx2")
+static ssize_t lh_count_byte_avx2(const uint8_t *p, ssize_t len, uint8_t c) {
+    __m256i vc = _mm256_set1_epi8(c);
+    __m256i zero = _mm256_setzero_si256();
+    __m256i total = zero;
+    ssize_t i=0;
+
+    while (i+32<=len) {
+        __m256i acc = zero;
+        int n;
+        for(n=0; n<255 && i+32<=len; n++, i+=32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(p+i));
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, vc));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(acc, zero));
+    }
+
+    ssize_t cnt = _mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1) +
+                  _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3);
+    _mm256_zeroupper();
+    return cnt + lh_count_byte_sse2(p+i, len-i, c);
+}
+
+LH_TARGET("avx2")
+static ssize_t lh_find_set_avx2(const uint8_t *p, ssize_t len, const lh_byteset *bs) {
+    __m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)bs->lo));
+    __m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)bs->hi));
+    __m256i bits = _mm256_setr_epi8(1,2,4,8,16,32,64,-128,1,2,4,8,16,32,64,-128,
+                                    1,2,4,8,16,32,64,-128,1,2,4,8,16,32,64,-128);
+    __m256i nib = _mm256_set1_epi8(0x0f);
+    __m256i seven = _mm256_set1_epi8(7);
+    ssize_t i=0;
+
+    for(; i+32<=len; i+=32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p+i));
+        __m256i lo = _mm256_and_si256(v, nib);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nib);
+        __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(tlo, lo),
+                                         _mm256_shuffle_epi8(thi, lo),
+                                         _mm256_cmpgt_epi8(hi, seven));
+        __m256i bit = _mm256_shuffle_epi8(bits, hi);
+        __m256i m = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), _mm256_setzero_si256());
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(m);
+        if (mask) return i+__builtin_ctz(mask);
+    }
+
+    _mm256_zeroupper();
+    ssize_t r = lh_find_set_ssse3(p+i, len-i, bs);
+    return (r<0) ? r : i+r;
+}
+
+LH_TARGET("avx2")
+static ssize_t lh_find_substr_avx2(const uint8_t *p, ssize_t len, const uint8_t *s, ssize_t slen) {
+    __m256i first = _mm256_set1_epi8(s[0]);
+    __m256i last  = _mm256_set1_epi8(s[slen-1]);
+    ssize_t i=0;
+
+    for(; i+slen-1+32<=len; i+=32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(p+i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(p+i+slen-1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                                              _mm256_cmpeq_epi8(b, last)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (!memcmp(p+i+bit+1, s+1, slen-2)) return i+bit;
+            mask &= mask-1;
+        }
+    }
+
+    ssize_t r = lh_find_substr_sse2(p+i, len-i, s, slen);
+    return (r<0) ? r : i+r;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+ssize_t lh_find_byte(const uint8_t *p, ssize_t len, uint8_t c) {
+    if (len <= 0) return -1;
+#ifdef HAVE_X86_SIMD
+    if (lh_cpu_has(LH_CPU_AVX2)) return lh_find_byte_avx2(p, len, c);
+    if (lh_cpu_has(LH_CPU_SSE2)) return lh_find_byte_sse2(p, len, c);
+#endif
+    return lh_find_byte_scalar(p, len, c);
+}
+
+ssize_t lh_count_byte(const uint8_t *p, ssize_t len, uint8_t c) {
+    if (len <= 0) return 0;
+#ifdef HAVE_X86_SIMD
+    if (lh_cpu_has(LH_CPU_AVX2)) return lh_count_byte_avx2(p, len, c);
+    if (lh_cpu_has(LH_CPU_SSE2)) return lh_count_byte_sse2(p, len, c);
+#endif
+    return lh_count_byte_scalar(p, len, c);
+}
+
+ssize_t lh_find_substr(const uint8_t *p, ssize_t len, const uint8_t *s, ssize_t slen) {
+    if (slen <= 0) return 0;
+    if (slen > len) return -1;
+    if (slen == 1) return lh_find_byte(p, len, s[0]);
+
+#ifdef HAVE_X86_SIMD
+    if (lh_cpu_has(LH_CPU_AVX2)) return lh_find_substr_avx2(p, len, s, slen);
+    if (lh_cpu_has(LH_CPU_SSE2)) return lh_find_substr_sse2(p, len, s, slen);
+#endif
+
+    // scan for the first byte of the needle and verify the rest
+    ssize_t i=0;
+    while (i+slen<=len) {
+        ssize_t r = lh_find_byte_scalar(p+i, len-i-slen+1, s[0]);
+        if (r<0) break;
+        i += r;
+        if (!memcmp(p+i+1, s+1, slen-1)) return i;
+        i++;
+    }
+    return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void lh_byteset_init(lh_byteset *bs, const uint8_t *set, int nset) {
+    lh_clear_ptr(bs);
+
+    int i;
+    for(i=0; i<nset; i++) {
+        uint8_t b = set[i];
+        if (bs->map[b>>3] & (1<<(b&7))) continue; // duplicate
+        bs->map[b>>3] |= 1<<(b&7);
+
+        if (b&0x80)
+            bs->hi[b&15] |= 1<<((b>>4)&7);
+        else
+            bs->lo[b&15] |= 1<<((b>>4)&7);
+
+        if (bs->nbytes < 16)
+            bs->bytes[bs->nbytes] = b;
+        if (bs->nbytes <= 16)
+            bs->nbytes++;
+    }
+}
+
+ssize_t lh_find_set(const uint8_t *p, ssize_t len, const lh_byteset *bs) {
+    if (len <= 0 || bs->nbytes == 0) return -1;
+    if (bs->nbytes == 1) return lh_find_byte(p, len, bs->bytes[0]);
+
+#ifdef HAVE_X86_SIMD
+    if (lh_cpu_has(LH_CPU_AVX2))  return lh_find_set_avx2(p, len, bs);
+    if (lh_cpu_has(LH_CPU_SSSE3)) return lh_find_set_ssse3(p, len, bs);
+    if (lh_cpu_has(LH_CPU_SSE2) && bs->nbytes <= 16)
+        return lh_find_set_sse2(p, len, bs);
+#endif
+    return lh_find_set_scalar(p, len, bs);
+}
+
+ssize_t lh_find_anyof(const uint8_t *p, ssize_t len, const uint8_t *set, int nset) {
+    if (nset == 1) return lh_find_byte(p, len, set[0]);
+
+    lh_byteset bs;
+    lh_byteset_init(&bs, set, nset);
+    return lh_find_set(p, len, &bs);
+}
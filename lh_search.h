@@ -0,0 +1,77 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+/*! \file
+ * Byte search primitives
+ *
+ * The functions operate on (ptr, len) spans, such as the unread part of a
+ * lh_buf_t (P(buf.data)+buf.ridx, C(buf.data)-buf.ridx), and return the
+ * offset of the match relative to ptr, or -1 if nothing was found.
+ * SSE2/SSSE3/AVX2 kernels are selected at runtime, see lh_cpu.h.
+ */
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Find the first occurence of a byte
+ * \param p Data to search in
+ * \param len Length of data
+ * \param c Byte to search for
+ * \return Offset of the byte, -1 if not found */
+ssize_t lh_find_byte(const uint8_t *p, ssize_t len, uint8_t c);
+
+/*! \brief Count occurences of a byte
+ * \param p Data to search in
+ * \param len Length of data
+ * \param c Byte to count
+ * \return Number of occurences */
+ssize_t lh_count_byte(const uint8_t *p, ssize_t len, uint8_t c);
+
+/*! \brief Find the first occurence of a byte sequence
+ * \param p Data to search in
+ * \param len Length of data
+ * \param s Byte sequence to search for
+ * \param slen Length of the byte sequence
+ * \return Offset of the sequence, -1 if not found, 0 if slen is 0 */
+ssize_t lh_find_substr(const uint8_t *p, ssize_t len, const uint8_t *s, ssize_t slen);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*! Precompiled set of bytes for lh_find_set(). Initializing it once
+ * avoids rebuilding the lookup tables on every search. */
+typedef struct {
+    uint8_t     map[32];        // bitmap of all 256 byte values
+    uint8_t     lo[16];         // nibble tables for the pshufb lookup:
+    uint8_t     hi[16];         // bit (b>>4)&7 of lo/hi[b&15] is set if
+                                // b is in the set, for b<128 and b>=128
+    uint8_t     bytes[16];      // distinct bytes, if there are 16 or less
+    int         nbytes;         // number of distinct bytes, 17 if more
+} lh_byteset;
+
+void lh_byteset_init(lh_byteset *bs, const uint8_t *set, int nset);
+
+/*! \brief Find the first byte that belongs to a set
+ * \param p Data to search in
+ * \param len Length of data
+ * \param bs Set of bytes initialized with lh_byteset_init()
+ * \return Offset of the byte, -1 if not found */
+ssize_t lh_find_set(const uint8_t *p, ssize_t len, const lh_byteset *bs);
+
+/*! \brief Find the first occurence of any of the given bytes
+ * \param p Data to search in
+ * \param len Length of data
+ * \param set Bytes to search for
+ * \param nset Number of bytes in the set
+ * \return Offset of the byte, -1 if not found */
+ssize_t lh_find_anyof(const uint8_t *p, ssize_t len, const uint8_t *set, int nset);
@@ -0,0 +1,92 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include "lh_split.h"
+#include "lh_search.h"
+#include "lh_buffers.h"
+
+#include <string.h>
+#include <assert.h>
+
+void lh_splitter_init(lh_splitter *sp, uint8_t delim, int flags) {
+    lh_clear_ptr(sp);
+    sp->delim = delim;
+    sp->flags = flags;
+}
+
+void lh_splitter_free(lh_splitter *sp) {
+    lh_arr_free(AR(sp->carry));
+}
+
+void lh_splitter_feed(lh_splitter *sp, const uint8_t *data, ssize_t len) {
+    assert(sp->ptr == sp->end);
+    assert(!sp->eof);
+    sp->ptr = data;
+    sp->end = data+len;
+}
+
+void lh_splitter_finish(lh_splitter *sp) {
+    sp->eof = 1;
+}
+
+// append bytes to the carry buffer
+static void lh_splitter_keep(lh_splitter *sp, const uint8_t *data, ssize_t len) {
+    if (len <= 0) return;
+    memcpy(lh_arr_add(GAR4(sp->carry), len), data, len);
+}
+
+int lh_splitter_next(lh_splitter *sp, lh_span *rec) {
+    while (1) {
+        // the record returned in the last call was assembled in the carry buffer
+        if (sp->used) {
+            C(sp->carry) = 0;
+            sp->used = 0;
+        }
+
+        ssize_t avail = sp->end - sp->ptr;
+        ssize_t pos = lh_find_byte(sp->ptr, avail, sp->delim);
+        const uint8_t *rp;
+        ssize_t rlen;
+
+        if (pos < 0) {
+            // no delimiter in the rest of the chunk - keep it for the next one
+            lh_splitter_keep(sp, sp->ptr, avail);
+            sp->ptr = sp->end;
+
+            // at the end of data, the remainder is the last record
+            if (!sp->eof || C(sp->carry) == 0) return 0;
+            rp = P(sp->carry);
+            rlen = C(sp->carry);
+            sp->used = 1;
+        }
+        else if (C(sp->carry)) {
+            // complete the record started in a previous chunk
+            lh_splitter_keep(sp, sp->ptr, pos);
+            sp->ptr += pos+1;
+            rp = P(sp->carry);
+            rlen = C(sp->carry);
+            sp->used = 1;
+        }
+        else {
+            // record lies within the chunk - no copying
+            rp = sp->ptr;
+            rlen = pos;
+            sp->ptr += pos+1;
+        }
+
+        if ((sp->flags & LH_SPLIT_CRLF) && rlen > 0 && rp[rlen-1] == '\r')
+            rlen--;
+
+        if (rlen > 0 || (sp->flags & LH_SPLIT_EMPTY)) {
+            *rec = lh_span_make(rp, rlen);
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+/*! \file
+ * Incremental record splitter
+ *
+ * The splitter is fed with chunks of data - from lh_read_buf(), a mmap'ed
+ * file or the rbuf of a lh_conn - and yields the delimited records as spans.
+ * Records that lie completely within a chunk point directly into it. Only
+ * a record crossing a chunk boundary is assembled in an internal buffer,
+ * so the rest of the data is never copied.
+ *
+ * EXAMPLE:
+ * lh_splitter sp;
+ * lh_splitter_init(&sp, '\n', LH_SPLIT_CRLF);
+ * while ((len = read(fd, buf, sizeof(buf))) > 0) {
+ *     lh_splitter_feed(&sp, buf, len);
+ *     while (lh_splitter_next(&sp, &rec))
+ *         process(rec.ptr, rec.len);
+ * }
+ * lh_splitter_finish(&sp);
+ * if (lh_splitter_next(&sp, &rec)) process(rec.ptr, rec.len);
+ * lh_splitter_free(&sp);
+ */
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lh_arr.h"
+#include "lh_strings.h"
+
+#define LH_SPLIT_CRLF   (1<<0)  /* strip a \r preceding the delimiter */
+#define LH_SPLIT_EMPTY  (1<<1)  /* report empty records, skipped otherwise */
+
+typedef struct {
+    uint8_t         delim;      // record delimiter
+    int             flags;      // LH_SPLIT_* flags
+    int             eof;        // no more data will be fed
+    int             used;       // carry buffer was returned as a record
+
+    const uint8_t * ptr;        // unprocessed part of the current chunk
+    const uint8_t * end;
+
+    lh_buf_declare(carry);      // partial record from the previous chunks
+} lh_splitter;
+
+////////////////////////////////////////////////////////////////////////////////
+
+void lh_splitter_init(lh_splitter *sp, uint8_t delim, int flags);
+void lh_splitter_free(lh_splitter *sp);
+
+/*! \brief Feed the next chunk of data to the splitter.
+ * The chunk must stay valid until lh_splitter_next() returns 0.
+ * All records from the previous chunk must have been retrieved.
+ * \param sp Splitter
+ * \param data Chunk data
+ * \param len Chunk length */
+void lh_splitter_feed(lh_splitter *sp, const uint8_t *data, ssize_t len);
+
+/*! \brief Signal the end of data. The remaining partial record will be
+ * returned by the next call to lh_splitter_next() */
+void lh_splitter_finish(lh_splitter *sp);
+
+/*! \brief Get the next complete record.
+ * The record span is valid until the next call to lh_splitter_next()
+ * or lh_splitter_feed().
+ * \param sp Splitter
+ * \param rec Returns the record, without the delimiter
+ * \return 1 if a record was returned, 0 if more data must be fed */
+int lh_splitter_next(lh_splitter *sp, lh_span *rec);
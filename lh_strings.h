@@ -14,9 +14,125 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdarg.h>
 
 #include "lh_buffers.h"
 
+////////////////////////////////////////////////////////////////////////////////
+/// Spans
+
+/*! A reference to a range of bytes owned by someone else, such as a part
+ * of a file buffer. Spans are not NUL-terminated. */
+typedef struct {
+    const uint8_t * ptr;
+    ssize_t         len;
+} lh_span;
+
+#define lh_span_make(p,l) ((lh_span){ (const uint8_t *)(p), (l) })
+
+/*! \brief Make a span from a NUL-terminated string - the only operation
+ * that scans for the terminator */
+static inline lh_span lh_span_cstr(const char *s) {
+    return lh_span_make(s, strlen(s));
+}
+
+static inline int lh_span_eq(lh_span a, lh_span b) {
+    return a.len == b.len && !memcmp(a.ptr, b.ptr, a.len);
+}
+
+/*! \brief Compare two spans bytewise, like strcmp
+ * \return <0, 0 or >0 if a is less than, equal to or greater than b */
+static inline int lh_span_cmp(lh_span a, lh_span b) {
+    int r = memcmp(a.ptr, b.ptr, (a.len < b.len) ? a.len : b.len);
+    return r ? r : (a.len > b.len) - (a.len < b.len);
+}
+
+/*! \brief Check if the span starts with the given prefix */
+static inline int lh_span_prefix(lh_span s, lh_span prefix) {
+    return s.len >= prefix.len && !memcmp(s.ptr, prefix.ptr, prefix.len);
+}
+
+/*! \brief Check if the span ends with the given suffix */
+static inline int lh_span_suffix(lh_span s, lh_span suffix) {
+    return s.len >= suffix.len && !memcmp(s.ptr+s.len-suffix.len, suffix.ptr, suffix.len);
+}
+
+/*! \brief Get a part of a span, clipped to its bounds
+ * \param from Offset of the part
+ * \param len Length of the part, -1 for the rest of the span */
+static inline lh_span lh_span_sub(lh_span s, ssize_t from, ssize_t len) {
+    if (from > s.len) from = s.len;
+    if (len < 0 || len > s.len-from) len = s.len-from;
+    return lh_span_make(s.ptr+from, len);
+}
+
+/*! \brief Split off the next token of a delimited span, like strsep.
+ * An empty span yields one empty token, n delimiters yield n+1 tokens.
+ *
+ * EXAMPLE:
+ * lh_span s = lh_span_cstr("usr/local/bin"), tok;
+ * while (lh_span_split(&s, '/', &tok))
+ *     process(tok);
+ *
+ * \param s Remainder of the span, advanced past the token
+ * \param delim Delimiter byte
+ * \param tok Returns the token, without the delimiter
+ * \return 1 if a token was returned, 0 if the span is exhausted */
+static inline int lh_span_split(lh_span *s, uint8_t delim, lh_span *tok) {
+    if (s->len < 0) return 0;
+    const uint8_t *d = memchr(s->ptr, delim, s->len);
+    if (!d) {
+        *tok = *s;
+        s->ptr += s->len;
+        s->len = -1;            // the last token was taken
+        return 1;
+    }
+    *tok = lh_span_make(s->ptr, d-s->ptr);
+    s->len -= d+1-s->ptr;
+    s->ptr = d+1;
+    return 1;
+}
+
+/*! \brief Append spans joined with a separator to a resizable buffer.
+ * The result is NUL-terminated, the terminator is not counted in *lenp.
+ * \param bufp Pointer to the buffer variable
+ * \param lenp Pointer to the length variable
+ * \param gran Granularity of the buffer
+ * \param parts Spans to join
+ * \param n Number of spans
+ * \param sep Separator inserted between the spans
+ * \return Number of bytes appended */
+static inline ssize_t lh_span_join_g(uint8_t **bufp, ssize_t *lenp, int gran,
+                                     const lh_span *parts, int n, lh_span sep) {
+    ssize_t total = (n > 1) ? (n-1)*sep.len : 0;
+    int i;
+    for(i=0; i<n; i++) total += parts[i].len;
+
+    if (!*bufp || *lenp+total+1 > lh_align(*lenp,gran))
+        lh_resize(*bufp, lh_align(*lenp+total+1, gran));
+
+    uint8_t *p = *bufp+*lenp;
+    for(i=0; i<n; i++) {
+        if (i) {
+            memcpy(p, sep.ptr, sep.len);
+            p += sep.len;
+        }
+        memcpy(p, parts[i].ptr, parts[i].len);
+        p += parts[i].len;
+    }
+    *p = 0;
+    *lenp += total;
+    return total;
+}
+
+#define _lh_span_join(ptr,cnt,parts,n,sep)                              \
+    lh_span_join_g(&ptr,&cnt,LH_BUFPRINTF_GRAN,parts,n,sep)
+
+#define lh_span_join(...) _lh_span_join(__VA_ARGS__)
+
+////////////////////////////////////////////////////////////////////////////////
+/// Formatted output into resizable buffers
+
 #ifndef LH_BUFPRINTF_GRAN
 #define LH_BUFPRINTF_GRAN 256
 #endif
@@ -0,0 +1,463 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include "lh_utf8.h"
+#include "lh_cpu.h"
+
+#include <string.h>
+
+#define HIGHS 0x8080808080808080ULL
+
+////////////////////////////////////////////////////////////////////////////////
+/// Scalar implementations
+
+// Check a single non-ASCII sequence at p. Returns the sequence length,
+// or 0 if it is invalid or incomplete. Optionally returns the code point.
+static inline int lh_utf8_seq(const uint8_t *p, ssize_t len, uint32_t *cp) {
+    uint8_t c = p[0];
+    uint8_t lo=0x80, hi=0xbf;
+    int n;
+
+    if (c>=0xc2 && c<=0xdf) {
+        n = 2;
+    }
+    else if (c>=0xe0 && c<=0xef) {
+        n = 3;
+        if (c==0xe0) lo=0xa0; // overlong
+        if (c==0xed) hi=0x9f; // surrogates
+    }
+    else if (c>=0xf0 && c<=0xf4) {
+        n = 4;
+        if (c==0xf0) lo=0x90; // overlong
+        if (c==0xf4) hi=0x8f; // above U+10FFFF
+    }
+    else
+        return 0;
+
+    if (len < n) return 0;
+    if (p[1]<lo || p[1]>hi) return 0;
+
+    uint32_t v = c & (0x7f>>n);
+    int k;
+    for(k=1; k<n; k++) {
+        if ((p[k]&0xc0) != 0x80) return 0;
+        v = (v<<6) | (p[k]&0x3f);
+    }
+
+    if (cp) *cp = v;
+    return n;
+}
+
+static ssize_t lh_utf8_check_scalar(const uint8_t *p, ssize_t len) {
+    ssize_t i=0;
+    while (i<len) {
+        // skip ASCII 8 bytes at a time
+        if (i+8<=len) {
+            uint64_t w;
+            memcpy(&w, p+i, 8);
+            if (!(w&HIGHS)) {
+                i+=8;
+                continue;
+            }
+        }
+
+        if (p[i]<0x80) {
+            i++;
+            continue;
+        }
+
+        int n = lh_utf8_seq(p+i, len-i, NULL);
+        if (!n) break;
+        i += n;
+    }
+    return i;
+}
+
+static void lh_utf8_counts_scalar(const uint8_t *p, ssize_t len, ssize_t *ncp, ssize_t *n4) {
+    ssize_t i;
+    for(i=0; i<len; i++) {
+        *ncp += ((p[i]&0xc0) != 0x80);
+        *n4  += (p[i] >= 0xf0);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// SIMD implementations
+
+#ifdef HAVE_X86_SIMD
+
+/* Lookup-table validation (J. Keiser, D. Lemire: "Validating UTF-8 In Less
+   Than One Instruction Per Byte"). The high and low nibble of each byte and
+   the high nibble of the following byte are used to look up sets of error
+   classes. Any class present in all three lookups is an error. */
+
+#define U8_TOO_SHORT    (1<<0)  // lead byte not followed by a continuation
+#define U8_TOO_LONG     (1<<1)  // ASCII followed by a continuation
+#define U8_OVERLONG_3   (1<<2)
+#define U8_TOO_LARGE    (1<<3)  // above U+10FFFF
+#define U8_SURROGATE    (1<<4)
+#define U8_OVERLONG_2   (1<<5)
+#define U8_TOO_LARGE_1000 (1<<6)
+#define U8_OVERLONG_4   (1<<6)
+#define U8_TWO_CONTS    (1<<7)  // continuation following a continuation
+#define U8_CARRY        (U8_TOO_SHORT|U8_TOO_LONG|U8_TWO_CONTS)
+
+static const uint8_t u8_byte1_high[16] = {
+    U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG,
+    U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG,
+    U8_TWO_CONTS, U8_TWO_CONTS, U8_TWO_CONTS, U8_TWO_CONTS,
+    U8_TOO_SHORT | U8_OVERLONG_2,
+    U8_TOO_SHORT,
+    U8_TOO_SHORT | U8_OVERLONG_3 | U8_SURROGATE,
+    U8_TOO_SHORT | U8_TOO_LARGE | U8_TOO_LARGE_1000 | U8_OVERLONG_4,
+};
+
+static const uint8_t u8_byte1_low[16] = {
+    U8_CARRY | U8_OVERLONG_3 | U8_OVERLONG_2 | U8_OVERLONG_4,
+    U8_CARRY | U8_OVERLONG_2,
+    U8_CARRY,
+    U8_CARRY,
+    U8_CARRY | U8_TOO_LARGE,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000 | U8_SURROGATE,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+};
+
+static const uint8_t u8_byte2_high[16] = {
+    U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT,
+    U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT,
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_OVERLONG_3 | U8_TOO_LARGE_1000 | U8_OVERLONG_4,
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_OVERLONG_3 | U8_TOO_LARGE,
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_SURROGATE  | U8_TOO_LARGE,
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_SURROGATE  | U8_TOO_LARGE,
+    U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT,
+};
+
+LH_TARGET("ssse3")
+static int lh_utf8_valid_ssse3(const uint8_t *p, ssize_t len) {
+    const __m128i t1h = _mm_loadu_si128((const __m128i *)u8_byte1_high);
+    const __m128i t1l = _mm_loadu_si128((const __m128i *)u8_byte1_low);
+    const __m128i t2h = _mm_loadu_si128((const __m128i *)u8_byte2_high);
+    const __m128i nib = _mm_set1_epi8(0x0f);
+
+    // the last three bytes of a block must not start a sequence that
+    // does not fit into the block
+    const __m128i maxv = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+                                       0xef, 0xdf, 0xbf);
+
+    __m128i prev = _mm_setzero_si128();
+    __m128i incomplete = _mm_setzero_si128();
+    __m128i error = _mm_setzero_si128();
+    ssize_t i;
+
+    for(i=0; i<len; i+=16) {
+        __m128i in;
+        if (i+16 <= len) {
+            in = _mm_loadu_si128((const __m128i *)(p+i));
+        }
+        else {
+            // pad the last block with zeros, these will catch a truncated sequence
+            uint8_t tmp[16] = { 0 };
+            memcpy(tmp, p+i, len-i);
+            in = _mm_loadu_si128((const __m128i *)tmp);
+        }
+
+        if (!_mm_movemask_epi8(in)) {
+            // ASCII block - only a sequence cut at the previous block is an error
+            error = _mm_or_si128(error, incomplete);
+        }
+        else {
+            __m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+            __m128i b1h = _mm_shuffle_epi8(t1h, _mm_and_si128(_mm_srli_epi16(prev1, 4), nib));
+            __m128i b1l = _mm_shuffle_epi8(t1l, _mm_and_si128(prev1, nib));
+            __m128i b2h = _mm_shuffle_epi8(t2h, _mm_and_si128(_mm_srli_epi16(in, 4), nib));
+            __m128i sc  = _mm_and_si128(_mm_and_si128(b1h, b1l), b2h);
+
+            // third and fourth bytes of 3 and 4-byte sequences must be continuations
+            __m128i prev2 = _mm_alignr_epi8(in, prev, 14);
+            __m128i prev3 = _mm_alignr_epi8(in, prev, 13);
+            __m128i must23 = _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(0xe0-0x80)),
+                                          _mm_subs_epu8(prev3, _mm_set1_epi8(0xf0-0x80)));
+            __m128i must23_80 = _mm_and_si128(must23, _mm_set1_epi8(0x80));
+
+            error = _mm_or_si128(error, _mm_xor_si128(must23_80, sc));
+            incomplete = _mm_subs_epu8(in, maxv);
+        }
+        prev = in;
+    }
+
+    error = _mm_or_si128(error, incomplete);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xffff;
+}
+
+LH_TARGET("avx2")
+static inline __m256i lh_prev_avx2(__m256i in, __m256i prev, const int n) {
+    // the previous bytes of in, shifted across the 128-bit lane boundary
+    __m256i cross = _mm256_permute2x128_si256(prev, in, 0x21);
+    switch (n) {
+        case 1: return _mm256_alignr_epi8(in, cross, 15);
+        case 2: return _mm256_alignr_epi8(in, cross, 14);
+        default: return _mm256_alignr_epi8(in, cross, 13);
+    }
+}
+
+LH_TARGET("avx2")
+static int lh_utf8_valid_avx2(const uint8_t *p, ssize_t len) {
+    const __m256i t1h = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)u8_byte1_high));
+    const __m256i t1l = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)u8_byte1_low));
+    const __m256i t2h = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)u8_byte2_high));
+    const __m256i nib = _mm256_set1_epi8(0x0f);
+    const __m256i maxv = _mm256_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+                                          -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+                                          0xef, 0xdf, 0xbf);
+
+    __m256i prev = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    __m256i error = _mm256_setzero_si256();
+    ssize_t i;
+
+    for(i=0; i<len; i+=32) {
+        __m256i in;
+        if (i+32 <= len) {
+            in = _mm256_loadu_si256((const __m256i *)(p+i));
+        }
+        else {
+            uint8_t tmp[32] = { 0 };
+            memcpy(tmp, p+i, len-i);
+            in = _mm256_loadu_si256((const __m256i *)tmp);
+        }
+
+        if (!_mm256_movemask_epi8(in)) {
+            error = _mm256_or_si256(error, incomplete);
+        }
+        else {
+            __m256i prev1 = lh_prev_avx2(in, prev, 1);
+            __m256i b1h = _mm256_shuffle_epi8(t1h, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nib));
+            __m256i b1l = _mm256_shuffle_epi8(t1l, _mm256_and_si256(prev1, nib));
+            __m256i b2h = _mm256_shuffle_epi8(t2h, _mm256_and_si256(_mm256_srli_epi16(in, 4), nib));
+            __m256i sc  = _mm256_and_si256(_mm256_and_si256(b1h, b1l), b2h);
+
+            __m256i prev2 = lh_prev_avx2(in, prev, 2);
+            __m256i prev3 = lh_prev_avx2(in, prev, 3);
+            __m256i must23 = _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8(0xe0-0x80)),
+                                             _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xf0-0x80)));
+            __m256i must23_80 = _mm256_and_si256(must23, _mm256_set1_epi8(0x80));
+
+            error = _mm256_or_si256(error, _mm256_xor_si256(must23_80, sc));
+            incomplete = _mm256_subs_epu8(in, maxv);
+        }
+        prev = in;
+    }
+
+    error = _mm256_or_si256(error, incomplete);
+    return _mm256_testz_si256(error, error);
+}
+
+LH_TARGET("sse2")
+static void lh_utf8_counts_sse2(const uint8_t *p, ssize_t len, ssize_t *ncp, ssize_t *n4) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i contlim = _mm_set1_epi8(-64);  // 0xc0
+    const __m128i lead4 = _mm_set1_epi8(-17);    // 0xef
+    __m128i tcont = zero, tlead = zero;
+    ssize_t i=0;
+
+    while (i+16<=len) {
+        __m128i acont = zero, alead = zero;
+        int n;
+        for(n=0; n<255 && i+16<=len; n++, i+=16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(p+i));
+            // continuations are 0x80..0xbf, i.e. signed -128..-65
+            acont = _mm_sub_epi8(acont, _mm_cmpgt_epi8(contlim, v));
+            // 4-byte leads are 0xf0..0xff, i.e. signed -16..-1
+            alead = _mm_sub_epi8(alead, _mm_and_si128(_mm_cmpgt_epi8(v, lead4),
+                                                      _mm_cmplt_epi8(v, zero)));
+        }
+        tcont = _mm_add_epi64(tcont, _mm_sad_epu8(acont, zero));
+        tlead = _mm_add_epi64(tlead, _mm_sad_epu8(alead, zero));
+    }
+
+    ssize_t ncont = _mm_cvtsi128_si64(tcont) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(tcont, tcont));
+    *ncp += i - ncont;
+    *n4  += _mm_cvtsi128_si64(tlead) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(tlead, tlead));
+    lh_utf8_counts_scalar(p+i, len-i, ncp, n4);
+}
+
+// widen the leading ASCII part of p to UTF-16, 16 characters at a time.
+// The whole block is stored even if only a part of it is ASCII, the rest
+// is overwritten by the caller.
+LH_TARGET("sse2")
+static ssize_t lh_ascii_widen_sse2(const uint8_t *p, ssize_t len, uint16_t *out) {
+    const __m128i zero = _mm_setzero_si128();
+    ssize_t i=0;
+    for(; i+16<=len; i+=16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p+i));
+        _mm_storeu_si128((__m128i *)(out+i),   _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128((__m128i *)(out+i+8), _mm_unpackhi_epi8(v, zero));
+        int m = _mm_movemask_epi8(v);
+        if (m) return i+__builtin_ctz(m);
+    }
+    return i;
+}
+
+// narrow the leading ASCII part of p to UTF-8, 16 characters at a time
+LH_TARGET("sse2")
+static ssize_t lh_ascii_narrow_sse2(const uint16_t *p, ssize_t len, uint8_t *out) {
+    const __m128i mask = _mm_set1_epi16((short)0xff80);
+    const __m128i zero = _mm_setzero_si128();
+    ssize_t i=0;
+    for(; i+16<=len; i+=16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(p+i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(p+i+8));
+        _mm_storeu_si128((__m128i *)(out+i), _mm_packus_epi16(a, b));
+        __m128i asc = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_and_si128(a, mask), zero),
+                                      _mm_cmpeq_epi16(_mm_and_si128(b, mask), zero));
+        int m = _mm_movemask_epi8(asc);
+        if (m != 0xffff) return i+__builtin_ctz(~m);
+    }
+    return i;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+int lh_utf8_valid(const uint8_t *p, ssize_t len) {
+    if (len <= 0) return 1;
+#ifdef HAVE_X86_SIMD
+    if (lh_cpu_has(LH_CPU_AVX2))  return lh_utf8_valid_avx2(p, len);
+    if (lh_cpu_has(LH_CPU_SSSE3)) return lh_utf8_valid_ssse3(p, len);
+#endif
+    return lh_utf8_check_scalar(p, len) == len;
+}
+
+ssize_t lh_utf8_check(const uint8_t *p, ssize_t len) {
+    if (len <= 0) return 0;
+
+    // the vectorized check is faster, but does not tell the error position
+    if (lh_utf8_valid(p, len)) return len;
+    return lh_utf8_check_scalar(p, len);
+}
+
+ssize_t lh_utf8_count(const uint8_t *p, ssize_t len) {
+    ssize_t ncp=0, n4=0;
+    if (len <= 0) return 0;
+#ifdef HAVE_X86_SIMD
+    if (lh_cpu_has(LH_CPU_SSE2)) {
+        lh_utf8_counts_sse2(p, len, &ncp, &n4);
+        return ncp;
+    }
+#endif
+    lh_utf8_counts_scalar(p, len, &ncp, &n4);
+    return ncp;
+}
+
+ssize_t lh_utf8_utf16_len(const uint8_t *p, ssize_t len) {
+    ssize_t ncp=0, n4=0;
+    if (len <= 0) return 0;
+#ifdef HAVE_X86_SIMD
+    if (lh_cpu_has(LH_CPU_SSE2)) {
+        lh_utf8_counts_sse2(p, len, &ncp, &n4);
+        return ncp+n4;
+    }
+#endif
+    lh_utf8_counts_scalar(p, len, &ncp, &n4);
+    return ncp+n4;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ssize_t lh_utf8_to_utf16(const uint8_t *p, ssize_t len, uint16_t *out) {
+    ssize_t i=0, o=0;
+#ifdef HAVE_X86_SIMD
+    int simd = lh_cpu_has(LH_CPU_SSE2);
+#endif
+
+    while (i<len) {
+#ifdef HAVE_X86_SIMD
+        if (simd && p[i] < 0x80) {
+            ssize_t n = lh_ascii_widen_sse2(p+i, len-i, out+o);
+            i += n;
+            o += n;
+            if (i>=len) break;
+        }
+#endif
+        if (p[i] < 0x80) {
+            out[o++] = p[i++];
+            continue;
+        }
+
+        uint32_t cp;
+        int n = lh_utf8_seq(p+i, len-i, &cp);
+        if (!n) return -1;
+        i += n;
+
+        if (cp < 0x10000) {
+            out[o++] = cp;
+        }
+        else {
+            cp -= 0x10000;
+            out[o++] = 0xd800 | (cp>>10);
+            out[o++] = 0xdc00 | (cp&0x3ff);
+        }
+    }
+
+    return o;
+}
+
+ssize_t lh_utf16_to_utf8(const uint16_t *p, ssize_t len, uint8_t *out) {
+    ssize_t i=0, o=0;
+#ifdef HAVE_X86_SIMD
+    int simd = lh_cpu_has(LH_CPU_SSE2);
+#endif
+
+    while (i<len) {
+#ifdef HAVE_X86_SIMD
+        if (simd && p[i] < 0x80) {
+            ssize_t n = lh_ascii_narrow_sse2(p+i, len-i, out+o);
+            i += n;
+            o += n;
+            if (i>=len) break;
+        }
+#endif
+        uint32_t cp = p[i++];
+
+        if (cp < 0x80) {
+            out[o++] = cp;
+        }
+        else if (cp < 0x800) {
+            out[o++] = 0xc0 | (cp>>6);
+            out[o++] = 0x80 | (cp&0x3f);
+        }
+        else if (cp < 0xd800 || cp > 0xdfff) {
+            out[o++] = 0xe0 | (cp>>12);
+            out[o++] = 0x80 | ((cp>>6)&0x3f);
+            out[o++] = 0x80 | (cp&0x3f);
+        }
+        else {
+            // surrogate pair
+            if (cp > 0xdbff || i>=len || p[i]<0xdc00 || p[i]>0xdfff) return -1;
+            cp = 0x10000 + (((cp&0x3ff)<<10) | (p[i++]&0x3ff));
+            out[o++] = 0xf0 | (cp>>18);
+            out[o++] = 0x80 | ((cp>>12)&0x3f);
+            out[o++] = 0x80 | ((cp>>6)&0x3f);
+            out[o++] = 0x80 | (cp&0x3f);
+        }
+    }
+
+    return o;
+}
@@ -0,0 +1,63 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+/*! \file
+ * UTF-8 validation, counting and UTF-8/UTF-16 transcoding
+ *
+ * Validation follows the Unicode definition of well-formed UTF-8, i.e.
+ * overlong forms, surrogates and code points above U+10FFFF are rejected.
+ * The SIMD validator is the lookup-table algorithm by Keiser and Lemire;
+ * the transcoders have vectorized ASCII fast paths.
+ * UTF-16 is handled in host byte order.
+ */
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Check if data is valid UTF-8
+ * \param p Data to check
+ * \param len Length of data
+ * \return 1 if valid, 0 if not */
+int lh_utf8_valid(const uint8_t *p, ssize_t len);
+
+/*! \brief Find the longest valid UTF-8 prefix.
+ * An incomplete sequence at the end is not included, so for chunked data
+ * the remaining bytes can be kept and prepended to the next chunk.
+ * \param p Data to check
+ * \param len Length of data
+ * \return Length of the valid prefix, len if all data is valid */
+ssize_t lh_utf8_check(const uint8_t *p, ssize_t len);
+
+/*! \brief Count code points in valid UTF-8 data
+ * \return Number of code points */
+ssize_t lh_utf8_count(const uint8_t *p, ssize_t len);
+
+/*! \brief Number of UTF-16 code units needed to encode valid UTF-8 data */
+ssize_t lh_utf8_utf16_len(const uint8_t *p, ssize_t len);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/*! \brief Convert UTF-8 to UTF-16
+ * \param p UTF-8 data
+ * \param len Length of UTF-8 data in bytes
+ * \param out Output buffer, must have space for at least len code units
+ * \return Number of UTF-16 code units written, -1 if input is not valid UTF-8 */
+ssize_t lh_utf8_to_utf16(const uint8_t *p, ssize_t len, uint16_t *out);
+
+/*! \brief Convert UTF-16 to UTF-8
+ * \param p UTF-16 data
+ * \param len Length of UTF-16 data in code units
+ * \param out Output buffer, must have space for at least 3*len bytes
+ * \return Number of bytes written, -1 if input contains unpaired surrogates */
+ssize_t lh_utf16_to_utf8(const uint16_t *p, ssize_t len, uint8_t *out);
@@ -0,0 +1,206 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_bits : bit streams, bit-packed and frame-of-reference arrays, time series
+*/
+
+#include "lhbench.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <lh_arr.h>
+#include <lh_cpu.h>
+#include <lh_bits.h>
+
+// as many values as the block states of a chunk section
+#define NVAL 4096
+#define NSEC 64
+
+static uint8_t packed[NSEC*NVAL*4];
+static uint32_t vals[NVAL];
+static uint16_t vals16[NVAL];
+
+static int unpack32(int bits, int flags) {
+    ssize_t size = lh_bits_size(NVAL, bits, flags);
+    int s;
+    for(s=0; s<NSEC; s++)
+        lh_bits_unpack32(vals, NVAL, packed+s*size, size, bits, flags);
+    return vals[NVAL-1];
+}
+
+static int unpack16(int bits, int flags) {
+    ssize_t size = lh_bits_size(NVAL, bits, flags);
+    int s;
+    for(s=0; s<NSEC; s++)
+        lh_bits_unpack16(vals16, NVAL, packed+s*size, size, bits, flags);
+    return vals16[NVAL-1];
+}
+
+// the same with a bit reader, one value at a time
+static int bitreader(int bits) {
+    ssize_t size = lh_bits_size(NVAL, bits, 0);
+    lh_bitreader r;
+    int i;
+    lh_bitreader_init(&r, packed, size*NSEC);
+    for(i=0; i<NVAL*NSEC; i++)
+        vals[i&(NVAL-1)] = lh_bitreader_get(&r, bits);
+    return vals[NVAL-1];
+}
+
+BF(bits, "unpacking chunk sections of 4096 values") {
+    int i;
+    for(i=0; i<sizeof(packed); i++) packed[i] = rand();
+
+    BENCH_RATE("bit reader, 5 bits", NVAL*NSEC*4, 200, bitreader(5));
+
+    lh_cpu_restrict(0);
+    BENCH_RATE("scalar unpack32, 5 bits", NVAL*NSEC*4, 200, unpack32(5, 0));
+    BENCH_RATE("scalar unpack32, 5 bits padded", NVAL*NSEC*4, 200, unpack32(5, LH_BITS_PADDED));
+    BENCH_RATE("scalar unpack16, 4 bits", NVAL*NSEC*2, 200, unpack16(4, 0));
+    lh_cpu_restrict(-1);
+
+    BENCH_RATE("unpack32, 5 bits", NVAL*NSEC*4, 200, unpack32(5, 0));
+    BENCH_RATE("unpack32, 5 bits padded", NVAL*NSEC*4, 200, unpack32(5, LH_BITS_PADDED));
+    BENCH_RATE("unpack32, 9 bits padded", NVAL*NSEC*4, 200, unpack32(9, LH_BITS_PADDED));
+    BENCH_RATE("unpack32, 17 bits", NVAL*NSEC*4, 200, unpack32(17, 0));
+    BENCH_RATE("unpack16, 4 bits", NVAL*NSEC*2, 200, unpack16(4, 0));
+    BENCH_RATE("unpack16, 6 bits padded", NVAL*NSEC*2, 200, unpack16(6, LH_BITS_PADDED));
+} _BF
+
+#define NIDS (1<<20)
+
+static uint32_t ids[NIDS], out[NIDS];
+static uint8_t raw[NIDS*4];
+static lh_buf_t fbuf;
+
+static int for_encode(int flags) {
+    C(fbuf.data) = 0;
+    return lh_buf_put_for_array(&fbuf, ids, NIDS, flags);
+}
+
+static int for_decode() {
+    lh_for_array a;
+    uint8_t *p = P(fbuf.data);
+    lh_lread_for_array(p, P(fbuf.data)+C(fbuf.data), a);
+    lh_for_decode(&a, out);
+    return out[NIDS-1];
+}
+
+// single values at random positions
+static int for_get_random() {
+    lh_for_array a;
+    uint8_t *p = P(fbuf.data);
+    uint32_t sum = 0, r = 12345;
+    int i;
+    lh_lread_for_array(p, P(fbuf.data)+C(fbuf.data), a);
+    for(i=0; i<4096; i++) {
+        r = r*1103515245+12345;
+        sum += lh_for_get(&a, (r>>8)%NIDS);
+    }
+    return sum;
+}
+
+// the raw serialization it replaces
+static int raw_decode() {
+    uint8_t *p = raw;
+    int i;
+    for(i=0; i<NIDS; i++) out[i] = lh_read_int_be(p);
+    return out[NIDS-1];
+}
+
+BF(for_array, "frame-of-reference arrays of 1M sorted IDs") {
+    uint32_t x = 1000;
+    int i;
+    for(i=0; i<NIDS; i++) ids[i] = x += 1+rand()%20;
+    lh_clear_obj(fbuf);
+
+    printf("size: raw %d, FOR %d, FOR+delta %d bytes\n",
+           NIDS*4, for_encode(0), for_encode(LH_FOR_DELTA));
+
+    BENCH_RATE("encode FOR+delta", NIDS*4, 50, for_encode(LH_FOR_DELTA));
+    BENCH_RATE("decode FOR+delta", NIDS*4, 200, for_decode());
+    lh_cpu_restrict(0);
+    BENCH_RATE("decode FOR+delta, scalar", NIDS*4, 200, for_decode());
+    lh_cpu_restrict(-1);
+    BENCH_RATE("encode FOR", NIDS*4, 50, for_encode(0));
+    BENCH_RATE("decode FOR", NIDS*4, 200, for_decode());
+    BENCH_TIME("lh_for_get, 4096 random values", 2000, for_get_random());
+
+    uint8_t *p = raw;
+    for(i=0; i<NIDS; i++) lh_write_int_be(p, ids[i]);
+    BENCH_RATE("decode raw lh_read_int_be", NIDS*4, 200, raw_decode());
+
+    lh_arr_free(AR(fbuf.data));
+} _BF
+
+#define NPTS (1<<18)
+
+static int64_t pts_t[NPTS];
+static double pts_v[NPTS];
+static lh_buf_t sbuf;
+
+static int series_encode() {
+    lh_series_writer sw;
+    int i;
+    C(sbuf.data) = 0;
+    lh_series_writer_init(&sw, &sbuf);
+    for(i=0; i<NPTS; i++) lh_series_put(&sw, pts_t[i], pts_v[i]);
+    return lh_series_finish(&sw);
+}
+
+static int series_decode() {
+    lh_series_reader sr;
+    int64_t t;
+    double v, sum = 0;
+    lh_series_reader_init(&sr, P(sbuf.data), C(sbuf.data));
+    while (lh_series_next(&sr, &t, &v)) sum += v;
+    return (int)sum;
+}
+
+// the raw serialization it replaces
+static int raw_encode() {
+    uint8_t *p = raw;
+    int i;
+    for(i=0; i<NPTS; i++) {
+        lh_write_long_be(p, pts_t[i]);
+        lh_write_double_be(p, pts_v[i]);
+    }
+    return p-raw;
+}
+
+BF(series, "time series of 256K latency samples") {
+    int64_t t = 1400000000000LL;
+    int i;
+    for(i=0; i<NPTS; i++) {
+        // 1s intervals, mostly on time, latencies in 0.1ms steps
+        pts_t[i] = t += 1000+(rand()%10==0 ? rand()%5 : 0);
+        pts_v[i] = (i%4 == 0) ? (rand()%300)/10.0 : pts_v[i ? i-1 : 0];
+    }
+    lh_clear_obj(sbuf);
+
+    printf("size: raw %d, compressed %d bytes\n", NPTS*16, series_encode());
+
+    BENCH_RATE("encode raw lh_write_*_be", NPTS*16, 200, raw_encode());
+    BENCH_RATE("encode series", NPTS*16, 200, series_encode());
+    BENCH_RATE("decode series", NPTS*16, 200, series_decode());
+
+    lh_arr_free(AR(sbuf.data));
+} _BF
+
+////////////////////////////////////////////////////////////////////////////////
+
+BM(bits) {
+
+    BENCH(bits);
+    BENCH(for_array);
+    BENCH(series);
+
+} _BM;
@@ -0,0 +1,624 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_bytes : byteorder operations, object serialization
+*/
+
+#include "lhbench.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <lh_cpu.h>
+#include <lh_bytes.h>
+
+#define N (1<<16)
+
+static uint8_t src[N*8];
+static uint8_t dst[N*8];
+
+static int read_int_be() {
+    uint8_t *p = src;
+    uint32_t *d = (uint32_t *)dst;
+    int i;
+    for(i=0; i<N; i++) d[i] = lh_read_int_be(p);
+    return d[N-1];
+}
+
+static int read_double_be() {
+    uint8_t *p = src;
+    double *d = (double *)dst;
+    int i;
+    for(i=0; i<N; i++) d[i] = lh_read_double_be(p);
+    return d[N-1] > 0;
+}
+
+BF(bswap, "converting big-endian arrays") {
+    static const struct { int mask; const char *name; } levels[] = {
+        { 0,                        "scalar" },
+        { LH_CPU_SSE2|LH_CPU_SSSE3, "SSSE3" },
+        { -1,                       "AVX2" },
+    };
+    int i, l;
+    char label[64];
+    for(i=0; i<sizeof(src); i++) src[i] = i*7;
+
+    BENCH_RATE("memcpy", sizeof(src), 2000, (memcpy(dst, src, sizeof(src)), dst[5]));
+    BENCH_RATE("lh_read_int_be loop", sizeof(src)/2, 2000, read_int_be());
+    BENCH_RATE("lh_read_double_be loop", sizeof(src), 2000, read_double_be());
+
+    for(l=0; l<sizeof(levels)/sizeof(levels[0]); l++) {
+        lh_cpu_restrict(levels[l].mask);
+        sprintf(label, "lh_conv_be_short %s", levels[l].name);
+        BENCH_RATE(label, sizeof(src), 2000, (lh_conv_be_short(dst, src, N*4), dst[5]));
+        sprintf(label, "lh_conv_be_int %s", levels[l].name);
+        BENCH_RATE(label, sizeof(src), 2000, (lh_conv_be_int(dst, src, N*2), dst[5]));
+        sprintf(label, "lh_conv_be_double %s", levels[l].name);
+        BENCH_RATE(label, sizeof(src), 2000, (lh_conv_be_double(dst, src, N), dst[5]));
+        sprintf(label, "lh_ibswap_array_int %s", levels[l].name);
+        BENCH_RATE(label, sizeof(src), 2000, (lh_ibswap_array_int(dst, N*2), dst[5]));
+    }
+    lh_cpu_restrict(-1);
+} _BF
+
+#define NV (1<<16)
+
+static uint32_t vals[NV];
+static uint64_t vals64[NV];
+static uint8_t venc[NV*10];
+static uint8_t *vend;
+
+static int read_varint_loop() {
+    uint8_t *p = venc;
+    int i;
+    for(i=0; i<NV; i++) vals[i] = lh_read_varint(p);
+    return vals[NV-1];
+}
+
+static int lread_varint_loop() {
+    uint8_t *p = venc;
+    int i;
+    for(i=0; i<NV; i++) lh_lread_varint(p, vend, vals[i]);
+    return vals[NV-1];
+}
+
+static int lread_varint_array() {
+    uint8_t *p = venc;
+    return lh_lread_varint_array(p, vend, vals, NV);
+}
+
+static int lread_varlong_array() {
+    uint8_t *p = venc;
+    return lh_lread_varlong_array(p, vend, vals64, NV);
+}
+
+BF(varint, "decoding varints") {
+    static const int maxbits[] = { 7, 14, 28 };
+    int b, i;
+
+    for(b=0; b<sizeof(maxbits)/sizeof(maxbits[0]); b++) {
+        uint8_t *p = venc;
+        srand(36);
+        for(i=0; i<NV; i++) {
+            // mostly small values, as in typical packets
+            int bits = rand()%(maxbits[b]+1);
+            lh_write_varint(p, rand()&((1u<<bits)-1));
+        }
+        vend = p;
+        printf("-- up to %d bits, %.2f bytes per value\n", maxbits[b], (double)(vend-venc)/NV);
+
+        BENCH_RATE("lh_read_varint loop", NV*4, 500, read_varint_loop());
+        BENCH_RATE("lh_lread_varint loop", NV*4, 500, lread_varint_loop());
+        lh_cpu_restrict(0);
+        BENCH_RATE("lh_lread_varint_array scalar", NV*4, 500, lread_varint_array());
+        lh_cpu_restrict(-1);
+        BENCH_RATE("lh_lread_varint_array SSSE3", NV*4, 500, lread_varint_array());
+        BENCH_RATE("lh_lread_varlong_array SSSE3", NV*4, 500, lread_varlong_array());
+    }
+} _BF
+
+static int put_varint_loop(lh_buf_t *b) {
+    C(b->data) = 0;
+    int i;
+    for(i=0; i<NV; i++) {
+        uint8_t *p = lh_arr_add(GAR4(b->data), lh_varint_size(vals[i]));
+        lh_place_varint(p, vals[i]);
+    }
+    return C(b->data);
+}
+
+static int put_varint_array(lh_buf_t *b, int flags) {
+    C(b->data) = 0;
+    return lh_buf_put_varint_array(b, vals, NV, flags);
+}
+
+static int put_varlong_array(lh_buf_t *b, int flags) {
+    C(b->data) = 0;
+    return lh_buf_put_varlong_array(b, vals64, NV, flags);
+}
+
+BF(varint_encode, "encoding varint arrays") {
+    lh_buf_t b;
+    lh_clear_obj(b);
+    int i;
+
+    // sorted IDs with small gaps
+    srand(37);
+    vals[0] = vals64[0] = 1000000;
+    for(i=1; i<NV; i++) vals64[i] = vals[i] = vals[i-1]+1+rand()%300;
+
+    BENCH_RATE("lh_place_varint loop", NV*4, 500, put_varint_loop(&b));
+    lh_cpu_restrict(0);
+    BENCH_RATE("put_varint_array scalar", NV*4, 500, put_varint_array(&b, 0));
+    lh_cpu_restrict(-1);
+    BENCH_RATE("put_varint_array", NV*4, 500, put_varint_array(&b, 0));
+    BENCH_RATE("put_varint_array DELTA", NV*4, 500, put_varint_array(&b, LH_VARINT_DELTA));
+    BENCH_RATE("put_varlong_array", NV*8, 500, put_varlong_array(&b, 0));
+    BENCH_RATE("put_varlong_array DELTA|ZIGZAG", NV*8, 500,
+               put_varlong_array(&b, LH_VARINT_DELTA|LH_VARINT_ZIGZAG));
+    printf("%d bytes plain, %d bytes delta\n",
+           put_varint_array(&b, 0), put_varint_array(&b, LH_VARINT_DELTA));
+    lh_arr_free(AR(b.data));
+} _BF
+
+// records of 30 fields: 10 ints, 10 shorts and 10 doubles
+#define NREC 8192
+#define RECSIZE 140
+
+static uint8_t recs[NREC*RECSIZE];
+
+typedef struct {
+    uint32_t i[10];
+    uint16_t s[10];
+    double d[10];
+} record;
+
+static record out[NREC];
+
+static int parse_lread() {
+    uint8_t *p = recs, *l = recs+sizeof(recs);
+    int n, k;
+    for(n=0; n<NREC; n++) {
+        record *o = out+n;
+        for(k=0; k<10; k++) {
+            if (!lh_lread_int_be(p, l, o->i[k])) return -1;
+            if (!lh_lread_short_be(p, l, o->s[k])) return -1;
+            if (!lh_lread_double_be(p, l, o->d[k])) return -1;
+        }
+    }
+    return n;
+}
+
+static int parse_reader() {
+    lh_reader r;
+    lh_reader_init(&r, recs, sizeof(recs));
+    int n, k;
+    for(n=0; n<NREC; n++) {
+        record *o = out+n;
+        for(k=0; k<10; k++) {
+            o->i[k] = lh_reader_int_be(&r);
+            o->s[k] = lh_reader_short_be(&r);
+            o->d[k] = lh_reader_double_be(&r);
+        }
+    }
+    return r.error ? -1 : n;
+}
+
+static int parse_reader_need() {
+    lh_reader r;
+    lh_reader_init(&r, recs, sizeof(recs));
+    int n, k;
+    for(n=0; n<NREC && lh_reader_need(&r, RECSIZE); n++) {
+        record *o = out+n;
+        for(k=0; k<10; k++) {
+            o->i[k] = lh_reader_int_be_u(&r);
+            o->s[k] = lh_reader_short_be_u(&r);
+            o->d[k] = lh_reader_double_be_u(&r);
+        }
+    }
+    return r.error ? -1 : n;
+}
+
+BF(reader, "parsing records") {
+    int i;
+    for(i=0; i<sizeof(recs); i++) recs[i] = i*13;
+
+    BENCH_RATE("lh_lread_* per field", sizeof(recs), 1000, parse_lread());
+    BENCH_RATE("lh_reader checked", sizeof(recs), 1000, parse_reader());
+    BENCH_RATE("lh_reader_need + unchecked", sizeof(recs), 1000, parse_reader_need());
+} _BF
+
+// each record is built as a message in a reused send buffer
+
+static lh_buf_t wbuf;
+
+static int build_lwrite() {
+    // a presized buffer and a check per field
+    int n, k, total = 0;
+    for(n=0; n<NREC; n++) {
+        record *o = out+n;
+        uint8_t *p = P(wbuf.data), *l = p+C(wbuf.data);
+        for(k=0; k<10; k++) {
+            if (!lh_lwrite_int_be(p, l, o->i[k])) return -1;
+            if (!lh_lwrite_short_be(p, l, o->s[k])) return -1;
+            if (!lh_lwrite_double_be(p, l, o->d[k])) return -1;
+        }
+        total += p-P(wbuf.data);
+    }
+    return total;
+}
+
+static int build_writer() {
+    int n, k, total = 0;
+    lh_writer w;
+    lh_writer_init(&w, &wbuf);
+    for(n=0; n<NREC; n++) {
+        record *o = out+n;
+        lh_writer_reset(&w);
+        for(k=0; k<10; k++) {
+            lh_writer_int_be(&w, o->i[k]);
+            lh_writer_short_be(&w, o->s[k]);
+            lh_writer_double_be(&w, o->d[k]);
+        }
+        total += lh_writer_finish(&w);
+    }
+    return total;
+}
+
+static int build_writer_reserve() {
+    int n, k, total = 0;
+    lh_writer w;
+    lh_writer_init(&w, &wbuf);
+    for(n=0; n<NREC; n++) {
+        record *o = out+n;
+        lh_writer_reset(&w);
+        lh_writer_reserve(&w, RECSIZE);
+        for(k=0; k<10; k++) {
+            lh_writer_int_be_u(&w, o->i[k]);
+            lh_writer_short_be_u(&w, o->s[k]);
+            lh_writer_double_be_u(&w, o->d[k]);
+        }
+        total += lh_writer_finish(&w);
+    }
+    return total;
+}
+
+static int build_writer_varlen() {
+    int n, k, total = 0;
+    lh_writer w;
+    lh_writer_init(&w, &wbuf);
+    for(n=0; n<NREC; n++) {
+        record *o = out+n;
+        lh_writer_reset(&w);
+        ssize_t len = lh_writer_begin_varlen(&w);
+        lh_writer_reserve(&w, RECSIZE);
+        for(k=0; k<10; k++) {
+            lh_writer_int_be_u(&w, o->i[k]);
+            lh_writer_short_be_u(&w, o->s[k]);
+            lh_writer_double_be_u(&w, o->d[k]);
+        }
+        lh_writer_end_varlen(&w, len);
+        total += lh_writer_finish(&w);
+    }
+    return total;
+}
+
+BF(writer, "building records") {
+    lh_clear_obj(wbuf);
+    lh_arr_add(GAR4(wbuf.data), RECSIZE);
+    parse_reader();
+
+    BENCH_RATE("lh_lwrite_* per field", sizeof(recs), 1000, build_lwrite());
+    BENCH_RATE("lh_writer checked", sizeof(recs), 1000, build_writer());
+    BENCH_RATE("lh_writer_reserve + unchecked", sizeof(recs), 1000, build_writer_reserve());
+    BENCH_RATE("... with varint length prefix", sizeof(recs), 1000, build_writer_varlen());
+    lh_arr_free(AR(wbuf.data));
+} _BF
+
+// messages of 8 strings, 4 to 40 bytes, varint-prefixed and NUL-terminated
+#define NMSG 8192
+#define NSTR 8
+
+static uint8_t smsg[NMSG*NSTR*42];
+static ssize_t slen;
+
+static struct {
+    char s[NSTR][48];
+} scopy[NMSG];
+
+static lh_span sspan[NMSG][NSTR];
+
+static int strings_copy() {
+    uint8_t *p = smsg;
+    int n, k, i;
+    for(n=0; n<NMSG; n++) {
+        for(k=0; k<NSTR; k++) {
+            // the old way: copy out byte by byte into a fixed field
+            uint32_t len = lh_read_varint(p);
+            for(i=0; i<len; i++) scopy[n].s[k][i] = lh_read_char(p);
+            scopy[n].s[k][i] = 0;
+        }
+    }
+    return p-smsg;
+}
+
+static int strings_lstring() {
+    lh_reader r;
+    lh_reader_init(&r, smsg, slen);
+    int n, k;
+    for(n=0; n<NMSG; n++)
+        for(k=0; k<NSTR; k++)
+            sspan[n][k] = lh_reader_lstring_varint(&r);
+    return r.error ? -1 : n;
+}
+
+static int strings_zstring() {
+    lh_reader r;
+    lh_reader_init(&r, smsg, slen);
+    int n, k;
+    for(n=0; n<NMSG; n++)
+        for(k=0; k<NSTR; k++)
+            sspan[n][k] = lh_reader_zstring(&r);
+    return r.error ? -1 : n;
+}
+
+static int strings_write() {
+    lh_writer w;
+    lh_writer_init(&w, &wbuf);
+    lh_writer_reset(&w);
+    int n, k;
+    for(n=0; n<NMSG; n++)
+        for(k=0; k<NSTR; k++)
+            lh_writer_lstring_varint(&w, sspan[n][k]);
+    return lh_writer_finish(&w);
+}
+
+BF(strings, "parsing string fields") {
+    int n, k, i;
+    uint8_t *p = smsg;
+    srand(41);
+    for(n=0; n<NMSG*NSTR; n++) {
+        uint8_t s[40];
+        int len = 4+rand()%37;
+        for(i=0; i<len; i++) s[i] = 'a'+rand()%26;
+        lh_write_lstring_varint(p, lh_span_make(s, len));
+    }
+    slen = p-smsg;
+
+    BENCH_RATE("copy byte by byte", slen, 200, strings_copy());
+    BENCH_RATE("lh_reader_lstring_varint", slen, 200, strings_lstring());
+    lh_clear_obj(wbuf);
+    BENCH_RATE("lh_writer_lstring_varint", slen, 200, strings_write());
+
+    // the same strings NUL-terminated
+    p = smsg;
+    for(n=0; n<NMSG; n++)
+        for(k=0; k<NSTR; k++) {
+            lh_span s = lh_span_make(scopy[n].s[k], strlen(scopy[n].s[k]));
+            lh_write_zstring(p, s);
+        }
+    slen = p-smsg;
+    BENCH_RATE("lh_reader_zstring", slen, 200, strings_zstring());
+    lh_arr_free(AR(wbuf.data));
+} _BF
+
+typedef struct {
+    float x, y, z;
+    float nx, ny, nz;
+    float tx, ty;
+} vertex;
+
+#define VERTEX(F) F(x,float_be) F(y,float_be) F(z,float_be) \
+    F(nx,float_be) F(ny,float_be) F(nz,float_be) F(tx,float_be) F(ty,float_be)
+lh_def_record(vertex, VERTEX)
+
+typedef struct {
+    uint8_t  kind;
+    uint16_t x;
+    uint32_t id;
+    double   t;
+} item;
+
+#define ITEM(F) F(kind,char) F(x,short_be) F(id,varint) F(t,double_be)
+lh_def_record(item, ITEM)
+
+#define NVTX (1<<15)
+
+static vertex vtx[NVTX];
+static item items[NVTX];
+static uint8_t venc2[NVTX*32];
+static ssize_t vlen;
+
+static int unpack_vertex_fields() {
+    uint8_t *p = venc2, *l = venc2+vlen;
+    int i;
+    for(i=0; i<NVTX; i++) {
+        vertex *v = vtx+i;
+        if (!lh_lread_float_be(p, l, v->x) || !lh_lread_float_be(p, l, v->y) ||
+            !lh_lread_float_be(p, l, v->z) || !lh_lread_float_be(p, l, v->nx) ||
+            !lh_lread_float_be(p, l, v->ny) || !lh_lread_float_be(p, l, v->nz) ||
+            !lh_lread_float_be(p, l, v->tx) || !lh_lread_float_be(p, l, v->ty)) break;
+    }
+    return i;
+}
+
+static int unpack_vertex_record() {
+    uint8_t *p = venc2;
+    return lh_record_unpack_vertex(&p, venc2+vlen, vtx, NVTX);
+}
+
+static int pack_vertex_record() {
+    C(wbuf.data) = 0;
+    return lh_record_pack_vertex(&wbuf, vtx, NVTX);
+}
+
+static int unpack_item_fields() {
+    uint8_t *p = venc2, *l = venc2+vlen;
+    int i;
+    for(i=0; i<NVTX; i++) {
+        item *v = items+i;
+        if (!lh_lread_char(p, l, v->kind) || !lh_lread_short_be(p, l, v->x) ||
+            !lh_lread_varint(p, l, v->id) || !lh_lread_double_be(p, l, v->t)) break;
+    }
+    return i;
+}
+
+static int unpack_item_record() {
+    uint8_t *p = venc2;
+    return lh_record_unpack_item(&p, venc2+vlen, items, NVTX);
+}
+
+static int pack_item_record() {
+    C(wbuf.data) = 0;
+    return lh_record_pack_item(&wbuf, items, NVTX);
+}
+
+BF(record, "packing and unpacking record arrays") {
+    int i;
+    lh_clear_obj(wbuf);
+
+    for(i=0; i<NVTX; i++) vtx[i] = (vertex){ i, i*0.5f, -i, 0, 1, 0, i/7.0f, i/3.0f };
+    vlen = lh_record_pack_vertex(&wbuf, vtx, NVTX);
+    memcpy(venc2, P(wbuf.data), vlen);
+    BENCH_RATE("vertex: lh_lread_float_be per field", vlen, 500, unpack_vertex_fields());
+    BENCH_RATE("vertex: lh_record_unpack", vlen, 500, unpack_vertex_record());
+    BENCH_RATE("vertex: lh_record_pack", vlen, 500, pack_vertex_record());
+
+    srand(42);
+    for(i=0; i<NVTX; i++) items[i] = (item){ i, rand(), rand()>>(rand()%31), i*0.1 };
+    C(wbuf.data) = 0;
+    vlen = lh_record_pack_item(&wbuf, items, NVTX);
+    memcpy(venc2, P(wbuf.data), vlen);
+    BENCH_RATE("item: lh_lread_* per field", vlen, 500, unpack_item_fields());
+    BENCH_RATE("item: lh_record_unpack", vlen, 500, unpack_item_record());
+    BENCH_RATE("item: lh_record_pack", vlen, 500, pack_item_record());
+
+    lh_arr_free(AR(wbuf.data));
+} _BF
+
+#define NF (1<<16)
+
+static float fvals[NF];
+static double dvals[NF];
+
+// per element, as the typed writes would do it
+static int half_loop() {
+    uint8_t *p = dst;
+    int i;
+    for(i=0; i<NF; i++) {
+        uint16_t h;
+        lh_float_to_half(&h, fvals+i, 1, 0);
+        lh_write_short_be(p, h);
+    }
+    return dst[5];
+}
+
+static int snorm16_loop() {
+    uint8_t *p = dst;
+    int i;
+    for(i=0; i<NF; i++) {
+        float x = fvals[i] < -1 ? -1 : fvals[i] > 1 ? 1 : fvals[i];
+        lh_write_short_be(p, (int16_t)(x*32767.0f+(x < 0 ? -0.5f : 0.5f)));
+    }
+    return dst[5];
+}
+
+BF(numconv, "converting float arrays to compact formats") {
+    static const struct { int mask; const char *name; } levels[] = {
+        { 0,  "scalar" },
+        { -1, "SIMD" },
+    };
+    int i, l;
+    char label[64];
+    for(i=0; i<NF; i++) {
+        fvals[i] = (i%2001-1000)/999.0f;
+        dvals[i] = fvals[i];
+    }
+
+    BENCH_RATE("float to half BE, per element", NF*4, 500, half_loop());
+    BENCH_RATE("float to snorm16 BE, per element", NF*4, 500, snorm16_loop());
+
+    for(l=0; l<sizeof(levels)/sizeof(levels[0]); l++) {
+        lh_cpu_restrict(levels[l].mask);
+        sprintf(label, "lh_float_to_half %s", levels[l].name);
+        BENCH_RATE(label, NF*4, 500, (lh_float_to_half(dst, fvals, NF, 0), dst[5]));
+        sprintf(label, "lh_float_to_half BE %s", levels[l].name);
+        BENCH_RATE(label, NF*4, 500, (lh_float_to_half(dst, fvals, NF, LH_CONV_BE), dst[5]));
+        sprintf(label, "lh_half_to_float BE %s", levels[l].name);
+        BENCH_RATE(label, NF*4, 500, (lh_half_to_float((float *)src, dst, NF, LH_CONV_BE), src[5]));
+        sprintf(label, "lh_float_to_snorm16 BE %s", levels[l].name);
+        BENCH_RATE(label, NF*4, 500, (lh_float_to_snorm16(dst, fvals, NF, LH_CONV_BE), dst[5]));
+        sprintf(label, "lh_unorm8_to_float %s", levels[l].name);
+        BENCH_RATE(label, NF*4, 500, (lh_unorm8_to_float((float *)src, dst, NF), src[5]));
+        sprintf(label, "lh_double_to_float %s", levels[l].name);
+        BENCH_RATE(label, NF*8, 500, (lh_double_to_float(dst, dvals, NF, 0), dst[5]));
+    }
+    lh_cpu_restrict(-1);
+} _BF
+
+// sums of a big-endian int array, element by element and in blocks
+static int sum_parse() {
+    int64_t sum = 0;
+    int i;
+    for(i=0; i<N; i++) sum += (int32_t)lh_parse_int_be(src+4*i);
+    return sum;
+}
+
+static int sum_view_int(const lh_view *v) {
+    int64_t sum = 0;
+    int i;
+    for(i=0; i<v->n; i++) sum += lh_view_int(v, i);
+    return sum;
+}
+
+static int sum_view_get(const lh_view *v) {
+    int64_t sum = 0;
+    int i;
+    for(i=0; i<v->n; i++) sum += (int32_t)lh_view_get_int(v, i);
+    return sum;
+}
+
+static int sum_view_read(const lh_view *v) {
+    int32_t tmp[1024];
+    int64_t sum = 0;
+    ssize_t i, k, m;
+    for(i=0; i<v->n; i+=m) {
+        m = lh_view_read(v, i, tmp, 1024);
+        for(k=0; k<m; k++) sum += tmp[k];
+    }
+    return sum;
+}
+
+BF(view, "summing a big-endian int array") {
+    int i;
+    for(i=0; i<N; i++) lh_place_int_be(src+4*i, i*7-1000);
+    lh_view v = lh_view_make(src, N, 'i', LH_CONV_BE);
+
+    BENCH_RATE("lh_parse_int_be", N*4, 2000, sum_parse());
+    BENCH_RATE("lh_view_int", N*4, 2000, sum_view_int(&v));
+    BENCH_RATE("lh_view_get_int", N*4, 2000, sum_view_get(&v));
+    BENCH_RATE("lh_view_read, blocks of 1024", N*4, 2000, sum_view_read(&v));
+} _BF
+
+////////////////////////////////////////////////////////////////////////////////
+
+BM(bytes) {
+
+    BENCH(bswap);
+    BENCH(varint);
+    BENCH(varint_encode);
+    BENCH(reader);
+    BENCH(writer);
+    BENCH(strings);
+    BENCH(record);
+    BENCH(numconv);
+    BENCH(view);
+
+} _BM;
@@ -0,0 +1,67 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_checksum : CRC32C, CRC32, xxHash64
+*/
+
+#include "lhbench.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <lh_cpu.h>
+#include <lh_checksum.h>
+
+#define NBUF (1<<20)
+#define NMSG 64
+
+static uint8_t buf[NBUF];
+
+// checksums of small messages, as in a packet stream
+static int crc32c_msgs() {
+    uint32_t c = 0;
+    int i;
+    for(i=0; i<NBUF; i+=NMSG) c ^= lh_crc32c(buf+i, NMSG);
+    return c;
+}
+
+static int xxh64_msgs() {
+    uint64_t h = 0;
+    int i;
+    for(i=0; i<NBUF; i+=NMSG) h ^= lh_xxh64(buf+i, NMSG, 0);
+    return h;
+}
+
+BF(checksum, "checksums of 1MB and of 64-byte messages") {
+    int i;
+    for(i=0; i<NBUF; i++) buf[i] = i*7+(i>>9);
+
+    BENCH_RATE("zlib crc32", NBUF, 200, crc32(0, buf, NBUF));
+
+    lh_cpu_restrict(0);
+    BENCH_RATE("lh_crc32 slicing-by-8", NBUF, 200, lh_crc32(buf, NBUF));
+    BENCH_RATE("lh_crc32c slicing-by-8", NBUF, 200, lh_crc32c(buf, NBUF));
+    lh_cpu_restrict(-1);
+    BENCH_RATE("lh_crc32 PCLMUL", NBUF, 200, lh_crc32(buf, NBUF));
+    BENCH_RATE("lh_crc32c SSE4.2", NBUF, 200, lh_crc32c(buf, NBUF));
+    BENCH_RATE("lh_xxh64", NBUF, 200, lh_xxh64(buf, NBUF, 0));
+
+    BENCH_RATE("lh_crc32c 64-byte messages", NBUF, 200, crc32c_msgs());
+    BENCH_RATE("lh_xxh64 64-byte messages", NBUF, 200, xxh64_msgs());
+} _BF
+
+////////////////////////////////////////////////////////////////////////////////
+
+BM(checksum) {
+
+    BENCH(checksum);
+
+} _BM;
@@ -0,0 +1,104 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_colfile : columnar container files
+*/
+
+#include "lhbench.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lh_marr.h>
+#include <lh_files.h>
+#include <lh_colfile.h>
+
+#define NROWS (1<<20)
+
+static char path[32];
+static int cnt;
+static uint32_t *id;
+static int64_t *ts;
+static float *x, *y, *z;
+static double *val;
+
+// sum of one column, mapped in place
+static int sum_mapped() {
+    lh_colfile f;
+    double sum = 0;
+    int64_t i;
+    if (lh_colfile_open(&f, path) < 0) return -1;
+    const double *v = lh_colfile_data(&f, lh_colfile_find(&f, "val"));
+    for(i=0; i<f.nrows; i++) sum += v[i];
+    lh_colfile_close(&f);
+    return (int)sum;
+}
+
+// the same column, read into a new array
+static int sum_loaded() {
+    lh_colfile f;
+    int n;
+    double sum = 0, *v = NULL;
+    int64_t i;
+    if (lh_colfile_open(&f, path) < 0) return -1;
+    lh_colfile_load(&f, n, "val", MAF(v));
+    for(i=0; i<n; i++) sum += v[i];
+    free(v);
+    lh_colfile_close(&f);
+    return (int)sum;
+}
+
+// loading the whole file, as for a hand-serialized multi-array
+static int sum_whole() {
+    uint8_t *buf = NULL;
+    double sum = 0;
+    int64_t i;
+    ssize_t len = lh_load_alloc(path, &buf);
+    const double *v = (const double *)(buf+len-NROWS*sizeof(double));
+    for(i=0; i<NROWS; i++) sum += v[i];
+    free(buf);
+    return (int)sum;
+}
+
+BF(colfile, "analytics over one column of 6, 1M rows") {
+    int i;
+    strcpy(path, "/tmp/lhbench_colXXXXXX");
+    close(mkstemp(path));
+
+    lh_multiarray_allocate(cnt, NROWS, MAF(id), MAF(ts), MAF(x), MAF(y), MAF(z), MAF(val));
+    for(i=0; i<cnt; i++) {
+        id[i] = i;
+        ts[i] = 1400000000000LL+i*1000;
+        x[i] = y[i] = z[i] = i*0.5f;
+        val[i] = (i%1000)*0.01;
+    }
+
+    off_t size = lh_colfile_save(path, cnt, "id,ts,x,y,z,val", "Ilfffd",
+                                 MAF(id), MAF(ts), MAF(x), MAF(y), MAF(z), MAF(val));
+    printf("file size %jd bytes\n", (intmax_t)size);
+
+    BENCH_RATE("save", size, 20, lh_colfile_save(path, cnt, "id,ts,x,y,z,val", "Ilfffd",
+               MAF(id), MAF(ts), MAF(x), MAF(y), MAF(z), MAF(val)));
+    BENCH_RATE("sum: load whole file", NROWS*8, 50, sum_whole());
+    BENCH_RATE("sum: lh_colfile_load", NROWS*8, 50, sum_loaded());
+    BENCH_RATE("sum: lh_colfile_data in place", NROWS*8, 50, sum_mapped());
+
+    unlink(path);
+    free(id); free(ts); free(x); free(y); free(z); free(val);
+} _BF
+
+////////////////////////////////////////////////////////////////////////////////
+
+BM(colfile) {
+
+    BENCH(colfile);
+
+} _BM;
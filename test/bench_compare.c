@@ -0,0 +1,101 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_compare : string comparison and sort keys
+*/
+
+#include "lhbench.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include <lh_strings.h>
+#include <lh_compare.h>
+
+#define NNAMES 20000
+
+static char names[NNAMES][48];
+static const char *ptrs[NNAMES];
+static lh_span spans[NNAMES];
+static lh_span work[NNAMES];
+static ssize_t order[NNAMES];
+
+static int cmp_strcasecmp(const void *a, const void *b) {
+    return strcasecmp(*(const char **)a, *(const char **)b);
+}
+
+static int cmp_casecmp(const void *a, const void *b) {
+    return lh_casecmp(*(const lh_span *)a, *(const lh_span *)b);
+}
+
+static int cmp_natcmp(const void *a, const void *b) {
+    return lh_strcmp_f(*(const lh_span *)a, *(const lh_span *)b,
+                       LH_CMP_NATURAL|LH_CMP_IGNORECASE);
+}
+
+// each pass sorts the same unsorted input
+static int sort_strcasecmp() {
+    int i;
+    for(i=0; i<NNAMES; i++) ptrs[i] = names[i];
+    qsort(ptrs, NNAMES, sizeof(*ptrs), cmp_strcasecmp);
+    return 0;
+}
+
+static int sort_spans(int (*cmp)(const void *, const void *)) {
+    memcpy(work, spans, sizeof(spans));
+    qsort(work, NNAMES, sizeof(*work), cmp);
+    return 0;
+}
+
+static int sort_keys(int flags) {
+    lh_sort_order(spans, NNAMES, flags, order);
+    return 0;
+}
+
+BF(sort, "sorting file names") {
+    int i;
+    srand(34);
+    for(i=0; i<NNAMES; i++) {
+        sprintf(names[i], "%s_Photo_%d.JPG", (i&1) ? "holiday_2015" : "IMG", rand()%100000);
+        spans[i] = lh_span_cstr(names[i]);
+    }
+
+    BENCH_TIME("qsort strcasecmp", 20, sort_strcasecmp());
+    BENCH_TIME("qsort lh_casecmp", 20, sort_spans(cmp_casecmp));
+    BENCH_TIME("lh_sort_order IGNORECASE", 20, sort_keys(LH_CMP_IGNORECASE));
+    BENCH_TIME("qsort lh_strcmp_f NATURAL", 20, sort_spans(cmp_natcmp));
+    BENCH_TIME("lh_sort_order NATURAL", 20, sort_keys(LH_CMP_NATURAL|LH_CMP_IGNORECASE));
+} _BF
+
+BF(prefix, "long common prefix") {
+    static char a[4097], b[4097];
+    memset(a, 'x', 4096);
+    memset(b, 'X', 4096);
+    a[4095] = 'a';
+    b[4095] = 'B';
+
+    // read through volatile pointers so the calls are not hoisted
+    const char * volatile pa = a, * volatile pb = b;
+    BENCH_RATE("strcasecmp", 4096, 100000, strcasecmp(pa, pb));
+    BENCH_RATE("lh_casecmp", 4096, 100000, lh_casecmp(lh_span_make(pa, 4096), lh_span_make(pb, 4096)));
+    BENCH_RATE("lh_strcmp_f NATURAL", 4096, 100000,
+               lh_strcmp_f(lh_span_make(pa, 4096), lh_span_make(pb, 4096),
+                           LH_CMP_NATURAL|LH_CMP_IGNORECASE));
+} _BF
+
+////////////////////////////////////////////////////////////////////////////////
+
+BM(compare) {
+
+    BENCH(sort);
+    BENCH(prefix);
+
+} _BM;
@@ -0,0 +1,121 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_csv : CSV/TSV reader
+*/
+
+#include "lhbench.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <lh_cpu.h>
+#include <lh_marr.h>
+#include <lh_search.h>
+#include <lh_split.h>
+#include <lh_csv.h>
+
+#define NREC 400000
+#define ITER 5
+
+static const char *names[] = { "alpha", "\"beta, quoted\"", "gamma", "a somewhat longer name string" };
+
+static char * make_csv(ssize_t *len) {
+    char *buf = malloc(NREC*80), *p = buf;
+    int i;
+    for(i=0; i<NREC; i++)
+        p += sprintf(p, "%d,%s,%d.%03d,%lld,%d\n", i, names[i&3], i%1000, i%997,
+                     i*123456789LL, i&1);
+    *len = p-buf;
+    return buf;
+}
+
+// the usual hand-written splitting: lines, then separators, no quoting
+static ssize_t split_by_hand(const uint8_t *p, ssize_t len) {
+    lh_splitter sp;
+    lh_span rec;
+    ssize_t n = 0;
+    lh_splitter_init(&sp, '\n', 0);
+    lh_splitter_feed(&sp, p, len);
+    lh_splitter_finish(&sp);
+    while (lh_splitter_next(&sp, &rec)) {
+        ssize_t pos = 0, f;
+        while ((f = lh_find_byte(rec.ptr+pos, rec.len-pos, ',')) >= 0) {
+            pos += f+1;
+            n++;
+        }
+        n++;
+    }
+    lh_splitter_free(&sp);
+    return n;
+}
+
+static ssize_t read_fields(const uint8_t *p, ssize_t len, const int *cols, int ncols) {
+    lh_csv_reader r;
+    ssize_t n = 0;
+    int nf;
+    lh_csv_init(&r, ',', 0);
+    if (ncols) lh_csv_select(&r, cols, ncols);
+    lh_csv_feed(&r, p, len);
+    lh_csv_finish(&r);
+    while ((nf = lh_csv_next(&r)) > 0) n += nf;
+    lh_csv_free(&r);
+    return n;
+}
+
+static ssize_t read_columns(const uint8_t *p, ssize_t len) {
+    static const int cols[] = { 0, 2 };
+    lh_csv_reader r;
+    int cnt = 0;
+    int64_t *id = NULL;
+    double *val = NULL;
+    lh_csv_init(&r, ',', 0);
+    lh_csv_select(&r, cols, 2);
+    lh_csv_feed(&r, p, len);
+    lh_csv_finish(&r);
+    lh_csv_columns(&r, cnt, 65536, "ld", MAF(id), MAF(val));
+    lh_csv_free(&r);
+    free(id);
+    free(val);
+    return cnt;
+}
+
+BF(split, "splitting fields") {
+    ssize_t len;
+    const uint8_t *buf = (const uint8_t *)make_csv(&len);
+    static const int cols[] = { 0, 3 };
+
+    BENCH_RATE("lh_count_byte (newlines)", len, ITER, lh_count_byte(buf, len, '\n'));
+    BENCH_RATE("lh_splitter + lh_find_byte", len, ITER, split_by_hand(buf, len));
+    lh_cpu_restrict(0);
+    BENCH_RATE("lh_csv_next (scalar)", len, ITER, read_fields(buf, len, NULL, 0));
+    lh_cpu_restrict(LH_CPU_SSE2);
+    BENCH_RATE("lh_csv_next (sse2)", len, ITER, read_fields(buf, len, NULL, 0));
+    lh_cpu_restrict(-1);
+    BENCH_RATE("lh_csv_next", len, ITER, read_fields(buf, len, NULL, 0));
+    BENCH_RATE("lh_csv_next, 2 of 5 columns", len, ITER, read_fields(buf, len, cols, 2));
+    free((void *)buf);
+} _BF
+
+BF(columns, "numeric columns") {
+    ssize_t len;
+    const uint8_t *buf = (const uint8_t *)make_csv(&len);
+    BENCH_RATE("lh_csv_columns, int64+double", len, ITER, read_columns(buf, len));
+    free((void *)buf);
+} _BF
+
+////////////////////////////////////////////////////////////////////////////////
+
+BM(csv) {
+
+    BENCH(split);
+    BENCH(columns);
+
+} _BM;
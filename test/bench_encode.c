@@ -0,0 +1,83 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_encode : hex and Base64
+*/
+
+#include "lhbench.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lh_cpu.h>
+#include <lh_debug.h>
+#include <lh_encode.h>
+
+#define BLEN (1<<20)
+#define ITER 100
+
+static const struct { const char *name; int mask; } levels[] = {
+    { "scalar", 0 },
+    { "ssse3",  LH_CPU_SSE2|LH_CPU_SSSE3 },
+    { "avx2",   -1 },
+};
+#define NLEVELS (sizeof(levels)/sizeof(levels[0]))
+
+static uint8_t *data;
+static char *enc;
+static uint8_t *dec;
+
+BF(hex, "hex") {
+    int l;
+    char label[64];
+    lh_hex_encode(data, BLEN, enc, 0);
+    BENCH_RATE("hex_import", BLEN, 10, hex_import(enc, dec, BLEN));
+    for(l=0; l<NLEVELS; l++) {
+        lh_cpu_restrict(levels[l].mask);
+        sprintf(label, "lh_hex_encode (%s)", levels[l].name);
+        BENCH_RATE(label, BLEN, ITER, lh_hex_encode(data, BLEN, enc, 0));
+        sprintf(label, "lh_hex_decode (%s)", levels[l].name);
+        BENCH_RATE(label, BLEN, ITER, lh_hex_decode(enc, 2*BLEN, dec, NULL));
+    }
+    lh_cpu_restrict(-1);
+} _BF
+
+BF(base64, "Base64") {
+    int l;
+    char label[64];
+    ssize_t n = lh_base64_encode(data, BLEN, enc, 0);
+    for(l=0; l<NLEVELS; l++) {
+        lh_cpu_restrict(levels[l].mask);
+        sprintf(label, "lh_base64_encode (%s)", levels[l].name);
+        BENCH_RATE(label, BLEN, ITER, lh_base64_encode(data, BLEN, enc, 0));
+        sprintf(label, "lh_base64_decode (%s)", levels[l].name);
+        BENCH_RATE(label, BLEN, ITER, lh_base64_decode(enc, n, dec, 0, NULL));
+    }
+    lh_cpu_restrict(-1);
+} _BF
+
+////////////////////////////////////////////////////////////////////////////////
+
+BM(encode) {
+
+    int i;
+    data = malloc(BLEN);
+    enc = malloc(2*BLEN);
+    dec = malloc(BLEN);
+    srand(1);
+    for(i=0; i<BLEN; i++) data[i] = rand();
+
+    BENCH(hex);
+    BENCH(base64);
+
+    free(data);
+    free(enc);
+    free(dec);
+
+} _BM;
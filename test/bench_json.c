@@ -0,0 +1,96 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_json : JSON writer and tokenizer
+*/
+
+#include "lhbench.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lh_cpu.h>
+#include <lh_strings.h>
+#include <lh_json.h>
+
+#define NREC 10000
+#define ITER 20
+
+static const char *names[] = { "alpha", "beta \"quoted\"", "gamma", "a somewhat longer name string" };
+
+// a metrics-like document written with lh_bufprintf
+static ssize_t write_bufprintf(uint8_t **bufp, ssize_t *lenp) {
+    int i;
+    *lenp = 0;
+    lh_bufprintf_g(bufp, lenp, 4096, "[");
+    for(i=0; i<NREC; i++)
+        lh_bufprintf_g(bufp, lenp, 4096, "%s{\"id\":%d,\"name\":\"%s\",\"value\":%lld}",
+                       i ? "," : "", i, names[i&3], i*123456789LL);
+    lh_bufprintf_g(bufp, lenp, 4096, "]");
+    return *lenp;
+}
+
+static ssize_t write_json(uint8_t **bufp, ssize_t *lenp) {
+    int i;
+    lh_json_writer w;
+    *lenp = 0;
+    lh_json_writer_init_(&w, bufp, lenp, 4096);
+    lh_json_begin_array(&w);
+    for(i=0; i<NREC; i++) {
+        lh_json_begin_object(&w);
+        lh_json_key(&w, "id", 2);       lh_json_int(&w, i);
+        lh_json_key(&w, "name", 4);     lh_json_string(&w, names[i&3], -1);
+        lh_json_key(&w, "value", 5);    lh_json_int(&w, i*123456789LL);
+        lh_json_end_object(&w);
+    }
+    lh_json_end_array(&w);
+    return *lenp;
+}
+
+static ssize_t tokenize(const uint8_t *p, ssize_t len) {
+    lh_json_tokenizer t;
+    lh_json_token tok;
+    ssize_t n = 0;
+    lh_json_tok_init(&t);
+    lh_json_tok_feed(&t, p, len);
+    lh_json_tok_finish(&t);
+    while (lh_json_tok_next(&t, &tok) > 0) n++;
+    lh_json_tok_free(&t);
+    return n;
+}
+
+BF(writer, "JSON writer") {
+    uint8_t *buf = NULL;
+    ssize_t len = 0;
+    ssize_t size = write_json(&buf, &len);
+    BENCH_RATE("lh_bufprintf", size, ITER, write_bufprintf(&buf, &len));
+    BENCH_RATE("lh_json_writer", size, ITER, write_json(&buf, &len));
+    free(buf);
+} _BF
+
+BF(tokenizer, "JSON tokenizer") {
+    uint8_t *buf = NULL;
+    ssize_t len = 0;
+    write_json(&buf, &len);
+
+    lh_cpu_restrict(0);
+    BENCH_RATE("lh_json_tok_next (scalar)", len, ITER, tokenize(buf, len));
+    lh_cpu_restrict(-1);
+    BENCH_RATE("lh_json_tok_next", len, ITER, tokenize(buf, len));
+    free(buf);
+} _BF
+
+////////////////////////////////////////////////////////////////////////////////
+
+BM(json) {
+
+    BENCH(writer);
+    BENCH(tokenizer);
+
+} _BM;
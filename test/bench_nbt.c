@@ -0,0 +1,114 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_nbt : tagged binary trees
+*/
+
+#include "lhbench.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <lh_nbt.h>
+
+#define S(s) lh_span_make(s, sizeof(s)-1)
+
+#define NSECTIONS   16
+#define NENTITIES   200
+
+static uint8_t blocks[4096], heights[256*4];
+static lh_buf_t b;
+static lh_nbt t;
+
+// a chunk with many small entities and a few large arrays
+static void make_chunk() {
+    int i;
+    lh_nbt_init(&t);
+    lh_nbt_begin(&t, LH_NBT_COMPOUND, S(""));
+    lh_nbt_begin(&t, LH_NBT_COMPOUND, S("Level"));
+    lh_nbt_add_int(&t, LH_NBT_INT, S("xPos"), 3);
+    lh_nbt_add_int(&t, LH_NBT_INT, S("zPos"), -2);
+    lh_nbt_begin(&t, LH_NBT_LIST, S("Sections"));
+    for(i=0; i<NSECTIONS; i++) {
+        lh_nbt_begin(&t, LH_NBT_COMPOUND, S(""));
+        lh_nbt_add_int(&t, LH_NBT_BYTE, S("Y"), i);
+        lh_nbt_add(&t, LH_NBT_BYTE_ARRAY, S("Blocks"), lh_span_make(blocks, sizeof(blocks)));
+        lh_nbt_add(&t, LH_NBT_BYTE_ARRAY, S("Data"), lh_span_make(blocks, sizeof(blocks)/2));
+        lh_nbt_end(&t);
+    }
+    lh_nbt_end(&t);
+    lh_nbt_begin(&t, LH_NBT_LIST, S("Entities"));
+    for(i=0; i<NENTITIES; i++) {
+        lh_nbt_begin(&t, LH_NBT_COMPOUND, S(""));
+        lh_nbt_add(&t, LH_NBT_STRING, S("id"), S("minecraft:item"));
+        lh_nbt_begin(&t, LH_NBT_LIST, S("Pos"));
+        lh_nbt_add_double(&t, LH_NBT_DOUBLE, S(""), i*0.5);
+        lh_nbt_add_double(&t, LH_NBT_DOUBLE, S(""), 64);
+        lh_nbt_add_double(&t, LH_NBT_DOUBLE, S(""), -i*0.5);
+        lh_nbt_end(&t);
+        lh_nbt_add_int(&t, LH_NBT_SHORT, S("Health"), 5);
+        lh_nbt_add_int(&t, LH_NBT_LONG, S("UUIDMost"), i*1234567LL);
+        lh_nbt_end(&t);
+    }
+    lh_nbt_end(&t);
+    lh_nbt_add(&t, LH_NBT_INT_ARRAY, S("HeightMap"), lh_span_make(heights, sizeof(heights)));
+    lh_nbt_end(&t);
+    lh_nbt_add_int(&t, LH_NBT_INT, S("DataVersion"), 1343);
+    lh_nbt_end(&t);
+
+    lh_clear_obj(b);
+    lh_nbt_write(&b, &t, 0);
+    lh_nbt_free(&t);
+}
+
+// all entries indexed, then a lookup
+static int64_t full_index() {
+    lh_nbt_parse(&t, P(b.data), C(b.data), -1);
+    return lh_nbt_int(&t, lh_nbt_path(&t, 0, "Level/zPos"));
+}
+
+// only the root and Level indexed, the lists are skipped
+static int64_t partial_index() {
+    lh_nbt_parse(&t, P(b.data), C(b.data), 2);
+    return lh_nbt_int(&t, lh_nbt_path(&t, 0, "Level/zPos"));
+}
+
+BF(nbt, "indexing a chunk") {
+    make_chunk();
+    printf("chunk size %zd bytes\n", C(b.data));
+
+    lh_nbt_init(&t);
+    lh_nbt_parse(&t, P(b.data), C(b.data), -1);
+    printf("entries: %zd full", C(t.ent));
+    lh_nbt_parse(&t, P(b.data), C(b.data), 2);
+    printf(", %zd to depth 2\n", C(t.ent));
+
+    BENCH_RATE("lh_nbt_skip", C(b.data), 20000,
+               lh_nbt_skip(P(b.data)+3, P(b.data)+C(b.data), LH_NBT_COMPOUND));
+    BENCH_RATE("lh_nbt_parse all levels", C(b.data), 20000, full_index());
+    BENCH_RATE("lh_nbt_parse depth 2", C(b.data), 20000, partial_index());
+
+    lh_buf_t o;
+    lh_clear_obj(o);
+    lh_nbt_parse(&t, P(b.data), C(b.data), -1);
+    BENCH_RATE("lh_nbt_write", C(b.data), 20000, (C(o.data) = 0, lh_nbt_write(&o, &t, 0)));
+
+    lh_arr_free(AR(o.data));
+    lh_arr_free(AR(b.data));
+    lh_nbt_free(&t);
+} _BF
+
+////////////////////////////////////////////////////////////////////////////////
+
+BM(nbt) {
+
+    BENCH(nbt);
+
+} _BM;
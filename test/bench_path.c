@@ -0,0 +1,76 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_path : path strings and builder
+*/
+
+#include "lhbench.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include <lh_strings.h>
+#include <lh_path.h>
+
+#define NNAMES 1000
+#define ITER 2000
+
+static char names[NNAMES][32];
+static ssize_t lens[NNAMES];
+
+// the way the directory walk used to build the entry paths
+static ssize_t build_snprintf() {
+    char path[PATH_MAX+1];
+    ssize_t i, n = 0;
+    for(i=0; i<NNAMES; i++)
+        n += snprintf(path, sizeof(path), "%s/%s", benchdir, names[i]);
+    return n;
+}
+
+static ssize_t build_pathbuf(lh_pathbuf *pb) {
+    ssize_t i, n = 0;
+    for(i=0; i<NNAMES; i++) {
+        ssize_t plen = lh_pathbuf_push(pb, lh_span_make(names[i], lens[i]));
+        n += pb->len;
+        lh_pathbuf_trunc(pb, plen);
+    }
+    return n;
+}
+
+BF(build, "building entry paths") {
+    int i;
+    for(i=0; i<NNAMES; i++)
+        lens[i] = sprintf(names[i], "file_%04d.dat", i*7919%10000);
+
+    lh_pathbuf pb;
+    lh_pathbuf_init(&pb, lh_span_cstr(benchdir));
+    ssize_t size = (strlen(benchdir)+14)*NNAMES;
+
+    BENCH_RATE("snprintf %s/%s", size, ITER, build_snprintf());
+    BENCH_RATE("lh_pathbuf_push/trunc", size, ITER, build_pathbuf(&pb));
+    lh_pathbuf_free(&pb);
+} _BF
+
+BF(normalize, "normalizing paths") {
+    static const char *p = "/usr/./local//lib/../share/doc/./libhelper/../../man/";
+    lh_span s = lh_span_cstr(p);
+    char out[128];
+    BENCH_TIME("lh_path_normalize", 1000000, lh_path_normalize(s, out));
+} _BF
+
+////////////////////////////////////////////////////////////////////////////////
+
+BM(path) {
+
+    BENCH(build);
+    BENCH(normalize);
+
+} _BM;
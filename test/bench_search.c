@@ -0,0 +1,101 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_search : byte search primitives
+*/
+
+#define _GNU_SOURCE
+#include "lhbench.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lh_cpu.h>
+#include <lh_search.h>
+
+#define BLEN (1<<20)
+#define ITER 200
+
+static uint8_t * bench_text() {
+    static uint8_t *text = NULL;
+    if (!text) {
+        int i;
+        text = malloc(BLEN+1);
+        srand(1);
+        for(i=0; i<BLEN; i++) text[i] = 'a'+rand()%26;
+        text[BLEN] = 0;
+    }
+    return text;
+}
+
+static void bench_levels(const char *name, ssize_t (*fn)(const uint8_t *, ssize_t)) {
+    static const struct { const char *name; int mask; } levels[] = {
+        { "scalar", 0 },
+        { "sse2",   LH_CPU_SSE2 },
+        { "ssse3",  LH_CPU_SSE2|LH_CPU_SSSE3 },
+        { "avx2",   -1 },
+    };
+    int l;
+    for(l=0; l<sizeof(levels)/sizeof(levels[0]); l++) {
+        char label[64];
+        sprintf(label, "%s (%s)", name, levels[l].name);
+        lh_cpu_restrict(levels[l].mask);
+        BENCH_RATE(label, BLEN, ITER, fn(bench_text(), BLEN));
+    }
+    lh_cpu_restrict(-1);
+}
+
+static ssize_t run_find_byte(const uint8_t *p, ssize_t len) {
+    return lh_find_byte(p, len, '\n');
+}
+
+static ssize_t run_count_byte(const uint8_t *p, ssize_t len) {
+    return lh_count_byte(p, len, 'e');
+}
+
+static ssize_t run_find_anyof(const uint8_t *p, ssize_t len) {
+    return lh_find_anyof(p, len, (const uint8_t *)"\r\n\t ,;:", 7);
+}
+
+static ssize_t run_find_substr(const uint8_t *p, ssize_t len) {
+    return lh_find_substr(p, len, (const uint8_t *)"\r\n\r\n", 4);
+}
+
+BF(find_byte, "find byte") {
+    BENCH_RATE("memchr", BLEN, ITER, memchr(bench_text(), '\n', BLEN) != NULL);
+    bench_levels("lh_find_byte", run_find_byte);
+} _BF
+
+BF(count_byte, "count byte") {
+    uint8_t *text = bench_text();
+    BENCH_RATE("loop", BLEN, ITER, ({ ssize_t i,c=0; for(i=0;i<BLEN;i++) c+=(text[i]=='e'); c; }));
+    bench_levels("lh_count_byte", run_count_byte);
+} _BF
+
+BF(find_anyof, "find any of a set") {
+    BENCH_RATE("strpbrk", BLEN, ITER, strpbrk((char *)bench_text(), "\r\n\t ,;:") != NULL);
+    bench_levels("lh_find_anyof", run_find_anyof);
+} _BF
+
+BF(find_substr, "find substring") {
+    BENCH_RATE("strstr", BLEN, ITER, strstr((char *)bench_text(), "\r\n\r\n") != NULL);
+    BENCH_RATE("memmem", BLEN, ITER, memmem(bench_text(), BLEN, "\r\n\r\n", 4) != NULL);
+    bench_levels("lh_find_substr", run_find_substr);
+} _BF
+
+////////////////////////////////////////////////////////////////////////////////
+
+BM(search) {
+
+    BENCH(find_byte);
+    BENCH(count_byte);
+    BENCH(find_anyof);
+    BENCH(find_substr);
+
+} _BM;
@@ -0,0 +1,110 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_utf8 : UTF-8 validation and transcoding
+*/
+
+#include "lhbench.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lh_cpu.h>
+#include <lh_utf8.h>
+
+#define BLEN (1<<20)
+#define ITER 100
+
+// ASCII text with a share of multi-byte characters
+static uint8_t * bench_text(int ascii) {
+    static const char *words[] = {
+        "the ", "quick ", "brown ", "fox ", "Grüße ", "Köln ", "Ελληνικά ", "日本語 ",
+        "\xf0\x9f\x98\x80 ",
+    };
+    static uint8_t *text[2] = { NULL, NULL };
+    if (!text[ascii]) {
+        ssize_t pos = 0;
+        text[ascii] = malloc(BLEN);
+        srand(1);
+        while (1) {
+            const char *w = words[rand()%(ascii ? 4 : 9)];
+            ssize_t wl = strlen(w);
+            if (pos+wl > BLEN) break;
+            memcpy(text[ascii]+pos, w, wl);
+            pos += wl;
+        }
+        memset(text[ascii]+pos, ' ', BLEN-pos);
+    }
+    return text[ascii];
+}
+
+static const struct { const char *name; int mask; } levels[] = {
+    { "scalar", 0 },
+    { "sse2",   LH_CPU_SSE2 },
+    { "ssse3",  LH_CPU_SSE2|LH_CPU_SSSE3 },
+    { "avx2",   -1 },
+};
+#define NLEVELS (sizeof(levels)/sizeof(levels[0]))
+
+BF(validate, "UTF-8 validation") {
+    int l, a;
+    for(a=1; a>=0; a--) {
+        uint8_t *text = bench_text(a);
+        for(l=0; l<NLEVELS; l++) {
+            char label[64];
+            sprintf(label, "lh_utf8_valid %s (%s)", a ? "ascii" : "mixed", levels[l].name);
+            lh_cpu_restrict(levels[l].mask);
+            BENCH_RATE(label, BLEN, ITER, lh_utf8_valid(text, BLEN));
+        }
+    }
+    lh_cpu_restrict(-1);
+} _BF
+
+BF(count, "code point counting") {
+    int l;
+    uint8_t *text = bench_text(0);
+    for(l=0; l<2; l++) {
+        char label[64];
+        sprintf(label, "lh_utf8_count (%s)", levels[l].name);
+        lh_cpu_restrict(levels[l].mask);
+        BENCH_RATE(label, BLEN, ITER, lh_utf8_count(text, BLEN));
+    }
+    lh_cpu_restrict(-1);
+} _BF
+
+BF(transcode, "UTF-8 <-> UTF-16") {
+    int l, a;
+    uint16_t *u16 = malloc(BLEN*sizeof(uint16_t));
+    uint8_t *u8 = malloc(3*BLEN);
+    for(a=1; a>=0; a--) {
+        uint8_t *text = bench_text(a);
+        ssize_t n = lh_utf8_to_utf16(text, BLEN, u16);
+        for(l=0; l<2; l++) {
+            char label[64];
+            lh_cpu_restrict(levels[l].mask);
+            sprintf(label, "lh_utf8_to_utf16 %s (%s)", a ? "ascii" : "mixed", levels[l].name);
+            BENCH_RATE(label, BLEN, ITER, lh_utf8_to_utf16(text, BLEN, u16));
+            sprintf(label, "lh_utf16_to_utf8 %s (%s)", a ? "ascii" : "mixed", levels[l].name);
+            BENCH_RATE(label, BLEN, ITER, lh_utf16_to_utf8(u16, n, u8));
+        }
+    }
+    lh_cpu_restrict(-1);
+    free(u16);
+    free(u8);
+} _BF
+
+////////////////////////////////////////////////////////////////////////////////
+
+BM(utf8) {
+
+    BENCH(validate);
+    BENCH(count);
+    BENCH(transcode);
+
+} _BM;
@@ -0,0 +1,54 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lhbench.h"
+
+volatile int64_t bench_sink;
+char benchdir[PATH_MAX];
+
+void bench_module_search();
+void bench_module_utf8();
+void bench_module_encode();
+void bench_module_json();
+void bench_module_csv();
+void bench_module_path();
+void bench_module_compare();
+void bench_module_bytes();
+void bench_module_checksum();
+void bench_module_bits();
+void bench_module_colfile();
+void bench_module_nbt();
+
+int main(int ac, char **av) {
+    // directory of the data files, the current one by default
+    if (ac > 1)
+        snprintf(benchdir, sizeof(benchdir), "%s", av[1]);
+    else if (!getcwd(benchdir, sizeof(benchdir)))
+        strcpy(benchdir, ".");
+
+    bench_module_search();
+    bench_module_utf8();
+    bench_module_encode();
+    bench_module_json();
+    bench_module_csv();
+    bench_module_path();
+    bench_module_compare();
+    bench_module_bytes();
+    bench_module_checksum();
+    bench_module_bits();
+    bench_module_colfile();
+    bench_module_nbt();
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <limits.h>
+
+/*
+  Benchmarks are organized like the tests: BF() defines a single benchmark,
+  BM() a module that runs a set of them. The numbers are only meaningful
+  with an optimized build, e.g.:
+
+  make clean bench CFLAGS="-O2 -std=gnu99"
+*/
+
+#define BF(name,descr)                                          \
+    static void bench_##name() {                                \
+        printf("\n\n=== Benchmark %s ===\n", descr);
+
+#define _BF                                                     \
+    }
+
+#define BM(name)                                                \
+    void bench_module_##name() {                                \
+        printf("\n\n====== Benchmarking module %s ======\n", #name);
+
+#define _BM                                                     \
+    }
+
+#define BENCH(name) bench_##name();
+
+// results are accumulated here so the compiler can't drop the calls
+extern volatile int64_t bench_sink;
+
+// directory of the data files, the first argument of lhbench
+extern char benchdir[PATH_MAX];
+
+static inline double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// run expr iter times and report the throughput for size bytes per call
+#define BENCH_RATE(label,size,iter,expr) {                              \
+        int _i;                                                         \
+        double _t = bench_now();                                        \
+        for(_i=0; _i<(iter); _i++) bench_sink += (int64_t)(expr);       \
+        _t = bench_now()-_t;                                            \
+        printf("%-32s %10.1f MB/s\n", label,                            \
+               (double)(size)*(iter)/_t/1e6);                           \
+    }
+
+// run expr iter times and report the time per call
+#define BENCH_TIME(label,iter,expr) {                                   \
+        int64_t _i;                                                     \
+        double _t = bench_now();                                        \
+        for(_i=0; _i<(iter); _i++) bench_sink += (int64_t)(expr);       \
+        _t = bench_now()-_t;                                            \
+        printf("%-32s %10.2f ns\n", label, _t*1e9/(iter));              \
+    }
@@ -1151,6 +1151,23 @@ int test_module_image() {
 ////////////////////////////////////////////////////////////////////////////////
 
 int test_module_debug();
+int test_module_intern();
+int test_module_search();
+int test_module_split();
+int test_module_utf8();
+int test_module_encode();
+int test_module_json();
+int test_module_csv();
+int test_module_path();
+int test_module_compare();
+int test_module_bswap();
+int test_module_varint();
+int test_module_cursor();
+int test_module_record();
+int test_module_checksum();
+int test_module_bits();
+int test_module_colfile();
+int test_module_nbt();
 
 int main(int ac, char **av) {
     strcpy(testdir, av[1] ? av[1] : ".");
@@ -1158,6 +1175,23 @@ int main(int ac, char **av) {
     int fail = 0;
 
     fail += test_module_debug();
+    fail += test_module_intern();
+    fail += test_module_search();
+    fail += test_module_split();
+    fail += test_module_utf8();
+    fail += test_module_encode();
+    fail += test_module_json();
+    fail += test_module_csv();
+    fail += test_module_path();
+    fail += test_module_compare();
+    fail += test_module_bswap();
+    fail += test_module_varint();
+    fail += test_module_cursor();
+    fail += test_module_record();
+    fail += test_module_checksum();
+    fail += test_module_bits();
+    fail += test_module_colfile();
+    fail += test_module_nbt();
 
 #if 0
     fail += test_module_buffers();
@@ -0,0 +1,337 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_bits : bit streams, bit-packed and frame-of-reference arrays, time series
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lh_arr.h>
+#include <lh_cpu.h>
+#include <lh_bits.h>
+
+static int cpu_levels[] = {
+    0, -1
+};
+
+#define NVAL 5000
+
+TF(bitstream, "bit reader and writer") {
+    static uint64_t vals[NVAL];
+    static int widths[NVAL];
+    lh_buf_t buf;
+    lh_bitwriter w;
+    lh_bitreader r;
+    int i;
+    ssize_t total = 0;
+
+    srand(44);
+    for(i=0; i<NVAL; i++) {
+        widths[i] = rand()%(LH_BITS_MAX+1);
+        vals[i] = ((uint64_t)rand()<<32 | rand()) & (((uint64_t)1<<widths[i])-1);
+        total += widths[i];
+    }
+
+    // after some existing data
+    lh_clear_obj(buf);
+    lh_arr_add(GAR4(buf.data), 3);
+    memcpy(P(buf.data), "abc", 3);
+
+    lh_bitwriter_init(&w, &buf);
+    for(i=0; i<NVAL; i++)
+        lh_bitwriter_put(&w, vals[i] | ((uint64_t)1<<widths[i]), widths[i]);
+    lh_bitwriter_bit(&w, 1);
+    lh_bitwriter_align(&w);
+    lh_bitwriter_put(&w, 0x5a, 8);
+    fail += (lh_bitwriter_finish(&w) != 3+(total+1+7)/8+1);
+    fail += memcmp(P(buf.data), "abc", 3);
+
+    lh_bitreader_init(&r, P(buf.data)+3, C(buf.data)-3);
+    fail += (lh_bitreader_left(&r) != 8*(C(buf.data)-3));
+    for(i=0; i<NVAL; i++)
+        fail += (lh_bitreader_get(&r, widths[i]) != vals[i]);
+    fail += (lh_bitreader_bit(&r) != 1);
+    lh_bitreader_align(&r);
+    fail += (lh_bitreader_peek(&r, 8) != 0x5a);
+    fail += (lh_bitreader_get(&r, 8) != 0x5a || r.error);
+    fail += (lh_bitreader_left(&r) != 0);
+
+    // reading past the end fails and stays failed
+    fail += (lh_bitreader_get(&r, 1) != 0 || !r.error);
+    fail += (lh_bitreader_get(&r, 0) != 0);
+
+    lh_bitreader_init(&r, "\xff\x01", 2);
+    fail += (lh_bitreader_get(&r, 9) != 0x1ff);
+    fail += (lh_bitreader_get(&r, 8) != 0 || !r.error);
+
+    lh_arr_free(AR(buf.data));
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+#define NMAX 700
+
+TF(bits_pack, "bit-packed arrays") {
+    static uint32_t v[NMAX], u[NMAX+1];
+    static uint16_t v16[NMAX], u16[NMAX+1];
+    static const ssize_t counts[] = { 0, 1, 7, 8, 15, 16, 17, 63, 64, 65, 200, 256, 4096/8, NMAX };
+    lh_buf_t buf;
+    int l, bits, flags, c, i;
+
+    lh_clear_obj(buf);
+
+    for(l=0; l<sizeof(cpu_levels)/sizeof(int); l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        for(bits=0; bits<=32; bits++) {
+            for(i=0; i<NMAX; i++) {
+                v[i] = ((uint32_t)rand()*7919+rand()) & (uint32_t)(((uint64_t)1<<bits)-1);
+                v16[i] = v[i];
+            }
+            for(flags=0; flags<=LH_BITS_PADDED; flags+=LH_BITS_PADDED) {
+                for(c=0; c<sizeof(counts)/sizeof(counts[0]); c++) {
+                    ssize_t n = counts[c];
+                    ssize_t size = lh_bits_size(n, bits, flags);
+                    // exactly sized, so the kernels must not read past it
+                    uint8_t *p = malloc(size > 0 ? size : 1);
+
+                    fail += (lh_bits_pack32(p, v, n, bits, flags) != size);
+                    if (flags == 0) {
+                        // the contiguous layout is a bit stream padded to a word
+                        lh_bitwriter w;
+                        C(buf.data) = 0;
+                        lh_bitwriter_init(&w, &buf);
+                        for(i=0; i<n; i++) lh_bitwriter_put(&w, v[i], bits);
+                        lh_bitwriter_finish(&w);
+                        fail += memcmp(P(buf.data), p, C(buf.data));
+                        fail += (C(buf.data) > size || size-C(buf.data) >= 8);
+                    }
+
+                    u[n] = 0xdeadbeef;
+                    fail += (lh_bits_unpack32(u, n, p, size, bits, flags) != size);
+                    fail += (memcmp(u, v, n*4) || u[n] != 0xdeadbeef);
+                    for(i=0; i<n; i+=13)
+                        fail += (lh_bits_get(p, i, bits, flags) != v[i]);
+
+                    if (bits <= 16) {
+                        fail += (lh_bits_pack16(p, v16, n, bits, flags) != size);
+                        u16[n] = 0xbeef;
+                        fail += (lh_bits_unpack16(u16, n, p, size, bits, flags) != size);
+                        fail += (memcmp(u16, v16, n*2) || u16[n] != 0xbeef);
+                    }
+                    else {
+                        fail += (lh_bits_unpack16(u16, n, p, size, bits, flags) != -1);
+                    }
+
+                    if (size > 0)
+                        fail += (lh_bits_unpack32(u, n, p, size-1, bits, flags) != -1);
+                    free(p);
+                }
+            }
+        }
+    }
+    lh_cpu_restrict(-1);
+
+    // the padded layout leaves the high bits of the words unused
+    uint8_t p[16];
+    uint32_t x[13];
+    for(i=0; i<13; i++) x[i] = i+1;
+    fail += (lh_bits_size(13, 5, LH_BITS_PADDED) != 16);
+    fail += (lh_bits_size(13, 5, 0) != 16);
+    fail += (lh_bits_size(13, 4, LH_BITS_PADDED) != 8);
+    lh_bits_pack32(p, x, 13, 5, LH_BITS_PADDED);
+    fail += (lh_parse_long_le(p)>>60 != 0 || lh_parse_long_le(p+8) != 13);
+    fail += (lh_bits_pack32(p, x, 13, 33, 0) != -1);
+
+    lh_arr_free(AR(buf.data));
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(for_array, "frame-of-reference arrays") {
+    static uint32_t v[NVAL], u[NVAL+1];
+    static const ssize_t counts[] = { 0, 1, 127, 128, 129, 256, 1000, NVAL };
+    lh_buf_t buf;
+    int l, kind, flags, c;
+    ssize_t i, k;
+
+    lh_clear_obj(buf);
+    for(l=0; l<sizeof(cpu_levels)/sizeof(int); l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        for(kind=0; kind<4; kind++) {
+            // sorted with small gaps, clustered, full range, constant
+            uint32_t x = 4000000000U;
+            for(i=0; i<NVAL; i++) {
+                switch (kind) {
+                    case 0: v[i] = x += rand()%50; break;
+                    case 1: v[i] = 1000000+(i/300)*5000+rand()%1000; break;
+                    case 2: v[i] = (uint32_t)rand()*7919+rand(); break;
+                    case 3: v[i] = 77; break;
+                }
+            }
+            for(flags=0; flags<4; flags++) {
+                for(c=0; c<sizeof(counts)/sizeof(counts[0]); c++) {
+                    ssize_t n = counts[c];
+                    C(buf.data) = 0;
+                    ssize_t size = lh_buf_put_for_array(&buf, v, n, flags);
+                    fail += (size != C(buf.data));
+                    if (kind == 0 && (flags & LH_FOR_DELTA) && n == NVAL)
+                        fail += (size > NVAL);      // 6 bits per value
+
+                    lh_for_array a;
+                    uint8_t *p = P(buf.data);
+                    fail += (!lh_lread_for_array(p, P(buf.data)+size, a));
+                    fail += (p != P(buf.data)+size || a.n != n);
+
+                    u[n] = 0xdeadbeef;
+                    fail += (lh_for_decode(&a, u) != n);
+                    fail += (memcmp(u, v, n*4) || u[n] != 0xdeadbeef);
+
+                    for(k=0; k<a.nblocks; k++) {
+                        ssize_t cnt = lh_for_decode_block(&a, k, u);
+                        fail += (cnt != ((n-k*a.bsize < a.bsize) ? n-k*a.bsize : a.bsize));
+                        fail += memcmp(u, v+k*a.bsize, cnt*4);
+                    }
+                    for(i=0; i<n; i+=37)
+                        fail += (lh_for_get(&a, i) != v[i]);
+
+                    // truncated
+                    if (size > 0) {
+                        p = P(buf.data);
+                        fail += lh_lread_for_array(p, P(buf.data)+size-1, a);
+                    }
+                }
+            }
+        }
+    }
+    lh_cpu_restrict(-1);
+
+    // checkpoints that do not match the widths
+    C(buf.data) = 0;
+    ssize_t size = lh_buf_put_for_array(&buf, v, NVAL, 0);
+    lh_for_array a;
+    uint8_t *p = P(buf.data);
+    fail += (!lh_lread_for_array(p, P(buf.data)+size, a) || a.nblocks <= LH_FOR_CKPT);
+    P(buf.data)[a.ckpt-P(buf.data)+4] ^= 1;
+    p = P(buf.data);
+    fail += lh_lread_for_array(p, P(buf.data)+size, a);
+
+    // unknown flags and too large widths
+    uint8_t bad1[] = { 1, 0x80 };
+    uint8_t bad2[] = { 1, 0, 33, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    p = bad1;
+    fail += lh_lread_for_array(p, bad1+sizeof(bad1), a);
+    p = bad2;
+    fail += lh_lread_for_array(p, bad2+sizeof(bad2), a);
+
+    lh_arr_free(AR(buf.data));
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(series, "XOR-compressed time series") {
+    static int64_t ts[NVAL];
+    static double vals[NVAL];
+    static float fv[NVAL];
+    lh_buf_t buf;
+    lh_series_writer sw;
+    lh_series_reader sr;
+    int64_t t;
+    double v;
+    int i;
+
+    srand(46);
+    t = 1400000000000LL;
+    for(i=0; i<NVAL; i++) {
+        // regular intervals with jitter and some gaps and jumps
+        if (i%500 == 499) t += 1000000;
+        else if (i == 3000) t = -5;
+        else if (i == 3001) t = INT64_MAX-10000000;
+        else t += 1000+(rand()%7==0 ? rand()%100-50 : 0);
+        ts[i] = t;
+        vals[i] = (i%10 < 3) ? 20.5 : 20+(i%200)*0.025;
+        fv[i] = (float)vals[i];
+    }
+    vals[100] = -0.0;
+    vals[101] = 1.0/0.0;
+    vals[102] = 0.0/0.0;
+    vals[103] = 1e-310;
+    for(i=200; i<300; i++) vals[i] = (double)rand()/RAND_MAX;
+
+    lh_clear_obj(buf);
+    lh_series_writer_init(&sw, &buf);
+    for(i=0; i<NVAL; i++) lh_series_put(&sw, ts[i], vals[i]);
+    ssize_t size = lh_series_finish(&sw);
+    fail += (size > NVAL*16/2);
+
+    lh_series_reader_init(&sr, P(buf.data), size);
+    for(i=0; i<NVAL; i++) {
+        if (!lh_series_next(&sr, &t, &v)) {
+            fail++;
+            break;
+        }
+        fail += (t != ts[i] || memcmp(&v, &vals[i], 8));
+    }
+    fail += (lh_series_next(&sr, &t, &v) != 0 || sr.r.error);
+
+    // a truncated stream ends with an error
+    lh_series_reader_init(&sr, P(buf.data), size-2);
+    for(i=0; i<NVAL+1 && lh_series_next(&sr, &t, &v); i++);
+    fail += (i >= NVAL || !sr.r.error);
+
+    // regular intervals and runs of equal values take a few bits
+    C(buf.data) = 0;
+    lh_series_writer_init(&sw, &buf);
+    for(i=0; i<NVAL; i++) lh_series_put(&sw, 1000*i, 50+(i/20)%4);
+    fail += (lh_series_finish(&sw) > NVAL*16/20);
+
+    // an empty series
+    C(buf.data) = 0;
+    lh_series_writer_init(&sw, &buf);
+    fail += (lh_series_finish(&sw) != 1);
+    lh_series_reader_init(&sr, P(buf.data), 1);
+    fail += (lh_series_next(&sr, &t, &v) != 0 || sr.r.error);
+
+    // floats and timestamps in separate streams of known length
+    lh_bitwriter w;
+    lh_xor_state xs;
+    lh_dod_state ds;
+    C(buf.data) = 0;
+    lh_bitwriter_init(&w, &buf);
+    lh_xor_init(&xs);
+    for(i=0; i<NVAL; i++) lh_xor_put_float(&w, &xs, fv[i]);
+    lh_dod_init(&ds);
+    for(i=0; i<NVAL; i++) lh_dod_put(&w, &ds, ts[i]);
+    size = lh_bitwriter_finish(&w);
+
+    lh_bitreader r;
+    lh_bitreader_init(&r, P(buf.data), size);
+    lh_xor_init(&xs);
+    for(i=0; i<NVAL; i++) {
+        float f = lh_xor_get_float(&r, &xs);
+        fail += memcmp(&f, &fv[i], 4);
+    }
+    lh_dod_init(&ds);
+    for(i=0; i<NVAL; i++)
+        fail += (!lh_dod_get(&r, &ds, &t) || t != ts[i]);
+    fail += r.error;
+
+    lh_arr_free(AR(buf.data));
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(bits) {
+
+    TEST(bitstream);
+    TEST(bits_pack);
+    TEST(for_array);
+    TEST(series);
+
+} _TM;
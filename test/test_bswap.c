@@ -0,0 +1,412 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_bytes : byteorder operations, object serialization
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lh_cpu.h>
+#include <lh_bytes.h>
+
+static int cpu_levels[] = {
+    0, LH_CPU_SSE2|LH_CPU_SSSE3, -1
+};
+
+#define NMAX 300
+
+TF(byteorder, "typed reads and writes") {
+    static const uint8_t be[8] = { 0x81, 0x02, 0x83, 0x04, 0x85, 0x06, 0x87, 0x08 };
+    uint8_t buf[24], le[8];
+    int off, i;
+    for(i=0; i<8; i++) le[i] = be[7-i];
+
+    // at every alignment
+    for(off=0; off<8; off++) {
+        uint8_t *p = buf+off;
+        memset(buf, 0, sizeof(buf));
+        lh_write_short_be(p, 0x8102);
+        lh_write_int_be(p, 0x81028304);
+        lh_write_long_be(p, 0x8102830485068708ULL);
+        fail += (p != buf+off+14);
+        fail += (memcmp(buf+off, be, 2) || memcmp(buf+off+2, be, 4) || memcmp(buf+off+6, be, 8));
+
+        p = buf+off;
+        fail += (lh_read_short_be(p) != 0x8102);
+        fail += (lh_read_int_be(p) != 0x81028304);
+        fail += (lh_read_long_be(p) != 0x8102830485068708ULL);
+        fail += (p != buf+off+14);
+
+        p = buf+off;
+        memset(buf, 0, sizeof(buf));
+        lh_write_short_le(p, 0x8708);
+        lh_write_int_le(p, 0x85068708);
+        lh_write_long_le(p, 0x8102830485068708ULL);
+        fail += (memcmp(buf+off, le, 2) || memcmp(buf+off+2, le, 4) || memcmp(buf+off+6, le, 8));
+
+        p = buf+off;
+        fail += (lh_read_short_le(p) != 0x8708);
+        fail += (lh_read_int_le(p) != 0x85068708);
+        fail += (lh_read_long_le(p) != 0x8102830485068708ULL);
+
+        // floats use the integer representation
+        p = buf+off;
+        lh_write_float_be(p, -1.5f);
+        lh_write_double_le(p, 0.1);
+        fail += (lh_parse_int_be(buf+off) != 0xbfc00000);
+        fail += (lh_parse_long_le(buf+off+4) != 0x3fb999999999999aULL);
+        p = buf+off;
+        fail += (lh_read_float_be(p) != -1.5f || lh_read_double_le(p) != 0.1);
+    }
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(bswap_array, "bulk byte swapping") {
+    static uint8_t src[NMAX*8+8], dst[NMAX*8+8], buf[NMAX*8+8];
+    int l, i, n, off;
+
+    for(i=0; i<sizeof(src); i++) src[i] = rand();
+
+    for(l=0; l<sizeof(cpu_levels)/sizeof(int); l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        for(n=0; n<NMAX; n+=(n<40) ? 1 : 37) {
+            // unaligned source and destination
+            for(off=0; off<3; off++) {
+                uint8_t *s = src+off, *d = dst+2*off;
+
+                memset(dst, 0, sizeof(dst));
+                lh_bswap_copy_short(d, s, n);
+                for(i=0; i<n; i++)
+                    fail += (lh_parse_short_le(d+2*i) != lh_parse_short_be(s+2*i));
+                fail += (d[2*n] != 0);
+
+                memset(dst, 0, sizeof(dst));
+                lh_bswap_copy_int(d, s, n);
+                for(i=0; i<n; i++)
+                    fail += (lh_parse_int_le(d+4*i) != lh_parse_int_be(s+4*i));
+                fail += (d[4*n] != 0);
+
+                memset(dst, 0, sizeof(dst));
+                lh_bswap_copy_long(d, s, n);
+                for(i=0; i<n; i++)
+                    fail += (lh_parse_long_le(d+8*i) != lh_parse_long_be(s+8*i));
+                fail += (d[8*n] != 0);
+
+                // in place, twice restores the original
+                memcpy(buf, s, 8*n);
+                lh_ibswap_array_long(buf, n);
+                fail += (n > 0 && memcmp(buf, dst+2*off, 8*n));
+                lh_ibswap_array_long(buf, n);
+                fail += memcmp(buf, s, 8*n);
+            }
+        }
+    }
+    lh_cpu_restrict(-1);
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(conv, "byteorder conversion") {
+    uint8_t be[40], le[40];
+    double d[5], dl[5];
+    int32_t v[10];
+    int i;
+
+    for(i=0; i<5; i++) {
+        uint8_t *p = be+8*i;
+        lh_write_double_be(p, i*1.5-2);
+        p = le+8*i;
+        lh_write_double_le(p, i*1.5-2);
+    }
+    lh_conv_be_double(d, be, 5);
+    lh_conv_le_double(dl, le, 5);
+    for(i=0; i<5; i++)
+        fail += (d[i] != i*1.5-2 || dl[i] != d[i]);
+
+    // and back
+    lh_conv_be_double(d, d, 5);
+    fail += memcmp(d, be, 40);
+
+    for(i=0; i<10; i++) v[i] = -i*1000;
+    lh_conv_be_int(be, v, 10);
+    for(i=0; i<10; i++)
+        fail += ((int32_t)lh_parse_int_be(be+4*i) != -i*1000);
+    lh_conv_le_int(v, v, 10);
+    for(i=0; i<10; i++)
+        fail += (v[i] != -i*1000);
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+#define NCONV 600
+
+TF(numconv, "bulk numeric conversion") {
+    static const float   nv[8]  = { -2, -1, -0.5, 0, 0.5, 1, 2, 0 };
+    static const int16_t sn16[8] = { -32767, -32767, -16384, 0, 16384, 32767, 32767, -32767 };
+    static const uint16_t un16[8] = { 0, 0, 0, 0, 32768, 65535, 65535, 0 };
+    static const int8_t  sn8[8] = { -127, -127, -64, 0, 64, 127, 127, -127 };
+    static const uint8_t un8[8] = { 0, 0, 0, 0, 128, 255, 255, 0 };
+    static const struct { uint32_t f; uint16_t h; } hv[] = {
+        { 0x3f800000, 0x3c00 },     // 1
+        { 0xc0000000, 0xc000 },     // -2
+        { 0x477fe000, 0x7bff },     // 65504
+        { 0x477ff000, 0x7c00 },     // 65520 rounds to infinity
+        { 0x3dcccccd, 0x2e66 },     // 0.1
+        { 0x33800000, 0x0001 },     // 2^-24, the smallest subnormal
+        { 0x33000000, 0x0000 },     // 2^-25 rounds to even
+        { 0x80000000, 0x8000 },     // -0
+        { 0xff800000, 0xfc00 },     // -infinity
+        { 0x7fc00000, 0x7e00 },     // NaN
+    };
+    static float f[NCONV], g[NCONV], ref[NCONV];
+    static double d[NCONV], e[NCONV];
+    static uint8_t buf[NCONV*4+1], rbuf[NCONV*4];
+    static uint16_t h[65536];
+    static float hf[65536], rhf[65536];
+    int i, l;
+    float nan;
+    uint32_t u = 0x7fc00000;
+    memcpy(&nan, &u, 4);
+
+    for(l=0; l<sizeof(cpu_levels)/sizeof(int); l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+
+        // exact values, at an odd address for the stored side
+        for(i=0; i<NCONV; i++) memcpy(f+i, &hv[i%10].f, 4);
+        lh_float_to_half(buf+1, f, NCONV, 0);
+        for(i=0; i<NCONV; i++) {
+            uint16_t x;
+            memcpy(&x, buf+1+2*i, 2);
+            fail += (x != hv[i%10].h);
+        }
+        lh_half_to_float(g, buf+1, NCONV, 0);
+        for(i=0; i<NCONV; i++)
+            if (i%10 != 3 && i%10 != 4 && i%10 != 6 && i%10 != 9)
+                fail += memcmp(g+i, f+i, 4);
+
+        // every half survives the round trip, NaN is made quiet
+        for(i=0; i<65536; i++) h[i] = i;
+        for(i=0; i<65536; i+=NCONV) {
+            int n = (65536-i < NCONV) ? 65536-i : NCONV;
+            lh_half_to_float(g, h+i, n, 0);
+            lh_float_to_half(buf, g, n, 0);
+            int k;
+            for(k=0; k<n; k++) {
+                uint16_t x = i+k, y;
+                memcpy(&y, buf+2*k, 2);
+                if ((x&0x7c00) == 0x7c00 && (x&0x3ff)) x |= 0x200;
+                fail += (x != y);
+            }
+        }
+
+        // every half decodes to the same bits as in the scalar code
+        lh_cpu_restrict(0);
+        lh_half_to_float(rhf, h, 65536, 0);
+        lh_cpu_restrict(cpu_levels[l]);
+        lh_half_to_float(hf, h, 65536, 0);
+        fail += memcmp(hf, rhf, sizeof(hf));
+
+        // random bit patterns agree with the scalar code
+        srand(l);
+        for(i=0; i<NCONV; i++) {
+            u = ((uint32_t)rand()<<16) ^ rand();
+            memcpy(f+i, &u, 4);
+        }
+        lh_cpu_restrict(0);
+        lh_float_to_half(rbuf, f, NCONV, 0);
+        lh_cpu_restrict(cpu_levels[l]);
+        lh_float_to_half(buf, f, NCONV, 0);
+        fail += memcmp(buf, rbuf, NCONV*2);
+
+        // normalized values, clamped and rounded to even
+        for(i=0; i<NCONV; i++) f[i] = (i%8 == 7) ? nan : nv[i%8];
+        lh_float_to_snorm16(buf+1, f, NCONV, 0);
+        for(i=0; i<NCONV; i++) {
+            int16_t x;
+            memcpy(&x, buf+1+2*i, 2);
+            fail += (x != sn16[i%8]);
+        }
+        lh_float_to_unorm16(buf+1, f, NCONV, 0);
+        for(i=0; i<NCONV; i++) {
+            uint16_t x;
+            memcpy(&x, buf+1+2*i, 2);
+            fail += (x != un16[i%8]);
+        }
+        lh_float_to_snorm8(buf+1, f, NCONV);
+        for(i=0; i<NCONV; i++)
+            fail += ((int8_t)buf[1+i] != sn8[i%8]);
+        lh_float_to_unorm8(buf+1, f, NCONV);
+        for(i=0; i<NCONV; i++)
+            fail += (buf[1+i] != un8[i%8]);
+
+        // every 16-bit value survives the round trip, except -32768
+        for(i=0; i<65536; i+=NCONV) {
+            int n = (65536-i < NCONV) ? 65536-i : NCONV;
+            int k;
+            lh_snorm16_to_float(g, h+i, n, 0);
+            lh_float_to_snorm16(buf, g, n, 0);
+            for(k=0; k<n; k++) {
+                int16_t x = i+k, y;
+                memcpy(&y, buf+2*k, 2);
+                fail += (y != ((x == -32768) ? -32767 : x));
+                fail += (g[k] < -1 || g[k] > 1);
+            }
+            lh_unorm16_to_float(g, h+i, n, 0);
+            lh_float_to_unorm16(buf, g, n, 0);
+            fail += memcmp(buf, h+i, 2*n);
+        }
+        for(i=0; i<256; i++) buf[i] = i;
+        lh_snorm8_to_float(g, buf, 256);
+        lh_float_to_snorm8(rbuf, g, 256);
+        for(i=0; i<256; i++)
+            fail += (rbuf[i] != ((i == 128) ? 129 : i));
+        lh_unorm8_to_float(g, buf, 256);
+        lh_float_to_unorm8(rbuf, g, 256);
+        fail += memcmp(rbuf, buf, 256);
+        fail += (g[0] != 0 || g[255] != 1);
+
+        // byte-swapped, longer than a conversion chunk
+        for(i=0; i<NCONV; i++) {
+            f[i] = (i-300)*0.25f;
+            d[i] = (i-300)*0.1;
+        }
+        lh_float_to_half(h, f, NCONV, 0);
+        lh_float_to_half(buf+1, f, NCONV, LH_CONV_BE);
+        for(i=0; i<NCONV; i++)
+            fail += (lh_parse_short_be(buf+1+2*i) != h[i]);
+        lh_half_to_float(g, buf+1, NCONV, LH_CONV_BE);
+        fail += memcmp(g, f, sizeof(f));
+
+        for(i=0; i<NCONV; i++) f[i] = (i-300)/256.0f;
+        lh_float_to_snorm16(h, f, NCONV, 0);
+        lh_float_to_snorm16(buf+1, f, NCONV, LH_CONV_LE);
+        for(i=0; i<NCONV; i++)
+            fail += (lh_parse_short_le(buf+1+2*i) != h[i]);
+        lh_snorm16_to_float(ref, h, NCONV, 0);
+        lh_snorm16_to_float(g, buf+1, NCONV, LH_CONV_LE);
+        fail += memcmp(g, ref, sizeof(g));
+        fail += (g[0] != -1 || g[NCONV-1] != 1 || g[300] != 0);
+
+        lh_double_to_float(buf+1, d, NCONV, LH_CONV_BE);
+        for(i=0; i<NCONV; i++)
+            fail += (lh_parse_float_be(buf+1+4*i) != (float)d[i]);
+        lh_float_to_double(e, buf+1, NCONV, LH_CONV_BE);
+        for(i=0; i<NCONV; i++)
+            fail += (e[i] != (float)d[i]);
+        lh_double_to_float(g, d, NCONV, 0);
+        lh_float_to_double(e, g, NCONV, 0);
+        for(i=0; i<NCONV; i++)
+            fail += (e[i] != (float)d[i]);
+    }
+    lh_cpu_restrict(-1);
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(view, "typed array views") {
+    static uint8_t be[NMAX*8+1], le[NMAX*8+1];
+    static int32_t v[NMAX], w[NMAX];
+    static double d[NMAX];
+    int i, l;
+
+    // at an odd address
+    uint8_t *p = be+1, *q = le+1;
+    for(i=0; i<NMAX; i++) {
+        lh_write_int_be(p, i*1000-7);
+        lh_write_int_le(q, i*1000-7);
+    }
+    lh_view vb = lh_view_make(be+1, NMAX, 'i', LH_CONV_BE);
+    lh_view vl = lh_view_make(le+1, NMAX, 'i', LH_CONV_LE);
+    fail += (vb.n != NMAX || vb.size != 4);
+    for(i=0; i<NMAX; i++) {
+        fail += (lh_view_int(&vb, i) != i*1000-7 || lh_view_int(&vl, i) != i*1000-7);
+        fail += ((int32_t)lh_view_get_int(&vb, i) != i*1000-7);
+        fail += (lh_view_double(&vl, i) != i*1000-7);
+    }
+
+    // unsigned and signed
+    lh_view vu = lh_view_make(be+1, NMAX, 'I', LH_CONV_BE);
+    fail += (lh_view_int(&vu, 0) != 0xfffffff9LL || lh_view_double(&vu, 0) != 0xfffffff9LL);
+    lh_view vh = lh_view_make(be+3, 1, 'h', LH_CONV_BE);
+    fail += (lh_view_int(&vh, 0) != -7);
+    vh.type = 'H';
+    fail += (lh_view_int(&vh, 0) != 0xfff9);
+    lh_view vc = lh_view_make(be+4, 1, 'b', LH_CONV_BE);
+    fail += (lh_view_int(&vc, 0) != -7);
+
+    // bulk conversion in ranges, through all implementations
+    for(l=0; l<sizeof(cpu_levels)/sizeof(int); l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        memset(v, 0, sizeof(v));
+        fail += (lh_view_read(&vb, 0, v, 100) != 100);
+        fail += (lh_view_read(&vb, 100, v+100, NMAX) != NMAX-100);
+        fail += (lh_view_read(&vb, NMAX, v, 10) != 0 || lh_view_read(&vb, -1, v, 10) != 0);
+        memset(w, 0, sizeof(w));
+        fail += (lh_view_read(&vl, 0, w, NMAX) != NMAX);
+        for(i=0; i<NMAX; i++)
+            fail += (v[i] != i*1000-7 || w[i] != v[i]);
+    }
+    lh_cpu_restrict(-1);
+
+    // slices
+    lh_view s = lh_view_slice(&vb, 290, 20);
+    fail += (s.n != 10 || lh_view_int(&s, 0) != 290000-7);
+    s = lh_view_slice(&vb, NMAX+5, 1);
+    fail += (s.n != 0 || lh_view_read(&s, 0, v, 1) != 0);
+
+    // stores, in the byteorder of the view
+    for(i=0; i<NMAX; i++) v[i] = -i;
+    fail += (lh_view_write(&vb, 0, v, NMAX) != NMAX);
+    for(i=0; i<NMAX; i++)
+        fail += ((int32_t)lh_parse_int_be(be+1+4*i) != -i);
+    lh_view_put_int(&vl, 3, 123);
+    lh_view_put_double(&vl, 4, 77.9);
+    fail += (lh_view_int(&vl, 3) != 123 || lh_view_int(&vl, 4) != 77);
+
+    for(i=0; i<NMAX; i++) d[i] = i*0.25;
+    lh_view vd = lh_view_make(le+1, NMAX, 'd', LH_CONV_LE);
+    fail += (lh_view_write(&vd, 0, d, NMAX) != NMAX);
+    lh_view_put_double(&vd, 7, -1.5);
+    fail += (lh_parse_double_le(le+1+8*7) != -1.5 || lh_view_double(&vd, 9) != 2.25);
+    lh_view_put_int(&vd, 9, 5);
+    fail += (lh_view_get_double(&vd, 9) != 5);
+
+    // signalling NaNs are kept bit for bit
+    static const uint8_t snan[12] = { 0x7f, 0x80, 0x00, 0x01, 0x7f, 0xf0, 0, 0, 0, 0, 0, 1 };
+    uint8_t nbuf[12];
+    lh_view sf = lh_view_make(snan, 1, 'f', LH_CONV_BE);
+    lh_view sd = lh_view_make(snan+4, 1, 'd', LH_CONV_BE);
+    lh_view nf = lh_view_make(nbuf, 1, 'f', LH_CONV_BE);
+    lh_view nd = lh_view_make(nbuf+4, 1, 'd', LH_CONV_BE);
+    lh_view_set_float(&nf, 0, lh_view_get_float(&sf, 0));
+    lh_view_set_double(&nd, 0, lh_view_get_double(&sd, 0));
+    fail += memcmp(nbuf, snan, 12);
+
+    // invalid types make empty views
+    lh_view vx = lh_view_make(be, NMAX, 'x', LH_CONV_BE);
+    fail += (vx.n != 0 || lh_view_read(&vx, 0, v, 1) != 0);
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(bswap) {
+
+    TEST(byteorder);
+    TEST(bswap_array);
+    TEST(conv);
+    TEST(numconv);
+    TEST(view);
+
+} _TM;
@@ -0,0 +1,123 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_checksum : CRC32C, CRC32, xxHash64
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lh_cpu.h>
+#include <lh_checksum.h>
+
+static int cpu_levels[] = {
+    0, LH_CPU_SSE2|LH_CPU_SSE42, LH_CPU_SSE2|LH_CPU_SSE41|LH_CPU_PCLMUL, -1
+};
+
+// bit by bit reference
+static uint32_t crc_ref(uint32_t poly, const uint8_t *p, ssize_t len) {
+    uint32_t c = 0xffffffff;
+    int k;
+    while (len--) {
+        c ^= *p++;
+        for(k=0; k<8; k++) c = (c & 1) ? (c>>1)^poly : c>>1;
+    }
+    return ~c;
+}
+
+#define NBUF 40000
+
+static uint8_t buf[NBUF];
+
+static const ssize_t lengths[] = {
+    0, 1, 2, 7, 8, 9, 15, 16, 17, 63, 64, 65, 79, 80, 127, 128, 129, 1000,
+    4095, 4096, 12287, 12288, 12289, 12345, 24576, 30000, NBUF-8,
+};
+
+TF(crc, "CRC32C and CRC32") {
+    int l, i, off;
+
+    fail += (lh_crc32c("123456789", 9) != 0xe3069283);
+    fail += (lh_crc32("123456789", 9) != 0xcbf43926);
+    fail += (lh_crc32c("", 0) != 0 || lh_crc32("", 0) != 0);
+
+    srand(43);
+    for(i=0; i<NBUF; i++) buf[i] = rand();
+
+    for(l=0; l<sizeof(cpu_levels)/sizeof(int); l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        for(i=0; i<sizeof(lengths)/sizeof(lengths[0]); i++) {
+            // at different alignments
+            for(off=0; off<8; off+=3) {
+                ssize_t len = lengths[i];
+                uint32_t c = lh_crc32c(buf+off, len);
+                uint32_t z = lh_crc32(buf+off, len);
+                fail += (c != crc_ref(0x82f63b78, buf+off, len));
+                fail += (z != crc_ref(0xedb88320, buf+off, len));
+
+                // incremental, and combined from separate parts
+                ssize_t s = len/3;
+                fail += (lh_crc32c_update(lh_crc32c(buf+off, s), buf+off+s, len-s) != c);
+                fail += (lh_crc32_update(lh_crc32(buf+off, s), buf+off+s, len-s) != z);
+                fail += (lh_crc32c_combine(lh_crc32c(buf+off, s), lh_crc32c(buf+off+s, len-s), len-s) != c);
+                fail += (lh_crc32_combine(lh_crc32(buf+off, s), lh_crc32(buf+off+s, len-s), len-s) != z);
+            }
+        }
+    }
+    lh_cpu_restrict(-1);
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(xxh64, "xxHash64") {
+    // the sanity test of the reference implementation
+    uint8_t sanity[101];
+    uint32_t gen = 2654435761U;
+    uint64_t prime = 2654435761U;
+    int i, step;
+    for(i=0; i<sizeof(sanity); i++) {
+        sanity[i] = gen>>24;
+        gen *= gen;
+    }
+
+    fail += (lh_xxh64(NULL, 0, 0) != 0xef46db3751d8e999ULL);
+    fail += (lh_xxh64(NULL, 0, prime) != 0xac75fda2929b17efULL);
+    fail += (lh_xxh64(sanity, 1, 0) != 0x4fce394cc88952d8ULL);
+    fail += (lh_xxh64(sanity, 1, prime) != 0x739840cb819fa723ULL);
+    fail += (lh_xxh64(sanity, 14, 0) != 0xcffa8db881bc3a3dULL);
+    fail += (lh_xxh64(sanity, 14, prime) != 0x5b9611585efcc9cbULL);
+    fail += (lh_xxh64(sanity, 101, 0) != 0x0eab543384f878adULL);
+    fail += (lh_xxh64(sanity, 101, prime) != 0xcaa65939306f1e21ULL);
+    fail += (lh_xxh64("abc", 3, 0) != 0x44bc2cf5ad770999ULL);
+
+    // incremental in steps of different sizes
+    srand(44);
+    for(i=0; i<NBUF; i++) buf[i] = rand();
+    uint64_t h = lh_xxh64(buf, 10000, 7);
+    for(step=1; step<100; step+=(step<40) ? 1 : 13) {
+        lh_xxh64_state s;
+        lh_xxh64_init(&s, 7);
+        for(i=0; i<10000; i+=step)
+            lh_xxh64_update(&s, buf+i, (i+step <= 10000) ? step : 10000-i);
+        fail += (lh_xxh64_digest(&s) != h);
+    }
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(checksum) {
+
+    TEST(crc);
+    TEST(xxh64);
+
+} _TM;
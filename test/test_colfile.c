@@ -0,0 +1,258 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_colfile : columnar container files
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lh_marr.h>
+#include <lh_files.h>
+#include <lh_colfile.h>
+
+#define NROWS 1000
+
+#ifdef LH_BIG_ENDIAN
+#define HOST_ORDER LH_COL_BE
+#else
+#define HOST_ORDER LH_COL_LE
+#endif
+
+typedef struct { int16_t a; uint8_t b[5]; } rec;
+
+static int temp_path(char *path) {
+    strcpy(path, "/tmp/lhtest_colXXXXXX");
+    int fd = mkstemp(path);
+    if (fd < 0) return -1;
+    close(fd);
+    return 0;
+}
+
+TF(colfile_marr, "multi-array round trip") {
+    char path[32];
+    int cnt = 0, i;
+    uint32_t *id = NULL;
+    float *x = NULL;
+    double *v = NULL;
+    int16_t *h = NULL;
+    uint8_t *c = NULL;
+    rec *r = NULL;
+
+    if (temp_path(path) < 0) {
+        printf("mkstemp failed\n");
+        return 1;
+    }
+
+    lh_multiarray_allocate(cnt, NROWS, MAF(id), MAF(x), MAF(v), MAF(h), MAF(c), MAF(r));
+    for(i=0; i<cnt; i++) {
+        id[i] = i*7+100;
+        x[i] = i*0.5f;
+        v[i] = -i/3.0;
+        h[i] = -i;
+        c[i] = i;
+        r[i].a = i*3;
+        memset(r[i].b, i, 5);
+    }
+
+    off_t size = lh_colfile_save(path, cnt, "id,x,v,h,c,r", "IfdhBr",
+                                 MAF(id), MAF(x), MAF(v), MAF(h), MAF(c), MAF(r));
+    fail += (size != lh_filesize_path(path));
+
+    lh_colfile f;
+    fail += (lh_colfile_open(&f, path) != 0);
+    fail += (f.nrows != NROWS || f.ncols != 6);
+    fail += (lh_colfile_find(&f, "v") != 2 || lh_colfile_find(&f, "w") != -1);
+
+    // in place, aligned and without a copy
+    for(i=0; i<f.ncols; i++) {
+        const uint8_t *d = lh_colfile_data(&f, i);
+        fail += (!d || ((uintptr_t)d % LH_COL_ALIGN) != 0);
+        fail += !lh_colfile_verify(&f, i);
+    }
+    const float *fx = lh_colfile_data(&f, lh_colfile_find(&f, "x"));
+    fail += memcmp(fx, x, NROWS*sizeof(*x));
+    const rec *fr = lh_colfile_data(&f, lh_colfile_find(&f, "r"));
+    fail += (f.cols[5].elsize != sizeof(rec) || memcmp(fr, r, NROWS*sizeof(*r)));
+    fail += (lh_colfile_data(&f, 6) != NULL || lh_colfile_data(&f, -1) != NULL);
+
+    // a subset into a new multi-array
+    int cnt2 = 0;
+    uint32_t *id2 = NULL;
+    double *v2 = NULL;
+    fail += (lh_colfile_load(&f, cnt2, "v,id", MAF(v2), MAF(id2)) != 0);
+    fail += (cnt2 != NROWS || memcmp(id2, id, NROWS*4) || memcmp(v2, v, NROWS*8));
+    free(id2);
+    free(v2);
+    id2 = NULL;
+    v2 = NULL;
+
+    // missing columns and mismatching sizes fail without allocating
+    fail += (lh_colfile_load(&f, cnt2, "id,w", MAF(id2), MAF(v2)) != -1);
+    fail += (lh_colfile_load(&f, cnt2, "h", MAF(id2)) != -1);
+    fail += (id2 != NULL || v2 != NULL);
+
+    lh_colfile_close(&f);
+    unlink(path);
+
+    free(id); free(x); free(v); free(h); free(c); free(r);
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(colfile_stored, "byteorder and frame-of-reference columns") {
+    static uint32_t ids[NROWS], tmp[NROWS];
+    static int16_t s[NROWS], stmp[NROWS];
+    static double d[NROWS], dtmp[NROWS];
+    char path[32];
+    int i;
+
+    if (temp_path(path) < 0) {
+        printf("mkstemp failed\n");
+        return 1;
+    }
+
+    uint32_t x = 5000;
+    for(i=0; i<NROWS; i++) {
+        ids[i] = x += 1+i%13;
+        s[i] = i*37-20000;
+        d[i] = i*1.25-7;
+    }
+
+    lh_colfile_writer w;
+    fail += (lh_colfile_create(&w, path, NROWS) != 0);
+    fail += (lh_colfile_add(&w, "ids", 'I', LH_COL_FOR|LH_COL_DELTA, ids, 4) != 0);
+    fail += (lh_colfile_add(&w, "raw", 'I', 0, ids, 4) != 0);
+    fail += (lh_colfile_add(&w, "sbe", 'h', LH_COL_BE, s, 2) != 0);
+    fail += (lh_colfile_add(&w, "sle", 'h', LH_COL_LE, s, 2) != 0);
+    fail += (lh_colfile_add(&w, "dbe", 'd', LH_COL_BE, d, 8) != 0);
+    fail += (lh_colfile_add(&w, "ifor", 'I', LH_COL_FOR, ids, 4) != 0);
+    fail += (lh_colfile_finish(&w) < 0);
+
+    lh_colfile f;
+    fail += (lh_colfile_open(&f, path) != 0);
+    fail += (f.ncols != 6);
+
+    // the compressed column is much smaller
+    fail += (f.cols[0].size*4 > f.cols[1].size);
+    fail += (f.cols[0].flags != (LH_COL_FOR|LH_COL_DELTA|LH_COL_LE));
+    fail += (f.cols[2].flags != LH_COL_BE || f.cols[3].flags != LH_COL_LE);
+
+    // stored big-endian, whatever the host order
+    const uint8_t *sbe = f.map+f.cols[2].offset;
+    fail += (lh_parse_short_be((uint8_t *)sbe+2*5) != (uint16_t)s[5]);
+
+    for(i=0; i<f.ncols; i++) {
+        const char *n = f.cols[i].name;
+        int inplace = (f.cols[i].flags & HOST_ORDER) && !(f.cols[i].flags & LH_COL_FOR);
+        fail += ((lh_colfile_data(&f, i) != NULL) != inplace);
+        fail += !lh_colfile_verify(&f, i);
+
+        if (n[0] == 'i' || n[0] == 'r') {
+            memset(tmp, 0, sizeof(tmp));
+            fail += (lh_colfile_read(&f, i, tmp) != NROWS*4);
+            fail += memcmp(tmp, ids, sizeof(ids));
+        }
+        else if (n[0] == 's') {
+            memset(stmp, 0, sizeof(stmp));
+            fail += (lh_colfile_read(&f, i, stmp) != NROWS*2);
+            fail += memcmp(stmp, s, sizeof(s));
+        }
+        else {
+            memset(dtmp, 0, sizeof(dtmp));
+            fail += (lh_colfile_read(&f, i, dtmp) != NROWS*8);
+            fail += memcmp(dtmp, d, sizeof(d));
+        }
+    }
+
+    // single values of a compressed column, in place
+    lh_for_array a;
+    fail += !lh_colfile_for_array(&f, 0, &a);
+    fail += (lh_for_get(&a, 0) != ids[0] || lh_for_get(&a, 777) != ids[777]);
+    fail += lh_colfile_for_array(&f, 1, &a);
+
+    // single values in any byteorder, in place
+    lh_view v;
+    fail += lh_colfile_view(&f, 0, &v);
+    fail += (!lh_colfile_view(&f, 2, &v) || v.n != NROWS || lh_view_int(&v, 5) != s[5]);
+    fail += (!lh_colfile_view(&f, 4, &v) || lh_view_double(&v, 777) != d[777]);
+    fail += (lh_view_read(&v, 990, dtmp, 20) != 10 || dtmp[9] != d[999]);
+
+    lh_colfile_close(&f);
+
+    // invalid columns make the file fail
+    fail += (lh_colfile_create(&w, path, NROWS) != 0);
+    fail += (lh_colfile_add(&w, "f", 'f', LH_COL_FOR, d, 4) != -1);
+    fail += (lh_colfile_add(&w, "d", 'd', 0, d, 4) != -1);
+    fail += (lh_colfile_finish(&w) != -1);
+
+    unlink(path);
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(colfile_damaged, "damaged and empty files") {
+    static uint32_t va[NROWS];
+    uint32_t *v = va;
+    char path[32];
+    int cnt = NROWS, i;
+    uint8_t *buf = NULL;
+
+    if (temp_path(path) < 0) {
+        printf("mkstemp failed\n");
+        return 1;
+    }
+
+    for(i=0; i<NROWS; i++) v[i] = i;
+    off_t size = lh_colfile_save(path, cnt, "v", "I", MAF(v));
+    fail += (size <= 0);
+    fail += (lh_load_alloc(path, &buf) != size);
+
+    lh_colfile f;
+
+    // the footer is checked on opening
+    buf[size-30] ^= 1;
+    fail += (lh_save(path, buf, size) != size);
+    fail += (lh_colfile_open(&f, path) != -1);
+    buf[size-30] ^= 1;
+
+    fail += (lh_save(path, buf, size-1) != size-1);
+    fail += (lh_colfile_open(&f, path) != -1);
+    fail += (lh_save(path, buf, 40) != 40);
+    fail += (lh_colfile_open(&f, path) != -1);
+
+    // the column data only on request
+    buf[64+100] ^= 1;
+    fail += (lh_save(path, buf, size) != size);
+    fail += (lh_colfile_open(&f, path) != 0);
+    fail += lh_colfile_verify(&f, 0);
+    lh_colfile_close(&f);
+    free(buf);
+
+    // no rows
+    fail += (lh_colfile_save(path, 0, "a,b", "Ii", MAF(v), MAF(v)) <= 0);
+    fail += (lh_colfile_open(&f, path) != 0);
+    fail += (f.nrows != 0 || f.ncols != 2 || !lh_colfile_data(&f, 1));
+    fail += (lh_colfile_read(&f, 0, v) != 0);
+    lh_colfile_close(&f);
+
+    unlink(path);
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(colfile) {
+
+    TEST(colfile_marr);
+    TEST(colfile_stored);
+    TEST(colfile_damaged);
+
+} _TM;
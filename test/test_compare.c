@@ -0,0 +1,204 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_compare : string comparison and sort keys
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <lh_cpu.h>
+#include <lh_strings.h>
+#include <lh_compare.h>
+#include <lh_dir.h>
+
+#define S(x) lh_span_cstr(x)
+
+static int cpu_levels[] = {
+    0, LH_CPU_SSE2, -1
+};
+
+static int sign(int x) {
+    return (x > 0) - (x < 0);
+}
+
+TF(casecmp, "ASCII case-insensitive compare") {
+    int l;
+    char a[200], b[200];
+
+    for(l=0; l<sizeof(cpu_levels)/sizeof(int); l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+
+        fail += (lh_casecmp(S("Hello"), S("hELLO")) != 0);
+        fail += (lh_casecmp(S("abc"), S("ABD")) >= 0);
+        fail += (lh_casecmp(S("ab"), S("AB_")) >= 0);
+        fail += (lh_casecmp(S("[") , S("a")) >= 0);  // '[' < 'a', but > 'A'
+
+        // against strcasecmp in the C locale, with the difference placed
+        // at every position of long strings
+        int i, n;
+        for(n=0; n<150; n++) {
+            for(i=0; i<n; i++) {
+                a[i] = 'A'+(i*7)%26;
+                b[i] = a[i]|0x20;
+            }
+            a[n] = b[n] = 0;
+            fail += (lh_casecmp(S(a), S(b)) != 0);
+            for(i=0; i<n; i++) {
+                char c = b[i];
+                b[i] = (c == 'z') ? 'a' : c+1;
+                fail += (sign(lh_casecmp(S(a), S(b))) != sign(strcasecmp(a, b)));
+                fail += (sign(lh_strcmp_f(S(a), S(b), 0)) != sign(strcmp(a, b)));
+                b[i] = c;
+            }
+        }
+
+        // non-ASCII bytes are not folded
+        fail += (lh_casecmp(S("\xc4"), S("\xe4")) == 0);
+    }
+    lh_cpu_restrict(-1);
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+// in sorted natural order
+static const char *natural[] = {
+    "", "0", "00", "1", "01", "001", "2", "10", "010", "99", "100",
+    "a", "a0", "a1", "a1a", "a1b", "a01", "a01a", "a2", "a10", "a10b",
+    "b", "file9.txt", "file10.txt", "file12345678901234567890",
+    "file123456789012345678901", "x",
+};
+
+TF(natcmp, "natural order compare") {
+    int l, i, j, n = sizeof(natural)/sizeof(natural[0]);
+
+    for(l=0; l<sizeof(cpu_levels)/sizeof(int); l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        for(i=0; i<n; i++)
+            for(j=0; j<n; j++)
+                fail += (sign(lh_natcmp(S(natural[i]), S(natural[j]))) != sign(i-j));
+
+        // numbers after a long common prefix
+        const char *p = "/a/long/common/prefix/to/skip/file";
+        char a[100], b[100];
+        sprintf(a, "%s%d", p, 9);
+        sprintf(b, "%s%d", p, 10);
+        fail += (lh_natcmp(S(a), S(b)) >= 0);
+        sprintf(a, "%s%d", p, 123456789);
+        sprintf(b, "%s%d", p, 123456799);
+        fail += (lh_natcmp(S(a), S(b)) >= 0);
+        sprintf(a, "%s%dB", p, 7);
+        sprintf(b, "%s%da", p, 7);
+        fail += (lh_strcmp_f(S(a), S(b), LH_CMP_NATURAL|LH_CMP_IGNORECASE) <= 0);
+        fail += (lh_natcmp(S(a), S(b)) >= 0);
+    }
+    lh_cpu_restrict(-1);
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(sortkey, "sort keys") {
+    static const char chars[] = "0019aAbZ_.";
+    int i, j, f;
+    char str[64][12];
+    lh_span s[64];
+    uint8_t keys[64][36];
+    ssize_t klen[64];
+
+    // random strings of digits and letters
+    srand(34);
+    for(i=0; i<64; i++) {
+        int len = rand()%12;
+        for(j=0; j<len; j++) str[i][j] = chars[rand()%10];
+        s[i] = lh_span_make(str[i], len);
+    }
+
+    for(f=0; f<4; f++) {
+        for(i=0; i<64; i++)
+            klen[i] = lh_sortkey(s[i], f, keys[i]);
+        for(i=0; i<64; i++)
+            for(j=0; j<64; j++) {
+                int kc = lh_span_cmp(lh_span_make(keys[i], klen[i]),
+                                     lh_span_make(keys[j], klen[j]));
+                fail += (sign(kc) != sign(lh_strcmp_f(s[i], s[j], f)));
+            }
+
+        ssize_t order[64];
+        lh_sort_order(s, 64, f, order);
+        for(i=1; i<64; i++)
+            fail += (lh_strcmp_f(s[order[i-1]], s[order[i]], f) > 0);
+    }
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(dirsort, "directory walk sort flags") {
+    char base[] = "/tmp/lhtest_cmpXXXXXX";
+    if (!mkdtemp(base)) {
+        printf("mkdtemp failed\n");
+        fail++;
+        return fail;
+    }
+
+    static const char *files[] = { "f10", "F2", "d1", "f1" };
+    char p[256];
+    int i;
+    for(i=0; i<4; i++) {
+        sprintf(p, "%s/%s", base, files[i]);
+        if (files[i][0] == 'd')
+            mkdir(p, 0700);
+        else
+            fclose(fopen(p, "w"));
+    }
+
+    static const struct { int flags; const char *exp; } tc[] = {
+        { LH_DW_SORT,                                   "F2 d1 f1 f10 " },
+        { LH_DW_SORT|LH_DW_SORT_DIRFIRST,               "d1 F2 f1 f10 " },
+        { LH_DW_SORT|LH_DW_SORT_IGNORECASE,             "d1 f1 f10 F2 " },
+        { LH_DW_SORT|LH_DW_SORT_NATURAL,                "F2 d1 f1 f10 " },
+        { LH_DW_SORT|LH_DW_SORT_NATURAL|LH_DW_SORT_IGNORECASE, "d1 f1 F2 f10 " },
+    };
+
+    for(i=0; i<sizeof(tc)/sizeof(tc[0]); i++) {
+        lh_dirwalk *dw = lh_dirwalk_create(base, tc[i].flags|LH_DW_REPORT_FILE|LH_DW_REPORT_DIR);
+        lh_dwres dr;
+        char got[256] = "";
+        while (lh_dirwalk_next(dw, &dr) > 0) {
+            size_t n = strlen(got);
+            if (dr.level == 1 && snprintf(got+n, sizeof(got)-n, "%s ", dr.name) >= sizeof(got)-n)
+                break;
+        }
+        lh_dirwalk_destroy(dw);
+
+        int f = strcmp(got, tc[i].exp) != 0;
+        if (f) printf("flags %x: '%s' != '%s'\n", tc[i].flags, got, tc[i].exp);
+        fail += f;
+    }
+
+    sprintf(p, "rm -rf %s", base);
+    if (system(p)) fail++;
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(compare) {
+
+    TEST(casecmp);
+    TEST(natcmp);
+    TEST(sortkey);
+    TEST(dirsort);
+
+} _TM;
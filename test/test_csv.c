@@ -0,0 +1,308 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_csv : CSV/TSV reader
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <locale.h>
+
+#include <lh_cpu.h>
+#include <lh_marr.h>
+#include <lh_csv.h>
+
+static const int cpu_levels[] = {
+    0, LH_CPU_SSE2, -1
+};
+#define NLEVELS (sizeof(cpu_levels)/sizeof(cpu_levels[0]))
+
+// read text fed in chunks of the given size, and describe the records in
+// a string - fields separated by |, records terminated by ;
+static void read_chunked(const char *text, ssize_t len, ssize_t chunk,
+                         uint8_t sep, int flags, const int *cols, int ncols, char *out) {
+    lh_csv_reader r;
+    lh_csv_init(&r, sep, flags);
+    if (ncols) lh_csv_select(&r, cols, ncols);
+    ssize_t pos = 0, o = 0;
+    out[0] = 0;
+
+    while (1) {
+        int n, i;
+        while ((n = lh_csv_next(&r)) > 0) {
+            for(i=0; i<n; i++) {
+                if (r.field_p[i].len) memcpy(out+o, r.field_p[i].ptr, r.field_p[i].len);
+                o += r.field_p[i].len;
+                out[o++] = (i<n-1) ? '|' : ';';
+            }
+        }
+        if (pos >= len) {
+            if (r.eof) break;
+            lh_csv_finish(&r);
+            continue;
+        }
+        ssize_t clen = (len-pos < chunk) ? len-pos : chunk;
+        lh_csv_feed(&r, (const uint8_t *)text+pos, clen);
+        pos += clen;
+    }
+    out[o] = 0;
+    lh_csv_free(&r);
+}
+
+// append a field to the description, decoding it if it is quoted
+static ssize_t ref_field(const char *f, ssize_t len, char *out) {
+    ssize_t i, o = 0;
+    int inq = 0;
+    if (len == 0 || f[0] != '"') {
+        memcpy(out, f, len);
+        return len;
+    }
+    for(i=0; i<len; i++) {
+        if (f[i] != '"') out[o++] = f[i];
+        else if (inq && i+1<len && f[i+1] == '"') out[o++] = f[i++];
+        else inq = !inq;
+    }
+    return o;
+}
+
+// straightforward reference implementation of the same description
+static void read_reference(const char *text, ssize_t len, char *out) {
+    ssize_t i, o = 0, rs = 0, fs = 0;
+    int inq = 0;
+    for(i=0; i<=len; i++) {
+        if (i == len || (text[i] == '\n' && !inq)) {
+            // end of record - strip a \r, skip empty lines
+            ssize_t e = (i > rs && text[i-1] == '\r') ? i-1 : i;
+            if (e > rs) {
+                o += ref_field(text+fs, e-fs, out+o);
+                out[o++] = ';';
+            }
+            rs = fs = i+1;
+            inq = 0;
+        }
+        else if (text[i] == '"')
+            inq = !inq;
+        else if (text[i] == ',' && !inq) {
+            o += ref_field(text+fs, i-fs, out+o);
+            out[o++] = '|';
+            fs = i+1;
+        }
+    }
+    out[o] = 0;
+}
+
+#define TEST_CSV(text,cols,ncols,sep,flags,exp) {                       \
+        int f=0, chunk;                                                 \
+        char out[1024];                                                 \
+        for(chunk=1; chunk<=80; chunk++) {                              \
+            read_chunked(text, strlen(text), chunk, sep, flags, cols, ncols, out); \
+            if (strcmp(out, exp)) {                                     \
+                printf("chunk=%d: '%s' != '%s'\n", chunk, out, exp);    \
+                f++;                                                    \
+                break;                                                  \
+            }                                                           \
+        }                                                               \
+        printf("%s: %s\n", text, PASSFAIL(!f));                         \
+        fail += f;                                                      \
+    }
+
+TF(records, "splitting records") {
+    static const int c20[] = { 2, 0 };
+    int l;
+    for(l=0; l<NLEVELS; l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        printf("cpu=%02x\n", lh_cpu_features());
+
+        TEST_CSV("a,b,c\n1,2,3\n", NULL, 0, ',', 0, "a|b|c;1|2|3;");
+        TEST_CSV("a,b\r\nc,d", NULL, 0, ',', 0, "a|b;c|d;");
+        TEST_CSV("\"x,y\",\"he said \"\"hi\"\"\",\"multi\nline\"\r\nlast",
+                 NULL, 0, ',', 0, "x,y|he said \"hi\"|multi\nline;last;");
+        TEST_CSV(",,\n\n\r\n\"\"\nz", NULL, 0, ',', 0, "||;;z;");
+        TEST_CSV("a field long enough to span a whole block of sixty-four bytes,"
+                 "\"and a quoted one, with a separator, spanning the next block\"\n",
+                 NULL, 0, ',', 0,
+                 "a field long enough to span a whole block of sixty-four bytes|"
+                 "and a quoted one, with a separator, spanning the next block;");
+        TEST_CSV("a,b,c\nd\n\"x\"\"\",y,\"z\"\"\"\n", c20, 2, ',', 0, "c|a;|d;z\"|x\";");
+        TEST_CSV("a\"b\tc\"\td\n", NULL, 0, '\t', LH_CSV_NOQUOTE, "a\"b|c\"|d;");
+        TEST_CSV("", NULL, 0, ',', 0, "");
+    }
+    lh_cpu_restrict(-1);
+} _TF
+
+TF(random, "random data") {
+    ssize_t len = 300000, i;
+    char *text = malloc(len+1);
+    char *exp = malloc(len+1), *out = malloc(len+1);
+    static const char chars[] = "abc,,\"\n\r xyz0123";
+
+    srand(3);
+    for(i=0; i<len; i++)
+        text[i] = chars[rand()%(sizeof(chars)-1)];
+    text[len] = 0;
+    read_reference(text, len, exp);
+
+    int l;
+    for(l=0; l<NLEVELS; l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        int f = 0;
+        static const ssize_t chunks[] = { 1000, 4099, 65536, 300000 };
+        for(i=0; i<sizeof(chunks)/sizeof(chunks[0]); i++) {
+            read_chunked(text, len, chunks[i], ',', 0, NULL, 0, out);
+            f += (strcmp(out, exp) != 0);
+        }
+        printf("cpu=%02x: %s\n", lh_cpu_features(), PASSFAIL(!f));
+        fail += f;
+    }
+    lh_cpu_restrict(-1);
+
+    free(text);
+    free(exp);
+    free(out);
+} _TF
+
+TF(numbers, "number conversion") {
+    int i;
+    double d;
+    int64_t v;
+    char s[64];
+
+#define SPAN(x) lh_span_make(x, strlen(x))
+    fail += (!lh_csv_int(SPAN("-9223372036854775808"), &v) || v != INT64_MIN);
+    fail += (!lh_csv_int(SPAN("+42"), &v) || v != 42);
+    fail += lh_csv_int(SPAN("9223372036854775808"), &v);
+    fail += lh_csv_int(SPAN("1.5"), &v);
+    fail += lh_csv_int(SPAN("-"), &v);
+    fail += lh_csv_double(SPAN("1.5x"), &d);
+    fail += lh_csv_double(SPAN("e5"), &d);
+    fail += lh_csv_double(SPAN("1e"), &d);
+    fail += (!lh_csv_double(SPAN("-inf"), &d) || d != -INFINITY);
+    fail += (!lh_csv_double(SPAN(".5"), &d) || d != 0.5);
+
+    // fields too long for the stack buffer of the strtod fallback
+    char big[200];
+    memset(big, '1', sizeof(big)-1);
+    big[sizeof(big)-1] = 0;
+    fail += (!lh_csv_double(SPAN(big), &d) || d != strtod(big, NULL));
+    memset(big, '0', 100);
+    big[1] = '.';
+    big[99] = '5';
+    big[100] = 0;
+    fail += (!lh_csv_double(SPAN(big), &d) || d != 5e-98);
+
+    // the fast path must round like strtod
+    srand(4);
+    for(i=0; i<100000; i++) {
+        double x = (double)rand()/RAND_MAX;
+        int e = rand()%40-20;
+        for(; e>0; e--) x *= 10;
+        for(; e<0; e++) x /= 10;
+        sprintf(s, (i&1) ? "%.17g" : "%.6f", x);
+        fail += (!lh_csv_double(SPAN(s), &d) || d != strtod(s, NULL));
+    }
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(locale, "numbers under a comma locale") {
+    static const char *names[] = {
+        "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8", "ru_RU.UTF-8", "de_DE", NULL,
+    };
+    int i;
+    for(i=0; names[i]; i++)
+        if (setlocale(LC_NUMERIC, names[i]) && localeconv()->decimal_point[0] == ',')
+            break;
+    if (!names[i]) {
+        setlocale(LC_NUMERIC, "C");
+        printf("no comma locale installed, skipped\n");
+        return 0;
+    }
+
+    // both the fast path and the strtod fallback
+    double d;
+    fail += (!lh_csv_double(SPAN("1.5"), &d) || d != 1.5);
+    fail += (!lh_csv_double(SPAN("1.2345678901234567890"), &d) || d != 1.2345678901234567);
+    fail += (!lh_csv_double(SPAN("1e300"), &d) || d != 1e300);
+    fail += lh_csv_double(SPAN("1,5"), &d);
+
+    setlocale(LC_NUMERIC, "C");
+    printf("%s: %s\n", names[i], PASSFAIL(!fail));
+} _TF
+
+TF(columns, "conversion into multi-array columns") {
+    static const char text[] =
+        "id,name,value,ratio\n"
+        "1,one,2.5,0.5\n"
+        "-2,\"two, quoted\",1e3,\n"
+        "3,three\n";
+    int cnt = 0;
+    int64_t *id = NULL;
+    double *val = NULL;
+    float *ratio = NULL;
+    static const int cols[] = { 0, 2, 3 };
+
+    lh_csv_reader r;
+    lh_csv_init(&r, ',', 0);
+    lh_csv_select(&r, cols, 3);
+    lh_csv_feed(&r, (const uint8_t *)text, sizeof(text)-1);
+    lh_csv_finish(&r);
+
+    // header row is not numeric
+    fail += (lh_csv_columns(&r, cnt, 16, "ldf", MAF(id), MAF(val), MAF(ratio)) != -1);
+    fail += (r.errrec != 0 || r.errcol != 0 || cnt != 0);
+
+    fail += (lh_csv_columns(&r, cnt, 16, "ldf", MAF(id), MAF(val), MAF(ratio)) != 3);
+    fail += (cnt != 3);
+    fail += (id[0] != 1 || id[1] != -2 || id[2] != 3);
+    fail += (val[0] != 2.5 || val[1] != 1000 || !isnan(val[2]));
+    fail += (ratio[0] != 0.5f || !isnan(ratio[1]) || !isnan(ratio[2]));
+    lh_csv_free(&r);
+
+    // a large input through many chunks, appending to the same arrays
+    int32_t *a = NULL;
+    double *b = NULL;
+    int n = 0, i;
+    char *big = malloc(100000*24), *p = big;
+    for(i=0; i<100000; i++)
+        p += sprintf(p, "%d,%d.%02d\n", i, i, i%100);
+
+    lh_csv_init(&r, ',', 0);
+    ssize_t pos, len = p-big;
+    for(pos=0; pos<len; pos+=10000) {
+        lh_csv_feed(&r, (const uint8_t *)big+pos, (len-pos < 10000) ? len-pos : 10000);
+        fail += (lh_csv_columns(&r, n, 4096, "id", MAF(a), MAF(b)) < 0);
+    }
+    lh_csv_finish(&r);
+    fail += (lh_csv_columns(&r, n, 4096, "id", MAF(a), MAF(b)) != 0);
+    fail += (n != 100000);
+    for(i=0; i<n; i++) {
+        sprintf(big, "%d.%02d", i, i%100);
+        fail += (a[i] != i || b[i] != strtod(big, NULL));
+    }
+    lh_csv_free(&r);
+
+    free(big);
+    free(id); free(val); free(ratio);
+    free(a); free(b);
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(csv) {
+
+    TEST(records);
+    TEST(random);
+    TEST(numbers);
+    TEST(locale);
+    TEST(columns);
+
+} _TM;
@@ -0,0 +1,229 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_bytes : reader and writer cursors
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lh_bytes.h>
+
+TF(reader, "reader cursor") {
+    uint8_t data[64], *p = data;
+    lh_write_char(p, 0x12);
+    lh_write_short_be(p, 0x3456);
+    lh_write_int_le(p, 0x789abcde);
+    lh_write_double_be(p, -2.5);
+    lh_write_varint(p, 300);
+    lh_write_varlong(p, 0x123456789abULL);
+    lh_write_varint(p, 5);
+    memcpy(p, "hello", 5); p+=5;
+    lh_write_long_be(p, 42);
+    ssize_t len = p-data;
+
+    lh_reader r;
+    lh_reader_init(&r, data, len);
+    fail += (lh_reader_char(&r) != 0x12);
+    fail += (lh_reader_short_be(&r) != 0x3456);
+    fail += (lh_reader_int_le(&r) != 0x789abcde);
+    fail += (lh_reader_double_be(&r) != -2.5);
+    fail += (lh_reader_varint(&r) != 300);
+    fail += (lh_reader_varlong(&r) != 0x123456789abULL);
+
+    // a length-prefixed string as a sub-reader
+    lh_reader s = lh_reader_sub(&r, lh_reader_varint(&r));
+    fail += (s.error || lh_reader_left(&s) != 5 || memcmp(s.ptr, "hello", 5));
+    fail += (lh_reader_peek(&s, 6) != NULL || lh_reader_peek(&s, 5) != s.ptr);
+    fail += (s.error);
+    lh_reader_skip(&s, 4);
+    fail += (lh_reader_char(&s) != 'o' || s.error);
+    fail += (lh_reader_char(&s) != 0 || !s.error);
+    fail += (r.error);
+
+    // unchecked reads after a single check
+    fail += (!lh_reader_need(&r, 8) || lh_reader_long_be_u(&r) != 42);
+    fail += (r.error || lh_reader_left(&r) != 0);
+
+    // the error is sticky
+    lh_reader_init(&r, data, 4);
+    fail += (lh_reader_char(&r) != 0x12);
+    fail += (lh_reader_int_be(&r) != 0 || !r.error);
+    fail += (lh_reader_char(&r) != 0 || lh_reader_left(&r) != 0 || !r.error);
+
+    // a failed skip or sub-reader
+    lh_reader_init(&r, data, len);
+    s = lh_reader_sub(&r, len+1);
+    fail += (!r.error || !s.error || lh_reader_left(&s) != 0);
+    lh_reader_init(&r, data, len);
+    lh_reader_skip(&r, -1);
+    fail += (!r.error);
+
+    // a truncated varint
+    lh_reader_init(&r, data+19, 1);
+    fail += (lh_reader_varint(&r) != 0 || !r.error);
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(writer, "writer cursor") {
+    lh_buf_t b;
+    lh_clear_obj(b);
+
+    // existing data in the buffer is kept
+    lh_arr_add(GAR4(b.data), 3);
+    memcpy(P(b.data), "abc", 3);
+
+    lh_writer w;
+    lh_writer_init(&w, &b);
+    lh_writer_reserve(&w, 15);
+    lh_writer_char_u(&w, 0x12);
+    lh_writer_short_be_u(&w, 0x3456);
+    lh_writer_int_le_u(&w, 0x789abcde);
+    lh_writer_double_be_u(&w, -2.5);
+    fail += (lh_writer_pos(&w) != 18);
+
+    // a fixed-size length slot, filled in later
+    ssize_t slot = lh_writer_slot(&w, 4);
+    lh_writer_varlong(&w, 0x123456789abULL);
+    lh_writer_bytes(&w, "hello", 5);
+    lh_place_int_be(lh_writer_at(&w, slot), lh_writer_since(&w, slot, 4));
+
+    // nested varint length prefixes, the outer one long enough for 2 bytes
+    ssize_t outer = lh_writer_begin_varlen(&w);
+    ssize_t inner = lh_writer_begin_varlen(&w);
+    lh_writer_bytes(&w, "xyz", 3);
+    lh_writer_end_varlen(&w, inner);
+    int i;
+    for(i=0; i<100; i++) lh_writer_short_le(&w, i);
+    lh_writer_end_varlen(&w, outer);
+
+    // many writes, growing the buffer several times
+    for(i=0; i<100000; i++) lh_writer_varint(&w, i);
+    fail += (lh_writer_finish(&w) != lh_writer_pos(&w) || C(b.data) != lh_writer_pos(&w));
+    fail += (memcmp(P(b.data), "abc", 3));
+
+    lh_reader r;
+    lh_reader_init(&r, P(b.data)+3, C(b.data)-3);
+    fail += (lh_reader_char(&r) != 0x12);
+    fail += (lh_reader_short_be(&r) != 0x3456);
+    fail += (lh_reader_int_le(&r) != 0x789abcde);
+    fail += (lh_reader_double_be(&r) != -2.5);
+    fail += (lh_reader_int_be(&r) != 6+5);
+    fail += (lh_reader_varlong(&r) != 0x123456789abULL);
+    fail += (memcmp(lh_reader_bytes(&r, 5), "hello", 5));
+
+    lh_reader o = lh_reader_sub(&r, lh_reader_varint(&r));
+    fail += (lh_reader_left(&o) != 1+3+200);
+    lh_reader s = lh_reader_sub(&o, lh_reader_varint(&o));
+    fail += (lh_reader_left(&s) != 3 || memcmp(s.ptr, "xyz", 3));
+    for(i=0; i<100; i++) fail += (lh_reader_short_le(&o) != i);
+    fail += (o.error || lh_reader_left(&o) != 0);
+
+    for(i=0; i<100000; i++) fail += (lh_reader_varint(&r) != i);
+    fail += (r.error || lh_reader_left(&r) != 0);
+
+    // appending to the finished buffer continues after its data
+    ssize_t len = C(b.data);
+    lh_writer_init(&w, &b);
+    lh_writer_int_be(&w, 7);
+    fail += (lh_writer_finish(&w) != len+4);
+    lh_arr_free(AR(b.data));
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(strings, "string codecs") {
+    uint8_t data[600], *p = data;
+    static char big[300];
+    memset(big, 'x', sizeof(big));
+    lh_span hello = lh_span_cstr("hello"), empty = lh_span_make("", 0);
+    lh_span lbig = lh_span_make(big, sizeof(big));
+
+    lh_write_lstring_char(p, hello);
+    lh_write_lstring_short_be(p, hello);
+    lh_write_lstring_short_le(p, empty);
+    lh_write_lstring_int_be(p, hello);
+    lh_write_lstring_int_le(p, hello);
+    lh_write_lstring_varint(p, lbig);
+    lh_write_zstring(p, hello);
+    lh_write_zstring(p, empty);
+    ssize_t len = p-data;
+    fail += (len != 6+7+2+9+9+302+6+1);
+    fail += (memcmp(data, "\x05hello\x00\x05hello\x00\x00", 15));
+
+    // bounded reads return views into the data
+    lh_span s;
+    uint8_t *l = data+len;
+    p = data;
+    fail += (!lh_lread_lstring_char(p, l, s) || !lh_span_eq(s, hello) || s.ptr != data+1);
+    fail += (!lh_lread_lstring_short_be(p, l, s) || !lh_span_eq(s, hello));
+    fail += (!lh_lread_lstring_short_le(p, l, s) || s.len != 0);
+    fail += (!lh_lread_lstring_int_be(p, l, s) || !lh_span_eq(s, hello));
+    fail += (!lh_lread_lstring_int_le(p, l, s) || !lh_span_eq(s, hello));
+    fail += (!lh_lread_lstring_varint(p, l, s) || !lh_span_eq(s, lbig));
+    fail += (!lh_lread_zstring(p, l, s) || !lh_span_eq(s, hello));
+    fail += (!lh_lread_zstring(p, l, s) || s.len != 0 || p != l);
+
+    // a string longer than the data, or without terminator
+    p = data;
+    fail += (lh_lread_lstring_char(p, data+5, s) || p != data);
+    fail += (lh_lread_lstring_varint(p, data, s) || p != data);
+    p = data+len-7;
+    fail += (lh_lread_zstring(p, data+len-2, s) || p != data+len-7);
+
+    // the reader cursor fails on the first bad string
+    lh_reader r;
+    lh_reader_init(&r, data, 30);
+    fail += (!lh_span_eq(lh_reader_lstring_char(&r), hello));
+    fail += (!lh_span_eq(lh_reader_lstring_short_be(&r), hello));
+    fail += (lh_reader_lstring_short_le(&r).len != 0 || r.error);
+    fail += (!lh_span_eq(lh_reader_lstring_int_be(&r), hello));
+    fail += (lh_reader_lstring_int_le(&r).len != 0 || !r.error);
+    fail += (lh_reader_zstring(&r).len != 0 || !r.error);
+
+    // bounded writes check the space and the prefix type
+    uint8_t out[16];
+    p = out;
+    fail += (lh_lwrite_lstring_char(p, out+5, hello) || p != out);
+    fail += (!lh_lwrite_lstring_char(p, out+6, hello) || p != out+6);
+    fail += (lh_lwrite_lstring_char(p, out+sizeof(out), lbig) || p != out+6);
+    fail += (lh_lwrite_zstring(p, out+11, hello) || p != out+6);
+    fail += (!lh_lwrite_zstring(p, out+12, hello) || p != out+12 || out[11] != 0);
+
+    // the writer cursor
+    lh_buf_t b;
+    lh_clear_obj(b);
+    lh_writer w;
+    lh_writer_init(&w, &b);
+    lh_writer_lstring_varint(&w, lbig);
+    lh_writer_lstring_short_le(&w, hello);
+    lh_writer_zstring(&w, hello);
+    fail += (lh_writer_finish(&w) != 302+7+6);
+    lh_reader_init(&r, P(b.data), C(b.data));
+    fail += (!lh_span_eq(lh_reader_lstring_varint(&r), lbig));
+    fail += (!lh_span_eq(lh_reader_lstring_short_le(&r), hello));
+    fail += (!lh_span_eq(lh_reader_zstring(&r), hello));
+    fail += (r.error || lh_reader_left(&r) != 0);
+    lh_arr_free(AR(b.data));
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(cursor) {
+
+    TEST(reader);
+    TEST(writer);
+    TEST(strings);
+
+} _TM;
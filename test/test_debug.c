@@ -61,6 +61,13 @@ TF(hex, "hex output") {
     const char *test = "This is an example string\n";
     hexdump(test, strlen(test));
     hexprint(test, strlen(test));
+
+    uint8_t bin[8];
+    fail += (hex_import("0a1B2c3D", bin, sizeof(bin)) != 4);
+    fail += memcmp(bin, "\x0a\x1b\x2c\x3d", 4) != 0;
+    fail += (hex_import("0a1B2x3D", bin, sizeof(bin)) != 2);
+    fail += (hex_import("0a1B2c3D", bin, 3) != 3);
+    printf("hex_import: %s\n", PASSFAIL(!fail));
 } _TF
 
 ////////////////////////////////////////////////////////////////////////////////
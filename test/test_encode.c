@@ -0,0 +1,184 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_encode : hex and Base64
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lh_cpu.h>
+#include <lh_buffers.h>
+#include <lh_encode.h>
+
+static const int cpu_levels[] = {
+    0, LH_CPU_SSE2, LH_CPU_SSE2|LH_CPU_SSSE3, -1
+};
+#define NLEVELS (sizeof(cpu_levels)/sizeof(cpu_levels[0]))
+
+#define MAXLEN 300
+
+TF(hex, "hex encoding") {
+    uint8_t data[MAXLEN], dec[MAXLEN];
+    char enc[2*MAXLEN];
+    int l, i, f;
+    srand(1);
+    for(i=0; i<MAXLEN; i++) data[i] = rand();
+
+    for(l=0; l<NLEVELS; l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        f = 0;
+
+        int len;
+        for(len=0; len<MAXLEN; len++) {
+            int fl = (len&1) ? LH_HEX_UPPER : 0;
+            f += (lh_hex_encode(data, len, enc, fl) != 2*len);
+            for(i=0; i<len; i++) {
+                char exp[3];
+                sprintf(exp, (fl&LH_HEX_UPPER) ? "%02X" : "%02x", data[i]);
+                f += memcmp(enc+2*i, exp, 2) != 0;
+            }
+            f += (lh_hex_decode(enc, 2*len, dec, NULL) != len);
+            f += memcmp(dec, data, len) != 0;
+        }
+
+        // an invalid character at every position
+        lh_hex_encode(data, MAXLEN, enc, 0);
+        const char badc[] = "g/:@G` \xff";
+        for(i=0; i<2*MAXLEN; i+=3) {
+            char c = enc[i];
+            enc[i] = badc[i%8];
+            ssize_t pos = -2;
+            f += (lh_hex_decode(enc, 2*MAXLEN, dec, &pos) != -1);
+            f += (pos != i);
+            enc[i] = c;
+        }
+
+        ssize_t pos = -2;
+        f += (lh_hex_decode("abc", 3, dec, &pos) != -1 || pos != 3);
+        f += (lh_hex_decode("aBcD", 4, dec, NULL) != 2 || dec[0]!=0xab || dec[1]!=0xcd);
+
+        printf("cpu=%02x: %s\n", lh_cpu_features(), PASSFAIL(!f));
+        fail += f;
+    }
+    lh_cpu_restrict(-1);
+} _TF
+
+static const char *b64_vectors[][2] = {
+    { "",       ""         },
+    { "f",      "Zg=="     },
+    { "fo",     "Zm8="     },
+    { "foo",    "Zm9v"     },
+    { "foob",   "Zm9vYg==" },
+    { "fooba",  "Zm9vYmE=" },
+    { "foobar", "Zm9vYmFy" },
+};
+
+TF(base64, "Base64 encoding") {
+    uint8_t data[MAXLEN], dec[MAXLEN];
+    char enc[2*MAXLEN];
+    int l, i, f;
+    srand(2);
+    for(i=0; i<MAXLEN; i++) data[i] = rand();
+
+    for(l=0; l<NLEVELS; l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        f = 0;
+
+        // RFC 4648 test vectors
+        for(i=0; i<sizeof(b64_vectors)/sizeof(b64_vectors[0]); i++) {
+            const char *s = b64_vectors[i][0], *e = b64_vectors[i][1];
+            ssize_t n = lh_base64_encode((const uint8_t *)s, strlen(s), enc, 0);
+            f += (n != strlen(e) || memcmp(enc, e, n));
+            n = lh_base64_decode(e, strlen(e), dec, 0, NULL);
+            f += (n != strlen(s) || memcmp(dec, s, n));
+        }
+
+        // round trips with all flag combinations
+        int len, fl;
+        for(fl=0; fl<4; fl++) {
+            for(len=0; len<MAXLEN; len++) {
+                ssize_t n = lh_base64_encode(data, len, enc, fl);
+                f += (n != lh_base64_encoded_len(len, fl));
+                f += (lh_base64_decode(enc, n, dec, fl, NULL) != len);
+                f += memcmp(dec, data, len) != 0;
+            }
+        }
+
+        // the alphabets must not be mixed
+        uint8_t ff[MAXLEN];
+        memset(ff, 0xff, MAXLEN);
+        ssize_t n = lh_base64_encode(ff, MAXLEN, enc, 0);
+        f += (memchr(enc, '/', n) == NULL);
+        f += (lh_base64_decode(enc, n, dec, LH_B64_URL, NULL) != -1);
+        n = lh_base64_encode(ff, MAXLEN, enc, LH_B64_URL);
+        f += (memchr(enc, '_', n) == NULL);
+        f += (lh_base64_decode(enc, n, dec, 0, NULL) != -1);
+
+        // an invalid character at every position
+        n = lh_base64_encode(data, MAXLEN, enc, 0);
+        const char badc[] = "-_=.\n \x80*";
+        for(i=0; i<n; i+=3) {
+            char c = enc[i];
+            enc[i] = badc[i%8];
+            ssize_t pos = -2;
+            f += (lh_base64_decode(enc, n, dec, 0, &pos) != -1);
+            f += (pos != i);
+            enc[i] = c;
+        }
+
+        // padding and trailing bits
+        ssize_t pos;
+        f += (lh_base64_decode("Zg=", 3, dec, 0, &pos) != -1 || pos != 3);
+        f += (lh_base64_decode("Zg==", 4, dec, LH_B64_NOPAD, &pos) != -1 || pos != 2);
+        f += (lh_base64_decode("Zg", 2, dec, LH_B64_NOPAD, NULL) != 1);
+        f += (lh_base64_decode("Zh==", 4, dec, 0, &pos) != -1 || pos != 1);
+        f += (lh_base64_decode("Zm9=", 4, dec, 0, &pos) != -1 || pos != 2);
+        f += (lh_base64_decode("Z===", 4, dec, 0, &pos) != -1 || pos != 1);
+        f += (lh_base64_decode("Zm=v", 4, dec, 0, &pos) != -1 || pos != 2);
+        f += (lh_base64_decode("Zm9vY", 5, dec, LH_B64_NOPAD, &pos) != -1 || pos != 5);
+
+        printf("cpu=%02x: %s\n", lh_cpu_features(), PASSFAIL(!f));
+        fail += f;
+    }
+    lh_cpu_restrict(-1);
+} _TF
+
+TF(buf, "encoding into lh_buf_t") {
+    lh_buf_t bo;
+    lh_clear_obj(bo);
+
+    lh_hex_encode_buf(&bo, (const uint8_t *)"\x01\xfe", 2, 0);
+    lh_base64_encode_buf(&bo, (const uint8_t *)"foob", 4, LH_B64_NOPAD);
+    fail += (C(bo.data) != 10 || memcmp(P(bo.data), "01feZm9vYg", 10));
+
+    // a failed decode leaves the buffer unchanged
+    fail += (lh_hex_decode_buf(&bo, "zz", 2, NULL) != -1);
+    fail += (lh_base64_decode_buf(&bo, "Zm9v!", 5, 0, NULL) != -1);
+    fail += (C(bo.data) != 10);
+
+    fail += (lh_hex_decode_buf(&bo, "4142", 4, NULL) != 2);
+    fail += (lh_base64_decode_buf(&bo, "Zm9v", 4, 0, NULL) != 3);
+    fail += (C(bo.data) != 15 || memcmp(P(bo.data)+10, "ABfoo", 5));
+
+    lh_arr_free(AR(bo.data));
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(encode) {
+
+    TEST(hex);
+    TEST(base64);
+    TEST(buf);
+
+} _TM;
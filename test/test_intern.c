@@ -0,0 +1,88 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_intern : string interning
+*/
+
+#include "lhtest.h"
+
+#include <lh_intern.h>
+
+TF(ids, "interning IDs") {
+    lh_intern *t = lh_intern_create();
+
+    uint32_t a = lh_intern_id(t, "Makefile", -1);
+    uint32_t b = lh_intern_id(t, ".git", -1);
+    uint32_t c = lh_intern_id(t, "Makefile", 8);
+    uint32_t d = lh_intern_id(t, "Makefile.am", 8);
+
+    fail += (a != 0);
+    fail += (b != 1);
+    fail += (c != a);
+    fail += (d != a);
+    fail += (lh_intern_count(t) != 2);
+    fail += (lh_intern_find(t, ".git", -1) != b);
+    fail += (lh_intern_find(t, ".gitignore", -1) != LH_INTERN_NONE);
+
+    const char *p = lh_intern_str(t, a);
+    fail += (strcmp(p, "Makefile") != 0);
+    fail += (lh_intern_len(t, a) != 8);
+    fail += (lh_intern_ptr(t, "Makefile", -1) != p);
+    fail += (lh_intern_str(t, 1000) != NULL);
+
+    // strings with embedded NULs are distinct from their prefixes
+    uint32_t e = lh_intern_id(t, "a\0b", 3);
+    uint32_t f = lh_intern_id(t, "a", 1);
+    fail += (e == f);
+    fail += (lh_intern_len(t, e) != 3);
+
+    printf("ids: %s\n", PASSFAIL(!fail));
+    lh_intern_destroy(t);
+} _TF
+
+TF(many, "interning many strings") {
+    lh_intern *t = lh_intern_create();
+
+    // enough entries to force several rehashes and pool blocks
+    int i;
+    char name[64];
+    for(i=0; i<100000; i++) {
+        sprintf(name, "file%d.txt", i);
+        if (lh_intern_id(t, name, -1) != i) fail++;
+    }
+
+    // the IDs and canonical pointers remain stable
+    for(i=0; i<100000; i+=7) {
+        sprintf(name, "file%d.txt", i);
+        uint32_t id = lh_intern_find(t, name, -1);
+        if (id != i) fail++;
+        if (strcmp(lh_intern_str(t, id), name)) fail++;
+    }
+
+    // a string larger than the pool block size
+    char *big = malloc(LH_INTERN_POOL_SIZE*2);
+    memset(big, 'x', LH_INTERN_POOL_SIZE*2-1);
+    big[LH_INTERN_POOL_SIZE*2-1] = 0;
+    uint32_t id = lh_intern_id(t, big, -1);
+    fail += (id != 100000);
+    fail += (strcmp(lh_intern_str(t, id), big) != 0);
+    free(big);
+
+    printf("count=%zd: %s\n", lh_intern_count(t), PASSFAIL(!fail));
+    lh_intern_destroy(t);
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(intern) {
+
+    TEST(ids);
+    TEST(many);
+
+} _TM;
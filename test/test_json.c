@@ -0,0 +1,304 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_json : JSON writer and tokenizer
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <locale.h>
+
+#include <lh_cpu.h>
+#include <lh_json.h>
+
+static const int cpu_levels[] = {
+    0, LH_CPU_SSE2, -1
+};
+#define NLEVELS (sizeof(cpu_levels)/sizeof(cpu_levels[0]))
+
+#define TEST_WRITE(descr,code,exp) {                                    \
+        uint8_t *P(out) = NULL; ssize_t C(out) = 0;                     \
+        lh_json_writer w;                                               \
+        lh_json_writer_init(&w, GAR0(out));                             \
+        code;                                                           \
+        int f = (C(out) != strlen(exp) || memcmp(P(out), exp, C(out))); \
+        if (f) printf("%.*s != %s\n", (int)C(out), P(out), exp);        \
+        printf("%s: %s\n", descr, PASSFAIL(!f));                        \
+        fail += f;                                                      \
+        free(P(out));                                                   \
+    }
+
+TF(writer, "JSON writer") {
+    int l;
+    for(l=0; l<NLEVELS; l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        printf("cpu=%02x\n", lh_cpu_features());
+
+        TEST_WRITE("nesting", ({
+            lh_json_begin_object(&w);
+            lh_json_key(&w, "a", -1); lh_json_int(&w, 1);
+            lh_json_key(&w, "b", -1);
+            lh_json_begin_array(&w);
+            lh_json_bool(&w, 1); lh_json_bool(&w, 0); lh_json_null(&w);
+            lh_json_begin_object(&w); lh_json_end_object(&w);
+            lh_json_begin_array(&w); lh_json_end_array(&w);
+            lh_json_end_array(&w);
+            lh_json_key(&w, "c", -1); lh_json_raw(&w, "{\"x\":1}", -1);
+            lh_json_end_object(&w);
+        }), "{\"a\":1,\"b\":[true,false,null,{},[]],\"c\":{\"x\":1}}");
+
+        TEST_WRITE("integers", ({
+            lh_json_begin_array(&w);
+            lh_json_int(&w, 0); lh_json_int(&w, -7); lh_json_int(&w, 1234567890123LL);
+            lh_json_int(&w, INT64_MIN); lh_json_uint(&w, UINT64_MAX); lh_json_uint(&w, 99);
+            lh_json_end_array(&w);
+        }), "[0,-7,1234567890123,-9223372036854775808,18446744073709551615,99]");
+
+        TEST_WRITE("doubles", ({
+            lh_json_begin_array(&w);
+            lh_json_double(&w, 0.1); lh_json_double(&w, -2.5); lh_json_double(&w, 1e300);
+            lh_json_double(&w, 1.0/3); lh_json_double(&w, 0.0/0.0);
+            lh_json_end_array(&w);
+        }), "[0.1,-2.5,1e+300,0.33333333333333331,null]");
+
+        TEST_WRITE("escaping", ({
+            lh_json_string(&w, "a \"quoted\" string with a \\ backslash and "
+                           "enough text to fill a vector register\n\t\x01\x1f", -1);
+        }), "\"a \\\"quoted\\\" string with a \\\\ backslash and "
+            "enough text to fill a vector register\\n\\t\\u0001\\u001f\"");
+
+        TEST_WRITE("utf-8", ({
+            lh_json_key(&w, "Grüße", -1); lh_json_string(&w, "日本", -1);
+        }), "\"Grüße\":\"日本\"");
+    }
+    lh_cpu_restrict(-1);
+} _TF
+
+// tokenize text fed in chunks of the given size, and describe the tokens
+// in a string for comparison
+static int tokenize_chunked(const char *text, ssize_t chunk, char *out) {
+    lh_json_tokenizer t;
+    lh_json_token tok;
+    lh_json_tok_init(&t);
+    ssize_t len = strlen(text), pos = 0;
+    int type;
+    out[0] = 0;
+
+    while (1) {
+        while ((type = lh_json_tok_next(&t, &tok)) > 0) {
+            static const char *names = "?{}[]ksntfz";
+            char tmp[256];
+            if (type == LH_JSON_KEY || type == LH_JSON_STRING || type == LH_JSON_NUMBER) {
+                uint8_t s[256];
+                ssize_t n = (type == LH_JSON_NUMBER) ? tok.text.len : lh_json_unescape(&tok, s);
+                sprintf(tmp, "%c:%.*s ", names[type], (int)n,
+                        (type == LH_JSON_NUMBER) ? (const char *)tok.text.ptr : (const char *)s);
+            }
+            else
+                sprintf(tmp, "%c ", names[type]);
+            strcat(out, tmp);
+        }
+        if (type < 0) {
+            char tmp[64];
+            sprintf(tmp, "ERROR@%zd", t.errpos);
+            strcat(out, tmp);
+            break;
+        }
+        if (pos >= len) {
+            if (t.eof) break;
+            lh_json_tok_finish(&t);
+            continue;
+        }
+
+        ssize_t clen = (len-pos < chunk) ? len-pos : chunk;
+        lh_json_tok_feed(&t, (const uint8_t *)text+pos, clen);
+        pos += clen;
+    }
+
+    lh_json_tok_free(&t);
+    return type;
+}
+
+#define TEST_TOK(text,exp) {                                            \
+        int f=0, chunk;                                                 \
+        char out[1024];                                                 \
+        for(chunk=1; chunk<=64; chunk++) {                              \
+            tokenize_chunked(text, chunk, out);                         \
+            if (strcmp(out, exp)) {                                     \
+                printf("chunk=%d: '%s' != '%s'\n", chunk, out, exp);    \
+                f++;                                                    \
+                break;                                                  \
+            }                                                           \
+        }                                                               \
+        printf("%s: %s\n", text, PASSFAIL(!f));                         \
+        fail += f;                                                      \
+    }
+
+TF(tokenizer, "JSON tokenizer") {
+    int l;
+    for(l=0; l<NLEVELS; l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        printf("cpu=%02x\n", lh_cpu_features());
+
+        TEST_TOK("{\"a\":1,\"b\":[true,false,null,{},[]],\"c\":\"x\"}",
+                 "{ k:a n:1 k:b [ t f z { } [ ] ] k:c s:x } ");
+        TEST_TOK("  [ -0.5e+3 , 12 ,\"\" ]\n", "[ n:-0.5e+3 n:12 s: ] ");
+        TEST_TOK("{\"long key spanning several chunks\" : \"esc \\\"\\\\\\/\\n\\u00e9\\ud83d\\ude00\"}",
+                 "{ k:long key spanning several chunks s:esc \"\\/\n\xc3\xa9\xf0\x9f\x98\x80 } ");
+        TEST_TOK("1 2 [3] \"four\" null", "n:1 n:2 [ n:3 ] s:four z ");
+        TEST_TOK("", "");
+
+        // syntax errors
+        TEST_TOK("[1,]", "[ n:1 ERROR@3");
+        TEST_TOK("[1 2]", "[ n:1 ERROR@3");
+        TEST_TOK("{\"a\" 1}", "{ k:a ERROR@5");
+        TEST_TOK("{\"a\":1,}", "{ k:a n:1 ERROR@7");
+        TEST_TOK("{1:2}", "{ ERROR@1");
+        TEST_TOK("[}", "[ ERROR@1");
+        TEST_TOK("[01]", "[ ERROR@1");
+        TEST_TOK("[1.]", "[ ERROR@1");
+        TEST_TOK("[tru]", "[ ERROR@1");
+        TEST_TOK("[\"a\x01\"]", "[ ERROR@3");
+        TEST_TOK("[\"\\x\"]", "[ ERROR@1");
+        TEST_TOK("[1", "[ n:1 ERROR@2");
+        TEST_TOK("[\"abc", "[ ERROR@5");
+        TEST_TOK("{\"a\":", "{ k:a ERROR@5");
+    }
+    lh_cpu_restrict(-1);
+} _TF
+
+TF(values, "token values") {
+    lh_json_token tok = { LH_JSON_NUMBER };
+    int64_t v;
+
+#define NUM(s) tok.text = lh_span_make(s, strlen(s))
+    NUM("-9223372036854775808");
+    fail += (!lh_json_tok_int(&tok, &v) || v != INT64_MIN);
+    NUM("9223372036854775807");
+    fail += (!lh_json_tok_int(&tok, &v) || v != INT64_MAX);
+    NUM("9223372036854775808");
+    fail += lh_json_tok_int(&tok, &v);
+    NUM("1.5");
+    fail += lh_json_tok_int(&tok, &v);
+    fail += (lh_json_tok_double(&tok) != 1.5);
+    NUM("-2e-3");
+    fail += (lh_json_tok_double(&tok) != -2e-3);
+
+    // lone surrogates
+    uint8_t out[16];
+    lh_json_token s = { LH_JSON_STRING, lh_span_make("\\ud83d", 6), 1 };
+    fail += (lh_json_unescape(&s, out) != -1);
+    s.text = lh_span_make("\\ude00", 6);
+    fail += (lh_json_unescape(&s, out) != -1);
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(roundtrip, "writer to tokenizer") {
+    uint8_t *P(out) = NULL;
+    ssize_t C(out) = 0;
+    lh_json_writer w;
+    lh_json_writer_init(&w, GAR2(out));
+
+    int i, n = 2000;
+    char key[32];
+    lh_json_begin_object(&w);
+    for(i=0; i<n; i++) {
+        sprintf(key, "key\"%d\"", i);
+        lh_json_key(&w, key, -1);
+        lh_json_begin_array(&w);
+        lh_json_int(&w, -i*1000003LL);
+        lh_json_double(&w, i/7.0);
+        lh_json_string(&w, key, -1);
+        lh_json_end_array(&w);
+    }
+    lh_json_end_object(&w);
+
+    lh_json_tokenizer t;
+    lh_json_token tok;
+    lh_json_tok_init(&t);
+    int type, k = 0, idx = 0;
+    ssize_t pos;
+
+    // feed in odd-sized chunks
+    for(pos=0; pos<C(out); pos+=1000) {
+        lh_json_tok_feed(&t, P(out)+pos, (C(out)-pos < 1000) ? C(out)-pos : 1000);
+        while ((type = lh_json_tok_next(&t, &tok)) > 0) {
+            int64_t v;
+            if (type == LH_JSON_ARR_BEGIN) {
+                idx = 0;
+            }
+            else if (type == LH_JSON_NUMBER && idx++ == 0) {
+                fail += (!lh_json_tok_int(&tok, &v) || v != -k*1000003LL);
+            }
+            else if (type == LH_JSON_NUMBER) {
+                fail += (lh_json_tok_double(&tok) != k/7.0);
+            }
+            else if (type == LH_JSON_STRING) {
+                uint8_t s[64];
+                sprintf(key, "key\"%d\"", k);
+                ssize_t len = lh_json_unescape(&tok, s);
+                fail += (len != strlen(key) || memcmp(s, key, len));
+                k++;
+            }
+        }
+        fail += (type != LH_JSON_NONE);
+    }
+    lh_json_tok_finish(&t);
+    fail += (lh_json_tok_next(&t, &tok) != LH_JSON_NONE);
+    fail += (k != n);
+
+    lh_json_tok_free(&t);
+    free(P(out));
+    printf("%zd bytes: %s\n", C(out), PASSFAIL(!fail));
+} _TF
+
+TF(locale, "numbers under a comma locale") {
+    static const char *names[] = {
+        "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8", "ru_RU.UTF-8", "de_DE", NULL,
+    };
+    int i;
+    for(i=0; names[i]; i++)
+        if (setlocale(LC_NUMERIC, names[i]) && localeconv()->decimal_point[0] == ',')
+            break;
+    if (!names[i]) {
+        setlocale(LC_NUMERIC, "C");
+        printf("no comma locale installed, skipped\n");
+        return 0;
+    }
+
+    uint8_t *P(out) = NULL;
+    ssize_t C(out) = 0;
+    lh_json_writer w;
+    lh_json_writer_init(&w, GAR0(out));
+    lh_json_double(&w, 1.5);
+    fail += (C(out) != 3 || memcmp(P(out), "1.5", 3));
+    free(P(out));
+
+    lh_json_token tok = { LH_JSON_NUMBER, lh_span_make("-2.25e1", 7), 0 };
+    fail += (lh_json_tok_double(&tok) != -22.5);
+
+    setlocale(LC_NUMERIC, "C");
+    printf("%s: %s\n", names[i], PASSFAIL(!fail));
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(json) {
+
+    TEST(writer);
+    TEST(tokenizer);
+    TEST(values);
+    TEST(roundtrip);
+    TEST(locale);
+
+} _TM;
@@ -0,0 +1,346 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_nbt : tagged binary trees
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lh_bytes.h>
+#include <lh_nbt.h>
+
+static uint8_t blocks[2][64];
+static uint8_t heights[16*4];
+
+#define S(s) lh_span_make(s, sizeof(s)-1)
+
+static void put_name(lh_writer *w, int type, const char *name) {
+    lh_writer_char(w, type);
+    lh_writer_lstring_short_be(w, lh_span_cstr(name));
+}
+
+// a chunk-like tree, written field by field
+static ssize_t make_chunk(lh_buf_t *b) {
+    lh_writer w;
+    int i;
+    C(b->data) = 0;
+    lh_writer_init(&w, b);
+
+    put_name(&w, LH_NBT_COMPOUND, "");
+    put_name(&w, LH_NBT_COMPOUND, "Level");
+    put_name(&w, LH_NBT_INT, "xPos");
+    lh_writer_int_be(&w, 3);
+    put_name(&w, LH_NBT_INT, "zPos");
+    lh_writer_int_be(&w, -2);
+    put_name(&w, LH_NBT_LONG, "LastUpdate");
+    lh_writer_long_be(&w, 123456789012LL);
+    put_name(&w, LH_NBT_LIST, "Sections");
+    lh_writer_char(&w, LH_NBT_COMPOUND);
+    lh_writer_int_be(&w, 2);
+    for(i=0; i<2; i++) {
+        put_name(&w, LH_NBT_BYTE, "Y");
+        lh_writer_char(&w, i);
+        put_name(&w, LH_NBT_BYTE_ARRAY, "Blocks");
+        lh_writer_int_be(&w, sizeof(blocks[i]));
+        lh_writer_bytes(&w, blocks[i], sizeof(blocks[i]));
+        lh_writer_char(&w, LH_NBT_END);
+    }
+    put_name(&w, LH_NBT_INT_ARRAY, "HeightMap");
+    lh_writer_int_be(&w, 16);
+    lh_writer_bytes(&w, heights, sizeof(heights));
+    put_name(&w, LH_NBT_LIST, "Entities");
+    lh_writer_char(&w, LH_NBT_END);
+    lh_writer_int_be(&w, 0);
+    put_name(&w, LH_NBT_LIST, "Pos");
+    lh_writer_char(&w, LH_NBT_DOUBLE);
+    lh_writer_int_be(&w, 3);
+    lh_writer_double_be(&w, 1.5);
+    lh_writer_double_be(&w, -64);
+    lh_writer_double_be(&w, 0.25);
+    put_name(&w, LH_NBT_STRING, "Status");
+    lh_writer_lstring_short_be(&w, lh_span_cstr("full"));
+    lh_writer_char(&w, LH_NBT_END);
+    put_name(&w, LH_NBT_INT, "DataVersion");
+    lh_writer_int_be(&w, 1343);
+    put_name(&w, LH_NBT_FLOAT, "Scale");
+    lh_writer_float_be(&w, 0.5f);
+    lh_writer_char(&w, LH_NBT_END);
+
+    return lh_writer_finish(&w);
+}
+
+// the same tree, built from entries
+static void build_chunk(lh_nbt *t) {
+    int i;
+    lh_nbt_init(t);
+    lh_nbt_begin(t, LH_NBT_COMPOUND, S(""));
+    lh_nbt_begin(t, LH_NBT_COMPOUND, S("Level"));
+    lh_nbt_add_int(t, LH_NBT_INT, S("xPos"), 3);
+    lh_nbt_add_int(t, LH_NBT_INT, S("zPos"), -2);
+    lh_nbt_add_int(t, LH_NBT_LONG, S("LastUpdate"), 123456789012LL);
+    lh_nbt_begin(t, LH_NBT_LIST, S("Sections"));
+    for(i=0; i<2; i++) {
+        lh_nbt_begin(t, LH_NBT_COMPOUND, S(""));
+        lh_nbt_add_int(t, LH_NBT_BYTE, S("Y"), i);
+        lh_nbt_add(t, LH_NBT_BYTE_ARRAY, S("Blocks"), lh_span_make(blocks[i], sizeof(blocks[i])));
+        lh_nbt_end(t);
+    }
+    lh_nbt_end(t);
+    lh_nbt_add(t, LH_NBT_INT_ARRAY, S("HeightMap"), lh_span_make(heights, sizeof(heights)));
+    lh_nbt_begin(t, LH_NBT_LIST, S("Entities"));
+    lh_nbt_end(t);
+    lh_nbt_begin(t, LH_NBT_LIST, S("Pos"));
+    lh_nbt_add_double(t, LH_NBT_DOUBLE, S(""), 1.5);
+    lh_nbt_add_double(t, LH_NBT_DOUBLE, S(""), -64);
+    lh_nbt_add_double(t, LH_NBT_DOUBLE, S(""), 0.25);
+    lh_nbt_end(t);
+    lh_nbt_add(t, LH_NBT_STRING, S("Status"), S("full"));
+    lh_nbt_end(t);
+    lh_nbt_add_int(t, LH_NBT_INT, S("DataVersion"), 1343);
+    lh_nbt_add_double(t, LH_NBT_FLOAT, S("Scale"), 0.5);
+    lh_nbt_end(t);
+}
+
+static void init_data() {
+    int i;
+    for(i=0; i<64; i++) {
+        blocks[0][i] = i*3;
+        blocks[1][i] = 255-i;
+    }
+    uint8_t *p = heights;
+    for(i=0; i<16; i++) lh_write_int_be(p, 60+i);
+}
+
+TF(nbt_parse, "indexing and lookups") {
+    lh_buf_t b, o;
+    lh_nbt t;
+    int i, j;
+    lh_clear_obj(b);
+    lh_clear_obj(o);
+    init_data();
+    ssize_t len = make_chunk(&b);
+
+    lh_nbt_init(&t);
+    fail += (lh_nbt_parse(&t, P(b.data), len, -1) != len);
+
+    // root, Level, 3 numbers, Sections with 2 compounds of 2, HeightMap,
+    // Entities, Pos, Status, DataVersion, Scale
+    fail += (C(t.ent) != 18);
+    fail += (lh_nbt_at(&t, 0)->type != LH_NBT_COMPOUND || lh_nbt_at(&t, 0)->count != 3);
+
+    fail += (lh_nbt_int(&t, lh_nbt_path(&t, 0, "Level/xPos")) != 3);
+    fail += (lh_nbt_int(&t, lh_nbt_path(&t, 0, "Level/zPos")) != -2);
+    fail += (lh_nbt_int(&t, lh_nbt_path(&t, 0, "Level/LastUpdate")) != 123456789012LL);
+    fail += (lh_nbt_int(&t, lh_nbt_find(&t, 0, "DataVersion")) != 1343);
+    fail += (lh_nbt_double(&t, lh_nbt_find(&t, 0, "Scale")) != 0.5);
+    fail += (lh_nbt_double(&t, lh_nbt_path(&t, 0, "Level/xPos")) != 3);
+    fail += (lh_nbt_path(&t, 0, "Level/yPos") != -1);
+    fail += (lh_nbt_path(&t, 0, "Level/xPos/a") != -1);
+    fail += (lh_nbt_find(&t, 0, "xPos") != -1);
+    fail += (lh_nbt_int(&t, -1) != 0);
+
+    lh_span s = lh_nbt_string(&t, lh_nbt_path(&t, 0, "Level/Status"));
+    fail += (s.len != 4 || memcmp(s.ptr, "full", 4));
+
+    // iterating the list skips the subtrees of its elements
+    int sec = lh_nbt_path(&t, 0, "Level/Sections");
+    fail += (lh_nbt_at(&t, sec)->count != 2 || lh_nbt_at(&t, sec)->etype != LH_NBT_COMPOUND);
+    for(i=lh_nbt_first(&t, sec), j=0; i>=0; i=lh_nbt_next(&t, i), j++) {
+        fail += (lh_nbt_int(&t, lh_nbt_find(&t, i, "Y")) != j);
+        int bl = lh_nbt_find(&t, i, "Blocks");
+        lh_span v = lh_nbt_value(&t, bl);
+        fail += (v.len != 64 || memcmp(v.ptr, blocks[j], 64));
+        fail += (lh_nbt_elem_int(&t, bl, 5) != (int8_t)blocks[j][5]);
+    }
+    fail += (j != 2);
+    fail += (lh_nbt_int(&t, lh_nbt_path(&t, 0, "Level/Sections/1/Y")) != 1);
+    fail += (lh_nbt_path(&t, 0, "Level/Sections/2") != -1);
+
+    // arrays and lists of numbers are not expanded
+    int hm = lh_nbt_path(&t, 0, "Level/HeightMap");
+    fail += (lh_nbt_at(&t, hm)->count != 16 || lh_nbt_elem_int(&t, hm, 15) != 75);
+    fail += (lh_nbt_elem_int(&t, hm, 16) != 0);
+    lh_view hv = lh_nbt_view(&t, hm);
+    int32_t hn[16];
+    fail += (hv.n != 16 || lh_view_read(&hv, 0, hn, 16) != 16 || hn[3] != 63);
+    fail += (lh_nbt_view(&t, sec).n != 0 || lh_nbt_view(&t, -1).n != 0);
+    int pos = lh_nbt_path(&t, 0, "Level/Pos");
+    fail += (lh_nbt_first(&t, pos) != -1 || lh_nbt_at(&t, pos)->count != 3);
+    fail += (lh_nbt_elem_double(&t, pos, 1) != -64 || lh_nbt_elem_double(&t, pos, 2) != 0.25);
+    int ent = lh_nbt_path(&t, 0, "Level/Entities");
+    fail += (lh_nbt_first(&t, ent) != -1 || lh_nbt_at(&t, ent)->count != 0);
+
+    // written back unchanged
+    fail += (lh_nbt_write(&o, &t, 0) != len || memcmp(P(o.data), P(b.data), len));
+
+    // changed numbers, the rest stays the same
+    lh_nbt_set_int(&t, lh_nbt_path(&t, 0, "Level/xPos"), 99);
+    lh_nbt_set_double(&t, lh_nbt_find(&t, 0, "Scale"), 2);
+    C(o.data) = 0;
+    fail += (lh_nbt_write(&o, &t, 0) != len);
+    lh_nbt t2;
+    lh_nbt_init(&t2);
+    fail += (lh_nbt_parse(&t2, P(o.data), C(o.data), -1) != len);
+    fail += (lh_nbt_int(&t2, lh_nbt_path(&t2, 0, "Level/xPos")) != 99);
+    fail += (lh_nbt_double(&t2, lh_nbt_find(&t2, 0, "Scale")) != 2);
+    fail += (lh_nbt_int(&t2, lh_nbt_path(&t2, 0, "Level/zPos")) != -2);
+    lh_nbt_free(&t2);
+
+    // a subtree by itself
+    C(o.data) = 0;
+    ssize_t slen = lh_nbt_write(&o, &t, sec);
+    fail += (lh_nbt_parse(&t2, P(o.data), slen, -1) != slen || C(t2.ent) != 7);
+    lh_nbt_free(&t2);
+
+    lh_nbt_free(&t);
+    lh_arr_free(AR(b.data));
+    lh_arr_free(AR(o.data));
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(nbt_depth, "partial indexing") {
+    lh_buf_t b, o;
+    lh_nbt t, sub;
+    lh_clear_obj(b);
+    lh_clear_obj(o);
+    init_data();
+    ssize_t len = make_chunk(&b);
+
+    // only the root level, Level is skipped as a whole
+    lh_nbt_init(&t);
+    lh_nbt_init(&sub);
+    fail += (lh_nbt_parse(&t, P(b.data), len, 1) != len);
+    fail += (C(t.ent) != 4);
+    int lv = lh_nbt_find(&t, 0, "Level");
+    fail += (!(lh_nbt_at(&t, lv)->flags & LH_NBT_RAW) || lh_nbt_at(&t, lv)->count != -1);
+    fail += (lh_nbt_path(&t, 0, "Level/xPos") != -1);
+    fail += (lh_nbt_int(&t, lh_nbt_find(&t, 0, "DataVersion")) != 1343);
+    fail += (lh_nbt_write(&o, &t, 0) != len || memcmp(P(o.data), P(b.data), len));
+
+    // indexed on demand
+    fail += (lh_nbt_expand(&sub, &t, lv, -1) != 0);
+    fail += (lh_nbt_int(&sub, lh_nbt_find(&sub, 0, "xPos")) != 3);
+    fail += (lh_nbt_int(&sub, lh_nbt_path(&sub, 0, "Sections/1/Y")) != 1);
+    fail += (lh_nbt_expand(&sub, &t, 0, -1) != -1);
+
+    // lists of compounds are skipped the same way
+    fail += (lh_nbt_parse(&t, P(b.data), len, 2) != len);
+    int sec = lh_nbt_path(&t, 0, "Level/Sections");
+    fail += (!(lh_nbt_at(&t, sec)->flags & LH_NBT_RAW) || lh_nbt_at(&t, sec)->count != 2);
+    fail += (lh_nbt_first(&t, sec) != -1);
+    C(o.data) = 0;
+    fail += (lh_nbt_write(&o, &t, 0) != len || memcmp(P(o.data), P(b.data), len));
+    fail += (lh_nbt_expand(&sub, &t, sec, 1) != 0);
+    fail += (C(sub.ent) != 3 || !(lh_nbt_at(&sub, 1)->flags & LH_NBT_RAW));
+
+    // the length of a payload, without the tag and name of the root
+    fail += (lh_nbt_skip(P(b.data)+3, P(b.data)+len, LH_NBT_COMPOUND) != len-3);
+    fail += (lh_nbt_skip(P(b.data)+3, P(b.data)+len-1, LH_NBT_COMPOUND) != -1);
+
+    lh_nbt_free(&t);
+    lh_nbt_free(&sub);
+    lh_arr_free(AR(b.data));
+    lh_arr_free(AR(o.data));
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(nbt_build, "building and malformed trees") {
+    lh_buf_t b, o;
+    lh_nbt t;
+    ssize_t i;
+    lh_clear_obj(b);
+    lh_clear_obj(o);
+    init_data();
+    ssize_t len = make_chunk(&b);
+
+    // the built tree serializes like the hand-written one
+    build_chunk(&t);
+    fail += (t.open != -1);
+    fail += (lh_nbt_write(&o, &t, 0) != len || memcmp(P(o.data), P(b.data), len));
+    fail += (lh_nbt_int(&t, lh_nbt_path(&t, 0, "Level/Sections/1/Y")) != 1);
+    fail += (lh_nbt_at(&t, lh_nbt_path(&t, 0, "Level/Pos"))->etype != LH_NBT_DOUBLE);
+    lh_nbt_free(&t);
+
+    lh_nbt_init(&t);
+    lh_nbt_begin(&t, LH_NBT_LIST, S("mixed"));
+    lh_nbt_add_int(&t, LH_NBT_INT, S(""), 1);
+    lh_nbt_add_int(&t, LH_NBT_SHORT, S(""), 1);
+    fail += (lh_nbt_end(&t) != -1);
+    fail += (lh_nbt_end(&t) != -1 || t.open != -1);
+    lh_nbt_free(&t);
+
+    // unbalanced
+    lh_nbt_init(&t);
+    fail += (lh_nbt_end(&t) != -1);
+    lh_nbt_begin(&t, LH_NBT_COMPOUND, S(""));
+    fail += (lh_nbt_end(&t) != 0 || lh_nbt_end(&t) != -1);
+    lh_nbt_free(&t);
+
+    // every truncation fails
+    lh_nbt_init(&t);
+    for(i=0; i<len; i++)
+        fail += (lh_nbt_parse(&t, P(b.data), i, -1) != -1);
+    fail += (C(t.ent) != 0);
+
+    // a list header cut off at the start of its own allocation
+    uint8_t *hl = malloc(4);
+    memcpy(hl, "\x09\x00\x00\x01", 4);
+    fail += (lh_nbt_parse(&t, hl, 4, -1) != -1);
+    fail += (lh_nbt_parse(&t, hl, 4, 0) != -1);
+    free(hl);
+
+    // invalid tags and lengths
+    uint8_t *d = P(b.data);
+    d[0] = 13;
+    fail += (lh_nbt_parse(&t, d, len, -1) != -1);
+    d[0] = LH_NBT_COMPOUND;
+    int off = 3+3+5+3+4+4;              // the tag of zPos
+    d[off] = 0x42;
+    fail += (lh_nbt_parse(&t, d, len, -1) != -1);
+    fail += (lh_nbt_parse(&t, d, len, 0) != -1);
+    d[off] = LH_NBT_INT;
+    fail += (lh_nbt_parse(&t, d, len, -1) != len);
+
+    // lists with a negative count
+    static const uint8_t neg[] = { 9, 0, 1, 'l', 3, 0xff, 0xff, 0xff, 0xff };
+    fail += (lh_nbt_parse(&t, neg, sizeof(neg), -1) != -1);
+
+    // nesting is limited
+    C(o.data) = 0;
+    lh_writer w;
+    lh_writer_init(&w, &o);
+    lh_writer_char(&w, LH_NBT_LIST);
+    lh_writer_short_be(&w, 0);
+    for(i=0; i<LH_NBT_MAXDEPTH+2; i++) {
+        lh_writer_char(&w, LH_NBT_LIST);
+        lh_writer_int_be(&w, 1);
+    }
+    lh_writer_char(&w, LH_NBT_END);
+    lh_writer_int_be(&w, 0);
+    lh_writer_finish(&w);
+    fail += (lh_nbt_parse(&t, P(o.data), C(o.data), -1) != -1);
+
+    lh_nbt_free(&t);
+    lh_arr_free(AR(b.data));
+    lh_arr_free(AR(o.data));
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(nbt) {
+
+    TEST(nbt_parse);
+    TEST(nbt_depth);
+    TEST(nbt_build);
+
+} _TM;
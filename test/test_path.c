@@ -0,0 +1,215 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_path : path strings and builder
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <lh_strings.h>
+#include <lh_path.h>
+#include <lh_dir.h>
+
+#define S(x) lh_span_cstr(x)
+
+static int span_is(lh_span s, const char *exp) {
+    int f = !lh_span_eq(s, S(exp));
+    if (f) printf("'%.*s' != '%s'\n", (int)s.len, s.ptr, exp);
+    return f;
+}
+
+TF(span, "span operations") {
+    fail += !lh_span_eq(S("abc"), S("abc"));
+    fail += lh_span_eq(S("abc"), S("abd"));
+    fail += (lh_span_cmp(S("abc"), S("abd")) >= 0);
+    fail += (lh_span_cmp(S("ab"), S("abc")) >= 0);
+    fail += (lh_span_cmp(S("abc"), S("ab")) <= 0);
+    fail += (lh_span_cmp(S(""), S("")) != 0);
+    fail += !lh_span_prefix(S("foobar"), S("foo"));
+    fail += lh_span_prefix(S("fo"), S("foo"));
+    fail += !lh_span_suffix(S("foobar"), S("bar"));
+    fail += span_is(lh_span_sub(S("foobar"), 2, 3), "oba");
+    fail += span_is(lh_span_sub(S("foobar"), 4, -1), "ar");
+    fail += span_is(lh_span_sub(S("foobar"), 9, 3), "");
+
+    // split - n delimiters give n+1 tokens
+    const char *exp[] = { "", "usr", "", "local", "" };
+    lh_span s = S("/usr//local/"), tok;
+    int n = 0;
+    while (lh_span_split(&s, '/', &tok))
+        fail += (n < 5) ? span_is(tok, exp[n++]) : 1;
+    fail += (n != 5);
+    s = S("");
+    n = 0;
+    while (lh_span_split(&s, '/', &tok)) n++;
+    fail += (n != 1);
+
+    // join
+    uint8_t *P(buf) = NULL;
+    ssize_t C(buf) = 0;
+    lh_span parts[] = { S("a"), S("bc"), S("") };
+    fail += (lh_span_join(P(buf), C(buf), parts, 3, S(", ")) != 7);
+    fail += (lh_span_join(P(buf), C(buf), parts, 1, S("-")) != 1);
+    fail += (lh_span_join(P(buf), C(buf), parts, 0, S("-")) != 0);
+    fail += (C(buf) != 8 || strcmp((char *)P(buf), "a, bc, a"));
+    free(P(buf));
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+static const char *names[][3] = {
+    // path             dirname     basename
+    { "/usr/lib/",      "/usr",     "lib"   },
+    { "/usr//lib",      "/usr",     "lib"   },
+    { "usr",            ".",        "usr"   },
+    { "/",              "/",        "/"     },
+    { "//",             "/",        "/"     },
+    { "/a",             "/",        "a"     },
+    { "a/b",            "a",        "b"     },
+    { "",               ".",        "."     },
+};
+
+static const char *norm[][2] = {
+    { "/usr/./lib//../bin/",    "/usr/bin"      },
+    { "a/b/../../..",           ".."            },
+    { "../a/../../b",           "../../b"       },
+    { "/../a",                  "/a"            },
+    { "./",                     "."             },
+    { "",                       "."             },
+    { "a/./b/.",                "a/b"           },
+    { "//",                     "/"             },
+};
+
+TF(path, "path strings") {
+    int i;
+    char out[64];
+
+    for(i=0; i<sizeof(names)/sizeof(names[0]); i++) {
+        fail += span_is(lh_path_dirname(S(names[i][0])), names[i][1]);
+        fail += span_is(lh_path_basename(S(names[i][0])), names[i][2]);
+    }
+
+    for(i=0; i<sizeof(norm)/sizeof(norm[0]); i++) {
+        ssize_t n = lh_path_normalize(S(norm[i][0]), out);
+        fail += (n != strlen(out)) || span_is(lh_span_make(out, n), norm[i][1]);
+
+        // in place
+        strcpy(out, norm[i][0]);
+        n = lh_path_normalize(S(out), out);
+        fail += span_is(lh_span_make(out, n), norm[i][1]);
+    }
+
+    fail += !lh_path_prefix(S("/usr/lib"), S("/usr"));
+    fail += !lh_path_prefix(S("/usr/lib"), S("/usr/"));
+    fail += !lh_path_prefix(S("/usr"), S("/usr"));
+    fail += !lh_path_prefix(S("/usr"), S("/"));
+    fail += lh_path_prefix(S("/usrx"), S("/usr"));
+    fail += lh_path_prefix(S("/us"), S("/usr"));
+
+    fail += (lh_path_join(S("/usr"), S("lib"), out) != 8 || strcmp(out, "/usr/lib"));
+    fail += (lh_path_join(S("/usr/"), S("lib"), out) != 8 || strcmp(out, "/usr/lib"));
+    fail += (lh_path_join(S("/usr"), S("/etc"), out) != 4 || strcmp(out, "/etc"));
+    fail += (lh_path_join(S(""), S("a"), out) != 1 || strcmp(out, "a"));
+    fail += (lh_path_join(S("a"), S(""), out) != 1 || strcmp(out, "a"));
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(pathbuf, "path builder") {
+    lh_pathbuf pb;
+    lh_pathbuf_init(&pb, S("/"));
+
+    ssize_t l1 = lh_pathbuf_push(&pb, S("usr"));
+    fail += (l1 != 1 || strcmp(pb.path, "/usr"));
+    ssize_t l2 = lh_pathbuf_push(&pb, S("lib"));
+    fail += (l2 != 4 || strcmp(pb.path, "/usr/lib"));
+
+    // long components force reallocation
+    char name[300];
+    memset(name, 'x', sizeof(name));
+    ssize_t l3 = lh_pathbuf_push(&pb, lh_span_make(name, sizeof(name)));
+    fail += (pb.len != 309 || strlen(pb.path) != 309);
+
+    lh_pathbuf_trunc(&pb, l3);
+    fail += strcmp(pb.path, "/usr/lib");
+    lh_pathbuf_trunc(&pb, l2);
+    fail += strcmp(pb.path, "/usr");
+    lh_pathbuf_push(&pb, S("lib/"));
+    lh_pathbuf_pop(&pb);
+    fail += strcmp(pb.path, "/usr");
+    lh_pathbuf_pop(&pb);
+    fail += strcmp(pb.path, "/");
+    lh_pathbuf_pop(&pb);
+    fail += strcmp(pb.path, "/");
+
+    lh_pathbuf_set(&pb, S(""));
+    lh_pathbuf_push(&pb, S("a"));
+    fail += strcmp(pb.path, "a");
+    lh_pathbuf_free(&pb);
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(dirwalk, "directory walk paths") {
+    char base[] = "/tmp/lhtest_pathXXXXXX";
+    if (!mkdtemp(base)) {
+        printf("mkdtemp failed\n");
+        fail++;
+        return fail;
+    }
+
+    char p[256];
+    sprintf(p, "%s/sub", base);         mkdir(p, 0700);
+    sprintf(p, "%s/sub/deep", base);    mkdir(p, 0700);
+    sprintf(p, "%s/a.txt", base);       fclose(fopen(p, "w"));
+    sprintf(p, "%s/sub/b.txt", base);   fclose(fopen(p, "w"));
+    sprintf(p, "%s/sub/deep/c.txt", base); fclose(fopen(p, "w"));
+
+    // the base path with a trailing slash, which is stripped
+    sprintf(p, "%s/", base);
+    lh_dirwalk *dw = lh_dirwalk_create(p, LH_DW_DEFAULTS);
+    lh_dwres dr;
+    char got[1024] = "", exp[1024];
+    int res;
+    while ((res = lh_dirwalk_next(dw, &dr)) > 0) {
+        size_t n = strlen(got);
+        if (snprintf(got+n, sizeof(got)-n, "%d:%s:%s:%d ",
+                     res, dr.path, dr.name, dr.level) >= sizeof(got)-n) break;
+    }
+    lh_dirwalk_destroy(dw);
+
+    const char *B = base;
+    sprintf(exp, "2::%s:0 2:%s:sub:1 2:%s/sub:deep:2 1:%s/sub/deep:c.txt:3 "
+            "3:%s/sub:deep:3 1:%s/sub:b.txt:2 3:%s:sub:2 1:%s:a.txt:1 3::%s:1 ",
+            B, B, B, B, B, B, B, B, B);
+    int f = strcmp(got, exp) != 0;
+    if (f) printf("%s\n%s\n", got, exp);
+    fail += f;
+
+    sprintf(p, "rm -rf %s", base);
+    if (system(p)) fail++;
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(path) {
+
+    TEST(span);
+    TEST(path);
+    TEST(pathbuf);
+    TEST(dirwalk);
+
+} _TM;
@@ -0,0 +1,201 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_bytes : record pack/unpack
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lh_bytes.h>
+
+typedef struct {
+    float x, y, z;
+    float nx, ny, nz;
+    float tx, ty;
+} vtx;
+
+#define VTX_BE(F) F(x,float_be) F(y,float_be) F(z,float_be) \
+    F(nx,float_be) F(ny,float_be) F(nz,float_be) F(tx,float_be) F(ty,float_be)
+
+typedef vtx vtx_le;
+#define VTX_LE(F) F(x,float_le) F(y,float_le) F(z,float_le) \
+    F(nx,float_le) F(ny,float_le) F(nz,float_le) F(tx,float_le) F(ty,float_le)
+
+lh_def_record(vtx, VTX_BE)
+lh_def_record(vtx_le, VTX_LE)
+
+typedef struct {
+    int a, b, c;
+} tri;
+
+#define TRI(F) F(a,int_be) F(b,int_be) F(c,int_be)
+lh_def_record(tri, TRI)
+
+// the fields in a different order than in memory
+typedef tri tri_rev;
+#define TRI_REV(F) F(c,int_be) F(b,int_be) F(a,int_be)
+lh_def_record(tri_rev, TRI_REV)
+
+// padding, mixed sizes and varints
+typedef struct {
+    uint8_t  kind;
+    uint16_t x;
+    uint32_t id;
+    double   t;
+    uint64_t big;
+} item;
+
+#define ITEM(F) F(kind,char) F(x,short_le) F(id,varint) F(t,double_be) F(big,varlong)
+lh_def_record(item, ITEM)
+
+#define NR 100
+
+TF(record_fixed, "fixed-size records") {
+    static vtx v[NR], r[NR];
+    static tri t[NR], u[NR];
+    static uint8_t ref[NR*32], *p;
+    int i, n;
+
+    fail += (_lh_record_layout_vtx() != 4 || _lh_record_layout_vtx_le() != 1);
+    fail += (_lh_record_layout_tri() != 4 || _lh_record_layout_tri_rev() != 0);
+    fail += (lh_record_maxsize_vtx != 32 || lh_record_maxsize_tri != 12);
+
+    for(i=0; i<NR; i++) {
+        v[i] = (vtx){ i, i*0.5f, -i, 1, 2, 3, i/3.0f, -0.25f };
+        t[i] = (tri){ i, -i, i*1000003 };
+    }
+
+    for(n=0; n<NR; n+=(n<5) ? 1 : 31) {
+        // the encoding matches the field-by-field writes
+        lh_buf_t b;
+        lh_clear_obj(b);
+        p = ref;
+        for(i=0; i<n; i++) {
+            lh_write_float_be(p, v[i].x);  lh_write_float_be(p, v[i].y);
+            lh_write_float_be(p, v[i].z);  lh_write_float_be(p, v[i].nx);
+            lh_write_float_be(p, v[i].ny); lh_write_float_be(p, v[i].nz);
+            lh_write_float_be(p, v[i].tx); lh_write_float_be(p, v[i].ty);
+        }
+        fail += (lh_record_pack_vtx(&b, v, n) != n*32 || C(b.data) != n*32);
+        fail += (n && memcmp(P(b.data), ref, n*32));
+
+        p = P(b.data);
+        memset(r, 0, sizeof(r));
+        fail += (lh_record_unpack_vtx(&p, P(b.data)+C(b.data), r, NR) != n);
+        fail += (p != P(b.data)+C(b.data) || memcmp(r, v, n*sizeof(vtx)));
+
+        // little-endian is copied as is
+        C(b.data) = 0;
+        fail += (lh_record_pack_vtx_le(&b, v, n) != n*32 || (n && memcmp(P(b.data), v, n*32)));
+
+        // reversed field order
+        C(b.data) = 0;
+        lh_record_pack_tri(&b, t, n);
+        lh_record_pack_tri_rev(&b, t, n);
+        for(i=0; i<n; i++) {
+            fail += (lh_parse_int_be(P(b.data)+12*i) != t[i].a);
+            fail += (lh_parse_int_be(P(b.data)+12*(n+i)) != t[i].c);
+        }
+        p = P(b.data);
+        memset(u, 0, sizeof(u));
+        fail += (lh_record_unpack_tri(&p, P(b.data)+C(b.data), u, n) != n || memcmp(u, t, n*sizeof(tri)));
+        memset(u, 0, sizeof(u));
+        fail += (lh_record_unpack_tri_rev(&p, P(b.data)+C(b.data), u, n) != n || memcmp(u, t, n*sizeof(tri)));
+
+        lh_arr_free(AR(b.data));
+    }
+
+    // incomplete records are not read
+    p = ref;
+    fail += (lh_record_unpack_vtx(&p, ref+3*32+31, r, NR) != 3 || p != ref+3*32);
+    p = ref;
+    fail += (lh_record_unpack_tri_rev(&p, ref+11, u, NR) != 0 || p != ref);
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(record_varint, "records with varints") {
+    static item v[NR], r[NR];
+    static uint8_t ref[NR*lh_record_maxsize_item], *p;
+    int i, n;
+
+    fail += (_lh_record_layout_item() != 0 || lh_record_maxsize_item != 1+2+5+8+10);
+
+    srand(42);
+    for(i=0; i<NR; i++) {
+        memset(v+i, 0, sizeof(item));
+        v[i].kind = i;
+        v[i].x = rand();
+        v[i].id = rand() >> (rand()%31);
+        v[i].t = i*0.1;
+        v[i].big = ((uint64_t)rand()<<33) >> (rand()%64);
+    }
+
+    for(n=0; n<NR; n+=(n<5) ? 1 : 31) {
+        lh_buf_t b;
+        lh_clear_obj(b);
+        lh_arr_add(GAR4(b.data), 1);
+        P(b.data)[0] = 'H';
+
+        p = ref;
+        uint8_t *last = ref;
+        for(i=0; i<n; i++) {
+            last = p;
+            lh_write_char(p, v[i].kind);
+            lh_write_short_le(p, v[i].x);
+            lh_write_varint(p, v[i].id);
+            lh_write_double_be(p, v[i].t);
+            lh_write_varlong(p, v[i].big);
+        }
+        ssize_t len = p-ref, lastsize = p-last;
+        fail += (lh_record_pack_item(&b, v, n) != len || C(b.data) != 1+len);
+        fail += (P(b.data)[0] != 'H' || memcmp(P(b.data)+1, ref, len));
+
+        // all at once, and at every truncation of the last record
+        int cut;
+        for(cut=0; cut<=lastsize; cut++) {
+            memset(r, 0, sizeof(r));
+            p = ref;
+            int k = lh_record_unpack_item(&p, ref+len-cut, r, NR);
+            int expect = (cut && n) ? n-1 : n;
+            fail += (k != expect || memcmp(r, v, k*sizeof(item)));
+        }
+
+        // the reader fails if not all records are there
+        lh_reader rd;
+        lh_reader_init(&rd, ref, len);
+        fail += (lh_record_read_item(&rd, r, n) != n || rd.error || lh_reader_left(&rd));
+        lh_reader_init(&rd, ref, len);
+        fail += (lh_record_read_item(&rd, r, n+1) != n || !rd.error);
+
+        lh_arr_free(AR(b.data));
+    }
+
+    // over-long varints do not make the unchecked reads pass the limit
+    memset(ref, 0xff, sizeof(ref));
+    for(n=1; n<=NR; n++) {
+        p = ref;
+        int k = lh_record_unpack_item(&p, ref+n*lh_record_maxsize_item, r, NR);
+        fail += (k > n || p > ref+n*lh_record_maxsize_item);
+    }
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(record) {
+
+    TEST(record_fixed);
+    TEST(record_varint);
+
+} _TM;
@@ -0,0 +1,167 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_search : byte search primitives
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lh_cpu.h>
+#include <lh_search.h>
+
+#define SEARCH_LEN 1000
+
+// run the checks for every implementation the CPU supports
+static const int cpu_levels[] = {
+    0, LH_CPU_SSE2, LH_CPU_SSE2|LH_CPU_SSSE3, -1
+};
+#define NLEVELS (sizeof(cpu_levels)/sizeof(cpu_levels[0]))
+
+static ssize_t ref_find_set(const uint8_t *p, ssize_t len, const uint8_t *set, int nset) {
+    ssize_t i;
+    for(i=0; i<len; i++)
+        if (memchr(set, p[i], nset)) return i;
+    return -1;
+}
+
+static ssize_t ref_find_substr(const uint8_t *p, ssize_t len, const uint8_t *s, ssize_t slen) {
+    ssize_t i;
+    for(i=0; i+slen<=len; i++)
+        if (!memcmp(p+i, s, slen)) return i;
+    return -1;
+}
+
+static ssize_t ref_count(const uint8_t *p, ssize_t len, uint8_t c) {
+    ssize_t i, cnt=0;
+    for(i=0; i<len; i++) cnt += (p[i]==c);
+    return cnt;
+}
+
+TF(find_byte, "lh_find_byte/lh_count_byte") {
+    uint8_t buf[SEARCH_LEN];
+    int l, i, f;
+    srand(1);
+    for(i=0; i<SEARCH_LEN; i++) buf[i] = 'a'+rand()%20;
+
+    for(l=0; l<NLEVELS; l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        f = 0;
+
+        // every offset and length around the vector sizes
+        int off, len;
+        for(off=0; off<40; off++) {
+            for(len=0; len<100; len++) {
+                uint8_t c = 'a'+(off+len)%22;
+                uint8_t *r = memchr(buf+off, c, len);
+                ssize_t exp = r ? r-(buf+off) : -1;
+                f += (lh_find_byte(buf+off, len, c) != exp);
+                f += (lh_count_byte(buf+off, len, c) != ref_count(buf+off, len, c));
+            }
+        }
+        f += (lh_count_byte(buf, SEARCH_LEN, 'a') != ref_count(buf, SEARCH_LEN, 'a'));
+        f += (lh_find_byte(buf, SEARCH_LEN, 0) != -1);
+
+        // more than 255 vector iterations for the count accumulators
+        uint8_t *big = malloc(100000);
+        memset(big, '\n', 100000);
+        f += (lh_count_byte(big, 100000, '\n') != 100000);
+        big[99999] = 0;
+        f += (lh_find_byte(big, 100000, 0) != 99999);
+        free(big);
+
+        printf("cpu=%02x: %s\n", lh_cpu_features(), PASSFAIL(!f));
+        fail += f;
+    }
+    lh_cpu_restrict(-1);
+} _TF
+
+TF(find_set, "lh_find_anyof") {
+    uint8_t buf[SEARCH_LEN];
+    int l, i, f;
+    srand(2);
+    for(i=0; i<SEARCH_LEN; i++) buf[i] = rand();
+
+    const uint8_t *sets[] = {
+        (const uint8_t *)"\r\n",
+        (const uint8_t *)",;\"\n",
+        (const uint8_t *)"{}[]:,\"\\",
+        (const uint8_t *)"\x80\xff\x01\x7f\x10\x90",
+        (const uint8_t *)"0123456789abcdefghijklmnopqrstuvwxyz",
+    };
+    const int nsets = sizeof(sets)/sizeof(sets[0]);
+
+    for(l=0; l<NLEVELS; l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        f = 0;
+
+        int s, off;
+        for(s=0; s<nsets; s++) {
+            int nset = strlen((const char *)sets[s]);
+            for(off=0; off<SEARCH_LEN; off+=7) {
+                ssize_t len = SEARCH_LEN-off;
+                f += (lh_find_anyof(buf+off, len, sets[s], nset) !=
+                      ref_find_set(buf+off, len, sets[s], nset));
+            }
+        }
+        f += (lh_find_anyof(buf, SEARCH_LEN, NULL, 0) != -1);
+
+        printf("cpu=%02x: %s\n", lh_cpu_features(), PASSFAIL(!f));
+        fail += f;
+    }
+    lh_cpu_restrict(-1);
+} _TF
+
+TF(find_substr, "lh_find_substr") {
+    uint8_t buf[SEARCH_LEN];
+    int l, i, f;
+    srand(3);
+    for(i=0; i<SEARCH_LEN; i++) buf[i] = 'a'+rand()%3;
+
+    for(l=0; l<NLEVELS; l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        f = 0;
+
+        // needles taken from the data and a few that do not occur
+        int off, slen;
+        for(off=0; off<SEARCH_LEN; off+=37) {
+            for(slen=1; slen<20 && off+slen<=SEARCH_LEN; slen++) {
+                uint8_t needle[20];
+                memcpy(needle, buf+off, slen);
+                f += (lh_find_substr(buf, SEARCH_LEN, needle, slen) !=
+                      ref_find_substr(buf, SEARCH_LEN, needle, slen));
+                needle[slen-1] = 'x';
+                f += (lh_find_substr(buf, SEARCH_LEN, needle, slen) != -1);
+            }
+        }
+
+        const char *hay = "GET /index.html HTTP/1.1\r\nHost: x\r\n\r\n";
+        f += (lh_find_substr((const uint8_t *)hay, strlen(hay),
+                             (const uint8_t *)"\r\n\r\n", 4) != 33);
+        f += (lh_find_substr((const uint8_t *)hay, 3, (const uint8_t *)"GET", 3) != 0);
+        f += (lh_find_substr((const uint8_t *)hay, 2, (const uint8_t *)"GET", 3) != -1);
+        f += (lh_find_substr((const uint8_t *)hay, 2, (const uint8_t *)"", 0) != 0);
+
+        printf("cpu=%02x: %s\n", lh_cpu_features(), PASSFAIL(!f));
+        fail += f;
+    }
+    lh_cpu_restrict(-1);
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(search) {
+
+    TEST(find_byte);
+    TEST(find_set);
+    TEST(find_substr);
+
+} _TM;
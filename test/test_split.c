@@ -0,0 +1,107 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_split : incremental record splitter
+*/
+
+#include "lhtest.h"
+
+#include <lh_split.h>
+
+// split the text feeding it in chunks of the given size, and join the
+// records with '|' for comparison
+static int split_chunked(const char *text, ssize_t chunk, uint8_t delim, int flags,
+                         char *out) {
+    lh_splitter sp;
+    lh_splitter_init(&sp, delim, flags);
+    lh_span rec;
+    ssize_t len = strlen(text), pos;
+    int nrec = 0;
+    out[0] = 0;
+
+    for(pos=0; pos<len; pos+=chunk) {
+        // copy each chunk into a scratch buffer, overwritten by the next one
+        uint8_t buf[256];
+        ssize_t clen = (len-pos < chunk) ? len-pos : chunk;
+        memcpy(buf, text+pos, clen);
+
+        lh_splitter_feed(&sp, buf, clen);
+        while (lh_splitter_next(&sp, &rec)) {
+            strncat(out, (const char *)rec.ptr, rec.len);
+            strcat(out, "|");
+            nrec++;
+        }
+        memset(buf, '#', sizeof(buf));
+    }
+
+    lh_splitter_finish(&sp);
+    while (lh_splitter_next(&sp, &rec)) {
+        strncat(out, (const char *)rec.ptr, rec.len);
+        strcat(out, "|");
+        nrec++;
+    }
+
+    lh_splitter_free(&sp);
+    return nrec;
+}
+
+#define TEST_SPLIT(text,delim,flags,exp) {                              \
+        int f=0, chunk;                                                 \
+        char out[1024];                                                 \
+        for(chunk=1; chunk<=40; chunk++) {                              \
+            split_chunked(text, chunk, delim, flags, out);              \
+            if (strcmp(out, exp)) {                                     \
+                printf("chunk=%d: '%s' != '%s'\n", chunk, out, exp);    \
+                f++;                                                    \
+            }                                                           \
+        }                                                               \
+        printf("%s: %s\n", #text, PASSFAIL(!f));                        \
+        fail += f;                                                      \
+    }
+
+TF(lines, "splitting lines") {
+    TEST_SPLIT("alpha\nbeta\ngamma\n", '\n', 0, "alpha|beta|gamma|");
+    TEST_SPLIT("alpha\nbeta\ngamma", '\n', 0, "alpha|beta|gamma|");
+    TEST_SPLIT("alpha\n\nbeta\n", '\n', 0, "alpha|beta|");
+    TEST_SPLIT("alpha\n\nbeta\n", '\n', LH_SPLIT_EMPTY, "alpha||beta|");
+    TEST_SPLIT("alpha\r\nbeta\r\n\r\ngamma\r", '\n', LH_SPLIT_CRLF, "alpha|beta|gamma|");
+    TEST_SPLIT("alpha\r\nbeta\r\n", '\n', 0, "alpha\r|beta\r|");
+    TEST_SPLIT("a longer record that spans several chunks;x;;y", ';', LH_SPLIT_EMPTY,
+               "a longer record that spans several chunks|x||y|");
+    TEST_SPLIT("", '\n', 0, "");
+} _TF
+
+TF(zerocopy, "zero-copy records") {
+    const char *text = "one\ntwo\nthree\n";
+    lh_splitter sp;
+    lh_splitter_init(&sp, '\n', 0);
+    lh_splitter_feed(&sp, (const uint8_t *)text, strlen(text));
+
+    lh_span rec;
+    int n = 0;
+    while (lh_splitter_next(&sp, &rec)) {
+        // records within a chunk point into the chunk
+        fail += (rec.ptr < (const uint8_t *)text || rec.ptr >= (const uint8_t *)text+strlen(text));
+        n++;
+    }
+    fail += (n != 3);
+    fail += (C(sp.carry) != 0);
+    lh_splitter_free(&sp);
+
+    printf("records=%d: %s\n", n, PASSFAIL(!fail));
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(split) {
+
+    TEST(lines);
+    TEST(zerocopy);
+
+} _TM;
@@ -0,0 +1,197 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_utf8 : UTF-8 validation and transcoding
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lh_cpu.h>
+#include <lh_utf8.h>
+
+static const int cpu_levels[] = {
+    0, LH_CPU_SSE2, LH_CPU_SSE2|LH_CPU_SSSE3, -1
+};
+#define NLEVELS (sizeof(cpu_levels)/sizeof(cpu_levels[0]))
+
+// mixed text with 1 to 4-byte sequences
+static const char *sample =
+    "ASCII text, Grüße aus Köln, Ελληνικά, русский, 日本語のテキスト, "
+    "emoji \xf0\x9f\x98\x80\xf0\x9f\x8e\x89 and more plain ASCII text to fill a few blocks.";
+
+// invalid sequences, each must be rejected wherever it is placed
+// err is the offset of the error within the sequence
+static const struct { const char *seq; int len, err; } invalid[] = {
+    { "\x80", 1, 0 },           // stray continuation
+    { "\xbf\x80", 2, 0 },
+    { "\xc0\xaf", 2, 0 },       // overlong '/'
+    { "\xc1\xbf", 2, 0 },
+    { "\xe0\x80\xaf", 3, 0 },   // overlong 3-byte
+    { "\xe0\x9f\xbf", 3, 0 },
+    { "\xf0\x80\x80\xaf", 4, 0 }, // overlong 4-byte
+    { "\xf0\x8f\xbf\xbf", 4, 0 },
+    { "\xed\xa0\x80", 3, 0 },   // surrogate U+D800
+    { "\xed\xbf\xbf", 3, 0 },   // surrogate U+DFFF
+    { "\xf4\x90\x80\x80", 4, 0 }, // U+110000
+    { "\xf5\x80\x80\x80", 4, 0 },
+    { "\xff", 1, 0 },
+    { "\xc3", 1, 0 },           // truncated
+    { "\xe2\x82", 2, 0 },
+    { "\xf0\x9f\x98", 3, 0 },
+    { "\xc3\x28", 2, 0 },       // lead followed by ASCII
+    { "\xe2\x28\xa1", 3, 0 },
+    { "\xc3\xa9\xa9", 3, 2 },   // too many continuations
+};
+#define NINVALID (sizeof(invalid)/sizeof(invalid[0]))
+
+TF(validate, "lh_utf8_valid/lh_utf8_check") {
+    int l, f, k;
+    ssize_t slen = strlen(sample);
+
+    for(l=0; l<NLEVELS; l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        f = 0;
+
+        f += !lh_utf8_valid((const uint8_t *)sample, slen);
+        f += (lh_utf8_check((const uint8_t *)sample, slen) != slen);
+        f += !lh_utf8_valid((const uint8_t *)"\xef\xbf\xbf\xf4\x8f\xbf\xbf\xee\x80\x80", 10);
+        f += !lh_utf8_valid(NULL, 0);
+
+        // insert each invalid sequence at every position around the vector sizes
+        for(k=0; k<NINVALID; k++) {
+            int pos;
+            for(pos=0; pos<70; pos++) {
+                uint8_t buf[128];
+                memset(buf, 'x', sizeof(buf));
+                memcpy(buf+pos, invalid[k].seq, invalid[k].len);
+
+                // invalid sequence in the middle of the data
+                int ok = lh_utf8_valid(buf, 100);
+                f += ok;
+                if (ok) printf("not detected: seq=%d pos=%d\n", k, pos);
+                f += (lh_utf8_check(buf, 100) != pos+invalid[k].err);
+
+                // and at the end of the data
+                f += lh_utf8_valid(buf, pos+invalid[k].len);
+            }
+        }
+
+        // valid multi-byte sequences spanning block boundaries
+        for(k=0; k<40; k++) {
+            uint8_t buf[256];
+            memset(buf, 'x', k);
+            memcpy(buf+k, sample, slen);
+            f += !lh_utf8_valid(buf, k+slen);
+        }
+
+        // a truncated tail is not part of the valid prefix
+        f += (lh_utf8_check((const uint8_t *)"abc\xe6\x97", 5) != 3);
+
+        printf("cpu=%02x: %s\n", lh_cpu_features(), PASSFAIL(!f));
+        fail += f;
+    }
+    lh_cpu_restrict(-1);
+} _TF
+
+TF(random, "random data against scalar") {
+    int l, i, f;
+    uint8_t *buf = malloc(4096);
+    srand(5);
+
+    for(i=0; i<2000; i++) {
+        // mostly valid data with an occasional random byte
+        ssize_t len = rand()%4000, pos = 0;
+        while (pos < len) {
+            int r = rand()%100;
+            if (r < 80)        buf[pos++] = 'a'+rand()%26;
+            else if (r < 98) {
+                const char *s = sample + 40 + rand()%20;
+                while ((*s&0xc0) == 0x80) s++;
+                int n = 1 + (*s&0x80 ? 1 : 0) + ((*s&0xe0)==0xe0) + ((*s&0xf0)==0xf0);
+                if (pos+n > len) break;
+                memcpy(buf+pos, s, n);
+                pos += n;
+            }
+            else               buf[pos++] = rand();
+        }
+        len = pos;
+
+        lh_cpu_restrict(0);
+        ssize_t exp = lh_utf8_check(buf, len);
+        ssize_t cnt = lh_utf8_count(buf, len);
+        ssize_t u16 = lh_utf8_utf16_len(buf, len);
+
+        f = 0;
+        for(l=1; l<NLEVELS; l++) {
+            lh_cpu_restrict(cpu_levels[l]);
+            f += (lh_utf8_valid(buf, len) != (exp == len));
+            f += (lh_utf8_check(buf, len) != exp);
+            f += (lh_utf8_count(buf, len) != cnt);
+            f += (lh_utf8_utf16_len(buf, len) != u16);
+        }
+        if (f) printf("mismatch in sample %d\n", i);
+        fail += f;
+    }
+    lh_cpu_restrict(-1);
+    free(buf);
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(transcode, "UTF-8 <-> UTF-16") {
+    int l, f;
+    ssize_t slen = strlen(sample);
+    uint16_t u16[256];
+    uint8_t u8[768];
+
+    for(l=0; l<NLEVELS; l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        f = 0;
+
+        ssize_t n = lh_utf8_to_utf16((const uint8_t *)sample, slen, u16);
+        f += (n != lh_utf8_utf16_len((const uint8_t *)sample, slen));
+        f += (u16[0] != 'A');
+        f += (u16[14] != 0xfc);                      // ü
+
+        // the emoji is encoded as a surrogate pair
+        int i, sp=0;
+        for(i=0; i<n; i++) sp += (u16[i]>=0xd800 && u16[i]<=0xdfff);
+        f += (sp != 4);
+        f += (n != lh_utf8_count((const uint8_t *)sample, slen) + 2);
+
+        ssize_t m = lh_utf16_to_utf8(u16, n, u8);
+        f += (m != slen || memcmp(u8, sample, slen));
+
+        // errors
+        f += (lh_utf8_to_utf16((const uint8_t *)"abc\xed\xa0\x80", 6, u16) != -1);
+        uint16_t bad1[] = { 'a', 0xd800, 'b' };
+        uint16_t bad2[] = { 'a', 0xdc00 };
+        uint16_t bad3[] = { 'a', 0xd83d };
+        f += (lh_utf16_to_utf8(bad1, 3, u8) != -1);
+        f += (lh_utf16_to_utf8(bad2, 2, u8) != -1);
+        f += (lh_utf16_to_utf8(bad3, 2, u8) != -1);
+
+        printf("cpu=%02x: %s\n", lh_cpu_features(), PASSFAIL(!f));
+        fail += f;
+    }
+    lh_cpu_restrict(-1);
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(utf8) {
+
+    TEST(validate);
+    TEST(random);
+    TEST(transcode);
+
+} _TM;
@@ -0,0 +1,223 @@
+/*
+ Authors:
+ Copyright 2012-2015 by Eduard Broese <ed.broese@gmx.de>
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version
+ 2 of the License, or (at your option) any later version.
+
+ lh_bytes : varint encoding
+*/
+
+#include "lhtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lh_cpu.h>
+#include <lh_bytes.h>
+
+static int cpu_levels[] = {
+    0, LH_CPU_SSE2|LH_CPU_SSSE3, -1
+};
+
+// a value with a random number of significant bits
+static uint64_t rand_value(int maxbits) {
+    uint64_t v = ((uint64_t)rand()<<42) ^ ((uint64_t)rand()<<21) ^ rand();
+    int bits = rand()%(maxbits+1);
+    return bits ? v>>(64-bits) : 0;
+}
+
+TF(varlong, "64-bit varints") {
+    static const uint64_t values[] = {
+        0, 1, 0x7f, 0x80, 0x3fff, 0x4000, 0xffffffffULL, 0x100000000ULL,
+        0x7fffffffffffffffULL, 0x8000000000000000ULL, 0xffffffffffffffffULL,
+    };
+    static const int sizes[] = { 1, 1, 1, 2, 2, 3, 5, 5, 9, 10, 10 };
+    uint8_t buf[32];
+    int i, j;
+
+    for(i=0; i<sizeof(values)/sizeof(values[0]); i++) {
+        uint64_t v = values[i], r;
+        uint8_t *p = buf;
+        memset(buf, 0xaa, sizeof(buf));
+        lh_write_varlong(p, v);
+        fail += (p-buf != sizes[i] || lh_varlong_size(v) != sizes[i]);
+        fail += (lh_parse_varlong(buf) != v);
+
+        // the bounded reader at every limit, with and without a word load
+        for(j=0; j<=sizes[i]+8; j++) {
+            p = buf;
+            int ok = lh_lread_varlong(p, buf+j, r);
+            if (j < sizes[i])
+                fail += (ok || p != buf);
+            else
+                fail += (!ok || r != v || p != buf+sizes[i]);
+        }
+
+        // the bounded writer
+        for(j=0; j<=sizes[i]; j++) {
+            p = buf;
+            int ok = lh_lwrite_varlong(p, buf+j, v);
+            fail += (ok != (j == sizes[i]) || p != buf+(ok ? j : 0));
+        }
+    }
+
+    // an unterminated varint longer than 10 bytes
+    memset(buf, 0xff, sizeof(buf));
+    uint8_t *p = buf;
+    uint64_t r;
+    fail += lh_lread_varlong(p, buf+sizeof(buf), r);
+
+    // the 32-bit reader with a word load
+    uint32_t r32;
+    p = buf;
+    lh_write_varint(p, 0x12345678);
+    p = buf;
+    fail += (!lh_lread_varint(p, buf+sizeof(buf), r32) || r32 != 0x12345678 || p != buf+5);
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+#define NV 1000
+
+TF(varint_array, "bulk varint decoding") {
+    static uint64_t v[NV], r64[NV+1];
+    static uint32_t r32[NV+1];
+    static uint8_t buf[NV*10];
+    int l, maxbits, i;
+
+    for(l=0; l<sizeof(cpu_levels)/sizeof(int); l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        for(maxbits=7; maxbits<=64; maxbits+=(maxbits<35) ? 7 : 29) {
+            uint8_t *p = buf;
+            srand(maxbits);
+            for(i=0; i<NV; i++) {
+                v[i] = rand_value(maxbits);
+                lh_write_varlong(p, v[i]);
+            }
+            uint8_t *end = p;
+
+            p = buf;
+            r64[NV] = 0x55;
+            fail += (lh_lread_varlong_array(p, end, r64, NV) != NV || p != end);
+            for(i=0; i<NV; i++) fail += (r64[i] != v[i]);
+            fail += (r64[NV] != 0x55);
+
+            if (maxbits <= 35) {
+                p = buf;
+                r32[NV] = 0x55;
+                fail += (lh_lread_varint_array(p, end, r32, NV) != NV || p != end);
+                for(i=0; i<NV; i++) fail += (r32[i] != (uint32_t)v[i]);
+                fail += (r32[NV] != 0x55);
+            }
+
+            // truncated data stops at the last complete varint
+            uint8_t *cut = buf+(end-buf)/2;
+            uint8_t *q = buf;
+            int nc = 0;
+            while (q+lh_varlong_size(v[nc]) <= cut) q += lh_varlong_size(v[nc++]);
+            p = buf;
+            fail += (lh_lread_varlong_array(p, cut, r64, NV) != nc || p != q);
+
+            // fewer values than available
+            p = buf;
+            fail += (lh_lread_varlong_array(p, end, r64, 17) != 17);
+            q = buf;
+            for(i=0; i<17; i++) q += lh_varlong_size(v[i]);
+            fail += (p != q);
+        }
+    }
+    lh_cpu_restrict(-1);
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+TF(varint_encode, "bulk varint encoding") {
+    static uint32_t v32[NV], r32[NV];
+    static uint64_t v64[NV], r64[NV];
+    static int64_t s64[NV];
+    int l, f, i, n;
+
+    srand(37);
+    for(i=0; i<NV; i++) {
+        v32[i] = rand_value(32);
+        v64[i] = rand_value(64);
+        s64[i] = (int64_t)rand_value(40) - (int64_t)rand_value(40);
+    }
+
+    for(l=0; l<sizeof(cpu_levels)/sizeof(int); l++) {
+        lh_cpu_restrict(cpu_levels[l]);
+        for(n=0; n<NV; n+=(n<40) ? 1 : 97) {
+            for(f=0; f<4; f++) {
+                lh_buf_t b;
+                lh_clear_obj(b);
+
+                // existing data in the buffer is kept
+                lh_arr_add(GAR4(b.data), 3);
+                memcpy(P(b.data), "abc", 3);
+
+                // the size matches one-by-one encoding
+                ssize_t size = 0, size64 = 0;
+                uint32_t prev = 0;
+                uint64_t prev64 = 0;
+                for(i=0; i<n; i++) {
+                    uint32_t x = (f&LH_VARINT_DELTA) ? v32[i]-prev : v32[i];
+                    uint64_t x64 = (f&LH_VARINT_DELTA) ? v64[i]-prev64 : v64[i];
+                    if (f&LH_VARINT_ZIGZAG) {
+                        x = lh_zigzag_int(x);
+                        x64 = lh_zigzag_long(x64);
+                    }
+                    size += lh_varint_size(x);
+                    size64 += lh_varlong_size(x64);
+                    prev = v32[i];
+                    prev64 = v64[i];
+                }
+                fail += (lh_varint_size_array(v32, n, f) != size);
+                fail += (lh_varlong_size_array(v64, n, f) != size64);
+
+                fail += (lh_buf_put_varint_array(&b, v32, n, f) != size);
+                fail += (lh_buf_put_varlong_array(&b, v64, n, f) != size64);
+                ssize_t s2 = lh_buf_put_svarlong_array(&b, s64, n, f);
+                fail += (C(b.data) != 3+size+size64+s2 || memcmp(P(b.data), "abc", 3));
+
+                uint8_t *p = P(b.data)+3, *end = P(b.data)+C(b.data);
+                fail += (lh_lread_varint_array(p, end, r32, n) != n);
+                lh_varint_restore(r32, n, f);
+                fail += (n && memcmp(r32, v32, 4*n));
+
+                fail += (lh_lread_varlong_array(p, end, r64, n) != n);
+                lh_varlong_restore(r64, n, f);
+                fail += (n && memcmp(r64, v64, 8*n));
+
+                fail += (lh_lread_varlong_array(p, end, r64, n) != n || p != end);
+                lh_varlong_restore(r64, n, f);
+                fail += (n && memcmp(r64, s64, 8*n));
+
+                lh_arr_free(AR(b.data));
+            }
+        }
+    }
+    lh_cpu_restrict(-1);
+
+    // zigzag makes small negative values short
+    int64_t neg[4] = { -1, -64, 63, -65 };
+    lh_buf_t b;
+    lh_clear_obj(b);
+    fail += (lh_buf_put_svarlong_array(&b, neg, 4, LH_VARINT_ZIGZAG) != 5);
+    fail += (lh_buf_put_svarlong_array(&b, neg, 4, 0) != 31);
+    lh_arr_free(AR(b.data));
+
+    printf("%s\n", PASSFAIL(!fail));
+} _TF
+
+////////////////////////////////////////////////////////////////////////////////
+
+TM(varint) {
+
+    TEST(varlong);
+    TEST(varint_array);
+    TEST(varint_encode);
+
+} _TM;